@@ -0,0 +1,144 @@
+// 主機上的回切模擬：主要伺服器故障後裝置連上備援伺服器，以1秒為步進模擬8小時，
+// 依韌體相同的BrokerPool判斷回切 (探測以TCP是否可連線決定結果，不需真的建立連線)。
+// 三種情境：
+//   1. 主要伺服器一直故障：不可以為了回切而中斷備援連線，探測間隔依回切失敗次數倍增
+//   2. 主要伺服器40分鐘後恢復：恢復後只回切一次並留在主要伺服器
+//   3. 主要伺服器接受TCP但拒絕MQTT連線：每次回切都失敗，回切次數受倍增的等待限制
+//
+// 編譯 (在hardware目錄)：
+//   g++ -O2 -std=gnu++11 -Ihost/include -Iinclude bench/broker_failback_bench.cpp src/BrokerPool.cpp -o broker_failback_bench
+//   ./broker_failback_bench
+
+#include <Arduino.h>
+#include <climits>
+#include <vector>
+#include "BrokerPool.h"
+
+static const unsigned long STEP_MS = 1000;
+static const unsigned long SIMULATION_MS = 8UL * 3600 * 1000;
+static const unsigned long RETRY_MS = 5000;        // 連線失敗後的重試間隔
+static const unsigned long CONNECT_MS = 500;       // 連線耗時 (與未量測伺服器的預設值相同，只靠順位決定回切)
+
+struct Scenario {
+    const char* name;
+    unsigned long primaryUpAt;      // 主要伺服器恢復TCP的時間 (ULONG_MAX代表不恢復)
+    bool primaryAcceptsMqtt;        // 恢復後是否接受MQTT連線
+};
+
+struct Outcome {
+    unsigned failbacks;             // 為了回切而中斷的次數
+    unsigned failedFailbacks;       // 回切後連線失敗的次數
+    unsigned probes;
+    unsigned long failbackMillis;   // 最後一次成功回切的時間 (0代表沒有)
+    uint8_t finalBroker;
+    std::vector<unsigned long> probeTimes;
+};
+
+static bool tcpUp(const Scenario& scenario, uint8_t index, unsigned long now) {
+    return index != 0 || now >= scenario.primaryUpAt;
+}
+
+static bool mqttUp(const Scenario& scenario, uint8_t index, unsigned long now) {
+    return tcpUp(scenario, index, now) && (index != 0 || scenario.primaryAcceptsMqtt);
+}
+
+static Outcome simulate(const Scenario& scenario) {
+    BrokerPool pool;
+    pool.add("primary", 1883);
+    pool.add("backup", 1883);
+
+    Outcome outcome = Outcome();
+    bool connected = false;
+    bool failingBack = false;
+    unsigned long nextAttempt = 0;
+
+    // 從1開始，0在韌體中代表「沒有失敗」
+    for (unsigned long now = 1; now < SIMULATION_MS; now += STEP_MS) {
+        if (connected) {
+            if (pool.shouldFailBack(now)) {
+                outcome.failbacks++;
+                connected = false;
+                failingBack = true;
+                nextAttempt = now;
+            } else if (pool.pendingProbe() >= 0) {
+                uint8_t target = pool.pendingProbe();
+                outcome.probes++;
+                outcome.probeTimes.push_back(now);
+                pool.recordProbe(target, now, tcpUp(scenario, target, now));
+            }
+            continue;
+        }
+
+        if (now < nextAttempt) {
+            continue;
+        }
+        pool.selectForReconnect(now);
+        uint8_t index = pool.currentIndex();
+        if (mqttUp(scenario, index, now)) {
+            pool.recordConnect(now, CONNECT_MS);
+            connected = true;
+            if (failingBack && index == 0) {
+                outcome.failbackMillis = now;
+            }
+        } else {
+            pool.recordFailure(now);
+            if (failingBack) {
+                outcome.failedFailbacks++;
+            }
+            nextAttempt = now + RETRY_MS;
+        }
+        failingBack = false;
+    }
+
+    outcome.finalBroker = pool.currentIndex();
+    return outcome;
+}
+
+static void print(const Scenario& scenario, const Outcome& outcome) {
+    printf("%s: 回切中斷 %u 次 (失敗 %u 次), 探測 %u 次, 最後使用 %s", scenario.name, outcome.failbacks,
+           outcome.failedFailbacks, outcome.probes, outcome.finalBroker == 0 ? "主要伺服器" : "備援伺服器");
+    if (outcome.failbackMillis != 0) {
+        printf(", 於 %lu 分鐘回切", outcome.failbackMillis / 60000);
+    }
+    printf("\n  探測時間 (分鐘):");
+    for (size_t i = 0; i < outcome.probeTimes.size(); i++) {
+        printf(" %lu", outcome.probeTimes[i] / 60000);
+    }
+    printf("\n");
+}
+
+int main() {
+    int failures = 0;
+
+    Scenario down = {"主要伺服器一直故障", ULONG_MAX, true};
+    Outcome result = simulate(down);
+    print(down, result);
+    if (result.failbacks != 0 || result.finalBroker != 1) {
+        printf("  錯誤: 主要伺服器故障時仍中斷備援連線\n");
+        failures++;
+    }
+    // 5、10、20、40分鐘後倍增到80分鐘為止，8小時內不應超過10次
+    if (result.probes > 10) {
+        printf("  錯誤: 探測間隔沒有倍增\n");
+        failures++;
+    }
+
+    Scenario recovered = {"主要伺服器40分鐘後恢復", 40UL * 60000, true};
+    result = simulate(recovered);
+    print(recovered, result);
+    if (result.failbacks != 1 || result.finalBroker != 0 || result.failbackMillis == 0) {
+        printf("  錯誤: 主要伺服器恢復後沒有回切，或回切超過一次\n");
+        failures++;
+    }
+
+    Scenario halfUp = {"主要伺服器接受TCP但拒絕MQTT", 0, false};
+    result = simulate(halfUp);
+    print(halfUp, result);
+    if (result.failbacks > 10 || result.failbacks != result.failedFailbacks || result.finalBroker != 1) {
+        printf("  錯誤: 回切失敗後等待沒有倍增\n");
+        failures++;
+    }
+
+    printf("%s\n", failures == 0 ? "全部通過" : "有檢查失敗");
+    return failures == 0 ? 0 : 1;
+}
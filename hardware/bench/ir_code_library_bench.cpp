@@ -0,0 +1,129 @@
+// 主機上的IR碼庫基準：以記憶體中的NVS (host/include/Preferences.h) 驗證保存、名稱查詢、
+// 重複名稱、學習時保留編號、重新開機後讀回、快取命中不讀Flash、淘汰與刪除，並比較快取命中與從Flash讀取的耗時。
+//
+// 編譯 (在hardware目錄)：
+//   g++ -O2 -std=gnu++11 -DAIOT_LOG_LEVEL=0 -Ihost/include -Iinclude bench/ir_code_library_bench.cpp src/IRCodeLibrary.cpp src/StorageManager.cpp src/IRTimingCodec.cpp -o ir_code_library_bench
+//   ./ir_code_library_bench
+
+#include <Arduino.h>
+#include <Preferences.h>
+#include <chrono>
+#include "IRCodeLibrary.h"
+
+static const int ITERATIONS = 200000;
+
+static int failures = 0;
+
+static void check(bool condition, const char* what) {
+    printf("%s %s\n", condition ? "通過" : "失敗", what);
+    if (!condition) {
+        failures++;
+    }
+}
+
+// 冷氣長訊框：前導 + 100個時序中的位元交替長短間隔
+static IRCommand makeRaw() {
+    IRCommand cmd = IRCommand();
+    cmd.type = IRCommandType::RAW;
+    cmd.khz = 38;
+    cmd.rawLength = IR_COMMAND_MAX_RAW;
+    cmd.raw[0] = 9000;
+    cmd.raw[1] = 4500;
+    for (uint16_t i = 2; i < IR_COMMAND_MAX_RAW; i++) {
+        cmd.raw[i] = (i & 1) == 0 ? 560 : ((i / 2) % 3 == 0 ? 1690 : 560);
+    }
+    return cmd;
+}
+
+static IRCommand makeNec(uint32_t value) {
+    IRCommand cmd = IRCommand();
+    cmd.type = IRCommandType::NEC;
+    cmd.value = value;
+    cmd.bits = 32;
+    cmd.khz = 38;
+    return cmd;
+}
+
+// 還原後的時序與原始時序相差在12.5%以內 (接收器容錯為25%)
+static bool closeTo(const IRCommand& a, const IRCommand& b) {
+    if (a.rawLength != b.rawLength) {
+        return false;
+    }
+    for (uint16_t i = 0; i < a.rawLength; i++) {
+        uint32_t diff = a.raw[i] > b.raw[i] ? a.raw[i] - b.raw[i] : b.raw[i] - a.raw[i];
+        if (diff * 8 > b.raw[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+int main() {
+    StorageManager storage("ircodes");
+    IRCommand raw = makeRaw();
+    {
+        IRCodeLibrary library(&storage);
+        check(library.allocateId() == 0, "空碼庫分配編號0");
+        check(library.store(17, "tv_power", makeNec(0x00FFA25D)), "保存NEC");
+        check(library.store(0, "ac", raw), "保存原始時序");
+        check(!library.store(3, "ac", makeNec(1)), "拒絕重複的名稱");
+        check(library.findId("tv_power") == 17 && library.findId("fan") == -1, "以名稱查詢編號");
+        check(library.allocateId() == 1, "分配最小的可用編號");
+
+        // 學習時保留的編號與名稱在訊框到達前不會被其他store取得
+        int32_t reserved = library.reserve(-1, "fan");
+        check(reserved == 1 && library.allocateId() == 2, "學習保留的編號不會被分配");
+        check(!library.store(2, "fan", makeNec(2)), "保留的名稱不可被其他編號使用");
+        check(library.store(reserved, "fan", makeNec(3)) && library.allocateId() == 2, "保存學習的IR碼後解除保留");
+        library.remove(reserved);
+        reserved = library.reserve(-1, NULL);
+        library.release(reserved);
+        check(reserved == 1 && library.allocateId() == 1, "逾時解除保留");
+    }
+
+    // 新的實例相當於重新開機：索引與IR碼都從Flash讀回
+    IRCodeLibrary library(&storage);
+    IRCommand out = IRCommand();
+    check(library.load(17, out) && out.type == IRCommandType::NEC && out.value == 0x00FFA25D && out.bits == 32,
+          "重新開機後讀回NEC");
+    check(library.load(0, out) && out.type == IRCommandType::RAW && closeTo(out, raw), "重新開機後讀回原始時序");
+
+    uint32_t reads = hostNvs().reads;
+    check(library.load(17, out) && library.load(0, out) && hostNvs().reads == reads, "快取命中不讀取Flash");
+
+    for (uint16_t id = 100; id < 100 + IRCodeLibrary::CACHE_SIZE; id++) {
+        library.store(id, NULL, makeNec(id));
+    }
+    reads = hostNvs().reads;
+    check(library.load(17, out) && hostNvs().reads > reads, "淘汰最久未使用的快取項目");
+
+    check(library.remove(100) && !library.load(100, out), "刪除IR碼");
+    IRCodeLibraryStats stats = library.getStats();
+    check(stats.codes == 2 + IRCodeLibrary::CACHE_SIZE - 1, "統計的IR碼數");
+    printf("Flash紀錄: 原始時序 %u 位元組 (%u 個時序)\n",
+           (unsigned)hostNvs().entries["ircodes/c0"].size(), (unsigned)raw.rawLength);
+
+    // 快取命中：同一筆原始時序反覆讀取
+    library.load(0, out);
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (int i = 0; i < ITERATIONS; i++) {
+        library.load(0, out);
+    }
+    double hitNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / ITERATIONS;
+
+    // 快取未命中：輪流讀取比快取多一筆的IR碼，每次都要讀Flash並解碼
+    uint16_t ids[IRCodeLibrary::CACHE_SIZE + 1];
+    for (size_t i = 0; i < IRCodeLibrary::CACHE_SIZE + 1; i++) {
+        ids[i] = 200 + i;
+        library.store(ids[i], NULL, raw);
+    }
+    start = std::chrono::steady_clock::now();
+    for (int i = 0; i < ITERATIONS; i++) {
+        library.load(ids[i % (IRCodeLibrary::CACHE_SIZE + 1)], out);
+    }
+    double missNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / ITERATIONS;
+
+    printf("原始時序讀取: 快取命中 %.0f ns, 從Flash讀取並解碼 %.0f ns\n", hitNs, missNs);
+    printf("%s\n", failures == 0 ? "全部通過" : "有檢查失敗");
+    return failures == 0 ? 0 : 1;
+}
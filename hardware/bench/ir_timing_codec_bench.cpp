@@ -0,0 +1,227 @@
+// 主機上的IR時序編碼基準：以常見遙控器協議的擷取樣本 (加入接收抖動) 為語料，
+// 比較publishIRReceived()原本的JSON陣列與IRTimingCodec的大小、還原誤差與解碼速度。
+//
+// 編譯：
+//   g++ -O2 -std=gnu++11 -Iinclude bench/ir_timing_codec_bench.cpp src/IRTimingCodec.cpp -o ir_timing_codec_bench
+//   ./ir_timing_codec_bench
+
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "IRTimingCodec.h"
+
+// 與IR_COMMAND_MAX_RAW相同
+static const size_t MAX_TIMINGS = 100;
+static const int ITERATIONS = 100000;
+
+struct Capture {
+    const char* name;
+    uint16_t khz;
+    uint16_t timings[MAX_TIMINGS];
+    size_t count;
+};
+
+// 簡單的線性同餘亂數，結果在每個平台都相同
+static uint32_t seed = 12345;
+static int jitter(int range) {
+    seed = seed * 1103515245 + 12345;
+    return (int)((seed >> 16) % (2 * range + 1)) - range;
+}
+
+// 接收器輸出的標記偏長、間隔偏短，並以2us (RAWTICK) 為單位
+static void add(Capture& capture, int micros, bool mark) {
+    if (capture.count >= MAX_TIMINGS) {
+        return;
+    }
+    int value = micros + (mark ? 40 : -40) + jitter(60);
+    capture.timings[capture.count++] = (uint16_t)(value / 2 * 2);
+}
+
+static void addBits(Capture& capture, uint64_t data, int bits, int mark, int one, int zero, bool msbFirst) {
+    for (int i = 0; i < bits; i++) {
+        int bit = msbFirst ? bits - 1 - i : i;
+        add(capture, mark, true);
+        add(capture, (data >> bit) & 1 ? one : zero, false);
+    }
+}
+
+static Capture nec(uint32_t value) {
+    Capture capture = {"NEC", 38, {0}, 0};
+    add(capture, 9000, true);
+    add(capture, 4500, false);
+    addBits(capture, value, 32, 560, 1690, 560, false);
+    add(capture, 560, true);
+    return capture;
+}
+
+static Capture necRepeat() {
+    Capture capture = {"NEC重複", 38, {0}, 0};
+    add(capture, 9000, true);
+    add(capture, 2250, false);
+    add(capture, 560, true);
+    return capture;
+}
+
+static Capture samsung(uint32_t value) {
+    Capture capture = {"SAMSUNG", 38, {0}, 0};
+    add(capture, 4500, true);
+    add(capture, 4500, false);
+    addBits(capture, value, 32, 560, 1690, 560, true);
+    add(capture, 560, true);
+    return capture;
+}
+
+static Capture sony(uint32_t value) {
+    Capture capture = {"SONY x3", 40, {0}, 0};
+    for (int frame = 0; frame < 3; frame++) {
+        add(capture, 2400, true);
+        add(capture, 600, false);
+        for (int i = 0; i < 12; i++) {
+            add(capture, (value >> i) & 1 ? 1200 : 600, true);
+            add(capture, i == 11 ? 25800 : 600, false);
+        }
+    }
+    capture.count--;  // 最後一個間隔不會被擷取
+    return capture;
+}
+
+// RC5曼徹斯特編碼，相鄰的同電位半位元合併為較長的脈衝
+static Capture rc5(uint32_t value) {
+    Capture capture = {"RC5", 36, {0}, 0};
+    bool level[28];
+    int halves = 0;
+    uint32_t frame = (value & 0x7FF) | (0x3 << 12);
+    for (int i = 13; i >= 0; i--) {
+        bool bit = (frame >> i) & 1;
+        level[halves++] = !bit;
+        level[halves++] = bit;
+    }
+    int start = level[0] ? 0 : 1;
+    int length = 889;
+    for (int i = start + 1; i <= halves; i++) {
+        if (i < halves && level[i] == level[i - 1]) {
+            length += 889;
+            continue;
+        }
+        add(capture, length, level[i - 1]);
+        length = 889;
+    }
+    return capture;
+}
+
+// 冷氣遙控器的長訊框 (超過100個時序時截斷，與publishIRReceived相同)
+static Capture airConditioner() {
+    Capture capture = {"冷氣 (截斷)", 38, {0}, 0};
+    static const uint8_t state[] = {0x23, 0xCB, 0x26, 0x01, 0x00, 0x24, 0x03, 0x0B, 0x38, 0x00, 0x00, 0x00, 0x00, 0x2D};
+    add(capture, 3400, true);
+    add(capture, 1750, false);
+    for (size_t i = 0; i < sizeof(state); i++) {
+        addBits(capture, state[i], 8, 450, 1300, 420, false);
+    }
+    return capture;
+}
+
+// publishIRReceived()原本輸出的 "raw":[...] 欄位長度
+static size_t jsonArrayLength(const Capture& capture) {
+    char buffer[16];
+    size_t length = strlen("\"raw\":[]");
+    for (size_t i = 0; i < capture.count; i++) {
+        length += snprintf(buffer, sizeof(buffer), "%u", capture.timings[i]) + (i > 0 ? 1 : 0);
+    }
+    return length;
+}
+
+int main() {
+    Capture corpus[] = {
+        nec(0x00FF20DF), nec(0xF708FB04), necRepeat(), samsung(0xE0E040BF),
+        sony(0xA90), rc5(0x0C), rc5(0x7A5), airConditioner(),
+    };
+    const size_t corpusSize = sizeof(corpus) / sizeof(corpus[0]);
+
+    size_t totalJson = 0;
+    size_t totalBinary = 0;
+    size_t totalBase64 = 0;
+    size_t totalTimings = 0;
+    double worstError = 0;
+    static uint8_t encoded[corpusSize][512];
+    size_t encodedLength[corpusSize];
+
+    printf("%-14s %5s %6s %6s %6s %7s %7s\n", "訊框", "時序", "JSON", "二進位", "base64", "壓縮比", "誤差");
+    for (size_t c = 0; c < corpusSize; c++) {
+        const Capture& capture = corpus[c];
+        size_t length = IRTimingCodec::encode(capture.timings, capture.count, capture.khz, encoded[c], sizeof(encoded[c]));
+        if (length == 0 || length > IRTimingCodec::maxEncodedSize(capture.count)) {
+            printf("編碼失敗: %s\n", capture.name);
+            return 1;
+        }
+        encodedLength[c] = length;
+
+        char text[1024];
+        size_t textLength = IRTimingCodec::toBase64(encoded[c], length, text, sizeof(text));
+        uint8_t roundTrip[512];
+        if (IRTimingCodec::fromBase64(text, textLength, roundTrip, sizeof(roundTrip)) != length ||
+            memcmp(roundTrip, encoded[c], length) != 0) {
+            printf("base64不一致: %s\n", capture.name);
+            return 1;
+        }
+
+        uint16_t decoded[MAX_TIMINGS];
+        uint16_t khz = 0;
+        if (IRTimingCodec::decode(encoded[c], length, decoded, MAX_TIMINGS, &khz) != capture.count || khz != capture.khz) {
+            printf("解碼失敗: %s\n", capture.name);
+            return 1;
+        }
+
+        // 相對誤差必須遠小於接收器的25%容錯
+        double error = 0;
+        for (size_t i = 0; i < capture.count; i++) {
+            double diff = (double)abs((int)decoded[i] - (int)capture.timings[i]) / capture.timings[i];
+            if (diff > error) {
+                error = diff;
+            }
+        }
+        if (error > 0.15) {
+            printf("誤差過大: %s %.1f%%\n", capture.name, error * 100);
+            return 1;
+        }
+        if (error > worstError) {
+            worstError = error;
+        }
+
+        size_t json = jsonArrayLength(capture);
+        size_t base64 = strlen("\"code\":\"\"") + textLength;
+        printf("%-14s %5u %6u %6u %6u %6.1fx %6.1f%%\n", capture.name, (unsigned)capture.count,
+               (unsigned)json, (unsigned)length, (unsigned)base64, (double)json / base64, error * 100);
+        totalJson += json;
+        totalBinary += length;
+        totalBase64 += base64;
+        totalTimings += capture.count;
+    }
+
+    printf("合計: JSON %u 位元組, 二進位 %u 位元組 (Flash原格式 %u), base64欄位 %u 位元組\n",
+           (unsigned)totalJson, (unsigned)totalBinary, (unsigned)totalTimings * 2, (unsigned)totalBase64);
+    printf("壓縮比: MQTT %.1fx, Flash %.1fx, 最大誤差 %.1f%%\n",
+           (double)totalJson / totalBase64, (double)totalTimings * 2 / totalBinary, worstError * 100);
+
+    uint16_t decoded[MAX_TIMINGS];
+    volatile uint32_t sink = 0;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (int i = 0; i < ITERATIONS; i++) {
+        size_t c = i % corpusSize;
+        sink += IRTimingCodec::decode(encoded[c], encodedLength[c], decoded, MAX_TIMINGS, nullptr);
+    }
+    double decodeNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / ITERATIONS;
+
+    start = std::chrono::steady_clock::now();
+    for (int i = 0; i < ITERATIONS; i++) {
+        size_t c = i % corpusSize;
+        uint8_t buffer[512];
+        sink += IRTimingCodec::encode(corpus[c].timings, corpus[c].count, corpus[c].khz, buffer, sizeof(buffer));
+    }
+    double encodeNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / ITERATIONS;
+
+    printf("解碼: %.0f ns/訊框 (%.1f ns/時序), 編碼: %.0f ns/訊框\n",
+           decodeNs, decodeNs * corpusSize * ITERATIONS / ((double)totalTimings * ITERATIONS), encodeNs);
+    return sink == 0;
+}
@@ -0,0 +1,126 @@
+// 主機上的訊息編碼基準：以與韌體相同的JsonDocument內容，比較publishJson()的文字JSON (serializeJson)
+// 與MessagePack (serializeMsgPack) 的輸出位元組數與序列化耗時。
+// 語料：單筆遙測、補傳的遙測、16筆批次遙測 (TelemetryBatcher)、NEC接收結果，
+// 以及舊格式的100個原始時序 (data陣列)。
+//
+// 編譯 (先以PlatformIO建置一次，讓ArduinoJson下載到.pio/libdeps)：
+//   g++ -O2 -std=gnu++11 -Ihost/include -Iinclude -I.pio/libdeps/nodemcu-32s/ArduinoJson/src
+//       bench/payload_encoding_bench.cpp src/TelemetryBatcher.cpp -o payload_encoding_bench
+//   ./payload_encoding_bench
+
+#include <ArduinoJson.h>
+#include <chrono>
+#include <stdio.h>
+#include <string.h>
+#include "TelemetryBatcher.h"
+
+static const char* DEVICE_ID = "24:6F:28:AB:CD:EF";
+static const char* ROOM_ID = "living-room";
+static const int ITERATIONS = 100000;
+
+// 與MQTTManager::publishSample()相同的單筆遙測
+static void buildSample(JsonDocument& doc, bool replay) {
+    doc.clear();
+    doc["temp"] = 25.3f;
+    doc["humidity"] = 61.2f;
+    doc["deviceId"] = DEVICE_ID;
+    doc["features"] = "ir_control";
+    doc["roomId"] = ROOM_ID;
+    if (replay) {
+        doc["replay"] = true;
+        doc["ts"] = 1760000000u;
+        doc["queued"] = 37;
+        doc["dropped"] = 0;
+    }
+}
+
+// 與MQTTManager::flushBatch()相同的16筆批次遙測 (每5秒一筆，讀數小幅變動)
+static void buildBatch(JsonDocument& doc) {
+    TelemetryBatcher batcher;
+    batcher.configure(TelemetryBatcher::MAX_BATCH_SIZE, 120000);
+    for (uint8_t i = 0; i < TelemetryBatcher::MAX_BATCH_SIZE; i++) {
+        TelemetrySample sample;
+        sample.timestamp = 1760000000u + i * 5;
+        sample.capturedMillis = 100000 + i * 5000;
+        sample.temperature = 25.3f + (i % 3) * 0.1f;
+        sample.humidity = 61.2f - (i % 4) * 0.1f;
+        batcher.add(sample);
+    }
+    doc.clear();
+    doc["deviceId"] = DEVICE_ID;
+    doc["roomId"] = ROOM_ID;
+    doc["features"] = "ir_control";
+    batcher.encode(doc);
+}
+
+// 與IRManager::publishIRReceived()相同的NEC接收結果
+static void buildNec(JsonDocument& doc) {
+    doc.clear();
+    doc["type"] = "NEC";
+    doc["bits"] = 32;
+    doc["value"] = 0x00FFA25Du;
+    doc["address"] = 0x00;
+    doc["command"] = 0x45;
+}
+
+// 舊格式的原始時序 (冷氣長訊框：前導 + 交替的長短間隔)
+static void buildRaw(JsonDocument& doc) {
+    doc.clear();
+    doc["type"] = "UNKNOWN";
+    doc["bits"] = 0;
+    JsonArray data = doc.createNestedArray("data");
+    data.add(9000);
+    data.add(4500);
+    for (int i = 2; i < 100; i++) {
+        data.add((i & 1) == 0 ? 560 : ((i / 2) % 3 == 0 ? 1690 : 560));
+    }
+}
+
+static double timeSerialize(JsonDocument& doc, bool msgpack, uint8_t* buffer, size_t size) {
+    volatile size_t sink = 0;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (int i = 0; i < ITERATIONS; i++) {
+        sink += msgpack ? serializeMsgPack(doc, buffer, size) : serializeJson(doc, (char*)buffer, size);
+    }
+    double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+    return sink > 0 ? ns / ITERATIONS : 0;
+}
+
+// 輸出一列結果，兩種編碼都必須能還原為相同的文檔
+static bool report(const char* name, JsonDocument& doc) {
+    uint8_t json[1024];
+    uint8_t msgpack[1024];
+    size_t jsonLength = serializeJson(doc, (char*)json, sizeof(json));
+    size_t msgpackLength = serializeMsgPack(doc, msgpack, sizeof(msgpack));
+
+    StaticJsonDocument<2048> decoded;
+    char roundTrip[1024];
+    bool same = !deserializeMsgPack(decoded, msgpack, msgpackLength) &&
+                serializeJson(decoded, roundTrip, sizeof(roundTrip)) == jsonLength &&
+                memcmp(roundTrip, json, jsonLength) == 0;
+
+    double jsonNs = timeSerialize(doc, false, json, sizeof(json));
+    double msgpackNs = timeSerialize(doc, true, msgpack, sizeof(msgpack));
+    printf("%-12s JSON %4u B %6.0f ns | MessagePack %4u B %6.0f ns | 位元組 %3.0f%%%s\n", name,
+           (unsigned)jsonLength, jsonNs, (unsigned)msgpackLength, msgpackNs, 100.0 * msgpackLength / jsonLength,
+           same ? "" : " (還原不一致)");
+    return same;
+}
+
+int main() {
+    StaticJsonDocument<2048> doc;
+    bool ok = true;
+
+    buildSample(doc, false);
+    ok = report("單筆遙測", doc) && ok;
+    buildSample(doc, true);
+    ok = report("補傳遙測", doc) && ok;
+    buildBatch(doc);
+    ok = report("16筆批次", doc) && ok;
+    buildNec(doc);
+    ok = report("NEC接收", doc) && ok;
+    buildRaw(doc);
+    ok = report("100個時序", doc) && ok;
+
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,95 @@
+// 主機上的遙測序列化微基準：比較publishSample()的ArduinoJson路徑與PayloadTemplate
+// 並逐位元組比對兩者在感測器範圍內的輸出。
+//
+// 編譯 (先以PlatformIO建置一次，讓ArduinoJson下載到.pio/libdeps)：
+//   g++ -O2 -std=gnu++11 -Iinclude -I.pio/libdeps/nodemcu-32s/ArduinoJson/src \
+//       bench/payload_template_bench.cpp src/PayloadTemplate.cpp -o payload_template_bench
+//   ./payload_template_bench
+
+#include <ArduinoJson.h>
+#include <chrono>
+#include <stdio.h>
+#include <string.h>
+#include "PayloadTemplate.h"
+
+static const char* DEVICE_ID = "A1B2C3D4E5F6";
+static const char* ROOM_ID = "living-room";
+static const int ITERATIONS = 200000;
+
+// 與MQTTManager::publishSample()相同的文檔，裝置主題與房間主題各序列化一次
+static size_t serializeLegacy(float temperature, float humidity, char* buffer, size_t size) {
+    StaticJsonDocument<256> doc;
+    doc["temp"] = temperature;
+    doc["humidity"] = humidity;
+    doc["deviceId"] = DEVICE_ID;
+    doc["features"] = "ir_control";
+    doc["roomId"] = ROOM_ID;
+
+    size_t length = serializeJson(doc, buffer, size);
+    length += serializeJson(doc, buffer, size);
+    return length / 2;
+}
+
+static void buildTemplate(PayloadTemplate& payload) {
+    payload.appendLiteral("{\"temp\":");
+    payload.appendSlot();
+    payload.appendLiteral(",\"humidity\":");
+    payload.appendSlot();
+    payload.appendLiteral(",\"deviceId\":");
+    payload.appendString(DEVICE_ID);
+    payload.appendLiteral(",\"features\":\"ir_control\",\"roomId\":");
+    payload.appendString(ROOM_ID);
+    payload.appendLiteral("}");
+}
+
+static size_t serializeTemplate(const PayloadTemplate& payload, float temperature, float humidity,
+                                char* buffer, size_t size) {
+    double values[2] = { temperature, humidity };
+    return payload.render(values, 2, buffer, size);
+}
+
+int main() {
+    PayloadTemplate payload;
+    buildTemplate(payload);
+
+    char expected[256];
+    char actual[256];
+
+    // 逐位元組比對: DHT22範圍 (溫度-40~80°C、濕度0~100%，解析度0.1)
+    unsigned checked = 0;
+    unsigned mismatches = 0;
+    for (int t = -400; t <= 800; t++) {
+        for (int h = 0; h <= 1000; h += 7) {
+            float temperature = t / 10.0f;
+            float humidity = h / 10.0f;
+            size_t expectedLength = serializeLegacy(temperature, humidity, expected, sizeof(expected));
+            size_t actualLength = serializeTemplate(payload, temperature, humidity, actual, sizeof(actual));
+            checked++;
+            if (expectedLength != actualLength || memcmp(expected, actual, expectedLength) != 0) {
+                if (mismatches++ < 5) {
+                    printf("不一致:\n  %.*s\n  %.*s\n", (int)expectedLength, expected, (int)actualLength, actual);
+                }
+            }
+        }
+    }
+    printf("比對 %u 組讀數，不一致 %u 組\n", checked, mismatches);
+
+    // 計時 (結果累加到sink，避免被最佳化掉)
+    size_t sink = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < ITERATIONS; i++) {
+        sink += serializeLegacy(20.0f + (i % 100) / 10.0f, 55.0f, expected, sizeof(expected));
+    }
+    auto middle = std::chrono::steady_clock::now();
+    for (int i = 0; i < ITERATIONS; i++) {
+        sink += serializeTemplate(payload, 20.0f + (i % 100) / 10.0f, 55.0f, actual, sizeof(actual));
+    }
+    auto end = std::chrono::steady_clock::now();
+
+    double legacyNs = std::chrono::duration<double, std::nano>(middle - start).count() / ITERATIONS;
+    double templateNs = std::chrono::duration<double, std::nano>(end - middle).count() / ITERATIONS;
+    printf("ArduinoJson: %.1f ns/樣本  範本: %.1f ns/樣本  (%.1fx)  [%zu]\n",
+           legacyNs, templateNs, legacyNs / templateNs, sink);
+
+    return mismatches == 0 ? 0 : 1;
+}
@@ -0,0 +1,201 @@
+// 主機上的發布路徑記憶體配置測試：以韌體相同的MqttTopicTable、PayloadTemplate、Mqtt5Client與MqttLink
+// 重現publishSample()的範本路徑 (檢查房間ID → 格式化負載 → 發布到裝置主題與房間主題)，
+// 並以取代全域operator new的方式計算每次發布的配置次數，必須為0。
+// 發布對象是本機上只回覆CONNACK並丟棄其餘資料的socket。
+// MQTT 3.1.1的PubSubClient與ArduinoJson路徑不在主機上編譯，不在此測試範圍內。
+//
+// 編譯 (在hardware目錄)：
+//   g++ -O2 -std=gnu++11 -pthread -DAIOT_LOG_LEVEL=0 -Ihost/include -Iinclude bench/publish_alloc_bench.cpp
+//       src/MqttTopicTable.cpp src/PayloadTemplate.cpp src/Mqtt5Client.cpp src/MqttLink.cpp src/MqttPacket.cpp
+//       host/MqttTlsHost.cpp -o publish_alloc_bench
+//   ./publish_alloc_bench
+
+#include <Arduino.h>
+#include <atomic>
+#include <chrono>
+#include <new>
+#include <string>
+#include <thread>
+#include <lwip/sockets.h>
+#include "MqttLink.h"
+#include "MqttPacket.h"
+#include "Mqtt5Client.h"
+#include "MqttTopicTable.h"
+#include "PayloadTemplate.h"
+
+static const char* BASE_TOPIC = "esp32/sensors";
+static const char* COMMAND_TOPIC = "esp32/cmd";
+static const char* DEVICE_ID = "24:6F:28:AB:CD:EF";
+static const char* ROOM_ID = "living-room";
+static const int PUBLISHES = 10000;
+
+static std::atomic<uint32_t> allocations(0);
+
+void* operator new(size_t size) {
+    allocations++;
+    void* memory = malloc(size > 0 ? size : 1);
+    if (memory == NULL) {
+        throw std::bad_alloc();
+    }
+    return memory;
+}
+
+void operator delete(void* memory) noexcept {
+    free(memory);
+}
+
+// 本機上的接收端：回覆MQTT 5 CONNACK (公告4個主題別名)，之後丟棄所有資料
+class SinkServer {
+public:
+    SinkServer() : listenFd(-1), port(0) {}
+
+    ~SinkServer() {
+        if (worker.joinable()) {
+            worker.join();
+        }
+        if (listenFd >= 0) {
+            ::close(listenFd);
+        }
+    }
+
+    bool start() {
+        listenFd = socket(AF_INET, SOCK_STREAM, 0);
+        struct sockaddr_in address;
+        memset(&address, 0, sizeof(address));
+        address.sin_family = AF_INET;
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        socklen_t length = sizeof(address);
+        if (listenFd < 0 || bind(listenFd, (struct sockaddr*)&address, sizeof(address)) < 0 ||
+            listen(listenFd, 1) < 0 || getsockname(listenFd, (struct sockaddr*)&address, &length) < 0) {
+            return false;
+        }
+        port = ntohs(address.sin_port);
+        worker = std::thread(&SinkServer::run, this);
+        return true;
+    }
+
+    uint16_t getPort() const { return port; }
+
+private:
+    int listenFd;
+    uint16_t port;
+    std::thread worker;
+
+    void run() {
+        int fd = accept(listenFd, NULL, NULL);
+        if (fd < 0) {
+            return;
+        }
+        static const uint8_t CONNACK5[] = {MQTT_PACKET_CONNACK, 0x06, 0x00, 0x00, 0x03,
+                                           MQTT_PROP_TOPIC_ALIAS_MAXIMUM, 0x00, 0x04};
+        send(fd, CONNACK5, sizeof(CONNACK5), MSG_NOSIGNAL);
+        uint8_t chunk[4096];
+        while (recv(fd, chunk, sizeof(chunk), 0) > 0) {
+        }
+        ::close(fd);
+    }
+};
+
+// 與MQTTManager::rebuildSampleTemplate()相同的遙測範本
+static void buildTemplate(PayloadTemplate& sampleTemplate, const MqttTopicTable& topics) {
+    sampleTemplate.clear();
+    sampleTemplate.appendLiteral("{\"temp\":");
+    sampleTemplate.appendSlot();
+    sampleTemplate.appendLiteral(",\"humidity\":");
+    sampleTemplate.appendSlot();
+    sampleTemplate.appendLiteral(",\"deviceId\":");
+    sampleTemplate.appendString(DEVICE_ID);
+    sampleTemplate.appendLiteral(",\"features\":\"ir_control\",\"roomId\":");
+    sampleTemplate.appendString(topics.roomId[0] != '\0' ? topics.roomId : "unknown");
+    sampleTemplate.appendLiteral("}");
+}
+
+static bool connect(MqttLink& link, Mqtt5Client& client, uint16_t port) {
+    if (!link.beginConnect(IPAddress(127, 0, 0, 1), port)) {
+        return false;
+    }
+    MqttLink::PollResult result;
+    while ((result = link.pollConnect()) == MqttLink::POLL_PENDING) {
+        delay(1);
+    }
+    if (result != MqttLink::POLL_DONE) {
+        return false;
+    }
+
+    MqttConnectOptions options;
+    memset(&options, 0, sizeof(options));
+    options.clientId = DEVICE_ID;
+    options.cleanSession = true;
+    options.keepAlive = 60;
+    options.protocolVersion = MQTT_VERSION_5;
+    uint8_t packet[128];
+    size_t length = MqttPacket::buildConnect(packet, sizeof(packet), options);
+    if (length == 0 || link.write(packet, length) != length) {
+        return false;
+    }
+    for (int i = 0; i < 1000; i++) {
+        Mqtt5Connack connack;
+        int accepted = client.acceptConnack(connack);
+        if (accepted != 0) {
+            return accepted > 0 && connack.reasonCode == 0;
+        }
+        delay(1);
+    }
+    return false;
+}
+
+int main() {
+    // 先確認計數確實有效
+    uint32_t before = allocations;
+    std::string probe(64, 'x');
+    bool hookActive = allocations != before && probe.size() == 64;
+
+    SinkServer sink;
+    MqttLink link;
+    Mqtt5Client client(link);
+    if (!sink.start() || !connect(link, client, sink.getPort())) {
+        printf("無法連線到本機接收端\n");
+        return 1;
+    }
+
+    // 建表：只在begin()與房間ID變更時執行
+    MqttTopicTable topics;
+    memset(&topics, 0, sizeof(topics));
+    PayloadTemplate sampleTemplate;
+    before = allocations;
+    topics.build(BASE_TOPIC, COMMAND_TOPIC, ROOM_ID, DEVICE_ID);
+    buildTemplate(sampleTemplate, topics);
+    client.clearAliases();
+    client.reserveAlias(topics.deviceTopic);
+    client.reserveAlias(topics.roomTopic);
+    uint32_t buildAllocations = allocations - before;
+
+    // 熱路徑：與publishTemplatedSample()相同，格式化一次後發布到兩個主題
+    bool ok = true;
+    uint32_t rebuilds = 0;
+    before = allocations;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (int i = 0; i < PUBLISHES; i++) {
+        if (topics.roomChanged(ROOM_ID)) {
+            rebuilds++;
+        }
+        double values[2] = { 20.0 + (i % 100) / 10.0, 40.0 + (i % 300) / 10.0 };
+        char buffer[256];
+        size_t length = sampleTemplate.render(values, 2, buffer, sizeof(buffer));
+        ok = length > 0 && client.publish(topics.deviceTopic, (const uint8_t*)buffer, length, false) &&
+             client.publish(topics.roomTopic, (const uint8_t*)buffer, length, false) && ok;
+    }
+    double elapsedUs = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+    uint32_t publishAllocations = allocations - before;
+
+    client.disconnect();
+
+    printf("計數有效: %s\n", hookActive ? "是" : "否");
+    printf("建表: %u 次配置 (裝置主題 %s)\n", buildAllocations, topics.deviceTopic);
+    printf("%d 次遙測 (每次發布到2個主題): %u 次配置, 重建 %u 次, 別名 %u 次, %.2f us/次\n", PUBLISHES,
+           publishAllocations, rebuilds, client.getAliasHits(), elapsedUs / PUBLISHES);
+
+    bool passed = ok && hookActive && publishAllocations == 0 && rebuilds == 0;
+    printf("%s\n", passed ? "通過" : "失敗");
+    return passed ? 0 : 1;
+}
@@ -0,0 +1,143 @@
+// 主機上的重連風暴模擬：1000台裝置在broker重啟時同時斷線，broker停機10秒，恢復後每100ms
+// 最多接受50個連線 (超過的連線被拒，視為一次失敗)。比較舊的固定5秒重試與ReconnectPolicy
+// (基準5秒、上限60秒、以MAC位址為種子的完全抖動)，輸出每秒的連線嘗試數 (文字長條圖)、
+// 每100ms的最大嘗試數、被拒次數，以及50%、99%與全部裝置重新連線的時間。
+//
+// 編譯 (在hardware目錄)：
+//   g++ -O2 -std=gnu++11 -Ihost/include -Iinclude bench/reconnect_storm_bench.cpp src/ReconnectPolicy.cpp -o reconnect_storm_bench
+//   ./reconnect_storm_bench
+
+#include <Arduino.h>
+#include <algorithm>
+#include <vector>
+#include "ReconnectPolicy.h"
+
+static const unsigned CLIENTS = 1000;
+static const unsigned long BROKER_DOWN_MS = 10000;     // broker重啟耗時
+static const unsigned long SLOT_MS = 100;              // broker接受連線的計算區間
+static const unsigned ACCEPTS_PER_SLOT = 50;           // 每個區間最多接受的連線數
+static const unsigned long RECONNECT_INTERVAL = 5000;  // 舊版的固定重試間隔，也是退避基準
+static const unsigned long MAX_DELAY = 60000;          // 退避上限
+static const unsigned long SIMULATION_MS = 300000;
+static const unsigned PLOT_SECONDS = 120;
+static const unsigned PLOT_WIDTH = 60;
+
+struct Client {
+    ReconnectPolicy policy;
+    unsigned long nextAttempt;
+    bool connected;
+};
+
+struct Result {
+    std::vector<unsigned> attemptsPerSecond;
+    unsigned peakPerSlot;
+    unsigned attempts;
+    unsigned refused;
+    std::vector<unsigned long> connectTimes;
+};
+
+// 簡單的線性同餘亂數，結果在每個平台都相同
+static uint32_t seed = 12345;
+static uint32_t nextRandom() {
+    seed = seed * 1103515245 + 12345;
+    return seed >> 16;
+}
+
+static Result simulate(bool backoff) {
+    std::vector<Client> clients(CLIENTS);
+    seed = 12345;
+    for (unsigned i = 0; i < CLIENTS; i++) {
+        Client& client = clients[i];
+        char deviceId[18];
+        snprintf(deviceId, sizeof(deviceId), "24:6F:28:%02X:%02X:%02X", (i >> 16) & 0xFF, (i >> 8) & 0xFF, i & 0xFF);
+        client.policy = ReconnectPolicy(RECONNECT_INTERVAL, MAX_DELAY);
+        client.policy.seed(deviceId);
+        client.connected = false;
+
+        // 所有裝置在時間0同時發現斷線；mqttTask每10ms輪詢一次，發現的時間相差不到10ms
+        unsigned long detected = nextRandom() % 10;
+        if (backoff) {
+            client.policy.onDisconnected(false);
+            client.nextAttempt = detected + client.policy.nextDelay();
+        } else {
+            client.nextAttempt = detected + RECONNECT_INTERVAL;
+        }
+    }
+
+    Result result = Result();
+    result.attemptsPerSecond.assign(SIMULATION_MS / 1000, 0);
+    unsigned remaining = CLIENTS;
+    unsigned slotAccepted = 0;
+    unsigned slotAttempts = 0;
+    for (unsigned long now = 0; now < SIMULATION_MS && remaining > 0; now++) {
+        if (now % SLOT_MS == 0) {
+            result.peakPerSlot = std::max(result.peakPerSlot, slotAttempts);
+            slotAccepted = 0;
+            slotAttempts = 0;
+        }
+        for (unsigned i = 0; i < CLIENTS; i++) {
+            Client& client = clients[i];
+            if (client.connected || client.nextAttempt != now) {
+                continue;
+            }
+            result.attempts++;
+            result.attemptsPerSecond[now / 1000]++;
+            slotAttempts++;
+            if (now >= BROKER_DOWN_MS && slotAccepted < ACCEPTS_PER_SLOT) {
+                slotAccepted++;
+                client.connected = true;
+                client.policy.onConnected();
+                result.connectTimes.push_back(now);
+                remaining--;
+            } else {
+                result.refused++;
+                client.nextAttempt = now + (backoff ? client.policy.nextDelay() : RECONNECT_INTERVAL);
+            }
+        }
+    }
+    result.peakPerSlot = std::max(result.peakPerSlot, slotAttempts);
+    std::sort(result.connectTimes.begin(), result.connectTimes.end());
+    return result;
+}
+
+static double connectedAfter(const Result& result, double fraction) {
+    size_t needed = (size_t)(fraction * CLIENTS + 0.5);
+    if (needed == 0 || result.connectTimes.size() < needed) {
+        return -1;
+    }
+    return result.connectTimes[needed - 1] / 1000.0;
+}
+
+static void plot(const char* name, const Result& result) {
+    printf("\n%s: 每秒連線嘗試數 (每個 # 代表 %u 次)\n", name, CLIENTS / PLOT_WIDTH + 1);
+    for (unsigned second = 0; second < PLOT_SECONDS; second++) {
+        unsigned count = result.attemptsPerSecond[second];
+        if (count == 0) {
+            continue;
+        }
+        printf("%4us %5u |", second, count);
+        for (unsigned bar = 0; bar < count / (CLIENTS / PLOT_WIDTH + 1) + 1 && bar < PLOT_WIDTH; bar++) {
+            putchar('#');
+        }
+        putchar('\n');
+    }
+}
+
+static void summarize(const char* name, const Result& result) {
+    printf("%s: 嘗試 %6u, 被拒 %6u, 每100ms最多 %4u 次, 重新連線 50%% %6.1f s, 99%% %6.1f s, 全部 %6.1f s\n",
+           name, result.attempts, result.refused, result.peakPerSlot, connectedAfter(result, 0.5),
+           connectedAfter(result, 0.99), connectedAfter(result, 1.0));
+}
+
+int main() {
+    printf("%u 台裝置, broker停機 %lu ms, 每 %lu ms 最多接受 %u 個連線\n", CLIENTS, BROKER_DOWN_MS, SLOT_MS,
+           ACCEPTS_PER_SLOT);
+    Result fixed = simulate(false);
+    Result backoff = simulate(true);
+    plot("固定5秒重試", fixed);
+    plot("指數退避抖動", backoff);
+    printf("\n");
+    summarize("固定5秒重試", fixed);
+    summarize("指數退避抖動", backoff);
+    return connectedAfter(backoff, 1.0) < 0 ? 1 : 0;
+}
@@ -0,0 +1,126 @@
+// 主機上的主題分派基準：註冊200個過濾器 (房間IR命令、群組命令與少數萬用字元)，
+// 以符合與不符合的主題混合分派，比較TopicRouter與逐一比對所有過濾器的線性掃描，
+// 並確認兩者呼叫的處理函數數相同。
+//
+// 編譯 (在hardware目錄)：
+//   g++ -O2 -std=gnu++11 -Ihost/include -Iinclude bench/topic_router_bench.cpp src/TopicRouter.cpp -o topic_router_bench
+//   ./topic_router_bench
+
+#include <Arduino.h>
+#include <chrono>
+#include <string>
+#include <vector>
+#include "TopicRouter.h"
+
+static const unsigned ROOMS = 99;
+static const int ITERATIONS = 1000000;
+
+// 與MQTT規範相同的比對 (線性掃描的基準)
+static bool topicMatches(const char* filter, const char* topic) {
+    bool firstLevel = true;
+    while (true) {
+        if (filter[0] == '#' && filter[1] == '\0') {
+            return !(firstLevel && topic[0] == '$');
+        }
+        const char* filterEnd = strchr(filter, '/');
+        const char* topicEnd = strchr(topic, '/');
+        size_t filterLength = filterEnd != NULL ? (size_t)(filterEnd - filter) : strlen(filter);
+        size_t topicLength = topicEnd != NULL ? (size_t)(topicEnd - topic) : strlen(topic);
+
+        if (filterLength == 1 && filter[0] == '+') {
+            if (firstLevel && topic[0] == '$') {
+                return false;
+            }
+        } else if (filterLength != topicLength || memcmp(filter, topic, topicLength) != 0) {
+            return false;
+        }
+
+        if (filterEnd == NULL || topicEnd == NULL) {
+            // "a/#" 也符合 "a"
+            return (filterEnd == NULL && topicEnd == NULL) ||
+                   (topicEnd == NULL && strcmp(filterEnd, "/#") == 0);
+        }
+        filter = filterEnd + 1;
+        topic = topicEnd + 1;
+        firstLevel = false;
+    }
+}
+
+// 簡單的線性同餘亂數，結果在每個平台都相同
+static uint32_t seed = 12345;
+static uint32_t nextRandom() {
+    seed = seed * 1103515245 + 12345;
+    return seed >> 16;
+}
+
+int main() {
+    std::vector<std::string> filters;
+    char text[64];
+    for (unsigned room = 0; room < ROOMS; room++) {
+        snprintf(text, sizeof(text), "esp32/cmd/room%02u/ir", room);
+        filters.push_back(text);
+        snprintf(text, sizeof(text), "esp32/cmd/room%02u/+/set", room);
+        filters.push_back(text);
+    }
+    filters.push_back("esp32/commands");
+    filters.push_back("esp32/+/status");
+
+    TopicRouter router;
+    uint32_t calls = 0;
+    for (size_t i = 0; i < filters.size(); i++) {
+        router.add(filters[i].c_str(), [&calls](const char*, const uint8_t*, unsigned int) {
+            calls++;
+        });
+    }
+
+    // 一半的主題符合某個過濾器，另一半是同一台broker上其他裝置的遙測
+    std::vector<std::string> topics;
+    for (int i = 0; i < 256; i++) {
+        unsigned room = nextRandom() % (ROOMS + 20);
+        switch (nextRandom() % 4) {
+            case 0: snprintf(text, sizeof(text), "esp32/cmd/room%02u/ir", room); break;
+            case 1: snprintf(text, sizeof(text), "esp32/cmd/room%02u/group%u/set", room, nextRandom() % 8); break;
+            case 2: snprintf(text, sizeof(text), "esp32/sensors/room%02u/A1B2C3%02u", room, nextRandom() % 50); break;
+            default: snprintf(text, sizeof(text), "esp32/%s/status", nextRandom() % 2 ? "gateway" : "sensors/room01"); break;
+        }
+        topics.push_back(text);
+    }
+
+    uint32_t expected = 0;
+    uint32_t matched = 0;
+    for (size_t t = 0; t < topics.size(); t++) {
+        uint32_t linear = 0;
+        for (size_t f = 0; f < filters.size(); f++) {
+            linear += topicMatches(filters[f].c_str(), topics[t].c_str()) ? 1 : 0;
+        }
+        size_t routed = router.dispatch(topics[t].c_str(), NULL, 0);
+        if (routed != linear) {
+            printf("分派結果不一致: %s (字典樹 %u, 線性 %u)\n", topics[t].c_str(), (unsigned)routed, linear);
+            return 1;
+        }
+        expected += linear;
+        matched += linear > 0 ? 1 : 0;
+    }
+    printf("%u 個過濾器, %u 個主題 (%u 個符合), 共 %u 次處理函數呼叫\n",
+           (unsigned)router.size(), (unsigned)topics.size(), matched, expected);
+
+    calls = 0;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (int i = 0; i < ITERATIONS; i++) {
+        router.dispatch(topics[i % topics.size()].c_str(), NULL, 0);
+    }
+    double routerNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / ITERATIONS;
+
+    volatile uint32_t sink = 0;
+    start = std::chrono::steady_clock::now();
+    for (int i = 0; i < ITERATIONS / 10; i++) {
+        const char* topic = topics[i % topics.size()].c_str();
+        for (size_t f = 0; f < filters.size(); f++) {
+            sink += topicMatches(filters[f].c_str(), topic) ? 1 : 0;
+        }
+    }
+    double linearNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / (ITERATIONS / 10);
+
+    printf("TopicRouter: %.0f ns/訊息, 線性掃描: %.0f ns/訊息 (%.1fx)\n", routerNs, linearNs, linearNs / routerNs);
+    return calls == 0 || sink == 0;
+}
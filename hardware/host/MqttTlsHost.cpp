@@ -0,0 +1,76 @@
+// 主機測試用的MqttTls：主機上沒有mbedTLS，設定TLS時一律失敗，MqttLink維持明文TCP
+#include "MqttTls.h"
+
+MqttTls::MqttTls()
+    : configured(false),
+      active(false),
+      sessionValid(false),
+      resume(false),
+      resumed(false),
+      offeredSession(false),
+      sawCertificate(false),
+      hostHash(0),
+      host(NULL),
+      handshakeStart(0),
+      handshakeMillis(0),
+      fullCount(0),
+      resumedCount(0) {
+}
+
+MqttTls::~MqttTls() {
+}
+
+bool MqttTls::configure(const char* caCert, const char* hostname, bool resumeSessions) {
+    fprintf(stderr, "主機測試不支援TLS\n");
+    return false;
+}
+
+void MqttTls::setHostname(const char* hostname) {
+    host = hostname;
+}
+
+bool MqttTls::begin(int sock) {
+    return false;
+}
+
+MqttTls::HandshakeResult MqttTls::handshake() {
+    return HANDSHAKE_FAILED;
+}
+
+int MqttTls::send(const uint8_t* data, size_t length) {
+    return -1;
+}
+
+int MqttTls::recv(uint8_t* data, size_t length) {
+    return -1;
+}
+
+size_t MqttTls::pending() const {
+    return 0;
+}
+
+void MqttTls::end() {
+}
+
+void MqttTls::clearSession() {
+}
+
+bool MqttTls::hasSession() const {
+    return false;
+}
+
+bool MqttTls::wasResumed() const {
+    return false;
+}
+
+unsigned long MqttTls::getHandshakeMillis() const {
+    return handshakeMillis;
+}
+
+uint32_t MqttTls::getFullHandshakes() const {
+    return fullCount;
+}
+
+uint32_t MqttTls::getResumedHandshakes() const {
+    return resumedCount;
+}
@@ -0,0 +1,74 @@
+// 主機測試用的Arduino最小替代：只提供MQTT傳輸層 (MqttLink、MqttPacket、TopicRouter、
+// ReconnectPolicy、Mqtt5Client) 與IR碼庫 (IRCodeLibrary、StorageManager) 用到的部分，
+// 讓相同的原始碼可以在Linux上以g++編譯
+#ifndef HOST_ARDUINO_H
+#define HOST_ARDUINO_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <mutex>
+#include <string>
+
+typedef uint8_t byte;
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+typedef uint32_t TickType_t;
+
+// FreeRTOS互斥鎖 (以std::mutex實作，不支援逾時)
+typedef std::mutex* SemaphoreHandle_t;
+#define portMAX_DELAY   0xFFFFFFFF
+#define pdTRUE          1
+
+inline SemaphoreHandle_t xSemaphoreCreateMutex() {
+    return new std::mutex();
+}
+
+inline BaseType_t xSemaphoreTake(SemaphoreHandle_t mutex, TickType_t) {
+    mutex->lock();
+    return pdTRUE;
+}
+
+inline BaseType_t xSemaphoreGive(SemaphoreHandle_t mutex) {
+    mutex->unlock();
+    return pdTRUE;
+}
+
+inline void vSemaphoreDelete(SemaphoreHandle_t mutex) {
+    delete mutex;
+}
+
+// 單調時鐘 (與ESP32相同，從程式啟動開始計算並會溢位)
+inline unsigned long millis() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (unsigned long)(now.tv_sec * 1000UL + now.tv_nsec / 1000000UL);
+}
+
+inline unsigned long micros() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (unsigned long)(now.tv_sec * 1000000UL + now.tv_nsec / 1000UL);
+}
+
+inline void delay(unsigned long ms) {
+    usleep(ms * 1000);
+}
+
+// Logger.h的String多載需要的最小String
+class String {
+public:
+    String(const char* text = "") : value(text) {}
+    const char* c_str() const { return value.c_str(); }
+    unsigned int length() const { return value.length(); }
+
+private:
+    std::string value;
+};
+
+#endif // HOST_ARDUINO_H
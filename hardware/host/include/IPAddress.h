@@ -0,0 +1,26 @@
+// 主機測試用的IPAddress (以網路位元組順序保存IPv4位址，與arduino-esp32相同)
+#ifndef HOST_IP_ADDRESS_H
+#define HOST_IP_ADDRESS_H
+
+#include <Arduino.h>
+
+class IPAddress {
+public:
+    IPAddress() : address(0) {}
+    IPAddress(uint32_t value) : address(value) {}
+    IPAddress(uint8_t a, uint8_t b, uint8_t c, uint8_t d) {
+        uint8_t bytes[4] = {a, b, c, d};
+        memcpy(&address, bytes, sizeof(address));
+    }
+
+    operator uint32_t() const { return address; }
+
+    uint8_t operator[](int index) const {
+        return ((const uint8_t*)&address)[index];
+    }
+
+private:
+    uint32_t address;
+};
+
+#endif // HOST_IP_ADDRESS_H
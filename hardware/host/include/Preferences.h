@@ -0,0 +1,92 @@
+// 主機測試用的Preferences：以記憶體中的表代替NVS (同一個程式內的所有實例共用)，
+// 並統計讀寫次數，讓基準可以確認哪些操作實際存取了Flash。
+#ifndef HOST_PREFERENCES_H
+#define HOST_PREFERENCES_H
+
+#include <Arduino.h>
+#include <map>
+#include <vector>
+
+// 模擬的NVS內容與存取次數
+struct HostNvs {
+    std::map<std::string, std::vector<uint8_t> > entries;   // "命名空間/鍵名" -> 內容
+    uint32_t reads;
+    uint32_t writes;
+};
+
+inline HostNvs& hostNvs() {
+    static HostNvs nvs = HostNvs();
+    return nvs;
+}
+
+class Preferences {
+public:
+    bool begin(const char* name, bool readOnly = false) {
+        prefix = std::string(name) + "/";
+        return true;
+    }
+
+    void end() {}
+
+    bool clear() {
+        std::map<std::string, std::vector<uint8_t> >& entries = hostNvs().entries;
+        for (std::map<std::string, std::vector<uint8_t> >::iterator it = entries.begin(); it != entries.end();) {
+            if (it->first.compare(0, prefix.size(), prefix) == 0) {
+                entries.erase(it++);
+            } else {
+                ++it;
+            }
+        }
+        return true;
+    }
+
+    bool isKey(const char* key) {
+        return hostNvs().entries.count(prefix + key) > 0;
+    }
+
+    bool remove(const char* key) {
+        hostNvs().writes++;
+        return hostNvs().entries.erase(prefix + key) > 0;
+    }
+
+    size_t putBytes(const char* key, const void* value, size_t length) {
+        hostNvs().writes++;
+        hostNvs().entries[prefix + key].assign((const uint8_t*)value, (const uint8_t*)value + length);
+        return length;
+    }
+
+    size_t getBytes(const char* key, void* buffer, size_t maxLength) {
+        hostNvs().reads++;
+        std::map<std::string, std::vector<uint8_t> >::iterator it = hostNvs().entries.find(prefix + key);
+        if (it == hostNvs().entries.end()) {
+            return 0;
+        }
+        size_t length = it->second.size() < maxLength ? it->second.size() : maxLength;
+        memcpy(buffer, it->second.data(), length);
+        return length;
+    }
+
+    size_t putString(const char* key, const char* value) { return putBytes(key, value, strlen(value) + 1); }
+    size_t putInt(const char* key, int32_t value) { return putBytes(key, &value, sizeof(value)); }
+    size_t putFloat(const char* key, float value) { return putBytes(key, &value, sizeof(value)); }
+    size_t putBool(const char* key, bool value) { return putBytes(key, &value, sizeof(value)); }
+
+    String getString(const char* key, const char* defaultValue = "") {
+        char text[256];
+        return getBytes(key, text, sizeof(text)) > 0 ? String(text) : String(defaultValue);
+    }
+    int32_t getInt(const char* key, int32_t defaultValue = 0) { return getValue(key, defaultValue); }
+    float getFloat(const char* key, float defaultValue = 0) { return getValue(key, defaultValue); }
+    bool getBool(const char* key, bool defaultValue = false) { return getValue(key, defaultValue); }
+
+private:
+    std::string prefix;
+
+    template <typename T>
+    T getValue(const char* key, T defaultValue) {
+        T value;
+        return getBytes(key, &value, sizeof(value)) == sizeof(value) ? value : defaultValue;
+    }
+};
+
+#endif // HOST_PREFERENCES_H
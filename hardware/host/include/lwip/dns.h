@@ -0,0 +1,56 @@
+// 主機測試用的lwIP非阻塞DNS：IP字串立即完成，主機名稱在另一個執行緒以getaddrinfo解析後
+// 持有TCP/IP核心鎖呼叫回調，與ESP32上回調在TCP/IP執行緒執行的情況相同。
+// 環境變數AIOT_HOST_DNS_DELAY_MS可延遲回調，用來重現逾時後才完成的查詢。
+#ifndef HOST_LWIP_DNS_H
+#define HOST_LWIP_DNS_H
+
+#include <Arduino.h>
+#include <netdb.h>
+#include <arpa/inet.h>
+#include <string>
+#include <thread>
+#include <lwip/err.h>
+#include <lwip/tcpip.h>
+
+typedef struct { uint32_t addr; } ip4_addr_t;
+typedef struct { ip4_addr_t ip4; } ip_addr_t;
+#define ip_2_ip4(ipaddr)        (&((ipaddr)->ip4))
+#define ip4_addr_get_u32(src)   ((src)->addr)
+
+typedef void (*dns_found_callback)(const char* name, const ip_addr_t* ipaddr, void* callback_arg);
+
+inline err_t dns_gethostbyname(const char* hostname, ip_addr_t* addr, dns_found_callback found, void* callback_arg) {
+    if (hostname == NULL || addr == NULL || found == NULL) {
+        return ERR_ARG;
+    }
+
+    struct in_addr literal;
+    if (inet_pton(AF_INET, hostname, &literal) == 1) {
+        addr->ip4.addr = literal.s_addr;
+        return ERR_OK;
+    }
+
+    const char* delayText = getenv("AIOT_HOST_DNS_DELAY_MS");
+    unsigned long delayMs = delayText != NULL ? strtoul(delayText, NULL, 10) : 0;
+    std::string name(hostname);
+    std::thread([name, found, callback_arg, delayMs]() {
+        delay(delayMs);
+        struct addrinfo hints;
+        memset(&hints, 0, sizeof(hints));
+        hints.ai_family = AF_INET;
+        hints.ai_socktype = SOCK_STREAM;
+        struct addrinfo* result = NULL;
+        bool ok = getaddrinfo(name.c_str(), NULL, &hints, &result) == 0 && result != NULL;
+        ip_addr_t resolved;
+        if (ok) {
+            resolved.ip4.addr = ((struct sockaddr_in*)result->ai_addr)->sin_addr.s_addr;
+            freeaddrinfo(result);
+        }
+        LOCK_TCPIP_CORE();
+        found(name.c_str(), ok ? &resolved : NULL, callback_arg);
+        UNLOCK_TCPIP_CORE();
+    }).detach();
+    return ERR_INPROGRESS;
+}
+
+#endif // HOST_LWIP_DNS_H
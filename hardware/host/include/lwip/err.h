@@ -0,0 +1,12 @@
+// 主機測試用的lwIP錯誤碼 (只列出用到的部分)
+#ifndef HOST_LWIP_ERR_H
+#define HOST_LWIP_ERR_H
+
+#include <stdint.h>
+
+typedef int8_t err_t;
+#define ERR_OK          0
+#define ERR_INPROGRESS  -5
+#define ERR_ARG         -16
+
+#endif // HOST_LWIP_ERR_H
@@ -0,0 +1,20 @@
+// 主機測試用的tcpip_api_call()：在持有TCP/IP核心鎖時同步執行 (與LWIP_TCPIP_CORE_LOCKING相同)
+#ifndef HOST_LWIP_TCPIP_PRIV_H
+#define HOST_LWIP_TCPIP_PRIV_H
+
+#include <lwip/tcpip.h>
+
+struct tcpip_api_call_data {
+    int dummy;
+};
+
+typedef err_t (*tcpip_api_call_fn)(struct tcpip_api_call_data* call);
+
+inline err_t tcpip_api_call(tcpip_api_call_fn fn, struct tcpip_api_call_data* call) {
+    LOCK_TCPIP_CORE();
+    err_t err = fn(call);
+    UNLOCK_TCPIP_CORE();
+    return err;
+}
+
+#endif // HOST_LWIP_TCPIP_PRIV_H
@@ -0,0 +1,17 @@
+// 主機測試用的TCP/IP核心鎖：以一個互斥鎖代表lwIP的TCP/IP執行緒，
+// DNS回調與tcpip_api_call()都在持有此鎖時執行，與ESP32上兩者互相序列化的情況相同
+#ifndef HOST_LWIP_TCPIP_H
+#define HOST_LWIP_TCPIP_H
+
+#include <mutex>
+#include <lwip/err.h>
+
+inline std::mutex& hostTcpipCore() {
+    static std::mutex core;
+    return core;
+}
+
+#define LOCK_TCPIP_CORE()   hostTcpipCore().lock()
+#define UNLOCK_TCPIP_CORE() hostTcpipCore().unlock()
+
+#endif // HOST_LWIP_TCPIP_H
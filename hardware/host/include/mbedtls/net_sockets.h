@@ -0,0 +1,7 @@
+// 主機測試用：只宣告MqttTls.h成員用到的mbedTLS類型 (主機上不支援TLS)
+#ifndef HOST_MBEDTLS_NET_SOCKETS_H
+#define HOST_MBEDTLS_NET_SOCKETS_H
+
+typedef struct { int unused; } mbedtls_net_context;
+
+#endif // HOST_MBEDTLS_NET_SOCKETS_H
@@ -0,0 +1,9 @@
+// 主機測試用：只宣告MqttTls.h成員用到的mbedTLS類型 (主機上不支援TLS)
+#ifndef HOST_MBEDTLS_SSL_H
+#define HOST_MBEDTLS_SSL_H
+
+typedef struct { int unused; } mbedtls_ssl_context;
+typedef struct { int unused; } mbedtls_ssl_config;
+typedef struct { int unused; } mbedtls_ssl_session;
+
+#endif // HOST_MBEDTLS_SSL_H
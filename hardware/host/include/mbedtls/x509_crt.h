@@ -0,0 +1,7 @@
+// 主機測試用：只宣告MqttTls.h成員用到的mbedTLS類型 (主機上不支援TLS)
+#ifndef HOST_MBEDTLS_X509_CRT_H
+#define HOST_MBEDTLS_X509_CRT_H
+
+typedef struct { int unused; } mbedtls_x509_crt;
+
+#endif // HOST_MBEDTLS_X509_CRT_H
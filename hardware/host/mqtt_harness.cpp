@@ -0,0 +1,1203 @@
+// 主機上的MQTT傳輸層測試驅動：以韌體相同的MqttLink、MqttPacket、TopicRouter、ReconnectPolicy
+// (MQTT 5時加上Mqtt5Client) 透過Linux socket連線到broker，依序驗證
+//   0. 被新查詢取代的DNS查詢在逾時後才完成時，不會覆寫新的結果
+//   1. 非阻塞DNS與TCP連線、CONNECT/CONNACK
+//   2. 批次SUBSCRIBE (每個過濾器的SUBACK原因碼都要看得到) 與TopicRouter分派 (每則訊息必須只送到一個處理函數)
+//   3. QoS 0 / QoS 1發布的往返延遲與PUBACK
+//   4. 斷線後依ReconnectPolicy退避重連，恢復訂閱並再發布一輪
+//   5. MQTT 5：主題別名確實被使用、會話保留 (-e秒數，重連時CONNACK必須回報已恢復會話)、
+//      broker拒絕連線時客戶端取得CONNACK原因碼
+// 未指定 -h 時啟動內建的最小broker (127.0.0.1上的隨機埠)，連線被拒的次數可用 -r 調整
+// (MQTT 5以原因碼0x89拒絕，MQTT 3.1.1直接關閉TCP)；
+// 指定 -h 時連到外部broker (例如本地mosquitto)，斷線由本端關閉socket模擬。
+// -o 限制本端的發布速率 (則/秒，預設0為只受在途窗口限制)，-i 由另一個連線以固定速率
+// 發布到測試主題，模擬其他裝置的入站流量。每輪輸出送達速率、往返延遲p50/p99與
+// 本端執行緒在該輪的配置次數 (取代全域operator new計算，不含內建broker與注入連線)。
+//
+// 範圍：MQTTManager、IRManager::handleMQTTMessage與ArduinoJson的負載組裝依賴PubSubClient、
+// ArduinoJson、WiFi與IRremoteESP8266，主機上沒有這些函式庫，不在此測試範圍內；
+// 這裡量測的是它們底下共用的傳輸層與分派。
+//
+// 編譯 (在hardware目錄)：
+//   g++ -O2 -std=gnu++11 -pthread -DAIOT_LOG_LEVEL=0 -Ihost/include -Iinclude
+//       host/mqtt_harness.cpp host/MqttTlsHost.cpp src/MqttLink.cpp src/MqttPacket.cpp
+//       src/TopicRouter.cpp src/ReconnectPolicy.cpp src/Mqtt5Client.cpp -o mqtt_harness
+//   ./mqtt_harness                     # 內建broker，MQTT 3.1.1
+//   ./mqtt_harness -5 -n 5000 -f 200   # MQTT 5，5000則訊息，200個過濾器
+//   ./mqtt_harness -o 2000 -i 500      # 每秒發布2000則，另有每秒500則的入站流量
+//   ./mqtt_harness -h localhost -p 1883
+//   ./mqtt_harness -5 -h localhost -p 1883   # 本地mosquitto 2.x，MQTT 5
+//
+// 結束碼為0代表所有訊息都送達且QoS 1訊息都收到PUBACK。
+
+#include <Arduino.h>
+#include <algorithm>
+#include <atomic>
+#include <map>
+#include <string>
+#include <thread>
+#include <vector>
+#include <new>
+#include <netdb.h>
+#include <poll.h>
+#include <signal.h>
+#include <lwip/sockets.h>
+#include "MqttLink.h"
+#include "MqttPacket.h"
+#include "Mqtt5Client.h"
+#include "TopicRouter.h"
+#include "ReconnectPolicy.h"
+
+static const unsigned long STEP_TIMEOUT = 5000;   // 每個連線階段的逾時
+static const uint8_t SUBSCRIBE_BATCH = MQTT_SUBSCRIBE_BATCH_MAX;  // 與MQTTManager相同的每個SUBSCRIBE過濾器數
+static const uint8_t WINDOW = 8;                  // 同時在途的訊息數
+static const uint8_t REFUSE_REASON = 0x89;        // 內建broker以MQTT 5拒絕連線時的原因碼 (Server busy)
+
+// 只計算設定了countAllocations的執行緒 (測試客戶端所在的主執行緒)
+static std::atomic<uint32_t> allocations(0);
+static thread_local bool countAllocations = false;
+
+void* operator new(size_t size) {
+    if (countAllocations) {
+        allocations++;
+    }
+    void* memory = malloc(size > 0 ? size : 1);
+    if (memory == NULL) {
+        throw std::bad_alloc();
+    }
+    return memory;
+}
+
+// 不內聯，避免GCC把free()與內建的operator new配對而誤報-Wmismatched-new-delete
+__attribute__((noinline)) void operator delete(void* memory) noexcept {
+    free(memory);
+}
+
+// ---------------------------------------------------------------------------
+// 內建broker：只實作測試需要的部分 (CONNECT、SUBSCRIBE、PUBLISH QoS 0/1、PINGREQ、
+// DISCONNECT、MQTT 5主題別名)，訊息一律以QoS 0轉送給符合的訂閱者
+// ---------------------------------------------------------------------------
+
+// 主題是否符合過濾器 (+ 與 #)
+static bool topicMatches(const char* filter, const char* topic) {
+    while (*filter != '\0') {
+        if (filter[0] == '#') {
+            return true;
+        }
+        if (filter[0] == '+') {
+            while (*topic != '\0' && *topic != '/') {
+                topic++;
+            }
+            filter++;
+        } else {
+            while (*filter != '\0' && *filter != '/') {
+                if (*filter++ != *topic++) {
+                    return false;
+                }
+            }
+            if (*topic != '\0' && *topic != '/') {
+                return false;
+            }
+        }
+        if (*filter == '\0' || *topic == '\0') {
+            // "a/#" 也符合 "a"
+            return *filter == *topic || strcmp(filter, "/#") == 0;
+        }
+        filter++;
+        topic++;
+    }
+    return *topic == '\0';
+}
+
+class LoopbackBroker {
+public:
+    LoopbackBroker()
+        : listenFd(-1), port(0), running(false), refuseCount(0), refuseReason(0), connects(0), aliasHits(0) {}
+
+    ~LoopbackBroker() {
+        stop();
+    }
+
+    bool start() {
+        listenFd = socket(AF_INET, SOCK_STREAM, 0);
+        if (listenFd < 0) {
+            return false;
+        }
+        int reuse = 1;
+        setsockopt(listenFd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+        struct sockaddr_in address;
+        memset(&address, 0, sizeof(address));
+        address.sin_family = AF_INET;
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        address.sin_port = 0;
+        socklen_t length = sizeof(address);
+        if (bind(listenFd, (struct sockaddr*)&address, sizeof(address)) < 0 || listen(listenFd, 4) < 0 ||
+            getsockname(listenFd, (struct sockaddr*)&address, &length) < 0) {
+            ::close(listenFd);
+            listenFd = -1;
+            return false;
+        }
+        port = ntohs(address.sin_port);
+        running = true;
+        worker = std::thread(&LoopbackBroker::run, this);
+        return true;
+    }
+
+    void stop() {
+        if (running) {
+            running = false;
+            worker.join();
+        }
+        for (size_t i = 0; i < sessions.size(); i++) {
+            ::close(sessions[i].fd);
+        }
+        sessions.clear();
+        if (listenFd >= 0) {
+            ::close(listenFd);
+            listenFd = -1;
+        }
+    }
+
+    uint16_t getPort() const { return port; }
+    uint32_t getConnects() const { return connects; }
+    uint32_t getAliasHits() const { return aliasHits; }
+
+    // 接下來的count次連線被拒 (模擬broker重啟中)：reasonCode為0時TCP建立後立即關閉，
+    // 否則在CONNECT之後以該原因碼的CONNACK拒絕 (僅MQTT 5)
+    void refuseNext(uint32_t count, uint8_t reasonCode = 0) {
+        refuseReason = reasonCode;
+        refuseCount = count;
+    }
+
+private:
+    struct Session {
+        int fd;
+        uint8_t version;
+        std::vector<uint8_t> input;
+        std::vector<std::string> filters;
+        std::vector<std::string> aliases;   // MQTT 5客戶端送來的主題別名 (索引為別名 - 1)
+        std::string clientId;
+        uint32_t sessionExpiry;             // MQTT 5會話保留秒數 (0代表斷線即清除)
+    };
+
+    int listenFd;
+    uint16_t port;
+    std::atomic<bool> running;
+    std::atomic<uint32_t> refuseCount;
+    std::atomic<uint8_t> refuseReason;
+    std::atomic<uint32_t> connects;
+    std::atomic<uint32_t> aliasHits;
+    std::thread worker;
+    std::vector<Session> sessions;
+    std::map<std::string, std::vector<std::string> > savedSessions;  // 斷線後保留的訂閱 (依客戶端ID)
+
+    void run() {
+        while (running) {
+            std::vector<struct pollfd> fds(sessions.size() + 1);
+            fds[0].fd = listenFd;
+            fds[0].events = POLLIN;
+            for (size_t i = 0; i < sessions.size(); i++) {
+                fds[i + 1].fd = sessions[i].fd;
+                fds[i + 1].events = POLLIN;
+            }
+            if (poll(fds.data(), fds.size(), 10) <= 0) {
+                continue;
+            }
+
+            // 從後往前處理，關閉的連線可以直接移除
+            for (size_t i = sessions.size(); i > 0; i--) {
+                if (fds[i].revents != 0 && !service(sessions[i - 1])) {
+                    Session& session = sessions[i - 1];
+                    if (session.sessionExpiry > 0) {
+                        // 測試時間很短，不實作保留期限到期
+                        savedSessions[session.clientId] = session.filters;
+                    }
+                    ::close(session.fd);
+                    sessions.erase(sessions.begin() + (i - 1));
+                }
+            }
+
+            if (fds[0].revents & POLLIN) {
+                int fd = accept(listenFd, NULL, NULL);
+                if (fd < 0) {
+                    continue;
+                }
+                if (refuseCount > 0 && refuseReason == 0) {
+                    refuseCount--;
+                    ::close(fd);
+                    continue;
+                }
+                int noDelay = 1;
+                setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+                Session session;
+                session.fd = fd;
+                session.version = MQTT_VERSION_3_1_1;
+                session.sessionExpiry = 0;
+                sessions.push_back(session);
+            }
+        }
+    }
+
+    // 讀取並處理完整的封包，連線結束時返回false
+    bool service(Session& session) {
+        uint8_t chunk[4096];
+        ssize_t received = recv(session.fd, chunk, sizeof(chunk), 0);
+        if (received <= 0) {
+            return false;
+        }
+        session.input.insert(session.input.end(), chunk, chunk + received);
+
+        while (session.input.size() >= 2) {
+            uint32_t remaining;
+            int lengthBytes = MqttPacket::decodeRemainingLength(&session.input[1], session.input.size() - 1, &remaining);
+            if (lengthBytes < 0) {
+                return false;
+            }
+            size_t total = 1 + lengthBytes + remaining;
+            if (lengthBytes == 0 || session.input.size() < total) {
+                break;
+            }
+            std::vector<uint8_t> body(session.input.begin() + 1 + lengthBytes, session.input.begin() + total);
+            uint8_t header = session.input[0];
+            session.input.erase(session.input.begin(), session.input.begin() + total);
+            if (!handle(session, header, body)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    static bool sendAll(int fd, const uint8_t* data, size_t length) {
+        while (length > 0) {
+            ssize_t sent = send(fd, data, length, MSG_NOSIGNAL);
+            if (sent <= 0) {
+                return false;
+            }
+            data += sent;
+            length -= sent;
+        }
+        return true;
+    }
+
+    // 略過MQTT 5的屬性欄位，返回屬性之後的位置 (格式錯誤返回0)
+    static size_t skipProperties(const std::vector<uint8_t>& body, size_t pos, uint16_t* topicAlias) {
+        uint32_t length;
+        int bytes = pos < body.size() ? MqttPacket::decodeRemainingLength(&body[pos], body.size() - pos, &length) : -1;
+        if (bytes <= 0 || pos + bytes + length > body.size()) {
+            return 0;
+        }
+        size_t end = pos + bytes + length;
+        for (size_t i = pos + bytes; i + 2 < end; i++) {
+            // 測試只用到主題別名，其他屬性不解析
+            if (body[i] == MQTT_PROP_TOPIC_ALIAS && topicAlias != NULL) {
+                *topicAlias = ((uint16_t)body[i + 1] << 8) | body[i + 2];
+                break;
+            }
+        }
+        return end;
+    }
+
+    bool handle(Session& session, uint8_t header, const std::vector<uint8_t>& body) {
+        switch (header & 0xF0) {
+            case MQTT_PACKET_CONNECT: {
+                // 協議名稱 "MQTT" (2 + 4位元組)、協議等級、連線旗標、心跳 (2位元組)，
+                // MQTT 5接著是屬性，之後是客戶端ID
+                if (body.size() < 12) {
+                    return false;
+                }
+                session.version = body[6];
+                bool cleanStart = (body[7] & 0x02) != 0;
+                size_t pos = 10;
+                if (session.version == MQTT_VERSION_5) {
+                    size_t propertiesEnd = skipProperties(body, pos, NULL);
+                    if (propertiesEnd == 0) {
+                        return false;
+                    }
+                    // 客戶端只送出會話保留秒數一個屬性
+                    uint32_t length;
+                    int bytes = MqttPacket::decodeRemainingLength(&body[pos], body.size() - pos, &length);
+                    if (length >= 5 && body[pos + bytes] == MQTT_PROP_SESSION_EXPIRY) {
+                        const uint8_t* value = &body[pos + bytes + 1];
+                        session.sessionExpiry = ((uint32_t)value[0] << 24) | ((uint32_t)value[1] << 16) |
+                                                ((uint32_t)value[2] << 8) | value[3];
+                    }
+                    pos = propertiesEnd;
+                }
+                if (pos + 2 > body.size()) {
+                    return false;
+                }
+                size_t idLength = ((size_t)body[pos] << 8) | body[pos + 1];
+                if (pos + 2 + idLength > body.size()) {
+                    return false;
+                }
+                session.clientId.assign((const char*)&body[pos + 2], idLength);
+                connects++;
+                if (session.version == MQTT_VERSION_5) {
+                    if (refuseCount > 0 && refuseReason != 0) {
+                        refuseCount--;
+                        session.sessionExpiry = 0;
+                        uint8_t refused[] = {MQTT_PACKET_CONNACK, 0x03, 0x00, refuseReason, 0x00};
+                        sendAll(session.fd, refused, sizeof(refused));
+                        return false;
+                    }
+
+                    std::map<std::string, std::vector<std::string> >::iterator saved = savedSessions.find(session.clientId);
+                    bool sessionPresent = !cleanStart && saved != savedSessions.end();
+                    if (sessionPresent) {
+                        session.filters = saved->second;
+                    }
+                    if (saved != savedSessions.end()) {
+                        savedSessions.erase(saved);
+                    }
+
+                    // 公告最多8個主題別名
+                    uint8_t connack5[] = {MQTT_PACKET_CONNACK, 0x06, (uint8_t)(sessionPresent ? 0x01 : 0x00), 0x00, 0x03,
+                                          MQTT_PROP_TOPIC_ALIAS_MAXIMUM, 0x00, 0x08};
+                    return sendAll(session.fd, connack5, sizeof(connack5));
+                }
+                static const uint8_t CONNACK[] = {MQTT_PACKET_CONNACK, 0x02, 0x00, 0x00};
+                return sendAll(session.fd, CONNACK, sizeof(CONNACK));
+            }
+
+            case MQTT_PACKET_SUBSCRIBE: {
+                if (body.size() < 2) {
+                    return false;
+                }
+                size_t pos = 2;
+                if (session.version == MQTT_VERSION_5 && (pos = skipProperties(body, pos, NULL)) == 0) {
+                    return false;
+                }
+                std::vector<uint8_t> codes;
+                while (pos + 2 <= body.size()) {
+                    size_t length = ((size_t)body[pos] << 8) | body[pos + 1];
+                    if (pos + 2 + length + 1 > body.size()) {
+                        return false;
+                    }
+                    session.filters.push_back(std::string((const char*)&body[pos + 2], length));
+                    codes.push_back(std::min<uint8_t>(body[pos + 2 + length] & 0x03, 1));
+                    pos += 2 + length + 1;
+                }
+
+                std::vector<uint8_t> suback;
+                size_t remaining = 2 + (session.version == MQTT_VERSION_5 ? 1 : 0) + codes.size();
+                uint8_t lengthField[4];
+                suback.push_back(MQTT_PACKET_SUBACK);
+                suback.insert(suback.end(), lengthField, lengthField + MqttPacket::encodeRemainingLength(remaining, lengthField));
+                suback.push_back(body[0]);
+                suback.push_back(body[1]);
+                if (session.version == MQTT_VERSION_5) {
+                    suback.push_back(0x00);
+                }
+                suback.insert(suback.end(), codes.begin(), codes.end());
+                return sendAll(session.fd, suback.data(), suback.size());
+            }
+
+            case MQTT_PACKET_PUBLISH:
+                return route(session, header, body);
+
+            case MQTT_PACKET_PINGREQ: {
+                static const uint8_t PINGRESP[] = {MQTT_PACKET_PINGRESP, 0x00};
+                return sendAll(session.fd, PINGRESP, sizeof(PINGRESP));
+            }
+
+            case MQTT_PACKET_DISCONNECT:
+                return false;
+
+            default:
+                // PUBACK (轉送一律QoS 0，不會收到)、UNSUBSCRIBE等測試用不到的封包忽略
+                return true;
+        }
+    }
+
+    bool route(Session& session, uint8_t header, const std::vector<uint8_t>& body) {
+        uint8_t qos = (header >> 1) & 0x03;
+        if (body.size() < 2) {
+            return false;
+        }
+        size_t topicLength = ((size_t)body[0] << 8) | body[1];
+        size_t pos = 2 + topicLength;
+        if (pos > body.size()) {
+            return false;
+        }
+        std::string topic((const char*)&body[2], topicLength);
+        uint16_t packetId = 0;
+        if (qos > 0) {
+            if (pos + 2 > body.size()) {
+                return false;
+            }
+            packetId = ((uint16_t)body[pos] << 8) | body[pos + 1];
+            pos += 2;
+        }
+
+        if (session.version == MQTT_VERSION_5) {
+            uint16_t alias = 0;
+            if ((pos = skipProperties(body, pos, &alias)) == 0 || alias > 8) {
+                return false;
+            }
+            if (alias != 0) {
+                if (session.aliases.size() < alias) {
+                    session.aliases.resize(alias);
+                }
+                if (topic.empty()) {
+                    // 只帶別名：必須是之前已建立的別名
+                    if (session.aliases[alias - 1].empty()) {
+                        return false;
+                    }
+                    topic = session.aliases[alias - 1];
+                    aliasHits++;
+                } else {
+                    session.aliases[alias - 1] = topic;
+                }
+            }
+        }
+
+        if (qos == 1) {
+            uint8_t puback[] = {MQTT_PACKET_PUBACK, 0x02, (uint8_t)(packetId >> 8), (uint8_t)(packetId & 0xFF)};
+            if (!sendAll(session.fd, puback, sizeof(puback))) {
+                return false;
+            }
+        }
+
+        // 以QoS 0轉送給所有符合的訂閱 (每個連線只送一次)
+        for (size_t i = 0; i < sessions.size(); i++) {
+            Session& target = sessions[i];
+            bool matched = false;
+            for (size_t f = 0; f < target.filters.size() && !matched; f++) {
+                matched = topicMatches(target.filters[f].c_str(), topic.c_str());
+            }
+            if (!matched) {
+                continue;
+            }
+            uint8_t forward[512];
+            size_t length = MqttPacket::buildPublishHeader(forward, sizeof(forward), topic.c_str(), body.size() - pos,
+                                                           0, false, false, 0, target.version);
+            if (length == 0 || !sendAll(target.fd, forward, length) ||
+                !sendAll(target.fd, body.data() + pos, body.size() - pos)) {
+                continue;
+            }
+        }
+        return true;
+    }
+};
+
+// ---------------------------------------------------------------------------
+// 入站流量：另一個MQTT 3.1.1連線以固定速率發布QoS 0訊息到測試主題
+// ---------------------------------------------------------------------------
+
+class InboundInjector {
+public:
+    InboundInjector() : fd(-1), running(false), sent(0) {}
+
+    ~InboundInjector() {
+        stop();
+    }
+
+    bool start(const char* host, uint16_t port, uint32_t rate, uint16_t filters) {
+        struct addrinfo hints;
+        memset(&hints, 0, sizeof(hints));
+        hints.ai_family = AF_INET;
+        hints.ai_socktype = SOCK_STREAM;
+        struct addrinfo* result = NULL;
+        char service[8];
+        snprintf(service, sizeof(service), "%u", port);
+        if (getaddrinfo(host, service, &hints, &result) != 0) {
+            return false;
+        }
+        fd = socket(AF_INET, SOCK_STREAM, 0);
+        bool connected = fd >= 0 && ::connect(fd, result->ai_addr, result->ai_addrlen) == 0;
+        freeaddrinfo(result);
+
+        MqttConnectOptions connectOptions;
+        memset(&connectOptions, 0, sizeof(connectOptions));
+        connectOptions.clientId = "mqtt_harness_in";
+        connectOptions.keepAlive = 60;
+        connectOptions.protocolVersion = MQTT_VERSION_3_1_1;
+        connectOptions.cleanSession = true;
+        uint8_t packet[64];
+        size_t length = MqttPacket::buildConnect(packet, sizeof(packet), connectOptions);
+        if (!connected || length == 0 || !sendAll(packet, length)) {
+            stop();
+            return false;
+        }
+
+        sent = 0;
+        running = true;
+        worker = std::thread(&InboundInjector::run, this, rate, filters);
+        return true;
+    }
+
+    void stop() {
+        if (running) {
+            running = false;
+            worker.join();
+        }
+        if (fd >= 0) {
+            ::close(fd);
+            fd = -1;
+        }
+    }
+
+    uint32_t getSent() const { return sent; }
+
+private:
+    int fd;
+    std::atomic<bool> running;
+    std::atomic<uint32_t> sent;
+    std::thread worker;
+
+    bool sendAll(const uint8_t* data, size_t length) {
+        while (length > 0) {
+            ssize_t written = send(fd, data, length, MSG_NOSIGNAL);
+            if (written <= 0) {
+                return false;
+            }
+            data += written;
+            length -= written;
+        }
+        return true;
+    }
+
+    // 依經過時間補足應送出的數量；CONNACK與其他回覆直接丟棄
+    void run(uint32_t rate, uint16_t filters) {
+        unsigned long start = micros();
+        while (running) {
+            uint8_t discard[64];
+            while (recv(fd, discard, sizeof(discard), MSG_DONTWAIT) > 0) {
+            }
+
+            uint64_t due = (uint64_t)(micros() - start) * rate / 1000000;
+            while (sent < due && running) {
+                char topic[48];
+                char payload[32];
+                uint32_t sequence = sent;
+                snprintf(topic, sizeof(topic), "harness/%u/inbound/state", sequence % filters);
+                int length = snprintf(payload, sizeof(payload), "{\"in\":%u}", sequence);
+                uint8_t header[64];
+                size_t headerLength = MqttPacket::buildPublishHeader(header, sizeof(header), topic, length, 0, false,
+                                                                     false, 0, MQTT_VERSION_3_1_1);
+                if (headerLength == 0 || !sendAll(header, headerLength) ||
+                    !sendAll((const uint8_t*)payload, length)) {
+                    return;
+                }
+                sent++;
+            }
+            delay(1);
+        }
+    }
+};
+
+// ---------------------------------------------------------------------------
+// 測試客戶端
+// ---------------------------------------------------------------------------
+
+struct HarnessOptions {
+    const char* host;
+    uint16_t port;
+    uint8_t version;
+    uint32_t messages;
+    uint16_t filters;
+    uint32_t refusals;
+    uint32_t sessionExpiry;     // MQTT 5會話保留秒數 (0代表每次連線清除會話)
+    uint32_t outboundRate;      // 本端發布速率 (則/秒，0代表只受在途窗口限制)
+    uint32_t inboundRate;       // 注入連線的發布速率 (則/秒，0代表不注入)
+};
+
+struct Round {
+    uint32_t sent;
+    uint32_t received;
+    uint32_t misrouted;
+    uint32_t qos1Sent;
+    uint32_t pubacks;
+    uint32_t inbound;                       // 收到的注入訊息
+    uint32_t allocations;                   // 本端執行緒在該輪的配置次數
+    std::vector<unsigned long> latencies;   // 微秒
+};
+
+class HarnessClient {
+public:
+    HarnessClient(const HarnessOptions& options)
+        : options(options),
+          client5(link),
+          policy(50, 1000, 10),
+          nextPacketId(1),
+          subacks(0),
+          subackCodes(0),
+          sessionPresent(false),
+          rxState(0),
+          rxHeader(0),
+          rxRemaining(0),
+          rxLength(0),
+          rxMultiplier(1),
+          round(NULL) {
+        link.setPacketListener(handlePacket, this);
+        policy.seed("harness");
+        client5.setKeepAlive(60);
+        client5.setCallback([this](char* topic, uint8_t* payload, unsigned int length) {
+            deliver(topic, payload, length);
+        });
+
+        // 每個過濾器只登記一個處理函數，訊息依主題只會送到其中一個
+        for (uint16_t i = 0; i < options.filters; i++) {
+            char filter[48];
+            snprintf(filter, sizeof(filter), "harness/%u/+/state", i);
+            filterNames.push_back(filter);
+            uint16_t index = i;
+            router.add(filter, [this, index](const char* topic, const uint8_t* payload, unsigned int length) {
+                onMessage(index, payload, length);
+            });
+        }
+    }
+
+    // 依序完成DNS、TCP、CONNECT/CONNACK與訂閱，返回耗時 (毫秒)，失敗返回-1
+    long connect() {
+        unsigned long start = millis();
+        if (!link.beginResolve(options.host)) {
+            return -1;
+        }
+        IPAddress address;
+        MqttLink::PollResult result;
+        while ((result = link.pollResolve(address)) == MqttLink::POLL_PENDING) {
+            if (millis() - start > STEP_TIMEOUT) {
+                return -1;
+            }
+            delay(1);
+        }
+        if (result != MqttLink::POLL_DONE || !link.beginConnect(address, options.port)) {
+            return -1;
+        }
+        while ((result = link.pollConnect()) == MqttLink::POLL_PENDING) {
+            if (millis() - start > STEP_TIMEOUT) {
+                link.stop();
+                return -1;
+            }
+            delay(1);
+        }
+        if (result != MqttLink::POLL_DONE) {
+            return -1;
+        }
+
+        MqttConnectOptions connectOptions;
+        memset(&connectOptions, 0, sizeof(connectOptions));
+        connectOptions.clientId = "mqtt_harness";
+        connectOptions.keepAlive = 60;
+        connectOptions.protocolVersion = options.version;
+        if (options.version == MQTT_VERSION_5 && options.sessionExpiry > 0) {
+            // 與MQTTManager相同：保留會話時不清除，讓伺服器在斷線期間保留訂閱
+            connectOptions.cleanSession = false;
+            connectOptions.sessionExpiry = options.sessionExpiry;
+        } else {
+            connectOptions.cleanSession = true;
+        }
+        uint8_t packet[128];
+        size_t length = MqttPacket::buildConnect(packet, sizeof(packet), connectOptions);
+        if (length == 0 || link.write(packet, length) != length || !awaitConnack(start)) {
+            link.stop();
+            return -1;
+        }
+
+        if (!subscribeAll(start)) {
+            link.stop();
+            return -1;
+        }
+        return (long)(millis() - start);
+    }
+
+    bool connected() {
+        return options.version == MQTT_VERSION_5 ? client5.connected() : link.connected() != 0;
+    }
+
+    // 發布count則訊息 (QoS 0與QoS 1交替)，等待全部送回
+    bool publishRound(Round& result, uint32_t count) {
+        // 先預留測試本身的容器，配置次數只反映傳輸層與分派
+        result.latencies.reserve(count);
+        inFlight.clear();
+        inFlight.reserve(WINDOW);
+        pendingAcks.reserve(count);
+        round = &result;
+        uint32_t next = 0;
+        unsigned long start = micros();
+        unsigned long lastProgress = millis();
+
+        uint32_t allocationsBefore = allocations;
+        countAllocations = true;
+        bool ok = true;
+        while (result.received + result.misrouted < count || result.pubacks < result.qos1Sent) {
+            uint64_t allowed = options.outboundRate == 0
+                                   ? count
+                                   : (uint64_t)(micros() - start) * options.outboundRate / 1000000 + 1;
+            while (next < count && next < allowed && inFlight.size() < WINDOW) {
+                if (!publishOne(next, result)) {
+                    ok = false;
+                    break;
+                }
+                next++;
+            }
+
+            uint32_t before = result.received + result.pubacks;
+            if (!ok || !pump(options.outboundRate == 0 ? 5 : 1)) {
+                ok = false;
+                break;
+            }
+            if (result.received + result.pubacks != before) {
+                lastProgress = millis();
+            } else if (millis() - lastProgress > STEP_TIMEOUT) {
+                printf("等待逾時: 已送達 %u / %u，PUBACK %u / %u\n", result.received, count, result.pubacks,
+                       result.qos1Sent);
+                ok = false;
+                break;
+            }
+        }
+        countAllocations = false;
+        result.allocations = allocations - allocationsBefore;
+        round = NULL;
+        return ok;
+    }
+
+    // 依ReconnectPolicy退避重連，返回嘗試次數，逾時返回-1
+    int reconnect(unsigned long& waitedMs, unsigned long& totalMs) {
+        link.stop();
+        policy.onDisconnected(false);
+        unsigned long start = millis();
+        waitedMs = 0;
+        for (int attempt = 1; millis() - start < 30000; attempt++) {
+            unsigned long wait = policy.nextDelay();
+            waitedMs += wait;
+            delay(wait);
+            if (connect() >= 0) {
+                policy.onConnected();
+                totalMs = millis() - start;
+                return attempt;
+            }
+        }
+        return -1;
+    }
+
+    void disconnect() {
+        if (options.version == MQTT_VERSION_5) {
+            client5.disconnect();
+        } else {
+            static const uint8_t DISCONNECT[] = {MQTT_PACKET_DISCONNECT, 0x00};
+            link.write(DISCONNECT, sizeof(DISCONNECT));
+            link.stop();
+        }
+    }
+
+    uint32_t getAliasHits() const { return client5.getAliasHits(); }
+
+    // 最近一次CONNACK是否回報伺服器保留了會話
+    bool getSessionPresent() const { return sessionPresent; }
+
+    // 最近一次被拒絕的CONNACK原因碼 (MQTT 5)
+    uint8_t getLastReasonCode() const { return client5.getLastReasonCode(); }
+
+private:
+    const HarnessOptions& options;
+    MqttLink link;
+    Mqtt5Client client5;
+    TopicRouter router;
+    ReconnectPolicy policy;
+    std::vector<std::string> filterNames;
+    uint16_t nextPacketId;
+    uint32_t subacks;
+    uint32_t subackCodes;                   // MqttLink監聽函數看到的SUBACK原因碼數
+    bool sessionPresent;
+
+    // MQTT 3.1.1的封包組裝 (韌體中由PubSubClient負責)
+    uint8_t buffer[512];
+    uint8_t rxState;
+    uint8_t rxHeader;
+    uint32_t rxRemaining;
+    uint32_t rxLength;
+    uint32_t rxMultiplier;
+
+    Round* round;
+    std::vector<std::pair<uint32_t, unsigned long> > inFlight;  // 序號與送出時間
+    std::vector<uint16_t> pendingAcks;
+
+    uint16_t takePacketId() {
+        if (nextPacketId == 0) {
+            nextPacketId = 1;
+        }
+        return nextPacketId++;
+    }
+
+    bool awaitConnack(unsigned long start) {
+        while (millis() - start < STEP_TIMEOUT) {
+            if (options.version == MQTT_VERSION_5) {
+                Mqtt5Connack connack;
+                int result = client5.acceptConnack(connack);
+                if (result != 0) {
+                    if (result > 0 && connack.reasonCode == 0) {
+                        sessionPresent = connack.sessionPresent;
+                        // 前幾個發布主題使用主題別名
+                        client5.clearAliases();
+                        for (uint16_t i = 0; i < options.filters && i < Mqtt5Client::ALIAS_SLOTS; i++) {
+                            char topic[48];
+                            snprintf(topic, sizeof(topic), "harness/%u/device/state", i);
+                            client5.reserveAlias(topic);
+                        }
+                        return true;
+                    }
+                    return false;
+                }
+            } else {
+                uint8_t data[4];
+                uint8_t returnCode;
+                if (link.peekBuffered(data, sizeof(data)) == sizeof(data)) {
+                    if (!MqttPacket::parseConnack(data, sizeof(data), &returnCode) || returnCode != 0) {
+                        return false;
+                    }
+                    link.read(data, sizeof(data));
+                    rxState = 0;
+                    return true;
+                }
+            }
+            if (!link.connected()) {
+                return false;
+            }
+            delay(1);
+        }
+        return false;
+    }
+
+    bool subscribeAll(unsigned long start) {
+        uint32_t expected = subacks;
+        uint32_t codes = subackCodes;
+        for (size_t i = 0; i < filterNames.size(); i += SUBSCRIBE_BATCH) {
+            const char* batch[SUBSCRIBE_BATCH];
+            uint8_t count = 0;
+            for (size_t j = i; j < filterNames.size() && count < SUBSCRIBE_BATCH; j++) {
+                batch[count++] = filterNames[j].c_str();
+            }
+            uint8_t packet[1024];
+            size_t length = MqttPacket::buildSubscribe(packet, sizeof(packet), takePacketId(), batch, count, 1,
+                                                       options.version);
+            if (length == 0 || link.write(packet, length) != length) {
+                return false;
+            }
+            expected++;
+        }
+        while (subacks < expected) {
+            if (millis() - start > STEP_TIMEOUT || !pump(1)) {
+                return false;
+            }
+        }
+
+        // 每個過濾器的原因碼都必須完整傳給監聽函數
+        if (subackCodes - codes != filterNames.size()) {
+            printf("SUBACK原因碼: 看到 %u / %u 個\n", subackCodes - codes, (unsigned)filterNames.size());
+            return false;
+        }
+        return true;
+    }
+
+    bool publishOne(uint32_t sequence, Round& result) {
+        char topic[48];
+        char payload[48];
+        snprintf(topic, sizeof(topic), "harness/%u/device/state", sequence % options.filters);
+        int length = snprintf(payload, sizeof(payload), "{\"seq\":%u}", sequence);
+        bool qos1 = (sequence & 1) != 0;
+        inFlight.push_back(std::make_pair(sequence, micros()));
+
+        if (!qos1 && options.version == MQTT_VERSION_5) {
+            if (!client5.publish(topic, (const uint8_t*)payload, length, false)) {
+                return false;
+            }
+        } else {
+            uint16_t packetId = qos1 ? takePacketId() : 0;
+            uint8_t header[96];
+            size_t headerLength = MqttPacket::buildPublishHeader(header, sizeof(header), topic, length, qos1 ? 1 : 0,
+                                                                 false, false, packetId, options.version);
+            if (headerLength == 0 || link.write(header, headerLength) != headerLength ||
+                link.write((const uint8_t*)payload, length) != (size_t)length) {
+                return false;
+            }
+            if (qos1) {
+                pendingAcks.push_back(packetId);
+                result.qos1Sent++;
+            }
+        }
+        result.sent++;
+        return true;
+    }
+
+    // 等待socket可讀 (最多timeoutMs)，處理所有已收到的封包
+    bool pump(int timeoutMs) {
+        if (link.buffered() == 0) {
+            struct pollfd fd = {link.fd(), POLLIN, 0};
+            poll(&fd, 1, timeoutMs);
+        }
+        if (options.version == MQTT_VERSION_5) {
+            return client5.loop();
+        }
+        while (link.available() > 0) {
+            int value = link.read();
+            if (value < 0) {
+                break;
+            }
+            assemble((uint8_t)value);
+        }
+        return link.connected() != 0;
+    }
+
+    void assemble(uint8_t b) {
+        switch (rxState) {
+            case 0:
+                rxHeader = b;
+                rxRemaining = 0;
+                rxLength = 0;
+                rxMultiplier = 1;
+                rxState = 1;
+                break;
+            case 1:
+                rxRemaining += (b & 0x7F) * rxMultiplier;
+                rxMultiplier *= 128;
+                if ((b & 0x80) == 0) {
+                    rxState = rxRemaining == 0 ? 0 : 2;
+                }
+                break;
+            default:
+                if (rxLength < sizeof(buffer)) {
+                    buffer[rxLength] = b;
+                }
+                if (++rxLength == rxRemaining) {
+                    rxState = 0;
+                    if ((rxHeader & 0xF0) == MQTT_PACKET_PUBLISH && rxLength <= sizeof(buffer) && rxLength >= 2) {
+                        // 轉送一律QoS 0：主題之後就是負載
+                        size_t topicLength = ((size_t)buffer[0] << 8) | buffer[1];
+                        if (2 + topicLength <= rxLength) {
+                            memmove(buffer, buffer + 2, topicLength);
+                            buffer[topicLength] = '\0';
+                            deliver((char*)buffer, buffer + 2 + topicLength, rxLength - 2 - topicLength);
+                        }
+                    }
+                }
+                break;
+        }
+    }
+
+    void deliver(char* topic, uint8_t* payload, unsigned int length) {
+        if (router.dispatch(topic, payload, length) != 1 && round != NULL) {
+            round->misrouted++;
+        }
+    }
+
+    void onMessage(uint16_t filterIndex, const uint8_t* payload, unsigned int length) {
+        if (round == NULL) {
+            return;
+        }
+        unsigned int sequence;
+        char text[48];
+        size_t copy = length < sizeof(text) - 1 ? length : sizeof(text) - 1;
+        memcpy(text, payload, copy);
+        text[copy] = '\0';
+        if (sscanf(text, "{\"in\":%u}", &sequence) == 1) {
+            if (sequence % options.filters != filterIndex) {
+                round->misrouted++;
+            } else {
+                round->inbound++;
+            }
+            return;
+        }
+        if (sscanf(text, "{\"seq\":%u}", &sequence) != 1 || sequence % options.filters != filterIndex) {
+            round->misrouted++;
+            return;
+        }
+        for (size_t i = 0; i < inFlight.size(); i++) {
+            if (inFlight[i].first == sequence) {
+                round->latencies.push_back(micros() - inFlight[i].second);
+                inFlight.erase(inFlight.begin() + i);
+                round->received++;
+                return;
+            }
+        }
+    }
+
+    static void handlePacket(uint8_t header, const uint8_t* body, size_t bodyLength, void* context) {
+        HarnessClient* client = static_cast<HarnessClient*>(context);
+        if ((header & 0xF0) == MQTT_PACKET_SUBACK) {
+            client->subacks++;
+            size_t codesOffset = client->options.version == MQTT_VERSION_5 ? 3 : 2;
+            if (bodyLength > codesOffset) {
+                client->subackCodes += bodyLength - codesOffset;
+            }
+        } else if ((header & 0xF0) == MQTT_PACKET_PUBACK && bodyLength >= 2 && client->round != NULL) {
+            uint16_t packetId = ((uint16_t)body[0] << 8) | body[1];
+            std::vector<uint16_t>& pending = client->pendingAcks;
+            std::vector<uint16_t>::iterator found = std::find(pending.begin(), pending.end(), packetId);
+            if (found != pending.end()) {
+                pending.erase(found);
+                client->round->pubacks++;
+            }
+        }
+    }
+};
+
+static unsigned long percentile(std::vector<unsigned long> values, double fraction) {
+    if (values.empty()) {
+        return 0;
+    }
+    std::sort(values.begin(), values.end());
+    size_t index = (size_t)(fraction * (values.size() - 1) + 0.5);
+    return values[index];
+}
+
+static bool report(const char* name, const Round& round, uint32_t expected, unsigned long elapsedMs) {
+    printf("%s: 送出 %u, 送達 %u, 分派錯誤 %u, PUBACK %u / %u, %.0f 則/秒, 往返 p50 %lu us, p99 %lu us, 最大 %lu us\n",
+           name, round.sent, round.received, round.misrouted, round.pubacks, round.qos1Sent,
+           elapsedMs > 0 ? round.received * 1000.0 / elapsedMs : 0.0, percentile(round.latencies, 0.5),
+           percentile(round.latencies, 0.99), percentile(round.latencies, 1.0));
+    printf("%s: 入站 %u 則 (%.0f 則/秒), 配置 %u 次 (每則 %.2f 次)\n", name, round.inbound,
+           elapsedMs > 0 ? round.inbound * 1000.0 / elapsedMs : 0.0, round.allocations,
+           round.sent + round.inbound > 0 ? (double)round.allocations / (round.sent + round.inbound) : 0.0);
+    return round.received == expected && round.misrouted == 0 && round.pubacks == round.qos1Sent;
+}
+
+// 發布一輪；指定入站速率時同時啟動注入連線
+static bool runRound(HarnessClient& client, const HarnessOptions& options, Round& round, unsigned long& elapsedMs) {
+    InboundInjector injector;
+    if (options.inboundRate > 0 && !injector.start(options.host, options.port, options.inboundRate, options.filters)) {
+        printf("無法建立入站注入連線\n");
+        return false;
+    }
+    unsigned long start = millis();
+    bool ok = client.publishRound(round, options.messages);
+    elapsedMs = millis() - start;
+    injector.stop();
+    return ok;
+}
+
+// 延遲完成的"localhost"查詢 (127.0.0.1) 被IP字串127.0.0.2取代後，結果必須維持127.0.0.2
+static bool checkSupersededResolve() {
+    MqttLink link;
+    setenv("AIOT_HOST_DNS_DELAY_MS", "100", 1);
+    bool started = link.beginResolve("localhost");
+    unsetenv("AIOT_HOST_DNS_DELAY_MS");
+    if (!started || !link.beginResolve("127.0.0.2")) {
+        return false;
+    }
+
+    // 等待舊查詢的回調執行完畢
+    delay(300);
+    IPAddress address;
+    return link.pollResolve(address) == MqttLink::POLL_DONE && address == IPAddress(127, 0, 0, 2);
+}
+
+int main(int argc, char** argv) {
+    HarnessOptions options = {NULL, 1883, MQTT_VERSION_3_1_1, 1000, 16, 3, 300, 0, 0};
+    int opt;
+    while ((opt = getopt(argc, argv, "h:p:5n:f:r:e:o:i:")) != -1) {
+        switch (opt) {
+            case 'h': options.host = optarg; break;
+            case 'p': options.port = (uint16_t)atoi(optarg); break;
+            case '5': options.version = MQTT_VERSION_5; break;
+            case 'n': options.messages = strtoul(optarg, NULL, 10); break;
+            case 'f': options.filters = (uint16_t)atoi(optarg); break;
+            case 'r': options.refusals = strtoul(optarg, NULL, 10); break;
+            case 'e': options.sessionExpiry = strtoul(optarg, NULL, 10); break;
+            case 'o': options.outboundRate = strtoul(optarg, NULL, 10); break;
+            case 'i': options.inboundRate = strtoul(optarg, NULL, 10); break;
+            default:
+                fprintf(stderr,
+                        "用法: %s [-h 主機] [-p 埠] [-5] [-n 訊息數] [-f 過濾器數] [-r 拒絕連線次數] [-e 會話保留秒數]"
+                        " [-o 發布速率] [-i 入站速率]\n",
+                        argv[0]);
+                return 2;
+        }
+    }
+    if (options.filters == 0 || options.messages == 0) {
+        fprintf(stderr, "訊息數與過濾器數必須大於0\n");
+        return 2;
+    }
+    signal(SIGPIPE, SIG_IGN);
+
+    // 確認operator new已被取代，否則配置次數一律為0
+    uint32_t allocationsBefore = allocations;
+    countAllocations = true;
+    std::string probe(64, 'x');
+    countAllocations = false;
+    if (allocations == allocationsBefore || probe.size() != 64) {
+        printf("operator new未被取代，無法計算配置次數\n");
+        return 1;
+    }
+
+    if (!checkSupersededResolve()) {
+        printf("被取代的DNS查詢覆寫了新的結果\n");
+        return 1;
+    }
+    printf("被取代的DNS查詢: 已忽略\n");
+
+    LoopbackBroker broker;
+    if (options.host == NULL) {
+        if (!broker.start()) {
+            fprintf(stderr, "無法啟動內建broker\n");
+            return 1;
+        }
+        // 以主機名稱連線，經過非同步DNS的路徑
+        options.host = "localhost";
+        options.port = broker.getPort();
+    }
+    printf("broker %s:%u, MQTT %s, %u 個過濾器, 每輪 %u 則訊息, 發布速率 %u 則/秒 (0為不限), 入站 %u 則/秒\n",
+           options.host, options.port, options.version == MQTT_VERSION_5 ? "5" : "3.1.1", options.filters,
+           options.messages, options.outboundRate, options.inboundRate);
+
+    HarnessClient client(options);
+    long connectMs = client.connect();
+    if (connectMs < 0) {
+        printf("連線失敗\n");
+        return 1;
+    }
+    printf("連線與訂閱: %ld ms\n", connectMs);
+
+    bool ok = true;
+    Round first = Round();
+    unsigned long elapsedMs = 0;
+    ok = runRound(client, options, first, elapsedMs) && ok;
+    ok = report("第一輪", first, options.messages, elapsedMs) && ok;
+
+    // 斷線後依退避重連；內建broker同時拒絕接下來的幾次連線
+    if (broker.getPort() != 0) {
+        broker.refuseNext(options.refusals, options.version == MQTT_VERSION_5 ? REFUSE_REASON : 0);
+    }
+    unsigned long waitedMs = 0;
+    unsigned long totalMs = 0;
+    int attempts = client.reconnect(waitedMs, totalMs);
+    if (attempts < 0) {
+        printf("重連失敗\n");
+        return 1;
+    }
+    printf("重連: 第 %d 次嘗試成功，退避等待 %lu ms，合計 %lu ms\n", attempts, waitedMs, totalMs);
+
+    Round second = Round();
+    ok = runRound(client, options, second, elapsedMs) && ok;
+    ok = report("重連後", second, options.messages, elapsedMs) && ok;
+
+    if (options.version == MQTT_VERSION_5) {
+        // 每個別名主題第一次發布後都應改用別名，內建broker解析的次數必須與客戶端相同
+        printf("主題別名: 客戶端 %u 次", client.getAliasHits());
+        bool aliasOk = client.getAliasHits() > 0;
+        if (broker.getPort() != 0) {
+            printf("，broker解析 %u 次", broker.getAliasHits());
+            aliasOk = aliasOk && broker.getAliasHits() == client.getAliasHits();
+        }
+        printf("%s\n", aliasOk ? "" : " (不符)");
+        ok = aliasOk && ok;
+
+        if (options.sessionExpiry > 0) {
+            printf("會話保留 %u 秒: 重連時%s\n", options.sessionExpiry,
+                   client.getSessionPresent() ? "伺服器已恢復會話" : "伺服器未保留會話");
+            ok = client.getSessionPresent() && ok;
+        }
+        if (broker.getPort() != 0 && options.refusals > 0) {
+            uint8_t reason = client.getLastReasonCode();
+            printf("拒絕連線的原因碼: 0x%02X (%s)\n", reason, Mqtt5Client::describeReason(reason));
+            ok = reason == REFUSE_REASON && ok;
+        }
+    }
+    client.disconnect();
+    broker.stop();
+
+    printf("%s\n", ok ? "通過" : "失敗");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,156 @@
+#ifndef BROKER_POOL_H
+#define BROKER_POOL_H
+
+#include <Arduino.h>
+
+// 單一MQTT伺服器與其健康狀態
+struct BrokerEndpoint {
+    char host[64];                  // 主機名稱或IP
+    uint16_t port;                  // 埠
+    float connectMillis;            // 連線耗時的指數移動平均 (毫秒)
+    float rttMillis;                // PINGREQ往返時間的指數移動平均 (毫秒)
+    float failureRate;              // 連線失敗率的指數移動平均 (0~1)
+    unsigned long lastFailure;      // 最近一次失敗的時間 (0代表沒有失敗)
+    unsigned long lastProbe;        // 最近一次探測成功的時間 (0代表沒有)
+    uint32_t connects;              // 成功連線次數
+    uint32_t failures;              // 失敗次數 (連線失敗與非預期斷線)
+};
+
+/**
+ * BrokerPool 類別 - 依優先順序排列的MQTT伺服器清單與健康評分
+ * 分數以毫秒為單位，越低越好:
+ *   連線耗時 + RTT x 2 + 失敗率 x 3000 (失敗後5分鐘內線性恢復) + 順位 x 250
+ * 只有候選伺服器比目前使用的低SWITCH_MARGIN以上才會切換，避免在分數相近的伺服器間來回切換。
+ * 已連線時的回切 (failback) 還需要在目前伺服器停留MIN_DWELL、候選伺服器HOLD_DOWN內沒有失敗，
+ * 並且由呼叫端以獨立的TCP連線探測候選伺服器成功後才會斷線 (pendingProbe()/recordProbe())。
+ * 探測或回切後的連線失敗時，下一次探測前的等待從MIN_DWELL起倍增 (最多MAX_FAILBACK_BACKOFF次)。
+ */
+class BrokerPool {
+public:
+    // 最多可登記的伺服器數量
+    static const uint8_t MAX_BROKERS = 4;
+
+    // 切換所需的分數差距 (毫秒)
+    static const uint16_t SWITCH_MARGIN = 200;
+
+    // 回切前至少在目前伺服器停留的時間 (毫秒)
+    static const unsigned long MIN_DWELL = 300000;
+
+    // 候選伺服器最近一次失敗後需穩定的時間 (毫秒)
+    static const unsigned long HOLD_DOWN = 120000;
+
+    // 已連線時檢查回切的間隔 (毫秒)
+    static const unsigned long FAILBACK_CHECK_INTERVAL = 60000;
+
+    // 回切失敗後等待時間的最多倍增次數 (MIN_DWELL x 16 = 80分鐘)
+    static const uint8_t MAX_FAILBACK_BACKOFF = 4;
+
+    BrokerPool();
+
+    /**
+     * 依優先順序加入伺服器 (第一個為主要伺服器)
+     * @param host 主機名稱或IP (會被複製)
+     * @param port 埠
+     * @return 清單已滿或主機名稱過長時返回false
+     */
+    bool add(const char* host, uint16_t port);
+
+    // 獲取伺服器數量
+    uint8_t count() const;
+
+    // 獲取目前使用的伺服器
+    const BrokerEndpoint& current() const;
+
+    // 獲取目前使用的伺服器索引
+    uint8_t currentIndex() const;
+
+    /**
+     * 獲取指定伺服器
+     * @param index 索引
+     * @return 伺服器
+     */
+    const BrokerEndpoint& at(uint8_t index) const;
+
+    /**
+     * 記錄目前伺服器連線成功
+     * @param now 目前時間 (millis)
+     * @param connectMillis 從開始連線到收到CONNACK的時間
+     */
+    void recordConnect(unsigned long now, unsigned long connectMillis);
+
+    /**
+     * 記錄目前伺服器連線失敗或非預期斷線
+     * @param now 目前時間 (millis)
+     */
+    void recordFailure(unsigned long now);
+
+    /**
+     * 記錄目前伺服器的PINGREQ往返時間
+     * @param rttMillis 往返時間
+     */
+    void recordRtt(unsigned long rttMillis);
+
+    /**
+     * 重新連線前選擇伺服器 (目前伺服器仍是最佳或差距不足時維持不變)
+     * @param now 目前時間 (millis)
+     * @return 切換了伺服器時返回true
+     */
+    bool selectForReconnect(unsigned long now);
+
+    /**
+     * 已連線時檢查是否應回切到更健康的伺服器 (每FAILBACK_CHECK_INTERVAL最多判斷一次)
+     * 找到候選伺服器時先要求探測，探測成功後的下一次呼叫才返回true
+     * @param now 目前時間 (millis)
+     * @return 應該斷線並改連其他伺服器時返回true
+     */
+    bool shouldFailBack(unsigned long now);
+
+    /**
+     * 獲取等待探測的伺服器
+     * @return 索引，沒有時返回-1
+     */
+    int8_t pendingProbe() const;
+
+    /**
+     * 記錄探測結果 (失敗視同該伺服器連線失敗，並延長下一次回切前的等待)
+     * @param index 探測的伺服器
+     * @param now 目前時間 (millis)
+     * @param reachable 是否成功建立TCP連線
+     */
+    void recordProbe(uint8_t index, unsigned long now, bool reachable);
+
+    // 獲取回切失敗的連續次數
+    uint8_t getFailbackFailures() const;
+
+    /**
+     * 計算伺服器的健康分數
+     * @param index 索引
+     * @param now 目前時間 (millis)
+     * @return 分數 (越低越好)
+     */
+    float score(uint8_t index, unsigned long now) const;
+
+    // 獲取切換伺服器的次數
+    uint32_t getSwitchCount() const;
+
+private:
+    BrokerEndpoint brokers[MAX_BROKERS];
+    uint8_t brokerCount;
+    uint8_t active;                     // 目前使用的伺服器
+    unsigned long activeSince;          // 開始連上目前伺服器的時間
+    unsigned long lastFailbackCheck;    // 上次檢查回切的時間
+    uint32_t switchCount;
+    int8_t probeTarget;                 // 等待探測的伺服器 (-1代表沒有)
+    int8_t failbackTarget;              // 探測成功、下次重連時改用的伺服器 (-1代表沒有)
+    bool failingBack;                   // 正在回切，尚未知道連線結果
+    uint8_t failbackFailures;           // 連續的回切失敗次數
+    unsigned long lastFailbackFailure;  // 最近一次回切失敗的時間
+
+    // 記錄一次回切失敗
+    void recordFailbackFailure(unsigned long now);
+
+    // 找出分數最低的其他伺服器
+    int8_t bestAlternative(unsigned long now, bool requireStable) const;
+};
+
+#endif // BROKER_POOL_H
@@ -0,0 +1,93 @@
+#ifndef DEVICE_SHADOW_H
+#define DEVICE_SHADOW_H
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+
+/**
+ * DeviceShadow 類別 - 裝置狀態影子 (完整狀態 + 差異更新)
+ * 完整狀態 (裝置ID、房間、功能與最新讀數) 以保留訊息發布在 <deviceTopic>/shadow，
+ * 之後的遙測只發布變動的欄位到 <deviceTopic>/shadow/delta，不再重複靜態欄位。
+ * 每次帶有變動的訊息版本號加1，App收到的版本不連續時，對 <deviceTopic>/shadow/get
+ * 發布任意內容即可要求重新發布完整狀態。讀數沒有變化的心跳訊息只帶目前版本，不加版本號。
+ */
+class DeviceShadow {
+public:
+    DeviceShadow();
+
+    /**
+     * 設置靜態欄位 (內容不同時視為結構變更，需要重新發布完整狀態)
+     * @param deviceId 裝置ID
+     * @param roomId 房間ID (空字串代表未設置)
+     * @param features 功能標記 (需保持有效)
+     * @return 結構變更時返回true
+     */
+    bool setIdentity(const char* deviceId, const char* roomId, const char* features);
+
+    /**
+     * 更新讀數，與上次發布值不同的欄位標記為待發布
+     * @param temperature 溫度
+     * @param humidity 濕度
+     * @return 有欄位變動時返回true
+     */
+    bool setReading(float temperature, float humidity);
+
+    /**
+     * 是否需要發布完整狀態 (尚未發布過、結構變更或App要求重新同步)
+     * @return 需要時返回true
+     */
+    bool needsFull() const;
+
+    // 要求下一次發布完整狀態
+    void requestFull();
+
+    /**
+     * 寫入完整狀態 (不改變影子，發布成功後呼叫commitFull())
+     * @param doc 輸出文檔
+     */
+    void encodeFull(JsonDocument& doc) const;
+
+    // 完整狀態已發布：套用新版本號並清除待發布的欄位
+    void commitFull();
+
+    /**
+     * 寫入差異 (只有版本號與變動的欄位，不改變影子，發布成功後呼叫commitDelta())
+     * 發布失敗時不呼叫commitDelta()，變動的欄位會併入下一次差異，版本號保持連續
+     * @param doc 輸出文檔
+     * @return 有欄位變動時返回true，只有版本號的心跳返回false
+     */
+    bool encodeDelta(JsonDocument& doc) const;
+
+    // 差異已發布：套用新版本號並清除待發布的欄位
+    void commitDelta();
+
+    // 獲取目前版本號
+    uint32_t getVersion() const;
+
+    // 獲取完整狀態的發布次數
+    uint32_t getFullCount() const;
+
+    // 獲取差異訊息的發布次數
+    uint32_t getDeltaCount() const;
+
+private:
+    // 待發布欄位的位元旗標
+    static const uint8_t FIELD_TEMPERATURE = 0x01;
+    static const uint8_t FIELD_HUMIDITY = 0x02;
+
+    char deviceId[33];
+    char roomId[33];
+    const char* features;
+    float temperature;
+    float humidity;
+    bool hasReading;
+
+    uint8_t dirty;                      // 尚未發布的欄位
+    bool fullPending;                   // 是否需要發布完整狀態
+    bool structureChanged;              // 靜態欄位是否在上次完整狀態後變更
+    uint32_t version;                   // 每則帶有變動的訊息加1
+    uint32_t fullCount;
+    uint32_t deltaCount;
+};
+
+#endif // DEVICE_SHADOW_H
@@ -6,6 +6,15 @@
 #include "WiFiManager.h"
 #include "BLEManager.h"
 #include "TimeManager.h"
+#include "SeqLock.h"
+
+// 紅外線接收資料快照 - 由IR任務寫入，顯示任務讀取
+struct IRDisplayData {
+    char protocol[24];                           // 紅外線協議類型
+    uint32_t value;                              // 紅外線接收到的值
+    uint32_t bits;                               // 紅外線位元數
+    uint32_t timeout;                            // 顯示截止時間 (millis)
+};
 
 // DisplayManager 類別 - 用於處理OLED顯示相關功能
 class DisplayManager {
@@ -14,15 +23,18 @@ private:
     WiFiManager* wifiManager;                    // WiFi管理器指標
     BLEManager* bleManager;                      // BLE管理器指標
     TimeManager* timeManager;                    // 時間管理器指標
-    SemaphoreHandle_t* mutex;                    // 互斥鎖指標
     const long mqttIconBlinkInterval;            // MQTT傳輸圖示閃爍間隔
     
-    // 紅外線接收資料顯示相關參數
-    String irProtocol;                           // 紅外線協議類型
-    uint32_t irValue;                            // 紅外線接收到的值
-    uint16_t irBits;                             // 紅外線位元數
-    unsigned long irDisplayTimeout;              // 紅外線資料顯示超時時間
-    bool hasIRData;                              // 是否有紅外線資料
+    // 紅外線接收資料顯示相關參數 (以序號鎖交接，繪圖時不持有任何鎖)
+    SeqLock<IRDisplayData> irData;               // 最新的紅外線資料
+    uint32_t shownIRSequence;                    // 已顯示過期的資料寫入次數 (只由顯示任務使用)
+    
+    // 繪圖耗時
+    unsigned long frameMicros;                   // 上一次畫面繪製與傳輸耗時
+    unsigned long maxFrameMicros;                // 最長畫面繪製與傳輸耗時
+    
+    // 記錄一次畫面的耗時
+    void recordFrame(unsigned long startMicros);
 
 public:
     // 建構函數
@@ -31,7 +43,6 @@ public:
         WiFiManager* wifiManagerPtr, 
         BLEManager* bleManagerPtr,
         TimeManager* timeManagerPtr,
-        SemaphoreHandle_t* mutexPtr,
         long blinkInterval = 500
     );
 
@@ -52,6 +63,12 @@ public:
     void updateIRData(const String& protocol, uint32_t value, uint16_t bits);
       // 顯示紅外線接收資料畫面
     bool showIRData();
+    
+    // 獲取上一次畫面繪製與傳輸耗時 (微秒)
+    unsigned long getFrameMicros() const;
+    
+    // 獲取最長畫面繪製與傳輸耗時 (微秒)
+    unsigned long getMaxFrameMicros() const;
 };
 
 #endif // DISPLAY_MANAGER_H
\ No newline at end of file
@@ -0,0 +1,156 @@
+#ifndef IR_CODE_LIBRARY_H
+#define IR_CODE_LIBRARY_H
+
+#include <Arduino.h>
+#include "StorageManager.h"
+#include "IRCommand.h"
+
+// IR碼庫統計
+struct IRCodeLibraryStats {
+    size_t codes;           // 已保存的IR碼數
+    uint32_t hits;          // 從RAM快取取得的次數
+    uint32_t misses;        // 需要從Flash讀取的次數
+    uint32_t stores;        // 寫入Flash的次數
+    uint32_t failures;      // 找不到或Flash讀寫失敗的次數
+};
+
+/**
+ * IRCodeLibrary 類別 - 保存在Flash中的具名IR碼庫
+ * 每個IR碼以編號 (可附加簡短名稱) 保存為一個NVS鍵 (原始時序以IRTimingCodec編碼)，索引另存一個鍵，
+ * 第一次使用時才從Flash載入索引。最近使用的IR碼保留在RAM快取中，
+ * 重放時不需要重新讀取Flash或解析JSON。
+ */
+class IRCodeLibrary {
+public:
+    // 最多保存的IR碼數
+    static const size_t MAX_CODES = 64;
+    // RAM快取的IR碼數
+    static const size_t CACHE_SIZE = 4;
+    // 名稱最大長度 (不含結尾)
+    static const size_t NAME_MAX = 15;
+
+    /**
+     * 構造函數
+     * @param storage IR碼使用的儲存空間 (建議獨立的命名空間，例如"ircodes")
+     */
+    IRCodeLibrary(StorageManager* storage);
+    ~IRCodeLibrary();
+
+    /**
+     * 保存IR碼，編號已存在時覆寫
+     * @param id 編號
+     * @param name 名稱 (可為nullptr，不可與其他編號重複)
+     * @param cmd 要保存的命令
+     * @return 操作成功返回true
+     */
+    bool store(uint16_t id, const char* name, const IRCommand& cmd);
+
+    /**
+     * 取得IR碼，優先從RAM快取讀取
+     * @param id 編號
+     * @param cmd 輸出命令
+     * @return 找到時返回true
+     */
+    bool load(uint16_t id, IRCommand& cmd);
+
+    /**
+     * 刪除IR碼
+     * @param id 編號
+     * @return 編號存在且刪除成功時返回true
+     */
+    bool remove(uint16_t id);
+
+    /**
+     * 以名稱查詢編號
+     * @param name 名稱
+     * @return 編號，找不到時返回-1
+     */
+    int32_t findId(const char* name);
+
+    /**
+     * 取得尚未使用的最小編號
+     * @return 編號，碼庫已滿時返回-1
+     */
+    int32_t allocateId();
+
+    /**
+     * 為學習模式保留編號：保存前allocateId()不會分配此編號，名稱也不可被其他編號使用
+     * 同時只保留一個編號，新的保留取代舊的，保存該編號或呼叫release()時解除
+     * @param id 編號，小於0時分配最小的可用編號
+     * @param name 名稱 (可為nullptr)
+     * @return 保留的編號，編號無效或碼庫已滿時返回-1
+     */
+    int32_t reserve(int32_t id, const char* name);
+
+    /**
+     * 解除保留 (學習逾時)
+     * @param id 保留的編號，已被新的保留取代時不處理
+     */
+    void release(uint16_t id);
+
+    /**
+     * 獲取統計資料
+     * @return 統計資料
+     */
+    IRCodeLibraryStats getStats();
+
+private:
+    // 索引項目 (直接以二進位保存到Flash，共20位元組)
+    struct IndexEntry {
+        uint16_t id;
+        uint16_t size;                  // 紀錄大小 (位元組)
+        char name[NAME_MAX + 1];
+    };
+
+    // RAM快取項目
+    struct CacheEntry {
+        bool used;
+        uint16_t id;
+        uint32_t lastUsed;              // 最近使用序號 (用來淘汰最久未使用的項目)
+        IRCommand cmd;
+    };
+
+    StorageManager* _storage;
+    SemaphoreHandle_t _mutex;
+
+    // 索引 (第一次使用時才載入)
+    bool _indexLoaded;
+    IndexEntry _index[MAX_CODES];
+    size_t _count;
+
+    // 學習中的編號與名稱 (只在RAM中，-1代表沒有保留)
+    int32_t _reservedId;
+    char _reservedName[NAME_MAX + 1];
+
+    CacheEntry _cache[CACHE_SIZE];
+    uint32_t _useCounter;
+
+    uint32_t _hits;
+    uint32_t _misses;
+    uint32_t _stores;
+    uint32_t _failures;
+
+    // 載入索引 (需持有鎖)
+    void ensureIndex();
+
+    // 保存索引 (需持有鎖)
+    bool saveIndex();
+
+    // 查詢索引位置，找不到時返回-1 (需持有鎖)
+    int findEntry(uint16_t id) const;
+
+    // 分配最小的可用編號，略過保留的編號 (需持有鎖)
+    int32_t nextFreeId() const;
+
+    // 放入RAM快取，快取已滿時淘汰最久未使用的項目 (需持有鎖)
+    void cachePut(uint16_t id, const IRCommand& cmd);
+
+    // IR碼的Flash鍵名
+    static void makeKey(uint16_t id, char* key, size_t keySize);
+
+    // 命令與Flash紀錄之間的轉換
+    static size_t encodeRecord(const IRCommand& cmd, uint8_t* out, size_t outSize);
+    static bool decodeRecord(const uint8_t* data, size_t length, IRCommand& cmd);
+};
+
+#endif // IR_CODE_LIBRARY_H
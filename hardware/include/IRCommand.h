@@ -0,0 +1,33 @@
+#ifndef IR_COMMAND_H
+#define IR_COMMAND_H
+
+#include <Arduino.h>
+
+// 原始IR命令的最大長度
+#define IR_COMMAND_MAX_RAW 100
+
+// 原始時序以IRTimingCodec編碼後的最大長度 (IRTimingCodec::maxEncodedSize(IR_COMMAND_MAX_RAW))
+#define IR_COMMAND_MAX_ENCODED 256
+
+// IR命令類型
+enum class IRCommandType : uint8_t {
+    RAW,
+    NEC,
+    SONY,
+    RC5,
+    RC6
+};
+
+// 已解析、等待發射的IR命令
+struct IRCommand {
+    IRCommandType type;
+    uint32_t value;                     // 編碼值 (RAW以外)
+    uint16_t bits;                      // 位元數
+    uint16_t repeat;                    // 重複次數 (Sony)
+    uint16_t khz;                       // 載波頻率 (RAW)
+    uint16_t rawLength;                 // 原始時序數量
+    uint16_t raw[IR_COMMAND_MAX_RAW];   // 原始時序 (微秒)
+    unsigned long enqueuedMicros;       // 放入佇列的時間
+};
+
+#endif // IR_COMMAND_H
@@ -7,10 +7,47 @@
 #include <IRrecv.h>
 #include <IRutils.h>
 #include <ArduinoJson.h>
+#include <driver/pcnt.h>
+#include "SpscQueue.h"
+#include "IRCommand.h"
+
+// IR發射統計
+struct IRTransmitStats {
+    size_t queued;                      // 佇列中的命令數
+    uint32_t sent;                      // 已發射的命令數
+    uint32_t overflow;                  // 佇列已滿而丟棄的命令數
+    unsigned long lastEnqueueMicros;    // 上一次解析到入列的耗時
+    unsigned long maxEnqueueMicros;     // 解析到入列的最長耗時
+    unsigned long lastQueueDelayMicros; // 上一個命令在佇列中等待的時間
+    unsigned long lastEmitMicros;       // 上一次發射耗時
+    unsigned long maxEmitMicros;        // 發射最長耗時
+    uint32_t groupFiltered;             // 群組不符而略過的命令數
+};
+
+// IR接收統計
+struct IRReceiveStats {
+    bool edgeDriven;                    // 是否以邊緣中斷喚醒 (false代表退回定時輪詢)
+    uint32_t frames;                    // 解碼並發布的訊框數
+    uint32_t wakeups;                   // 接收任務被喚醒的次數
+    uint32_t spurious;                  // 喚醒後沒有解碼出訊框的次數 (雜訊)
+    uint32_t decodeCalls;               // 呼叫decode()的次數
+    uint64_t busyMicros;                // 接收任務累計耗時
+    unsigned long lastLatencyMicros;    // 上一個訊框從第一個邊緣到排入發布佇列的時間
+    unsigned long maxLatencyMicros;     // 上述時間的最大值
+};
+
+// 學習請求 (由MQTT任務交給IR接收任務)
+struct IRLearnRequest {
+    int32_t id;                         // 保存的編號 (已在碼庫中保留)
+    char name[16];                      // 名稱
+    unsigned long deadline;             // 逾時時間 (millis)
+};
 
 // 前向宣告以避免循環引用
 class DisplayManager;
 class MQTTManager;
+class ConfigManager;
+class IRCodeLibrary;
 
 
 class IRManager {
@@ -25,6 +62,72 @@ private:
     TaskHandle_t irReceiverTaskHandle;
     SemaphoreHandle_t irMutex;
     DisplayManager* displayManager;  // 顯示管理器指標
+    
+    // 發射佇列 (生產者: MQTT任務, 消費者: IR發射任務)
+    SpscQueue<IRCommand, 8> txQueue;
+    TaskHandle_t irTransmitTaskHandle;
+    volatile uint32_t txOverflowCount;
+    volatile uint32_t txSentCount;
+    unsigned long lastEnqueueMicros;
+    unsigned long maxEnqueueMicros;
+    volatile unsigned long lastQueueDelayMicros;
+    volatile unsigned long lastEmitMicros;
+    volatile unsigned long maxEmitMicros;
+    
+    // 接收喚醒 (PCNT在訊框的第一個邊緣觸發中斷，通知接收任務)
+    bool edgeDriven;
+    volatile unsigned long frameStartMicros;    // 目前訊框第一個邊緣的時間 (0代表沒有進行中的訊框)
+    uint32_t rxFrames;
+    uint32_t rxWakeups;
+    uint32_t rxSpurious;
+    uint32_t rxDecodeCalls;
+    uint64_t rxBusyMicros;
+    unsigned long rxLastLatencyMicros;
+    unsigned long rxMaxLatencyMicros;
+    
+    // 以PCNT監看接收腳位的邊緣 (不影響IRrecv自己的GPIO中斷)
+    bool beginEdgeInterrupt(int pin);
+    
+    // PCNT中斷 (訊框開始)
+    static void IRAM_ATTR onReceiveEdge(void* arg);
+    
+    // 等待目前訊框結束並發布，返回是否解碼出訊框
+    bool serviceFrame(MQTTManager* mqttManager);
+    
+    // 訊框處理完畢，準備偵測下一個訊框
+    void resetFrame();
+    
+    // 裝置群組 (命令帶有groups位元遮罩時，與本裝置的群組沒有交集就略過)
+    static const uint32_t ALL_GROUPS = 0xFFFFFFFF;
+    uint32_t groupMask;
+    uint32_t groupFilteredCount;
+    ConfigManager* configManager;       // 保存群組設定 (可選)
+    
+    // IR碼庫 (可選)，學習模式下一個接收到的訊框保存為learning.id
+    IRCodeLibrary* codeLibrary;
+    SpscQueue<IRLearnRequest, 4> learnQueue;    // 生產者: MQTT任務, 消費者: IR接收任務
+    IRLearnRequest learning;                    // 進行中的學習 (只由IR接收任務存取，id為-1代表沒有)
+    
+    // 取出最新的學習請求並處理逾時 (只在IR接收任務中呼叫)
+    void updateLearning();
+    
+    // 依命令類型解析協議值或原始時序
+    static bool parseCommand(const char* type, JsonVariantConst source, IRCommand& cmd);
+    
+    // 將接收到的訊框轉為可重放的命令
+    void captureCommand(IRCommand& cmd) const;
+    
+    // 處理碼庫命令 (play/store/learn/delete)，返回是否為碼庫命令，執行結果寫入result
+    bool handleLibraryCommand(const char* command, JsonVariantConst doc, unsigned long startMicros, bool& result);
+    
+    // 將命令放入發射佇列並喚醒發射任務
+    bool enqueueCommand(IRCommand& cmd, unsigned long startMicros);
+    
+    // 送出單一命令
+    void transmit(const IRCommand& cmd);
+    
+    // IR發射任務
+    static void irTransmitTask(void* parameter);
 
 public:
     // 構造函數
@@ -44,8 +147,32 @@ public:
     // 獲取IR接收主題
     const char* getIRReceiveTopic() const;
     
-    // 處理MQTT消息
-    bool handleMQTTMessage(const char* topic, const char* payload);
+    // 處理MQTT消息 (payload不需要以NULL結尾)，解析後放入發射佇列即返回
+    bool handleMQTTMessage(const char* topic, const uint8_t* payload, unsigned int length);
+    
+    // 處理已確定送給本裝置的IR命令 (裝置或房間主題)，不檢查主題
+    // 命令帶有"groups"位元遮罩時，只有屬於其中任一群組的裝置會發射
+    // {"command":"groups","groups":5} 設置本裝置所屬的群組
+    // 設置碼庫後可用 {"cmd":"play","id":17} 重放已保存的IR碼 ("cmd"與"command"相同)
+    bool handleCommand(const uint8_t* payload, unsigned int length);
+    
+    // 設置保存群組設定的ConfigManager，並載入已保存的群組
+    void setConfigManager(ConfigManager* config);
+    
+    // 設置IR碼庫，啟用play/store/learn/delete命令
+    void setCodeLibrary(IRCodeLibrary* library);
+    
+    // 設置本裝置所屬的群組 (位元遮罩，預設屬於所有群組，0代表不屬於任何群組)
+    void setGroupMask(uint32_t mask);
+    
+    // 獲取本裝置所屬的群組
+    uint32_t getGroupMask() const;
+    
+    // 獲取IR發射統計
+    IRTransmitStats getTransmitStats() const;
+    
+    // 獲取IR接收統計
+    IRReceiveStats getReceiveStats() const;
     
     // 發送原始IR數據
     void sendRawData(uint16_t* data, uint16_t len, uint16_t khz);
@@ -70,13 +197,13 @@ public:
     
     // 獲取接收到的IR信號並解碼
     bool read();
-      // 解析接收到的IR數據並發送到MQTT
-    void publishIRReceived(MQTTManager* mqttManager);
+      // 解析接收到的IR數據並發送到MQTT，返回是否有新的訊框
+    bool publishIRReceived(MQTTManager* mqttManager);
     
     // IR接收任務（靜態方法，用於FreeRTOS任務）
     static void irReceiverTask(void* parameter);
-      // 啟動IR接收任務
-    void startReceiverTask(MQTTManager* mqttManager);
+      // 啟動IR接收任務 (edgeWake為false時退回每10ms輪詢，用於比較)
+    void startReceiverTask(MQTTManager* mqttManager, bool edgeWake = true);
     
     // 將解碼類型轉換為字符串的靜態方法
     static const char* typeToString(decode_type_t type);
@@ -0,0 +1,84 @@
+#ifndef IR_TIMING_CODEC_H
+#define IR_TIMING_CODEC_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * IRTimingCodec 類別 - 原始IR時序 (標記/間隔，微秒) 的精簡編碼
+ * 時序先量化為載波週期數，再把相近的標記或間隔 (誤差12.5%以內) 合併為每個訊框自己的長度字典，
+ * 每個標記/間隔配對以字典索引表示，連續相同的配對以游程合併，最後以varint輸出。
+ * 量化與合併是有損的，但誤差遠小於IR接收器的容錯 (IRremoteESP8266預設25%)。
+ * 二進位格式用於Flash，MQTT以base64傳送。
+ * 不依賴Arduino核心，可在主機上編譯 (見bench/ir_timing_codec_bench.cpp)。
+ *
+ * 格式: 版本(1) 載波kHz(1) 時序數量(varint) 標記長度數(1) 間隔長度數(1)
+ *       字典 (varint載波週期數，先標記後間隔)...
+ *       配對 (varint: (游程-1) << 符號位元數 | 標記索引 * 間隔長度數 + 間隔索引)...
+ */
+class IRTimingCodec {
+public:
+    // 格式版本
+    static const uint8_t VERSION = 1;
+
+    // 字典最多的長度數 (標記與間隔合計)
+    static const uint8_t MAX_DICT = 32;
+
+    /**
+     * 編碼後最大的位元組數
+     * @param count 時序數量
+     * @return 位元組數
+     */
+    static size_t maxEncodedSize(size_t count);
+
+    /**
+     * 編碼原始時序
+     * @param timings 時序 (微秒，標記與間隔交替)
+     * @param count 時序數量
+     * @param khz 載波頻率
+     * @param out 輸出緩衝區
+     * @param outSize 緩衝區大小
+     * @return 編碼後的位元組數，空間不足或長度種類超過MAX_DICT時返回0
+     */
+    static size_t encode(const uint16_t* timings, size_t count, uint16_t khz, uint8_t* out, size_t outSize);
+
+    /**
+     * 解碼為原始時序
+     * @param data 編碼資料
+     * @param length 資料長度
+     * @param timings 輸出時序 (微秒)
+     * @param maxCount 輸出可保存的時序數量
+     * @param khz 輸出載波頻率 (可為nullptr)
+     * @return 時序數量，資料無效或超過maxCount時返回0
+     */
+    static size_t decode(const uint8_t* data, size_t length, uint16_t* timings, size_t maxCount, uint16_t* khz);
+
+    /**
+     * base64編碼後的長度 (不含結尾)
+     * @param length 資料長度
+     * @return 字元數
+     */
+    static size_t base64Length(size_t length);
+
+    /**
+     * base64編碼 (標準字元表，含補位)
+     * @param data 資料
+     * @param length 資料長度
+     * @param out 輸出字串 (以NULL結尾)
+     * @param outSize 緩衝區大小
+     * @return 字元數 (不含結尾)，空間不足時返回0
+     */
+    static size_t toBase64(const uint8_t* data, size_t length, char* out, size_t outSize);
+
+    /**
+     * base64解碼
+     * @param text 字串 (不需要以NULL結尾)
+     * @param length 字元數
+     * @param out 輸出緩衝區
+     * @param outSize 緩衝區大小
+     * @return 位元組數，格式錯誤或空間不足時返回0
+     */
+    static size_t fromBase64(const char* text, size_t length, uint8_t* out, size_t outSize);
+};
+
+#endif // IR_TIMING_CODEC_H
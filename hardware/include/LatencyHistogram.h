@@ -0,0 +1,75 @@
+#ifndef LATENCY_HISTOGRAM_H
+#define LATENCY_HISTOGRAM_H
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+
+/**
+ * LatencyHistogram 類別 - 固定區間的延遲直方圖
+ * 區間上限由呼叫者以遞增的靜態陣列提供，最後一格收集超過最大上限的樣本，
+ * 記錄只需比較與遞增，不配置記憶體。
+ */
+class LatencyHistogram {
+public:
+    // 最多支援的區間數 (含最後的溢位格)
+    static const uint8_t MAX_BUCKETS = 12;
+
+    /**
+     * 構造函數
+     * @param bounds 各區間的上限 (遞增，需在物件存續期間有效)
+     * @param boundCount 上限數量，區間數為boundCount+1
+     */
+    LatencyHistogram(const uint32_t* bounds, uint8_t boundCount);
+
+    /**
+     * 記錄一筆樣本
+     * @param value 延遲值 (單位與bounds相同)
+     */
+    void record(uint32_t value);
+
+    /**
+     * 清除所有樣本
+     */
+    void reset();
+
+    /**
+     * 獲取樣本數
+     * @return 樣本數
+     */
+    uint32_t getCount() const;
+
+    /**
+     * 獲取最大值
+     * @return 最大值
+     */
+    uint32_t getMax() const;
+
+    /**
+     * 獲取平均值
+     * @return 平均值，沒有樣本時為0
+     */
+    uint32_t getMean() const;
+
+    /**
+     * 以區間上限估計百分位數
+     * @param percent 百分位 (0-100)
+     * @return 樣本落入區間的上限，落在溢位格時返回最大值
+     */
+    uint32_t percentile(uint8_t percent) const;
+
+    /**
+     * 寫入精簡的JSON格式: {"n":樣本數,"avg":平均,"max":最大,"b":[各區間計數]}
+     * @param obj 輸出物件
+     */
+    void encode(JsonObject obj) const;
+
+private:
+    const uint32_t* _bounds;
+    uint8_t _bucketCount;
+    uint32_t _buckets[MAX_BUCKETS];
+    uint32_t _count;
+    uint32_t _max;
+    uint64_t _sum;
+};
+
+#endif // LATENCY_HISTOGRAM_H
@@ -0,0 +1,214 @@
+#ifndef LOGGER_H
+#define LOGGER_H
+
+#include <Arduino.h>
+#include <atomic>
+#include <functional>
+#include <type_traits>
+
+// 日誌等級
+#define AIOT_LOG_LEVEL_NONE     0
+#define AIOT_LOG_LEVEL_ERROR    1
+#define AIOT_LOG_LEVEL_WARN     2
+#define AIOT_LOG_LEVEL_INFO     3
+#define AIOT_LOG_LEVEL_DEBUG    4
+#define AIOT_LOG_LEVEL_VERBOSE  5
+
+// 編譯時的日誌等級 (可在platformio.ini以 -DAIOT_LOG_LEVEL=4 覆寫)
+#ifndef AIOT_LOG_LEVEL
+#define AIOT_LOG_LEVEL AIOT_LOG_LEVEL_INFO
+#endif
+
+// 高於編譯等級的巨集展開為空敘述，參數不會被求值
+#if AIOT_LOG_LEVEL >= AIOT_LOG_LEVEL_ERROR
+#define LOG_E(format, ...) Logger::write(AIOT_LOG_LEVEL_ERROR, format, ##__VA_ARGS__)
+#else
+#define LOG_E(format, ...) do {} while (0)
+#endif
+
+#if AIOT_LOG_LEVEL >= AIOT_LOG_LEVEL_WARN
+#define LOG_W(format, ...) Logger::write(AIOT_LOG_LEVEL_WARN, format, ##__VA_ARGS__)
+#else
+#define LOG_W(format, ...) do {} while (0)
+#endif
+
+#if AIOT_LOG_LEVEL >= AIOT_LOG_LEVEL_INFO
+#define LOG_I(format, ...) Logger::write(AIOT_LOG_LEVEL_INFO, format, ##__VA_ARGS__)
+#else
+#define LOG_I(format, ...) do {} while (0)
+#endif
+
+#if AIOT_LOG_LEVEL >= AIOT_LOG_LEVEL_DEBUG
+#define LOG_D(format, ...) Logger::write(AIOT_LOG_LEVEL_DEBUG, format, ##__VA_ARGS__)
+#else
+#define LOG_D(format, ...) do {} while (0)
+#endif
+
+#if AIOT_LOG_LEVEL >= AIOT_LOG_LEVEL_VERBOSE
+#define LOG_V(format, ...) Logger::write(AIOT_LOG_LEVEL_VERBOSE, format, ##__VA_ARGS__)
+#else
+#define LOG_V(format, ...) do {} while (0)
+#endif
+
+// 日誌輸出到MQTT等外部目的地的函數，返回false代表未送出
+typedef std::function<bool(uint8_t level, const char* line)> LogSink;
+
+// 單筆二進位日誌記錄 - 只存格式字串指標與打包後的參數，由輸出任務再格式化
+struct LogRecord {
+    const char* format;         // 格式字串 (必須是字串常數)
+    uint32_t timestamp;         // millis()
+    uint8_t level;              // 日誌等級
+    uint8_t length;             // args已使用的位元組數
+    uint8_t truncated;          // 參數是否因空間不足被截斷
+    uint8_t args[113];          // 打包的參數 (類型標記 + 數值)，足夠每60秒統計日誌最長的一行
+};
+
+/**
+ * Logger 類別 - 非同步日誌
+ * 呼叫端只把參數以二進位方式打包進無鎖的多生產者環形佇列 (Vyukov MPMC)，
+ * 由低優先權任務格式化後輸出到Serial，並可依速率限制轉送到MQTT。
+ * 佇列已滿時直接丟棄並計數，不會阻塞呼叫端。
+ */
+class Logger {
+public:
+    // 參數類型標記
+    enum ArgType : uint8_t {
+        ARG_INT = 1,
+        ARG_UINT,
+        ARG_INT64,
+        ARG_UINT64,
+        ARG_DOUBLE,
+        ARG_STRING,
+        ARG_POINTER
+    };
+
+    /**
+     * 啟動輸出任務
+     * @param priority 任務優先權
+     * @param core 執行的核心
+     */
+    static void begin(UBaseType_t priority = 1, BaseType_t core = 1);
+
+    /**
+     * 設置外部輸出 (例如MQTT日誌主題)
+     * @param sink 輸出函數，在輸出任務中呼叫
+     * @param minLevel 只轉送此等級以上 (數值較小) 的日誌
+     * @param burst 最多可連續送出的筆數
+     * @param refillMs 每補充一筆額度所需的毫秒數
+     */
+    static void setSink(LogSink sink, uint8_t minLevel = AIOT_LOG_LEVEL_WARN, uint8_t burst = 5,
+                        unsigned long refillMs = 2000);
+
+    /**
+     * 寫入一筆日誌 (請使用LOG_x巨集)
+     * @param level 日誌等級
+     * @param format printf格式字串，必須是字串常數
+     * @param args 參數
+     */
+    template <typename... Args>
+    static void write(uint8_t level, const char* format, const Args&... args) {
+        LogRecord* record = claim();
+        if (record == NULL) {
+            return;
+        }
+
+        record->format = format;
+        record->timestamp = millis();
+        record->level = level;
+        record->length = 0;
+        record->truncated = 0;
+        packAll(*record, args...);
+        commit(record);
+    }
+
+    /**
+     * 獲取因佇列已滿而丟棄的日誌數
+     * @return 丟棄數量
+     */
+    static uint32_t getDroppedCount();
+
+    /**
+     * 獲取因速率限制未轉送到外部輸出的日誌數
+     * @return 限流數量
+     */
+    static uint32_t getSinkThrottledCount();
+
+    /**
+     * 將記錄格式化為文字
+     * @param record 日誌記錄
+     * @param out 輸出緩衝區
+     * @param size 緩衝區大小
+     * @return 文字長度
+     */
+    static size_t render(const LogRecord& record, char* out, size_t size);
+
+private:
+    // 預留環形佇列位置，佇列已滿時返回NULL
+    static LogRecord* claim();
+
+    // 完成寫入，讓輸出任務可以讀取
+    static void commit(LogRecord* record);
+
+    // 取出一筆記錄並格式化，沒有記錄時返回false
+    static bool drainOne(char* line, size_t size, uint8_t* level);
+
+    // 輸出任務
+    static void drainTask(void* parameter);
+
+    // 寫入原始位元組
+    static void put(LogRecord& record, uint8_t type, const void* data, size_t size);
+
+    static void packAll(LogRecord&) {}
+
+    template <typename First, typename... Rest>
+    static void packAll(LogRecord& record, const First& first, const Rest&... rest) {
+        pack(record, first);
+        packAll(record, rest...);
+    }
+
+    template <typename T>
+    static typename std::enable_if<std::is_integral<T>::value || std::is_enum<T>::value>::type
+    pack(LogRecord& record, const T& value) {
+        if (std::is_signed<T>::value) {
+            if (sizeof(T) > 4) {
+                int64_t v = (int64_t)value;
+                put(record, ARG_INT64, &v, sizeof(v));
+            } else {
+                int32_t v = (int32_t)value;
+                put(record, ARG_INT, &v, sizeof(v));
+            }
+        } else {
+            if (sizeof(T) > 4) {
+                uint64_t v = (uint64_t)value;
+                put(record, ARG_UINT64, &v, sizeof(v));
+            } else {
+                uint32_t v = (uint32_t)value;
+                put(record, ARG_UINT, &v, sizeof(v));
+            }
+        }
+    }
+
+    template <typename T>
+    static typename std::enable_if<std::is_floating_point<T>::value>::type
+    pack(LogRecord& record, const T& value) {
+        double v = value;
+        put(record, ARG_DOUBLE, &v, sizeof(v));
+    }
+
+    // 字串會被複製，呼叫後緩衝區可以立即重複使用
+    static void pack(LogRecord& record, const char* value);
+    static void pack(LogRecord& record, char* value) { pack(record, (const char*)value); }
+    static void pack(LogRecord& record, const String& value) { pack(record, value.c_str()); }
+
+    template <size_t N>
+    static void pack(LogRecord& record, const char (&value)[N]) { pack(record, (const char*)value); }
+
+    template <size_t N>
+    static void pack(LogRecord& record, char (&value)[N]) { pack(record, (const char*)value); }
+
+    static void pack(LogRecord& record, const void* value) {
+        put(record, ARG_POINTER, &value, sizeof(value));
+    }
+};
+
+#endif // LOGGER_H
@@ -4,46 +4,318 @@
 #include <Arduino.h>
 #include <PubSubClient.h>
 #include <ArduinoJson.h>
+#include <atomic>
 #include "WiFiManager.h"
+#include "TelemetryBuffer.h"
+#include "TelemetryBatcher.h"
+#include "TelemetryFilter.h"
+#include "MqttLink.h"
+#include "Mqtt5Client.h"
+#include "ReconnectPolicy.h"
+#include "MqttOutbox.h"
+#include "MqttTopicTable.h"
+#include "TopicRouter.h"
+#include "MqttStats.h"
+#include "BrokerPool.h"
+#include "DeviceShadow.h"
+#include "PayloadTemplate.h"
+#include "SpscQueue.h"
 
 // 定義 MQTT 回調函數的格式
 typedef std::function<void(const char*, byte*, unsigned int)> MqttCallbackFunction;
 
+// 發布訊息的編碼格式
+enum class PayloadEncoding : uint8_t {
+    JSON,       // 文字JSON (預設)
+    MSGPACK     // MessagePack二進位格式
+};
+
+// 單一主題前綴的編碼規則
+struct TopicEncodingRule {
+    char prefix[64];            // 主題前綴
+    PayloadEncoding encoding;   // 使用的編碼
+};
+
+// MQTT非阻塞連線狀態機的階段
+enum class MqttConnectState : uint8_t {
+    IDLE,           // 未連線，等待下一次重連
+    RESOLVING,      // DNS解析中
+    CONNECTING,     // TCP連線中
+    AWAIT_CONNACK,  // 已送出CONNECT，等待CONNACK
+    CONNECTED       // 已連線
+};
+
+// 等待轉送到MQTT的一行日誌 (與Logger格式化的單行長度相同)
+struct MqttLogLine {
+    char text[192];
+};
+
+// 單筆遙測的發布主題 (位元遮罩，部分主題失敗時只重送失敗的主題)
+static const uint8_t SAMPLE_DEVICE_TOPIC = 0x01;    // 裝置主題 (影子模式為歷史主題)
+static const uint8_t SAMPLE_ROOM_TOPIC = 0x02;      // 房間主題
+static const uint8_t SAMPLE_ALL_TOPICS = SAMPLE_DEVICE_TOPIC | SAMPLE_ROOM_TOPIC;
+
+// 只發布到部分主題的暫存樣本 (以取樣時的millis()識別)
+struct PartialSample {
+    uint32_t capturedMillis;  // 取樣時間
+    uint8_t pendingTopics;    // 尚未成功的主題
+};
+
+// 依裝置與房間定址的命令主題 (<commandDeviceTopic>/<suffix> 與 <commandRoomTopic>/<suffix>)
+// 命令使用獨立的前綴，房間命令主題不會與deviceId相同的裝置遙測主題重疊
+struct ScopedRoute {
+    char suffix[16];          // 主題結尾，例如 "ir"
+    MqttTopicHandler handler; // 處理函數
+    char deviceFilter[152];   // 目前註冊的裝置主題
+    char roomFilter[112];     // 目前註冊的房間主題 (未設置房間時為空字串)
+};
+
 // MQTT管理器類別 - 用於處理MQTT相關功能
 class MQTTManager {
 private:
-    WiFiClient* wifiClient;                  // WiFi客戶端指標
-    PubSubClient* mqttClient;                // MQTT客戶端指標
+    MqttLink link;                           // 非阻塞TCP連線
+    PubSubClient* mqttClient;                // MQTT客戶端指標 (MQTT 3.1.1)
+    Mqtt5Client* mqtt5Client;                // MQTT 5客戶端指標 (選用MQTT 5時才建立)
+    uint8_t protocolVersion;                 // 使用的協議等級
+    uint32_t sessionExpiry;                  // MQTT 5會話保留秒數
+    MqttTls* tls;                            // TLS加密層 (啟用TLS時才建立)
     WiFiManager* wifiManager;                // WiFi管理器指標
     String deviceId;                         // 設備ID
     unsigned long lastMqttReconnectAttempt;  // 上次嘗試重連的時間
-    const long mqttReconnectInterval;        // 重連間隔
+    ReconnectPolicy reconnectPolicy;         // 重連退避策略
+    unsigned long reconnectDelay;            // 距離上次嘗試後需等待的時間
     unsigned long lastMqttPublish;           // 上次發布的時間
     const long mqttPublishInterval;          // 發布間隔
-    SemaphoreHandle_t* mutex;                // 互斥鎖指標
-    bool isMqttConnected;                    // MQTT連接狀態
-    bool isMqttTransmitting;                 // MQTT傳輸狀態
-    unsigned long mqttIconBlinkMillis;       // MQTT圖標閃爍時間
+    // 狀態旗標以原子變數保存，顯示任務讀取時不需互斥鎖
+    std::atomic<bool> isMqttConnected;                 // MQTT連接狀態
+    std::atomic<bool> isMqttTransmitting;              // MQTT傳輸狀態
+    std::atomic<unsigned long> mqttIconBlinkMillis;    // MQTT圖標閃爍時間
     const long mqttIconBlinkInterval;        // MQTT圖標閃爍間隔
     
     // MQTT設定
-    const char* mqttServer;                  // MQTT伺服器地址
-    const int mqttPort;                      // MQTT伺服器埠
+    BrokerPool brokers;                      // MQTT伺服器清單 (第一個為主要伺服器)
+    unsigned long connectStartedMillis;      // 本次連線嘗試的開始時間
+    
+    // 回切前的候選伺服器探測 (只建立TCP連線，不送CONNECT，避免伺服器踢掉同ID的連線)
+    MqttLink probeLink;
+    MqttConnectState probeState;             // 探測階段 (IDLE/RESOLVING/CONNECTING)
+    unsigned long probeStateSince;           // 進入目前探測階段的時間
+    IPAddress probeAddress;                  // 候選伺服器的位址
     const char* mqttTopic;                   // 基本主題
     const char* clientIdPrefix;              // 客戶端ID前綴
     
-    // 用戶回調函數
+    // 主題表
+    MqttTopicTable topics;
+    
+    // 非阻塞連線狀態機
+    MqttConnectState connectState;           // 目前階段
+    unsigned long connectStateSince;         // 進入目前階段的時間
+    unsigned long dnsTimeout;                // DNS解析逾時
+    unsigned long tcpTimeout;                // TCP連線逾時
+    unsigned long connackTimeout;            // 等待CONNACK逾時
+    IPAddress brokerAddress;                 // 解析出的伺服器位址
+    char clientId[40];                       // 本次連線使用的客戶端ID
+    bool persistentSession;                  // 以固定客戶端ID與clean session = false連線
+    uint8_t subscriptionQos;                 // 訂閱使用的QoS (保留會話時為1，離線期間的命令由伺服器保留)
+    uint16_t subscribePacketId;              // 最近一次SUBSCRIBE封包ID
+    uint8_t restoredSubscriptions;           // 最近一次連線恢復的訂閱數
+    unsigned long lastLoopMicros;            // 上一次loop()耗時
+    unsigned long maxLoopMicros;             // loop()最長耗時
+    
+    // 事件驅動喚醒
+    int eventFd;                             // 其他任務用來喚醒MQTT任務的eventfd (-1代表不可用)
+    uint32_t wakeupCount;                    // waitForEvent()返回次數
+    uint64_t busyMicros;                     // loop()累計耗時
+    unsigned long socketReadyMicros;         // socket可讀而喚醒的時間 (0代表無)
+    unsigned long lastInboundLatencyMicros;  // 上一則訊息從socket可讀到處理函數的時間
+    unsigned long maxInboundLatencyMicros;   // 上述時間的最大值
+    
+    // 診斷統計
+    MqttStats stats;
+    unsigned long disconnectedSince;         // 開始斷線的時間 (0代表已連線)
+    unsigned long diagInterval;              // 診斷快照發布間隔 (0代表停用)
+    unsigned long lastDiagPublish;           // 上次發布診斷快照的時間
+    
+    // 斷線期間的遙測暫存與補傳設定
+    TelemetryBuffer* telemetryBuffer;        // 遙測緩衝區指標 (可選)
+    uint8_t replayBatchSize;                 // 每次補傳的樣本數
+    unsigned long replayInterval;            // 補傳間隔
+    unsigned long lastReplay;                // 上次補傳的時間
+    static const uint8_t MAX_PARTIAL_SAMPLES = 4;
+    PartialSample partialSamples[MAX_PARTIAL_SAMPLES];  // 已發布到部分主題的暫存樣本
+    uint8_t partialSampleCount;
+    
+    // 批次模式 (預設停用，維持單筆格式)
+    TelemetryBatcher batcher;
+    
+    // 變化才回報 (預設停用，每個發布間隔都發布)
+    TelemetryFilter telemetryFilter;
+    
+    // 單筆遙測的預先序列化範本 (主題表重建時更新，預設停用)
+    PayloadTemplate sampleTemplate;
+    bool templateEnabled;
+    uint32_t templatePublishes;              // 以範本發布的次數
+    
+    // 裝置影子 (預設停用，維持每筆帶靜態欄位的格式)
+    DeviceShadow shadow;
+    bool shadowEnabled;
+    unsigned long lastShadowFull;            // 上次發布完整狀態的時間
+    
+    // 訊息編碼設定
+    static const uint8_t MAX_ENCODING_RULES = 4;
+    TopicEncodingRule encodingRules[MAX_ENCODING_RULES];
+    uint8_t encodingRuleCount;
+    PayloadEncoding defaultEncoding;
+    
+    // QoS 1 發布佇列
+    MqttOutbox outbox;
+    
+    // 轉送到MQTT的日誌 (生產者為日誌任務，與QoS 1佇列分開，不會佔用IR事件等訊息的位置)
+    SpscQueue<MqttLogLine, 4> logQueue;
+    
+    // 收到訊息的主題分派
+    TopicRouter router;
+    
+    // 依裝置與房間定址的命令主題 (房間變更時重新註冊)
+    static const uint8_t MAX_SCOPED_ROUTES = 2;
+    ScopedRoute scopedRoutes[MAX_SCOPED_ROUTES];
+    uint8_t scopedRouteCount;
+    
+    // 用戶回調函數 (沒有符合的處理函數時使用)
     MqttCallbackFunction userCallback;
     
+    // 重建主題表
+    void rebuildTopicTable();
+    
+    // 檢查房間ID是否變更，必要時重建主題表
+    void refreshTopicTable();
+    
+    // 開始新的連線嘗試
+    bool startConnect(unsigned long currentMillis);
+    
+    // 推進連線狀態機一步，連線完成時返回true
+    bool advanceConnect(unsigned long currentMillis);
+    
+    // 切換連線階段
+    void enterConnectState(MqttConnectState state, unsigned long currentMillis);
+    
+    // 連線失敗，回到閒置狀態等待重連
+    void failConnect(const char* reason);
+    
+    // 推進回切前的候選伺服器探測
+    void serviceBrokerProbe(unsigned long currentMillis);
+    
+    // 結束探測並把結果交給BrokerPool
+    void finishBrokerProbe(unsigned long currentMillis, bool reachable);
+    
+    // 直接送出CONNECT封包
+    bool sendConnect();
+    
+    // 處理緩衝區中的CONNACK並完成連線 (依協議等級交給對應的客戶端)
+    void acceptConnack(unsigned long currentMillis);
+    
+    // 目前協議的客戶端操作
+    bool clientConnected() const;
+    bool clientPublish(const char* topic, const uint8_t* payload, size_t length, bool retain);
+    bool clientSubscribe(const char* filter);
+    bool clientUnsubscribe(const char* filter);
+    
+    // 以批次SUBSCRIBE恢復訂閱登記表中的所有過濾器
+    bool restoreSubscriptions();
+    
+    // 送出一個批次SUBSCRIBE封包
+    bool sendSubscribeBatch(const char* const* filters, uint8_t count);
+    
+    // 送出UNSUBSCRIBE封包
+    bool sendUnsubscribe(const char* filter);
+    
+    // 為遙測主題登記MQTT 5主題別名
+    void reserveTopicAliases();
+    
+    // 連線完成後的訂閱與狀態發布
+    void onConnected();
+    
+    // 輸出連線錯誤碼說明
+    static void logConnectError(int state);
+    
+    // 計算距離下一個需要處理的期限的毫秒數
+    unsigned long nextWakeDelay(unsigned long currentMillis) const;
+    
+    // 發布單筆遙測樣本 (replay為true時附帶時間戳與佇列狀態，previousBoot為true時樣本的millis()已失效)
+    // pendingTopics為要發布的主題，返回時只留下失敗的主題 (nullptr代表所有主題)
+    bool publishSample(const TelemetrySample& sample, bool replay, bool previousBoot = false,
+                       uint8_t* pendingTopics = nullptr);
+    
+    // 記錄只發布到部分主題的暫存樣本，補傳時只重送失敗的主題
+    void rememberPartialSample(const TelemetrySample& sample, uint8_t pendingTopics);
+    
+    // 取出暫存樣本尚未成功的主題 (沒有紀錄時為所有主題)
+    uint8_t takePartialSample(const TelemetrySample& sample, bool previousBoot);
+    
+    // 重建單筆遙測的範本
+    void rebuildSampleTemplate();
+    
+    // 以範本發布單筆遙測 (編碼不是JSON或數值無法直接格式化時返回false，由呼叫端改用ArduinoJson)
+    bool publishTemplatedSample(const TelemetrySample& sample, uint8_t& pendingTopics, bool* result);
+    
+    // 以裝置影子發布樣本 (需要時發布完整狀態，否則只發布差異；補傳的樣本發布為歷史，不改變影子)
+    bool publishShadowSample(const TelemetrySample& sample, bool replay, bool previousBoot);
+    
+    // 補傳樣本的取樣時間 (有校時用ts，同一次開機用age，上次開機且未校時則只標記prevBoot)
+    void addReplayTime(JsonDocument& doc, const TelemetrySample& sample, bool previousBoot) const;
+    
+    // 發布完整狀態 (保留訊息，QoS 1)
+    bool publishShadowFull();
+    
+    // 處理App的重新同步要求
+    void handleShadowGet();
+    
+    // 以QoS 0發布排隊中的日誌 (publishLines為false時直接丟棄)
+    void drainLogQueue(bool publishLines);
+    
+    // 以限速批次補傳斷線期間暫存的樣本
+    void drainTelemetryBuffer(unsigned long currentMillis);
+    
+    // 送出目前累積的批次 (未連接時轉存到遙測緩衝區)
+    bool flushBatch();
+    
+    // 查詢主題使用的編碼
+    PayloadEncoding encodingFor(const char* topic) const;
+    
+    // 公告支援的編碼
+    void announceCapabilities();
+    
+    // 註冊裝置主題下的處理函數 (編碼協商與遙測設定)
+    void registerDeviceRoutes();
+    
+    // 以目前的主題表註冊定址命令主題
+    void registerScopedRoute(ScopedRoute& route);
+    
+    // 處理遙測設定訊息
+    void handleConfigMessage(const uint8_t* payload, unsigned int length);
+    
+    // 處理編碼協商訊息
+    void handleEncodingMessage(const uint8_t* payload, unsigned int length);
+    
+    // 序列化JSON文檔到緩衝區 (依主題選擇編碼)
+    size_t serializeFor(const char* topic, JsonDocument& doc, uint8_t* buffer, size_t bufferSize) const;
+    
+    // 處理MqttLink攔截到的封包 (PUBACK)
+    static void handlePacket(uint8_t header, const uint8_t* body, size_t bodyLength, void* instance);
+    
     // 內部回調處理
     static void handleCallback(char* topic, byte* payload, unsigned int length, void* instance);
 
 public:
+    // MQTT心跳間隔 (秒)
+    static const uint16_t KEEPALIVE_SECONDS = 15;
+    
+    // 保留會話時MQTT 5預設的會話保留秒數
+    static const uint32_t DEFAULT_SESSION_EXPIRY = 86400;
+    
     // 建構函數
     MQTTManager(
-        WiFiClient* wifiClientPtr, 
         WiFiManager* wifiManagerPtr,
-        SemaphoreHandle_t* mutexPtr,
         const char* server = "broker.emqx.io",
         int port = 1883,
         const char* baseTopic = "esp32/sensors",
@@ -59,30 +331,193 @@ public:
     // 初始化MQTT服務
     void begin(const String& deviceIdentifier);
     
-    // 設置使用者回調函數
+    // 設置使用者回調函數 (只收到沒有註冊處理函數的主題)
     void setCallback(MqttCallbackFunction callback);
     
-    // 訂閱主題
+    // 註冊主題過濾器的處理函數 (支援 + 與 # 萬用字元)，已連線時立即訂閱
+    // 過濾器保留在訂閱登記表中，每次收到CONNACK後以單一批次SUBSCRIBE恢復
+    bool on(const char* filter, MqttTopicHandler handler);
+    
+    // 移除主題過濾器的處理函數並取消訂閱
+    bool off(const char* filter);
+    
+    // 註冊只送給本裝置或本房間的命令主題: esp32/cmd/<room>/<deviceId>/<suffix> 與 esp32/cmd/<room>/<suffix>
+    // 房間變更時自動改訂新主題，伺服器只把命令轉送給實際的目標裝置
+    bool onScoped(const char* suffix, MqttTopicHandler handler);
+    
+    // 訂閱主題 (加入訂閱登記表，訊息交給setCallback()設置的回調函數)
     bool subscribe(const char* topic);
     
-    // 取消訂閱主題
+    // 取消訂閱主題 (從訂閱登記表移除)
     bool unsubscribe(const char* topic);
     
+    // 保留會話 (必須在begin()之前呼叫)：客戶端ID固定為前綴 + 裝置ID，以clean session = false連線，
+    // 訂閱改用QoS 1，離線期間的QoS 1命令由伺服器保留，重新連線後送達
+    // MQTT 5未設置會話保留秒數時使用DEFAULT_SESSION_EXPIRY
+    void setPersistentSession(bool enabled);
+    
+    // 是否保留會話
+    bool isPersistentSession() const;
+    
+    // 獲取最近一次連線恢復的訂閱數
+    uint8_t getRestoredSubscriptions() const;
+    
     // 發布消息
     bool publish(const char* topic, const char* payload, bool retain = false);
     
-    // 發布JSON格式的數據
-    bool publishJson(const char* topic, JsonDocument& doc, bool retain = false);
+    // 發布二進位消息
+    bool publish(const char* topic, const uint8_t* payload, size_t length, bool retain = false);
+    
+    // 以QoS 1發布消息 (複製到佇列後立即返回，由loop()送出並在收到PUBACK前保留)
+    bool publishQos1(const char* topic, const uint8_t* payload, size_t length, bool retain = false);
     
-    // 發布標準傳感器數據
+    // 轉送一行日誌到 <deviceTopic>/log (只由日誌任務呼叫)
+    // 只在已連線時放入獨立的佇列，由MQTT任務以QoS 0發布；未連線或佇列已滿時返回false，不輸出任何日誌
+    bool forwardLog(const char* line);
+    
+    // 發布JSON文檔 (依主題設定序列化為JSON或MessagePack，qos為0或1)
+    bool publishJson(const char* topic, JsonDocument& doc, bool retain = false, uint8_t qos = 0);
+    
+    // 設置預設編碼
+    void setDefaultEncoding(PayloadEncoding encoding);
+    
+    // 設置特定主題前綴使用的編碼
+    bool setTopicEncoding(const char* topicPrefix, PayloadEncoding encoding);
+    
+    // 發布標準傳感器數據 (MQTT未連接時暫存到遙測緩衝區)
     bool publishSensorData(float temperature, float humidity);
     
-    // 檢查並維護MQTT連接
+    // 設置批次模式 (batchSize小於等於1時停用，maxLatency為最長等待毫秒數)
+    void setBatchMode(uint8_t batchSize, unsigned long maxLatency);
+    
+    // 設置變化才回報模式 (溫濕度差距達到死區或超過heartbeat毫秒未發布時才發布)
+    void setReportOnChange(bool enabled, float temperatureDeadband = 1.0f, float humidityDeadband = 1.0f,
+                           unsigned long heartbeat = 300000);
+    
+    // 獲取被變化才回報模式抑制的發布次數
+    uint32_t getSuppressedCount() const;
+    
+    // 設置是否以預先序列化範本發布單筆遙測 (預設停用，一律以ArduinoJson序列化)
+    void setSampleTemplate(bool enabled);
+    
+    // 獲取以預先序列化範本發布的遙測次數
+    uint32_t getTemplatePublishCount() const;
+    
+    // 設置裝置影子模式 (完整狀態以保留訊息發布在<deviceTopic>/shadow，遙測只發布變動欄位到<deviceTopic>/shadow/delta)
+    void setShadowMode(bool enabled);
+    
+    // 是否使用裝置影子模式
+    bool isShadowMode() const;
+    
+    // 獲取裝置影子 (版本號與發布次數)
+    const DeviceShadow& getShadow() const;
+    
+    // 設置斷線期間使用的遙測緩衝區
+    void setTelemetryBuffer(TelemetryBuffer* buffer);
+    
+    // 設置補傳速率 (每interval毫秒最多補傳batchSize筆)
+    void setReplayRate(uint8_t batchSize, unsigned long interval);
+    
+    // 獲取待補傳的樣本數
+    size_t getBacklogDepth() const;
+    
+    // 獲取因緩衝區已滿而丟棄的樣本數
+    uint32_t getBacklogDropped() const;
+    
+    // 檢查並維護MQTT連接 (每次呼叫只推進連線狀態機一步，不會阻塞)
     bool loop();
     
-    // 嘗試連接MQTT伺服器
+    // 阻塞直到socket有資料、收到notify()或到達下一個期限 (心跳、重連、發布間隔等)
+    void waitForEvent(unsigned long maxWaitMs);
+    
+    // 喚醒在waitForEvent()中等待的MQTT任務 (可從任意任務呼叫)
+    void notify();
+    
+    // 檢查是否到了下一次發布傳感器數據的時間
+    bool isPublishDue() const;
+    
+    // 設置診斷快照的發布間隔 (毫秒，0代表停用)
+    void setDiagnosticsInterval(unsigned long interval);
+    
+    // 立即發布診斷快照到 <deviceTopic>/diag (保留訊息)
+    bool publishDiagnostics();
+    
+    // 獲取診斷統計
+    const MqttStats& getStats() const;
+    
+    // 獲取waitForEvent()喚醒次數
+    uint32_t getWakeupCount() const;
+    
+    // 獲取loop()累計耗時 (微秒)
+    uint64_t getBusyMicros() const;
+    
+    // 獲取上一則訊息從socket可讀到處理函數的延遲 (微秒)
+    unsigned long getInboundLatencyMicros() const;
+    
+    // 獲取上述延遲的最大值 (微秒)
+    unsigned long getMaxInboundLatencyMicros() const;
+    
+    // 選擇MQTT協議等級 (MQTT_VERSION_3_1_1 或 MQTT_VERSION_5)，必須在begin()之前呼叫
+    // sessionExpirySeconds大於0時，MQTT 5會話在斷線後保留，重新連線不需重建訂閱
+    bool setProtocolVersion(uint8_t version, uint32_t sessionExpirySeconds = 0);
+    
+    // 獲取使用的協議等級
+    uint8_t getProtocolVersion() const;
+    
+    // 啟用TLS (必須在begin()之前呼叫)
+    // caCert為PEM格式的CA憑證，NULL代表不驗證伺服器 (只適合本地測試)
+    // resumeSessions為true時重新連線 (含軟體重啟) 會嘗試以縮短握手恢復TLS會話
+    bool setTls(const char* caCert, bool resumeSessions = true);
+    
+    // 獲取TLS加密層 (未啟用時為NULL)，可查詢握手耗時與恢復次數
+    const MqttTls* getTls() const;
+    
+    // 加入備援伺服器 (依優先順序，必須在begin()之前呼叫)
+    // 重新連線時依連線耗時、PING往返時間與失敗率選擇伺服器，主要伺服器恢復後會自動回切
+    bool addBroker(const char* host, uint16_t port);
+    
+    // 獲取伺服器清單與健康狀態
+    const BrokerPool& getBrokerPool() const;
+    
+    // 獲取最近一次MQTT 5失敗的原因碼 (0代表沒有失敗，3.1.1時固定為0)
+    uint8_t getLastReasonCode() const;
+    
+    // 獲取MQTT 5主題別名省下的位元組數
+    uint32_t getAliasBytesSaved() const;
+    
+    // 以阻塞方式連接MQTT伺服器 (只在開機初始化時使用)
     bool connect();
     
+    // 主動乾淨斷線，loop()會以快速路徑重新連線
+    void disconnect();
+    
+    // 設置重連退避的基準時間與上限 (毫秒)
+    void setReconnectBackoff(unsigned long baseDelay, unsigned long maxDelay);
+    
+    // 設置連線各階段的逾時 (毫秒)
+    void setConnectTimeouts(unsigned long dnsMs, unsigned long tcpMs, unsigned long connackMs);
+    
+    // 獲取連線狀態機目前階段
+    MqttConnectState getConnectState() const;
+    
+    // 獲取上一次loop()耗時 (微秒)
+    unsigned long getLastLoopMicros() const;
+    
+    // 獲取loop()最長耗時 (微秒)
+    unsigned long getMaxLoopMicros() const;
+    
+    // 獲取等待PUBACK的QoS 1訊息數
+    uint8_t getInFlightDepth() const;
+    
+    // 獲取QoS 1佇列中的訊息數 (含在途)
+    uint8_t getOutboxDepth() const;
+    
+    // 獲取QoS 1累計重送次數
+    uint32_t getRetransmitCount() const;
+    
+    // 獲取QoS 1因佇列已滿而丟棄的訊息數
+    uint32_t getOutboxDropped() const;
+    
     // 獲取連接狀態
     bool isConnected() const;
     
@@ -95,7 +530,7 @@ public:
     // 設置傳輸狀態
     void setTransmitting(bool state);
     
-    // 獲取客戶端實例
+    // 獲取客戶端實例 (MQTT 3.1.1)
     PubSubClient* getClient();
     
     // 獲取基礎主題
@@ -103,6 +538,9 @@ public:
 
     // 生成完整的設備主題路徑
     String getDeviceTopic(const String& suffix = "") const;
+    
+    // 獲取預先計算的設備主題（不產生配置）
+    const char* getDeviceTopicCStr() const;
 };
 
 #endif // MQTT_MANAGER_H
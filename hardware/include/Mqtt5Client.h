@@ -0,0 +1,167 @@
+#ifndef MQTT5_CLIENT_H
+#define MQTT5_CLIENT_H
+
+#include <Arduino.h>
+#include <functional>
+#include "MqttLink.h"
+#include "MqttPacket.h"
+
+// 收到訊息時的回調 (與PubSubClient相同的格式)
+typedef std::function<void(char*, uint8_t*, unsigned int)> Mqtt5Callback;
+
+/**
+ * Mqtt5Client 類別 - 在MqttLink上實作MQTT 5的最小客戶端
+ * 介面對應MQTTManager用到的PubSubClient函數 (connected/loop/publish/subscribe)，
+ * 另外支援:
+ *   - 主題別名: 預先登記的熱門主題第一次發布時帶完整主題與別名，之後只送別名
+ *   - 會話保留: CONNECT帶Session Expiry Interval (由MQTTManager送出)
+ *   - 原因碼: 記錄CONNACK / SUBACK / DISCONNECT的原因碼並提供說明文字
+ * CONNECT由MQTTManager的非阻塞狀態機送出，CONNACK由acceptConnack()取走。
+ * PUBACK與PINGRESP仍由MqttLink的封包監聽處理。
+ */
+class Mqtt5Client {
+public:
+    // 可登記的主題別名數量
+    static const uint8_t ALIAS_SLOTS = 4;
+
+    // 接收緩衝區大小 (超過的訊息會被丟棄)，需容納帶100個原始時序的IR store命令 (約800位元組)
+    static const size_t BUFFER_SIZE = 1024;
+
+    explicit Mqtt5Client(MqttLink& link);
+
+    /**
+     * 設置收到訊息時的回調
+     * @param callback 回調函數
+     */
+    void setCallback(Mqtt5Callback callback);
+
+    /**
+     * 設置心跳間隔 (CONNACK帶有Server Keep Alive時以伺服器為準)
+     * @param seconds 秒數
+     */
+    void setKeepAlive(uint16_t seconds);
+
+    /**
+     * 從接收緩衝區取走CONNACK並進入已連線狀態 (不阻塞)
+     * @param connack 輸出CONNACK內容
+     * @return 1: 已取得CONNACK, 0: 資料尚未到齊, -1: 不是有效的CONNACK
+     */
+    int acceptConnack(Mqtt5Connack& connack);
+
+    // 是否已完成連線
+    bool connected() const;
+
+    /**
+     * 讀取並處理收到的封包、維持心跳
+     * @return 仍連線時返回true
+     */
+    bool loop();
+
+    /**
+     * 發布QoS 0訊息 (已登記別名的主題會自動使用別名)
+     * @param topic 主題
+     * @param payload 負載
+     * @param length 負載長度
+     * @param retain 是否保留
+     * @return 寫入成功返回true
+     */
+    bool publish(const char* topic, const uint8_t* payload, size_t length, bool retain);
+    bool publish(const char* topic, const char* payload, bool retain);
+
+    /**
+     * 訂閱主題，SUBACK的原因碼在loop()中檢查
+     * @param filter 主題過濾器
+     * @param qos 訂閱的QoS
+     * @return 寫入成功返回true
+     */
+    bool subscribe(const char* filter, uint8_t qos = 0);
+
+    /**
+     * 取消訂閱主題
+     * @param filter 主題過濾器
+     * @return 寫入成功返回true
+     */
+    bool unsubscribe(const char* filter);
+
+    /**
+     * 送出DISCONNECT並關閉連線
+     * @param reasonCode 原因碼 (0x00正常斷線，0x04斷線並發布遺囑)
+     */
+    void disconnect(uint8_t reasonCode = 0x00);
+
+    /**
+     * 登記使用別名的主題 (例如遙測主題)
+     * @param topic 主題 (會被複製)
+     * @return 登記成功返回true
+     */
+    bool reserveAlias(const char* topic);
+
+    /**
+     * 清除已登記的別名 (主題表重建時使用)
+     */
+    void clearAliases();
+
+    // 獲取最近一次失敗的原因碼 (0代表沒有失敗)
+    uint8_t getLastReasonCode() const;
+
+    // 獲取使用別名發布的次數
+    uint32_t getAliasHits() const;
+
+    // 獲取因使用別名而省下的位元組數
+    uint32_t getAliasBytesSaved() const;
+
+    /**
+     * 獲取原因碼的說明文字
+     * @param reasonCode 原因碼
+     * @return 說明文字
+     */
+    static const char* describeReason(uint8_t reasonCode);
+
+private:
+    // 已登記的主題別名
+    struct AliasSlot {
+        char topic[144];        // 主題 (空字串代表未使用)
+        bool announced;         // 本次連線是否已送出完整主題
+    };
+
+    MqttLink& link;
+    Mqtt5Callback callback;
+    bool sessionUp;                     // 是否已收到CONNACK
+    uint16_t keepAlive;                 // 心跳間隔 (秒)
+    uint16_t aliasMaximum;              // 伺服器接受的別名數量
+    uint32_t maximumPacketSize;         // 伺服器接受的最大封包 (0代表無限制)
+    uint16_t nextPacketId;              // 下一個SUBSCRIBE/UNSUBSCRIBE的封包ID
+    unsigned long lastOutbound;         // 上次送出資料的時間
+    unsigned long lastInbound;          // 上次收到資料的時間
+    bool pingOutstanding;               // 已送出PINGREQ尚未收到回應
+    uint8_t lastReasonCode;             // 最近一次失敗的原因碼
+
+    AliasSlot aliases[ALIAS_SLOTS];
+    uint32_t aliasHits;
+    uint32_t aliasBytesSaved;
+
+    // 封包組裝
+    uint8_t buffer[BUFFER_SIZE];
+    uint8_t rxState;                    // 0: 固定標頭, 1: 剩餘長度, 2: 封包內容
+    uint8_t rxHeader;
+    uint32_t rxRemaining;
+    uint32_t rxLength;
+    uint32_t rxMultiplier;
+
+    // 處理一個完整的封包
+    void handlePacket(uint8_t header, uint8_t* body, size_t length, bool truncated);
+
+    // 處理收到的PUBLISH
+    void handlePublish(uint8_t header, uint8_t* body, size_t length);
+
+    // 寫入封包並更新送出時間
+    bool send(const uint8_t* data, size_t length);
+
+    // 取得封包ID (跳過0)
+    uint16_t takePacketId();
+
+    // 關閉連線
+    void close();
+};
+
+#endif // MQTT5_CLIENT_H
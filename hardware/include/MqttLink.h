@@ -0,0 +1,176 @@
+#ifndef MQTT_LINK_H
+#define MQTT_LINK_H
+
+#include <Arduino.h>
+#include <Client.h>
+#include <IPAddress.h>
+#include "MqttTls.h"
+#include "MqttPacket.h"
+
+// 非阻塞DNS查詢的狀態 (只在lwIP的TCP/IP執行緒中寫入)
+struct MqttDnsQuery {
+    uint32_t generation;        // 查詢編號，每次開始查詢時加1，舊查詢的回調因編號不符而被忽略
+    volatile int8_t state;      // 0: 進行中, 1: 完成, -1: 失敗
+    volatile uint32_t address;  // 解析出的IPv4位址
+};
+
+// 收到完整MQTT封包時的通知 (body只包含封包內容的前SNIFF_BODY_SIZE個位元組)
+typedef void (*MqttPacketListener)(uint8_t header, const uint8_t* body, size_t bodyLength, void* context);
+
+/**
+ * MqttLink 類別 - 提供給PubSubClient使用的非阻塞TCP連線
+ * 直接使用lwIP socket，讓DNS解析與TCP連線可以分步推進，
+ * 每次呼叫只檢查一次狀態而不會阻塞MQTT任務。
+ * 設定MqttTls後，TCP連線完成會接著分步完成TLS握手，讀寫改經由TLS加密。
+ */
+class MqttLink : public Client {
+public:
+    // 非阻塞操作的結果
+    enum PollResult {
+        POLL_PENDING = 0,   // 仍在進行中
+        POLL_DONE = 1,      // 已完成
+        POLL_FAILED = -1    // 失敗
+    };
+
+    MqttLink();
+    ~MqttLink();
+
+    /**
+     * 開始非阻塞DNS解析
+     * 查詢在lwIP的TCP/IP執行緒中送出 (與arduino-esp32的hostByName相同)，
+     * 並使尚未完成的前一個查詢失效，逾時後才完成的查詢不會覆寫新的結果
+     * @param host 主機名稱或IP字串
+     * @return 成功送出查詢返回true
+     */
+    bool beginResolve(const char* host);
+
+    /**
+     * 檢查DNS解析結果
+     * @param address 解析完成時輸出的位址
+     * @return POLL_PENDING / POLL_DONE / POLL_FAILED
+     */
+    PollResult pollResolve(IPAddress& address);
+
+    /**
+     * 開始非阻塞TCP連線
+     * @param ip 伺服器位址
+     * @param port 伺服器埠
+     * @return 成功送出連線請求返回true
+     */
+    bool beginConnect(IPAddress ip, uint16_t port);
+
+    /**
+     * 檢查TCP連線 (與TLS握手) 是否已完成 (不阻塞)
+     * @return POLL_PENDING / POLL_DONE / POLL_FAILED
+     */
+    PollResult pollConnect();
+
+    /**
+     * 設置TLS加密層 (NULL代表使用明文TCP)
+     * @param tlsLayer TLS加密層
+     */
+    void setTls(MqttTls* tlsLayer);
+
+    // 獲取TLS加密層 (未使用時為NULL)
+    MqttTls* getTls() const;
+
+    /**
+     * 讓下一個送出的CONNECT封包被靜默丟棄
+     * 用於CONNACK已由MQTTManager接收後，再交由PubSubClient完成連線狀態
+     */
+    void suppressNextConnect();
+
+    /**
+     * 非阻塞地讀取已收到但尚未被取走的資料 (不會消耗資料)
+     * @param out 輸出緩衝區
+     * @param length 要讀取的長度
+     * @return 實際複製的位元組數
+     */
+    size_t peekBuffered(uint8_t* out, size_t length);
+
+    /**
+     * 設置收到封包時的監聽函數
+     * PubSubClient會忽略PUBACK等封包，透過監聽讀取的位元組流可以在不修改函式庫的情況下取得它們
+     * @param listener 監聽函數
+     * @param context 傳給監聽函數的指標
+     */
+    void setPacketListener(MqttPacketListener listener, void* context);
+
+    /**
+     * 設置寫入逾時 (預設3000毫秒)
+     * write()在傳送緩衝區已滿時最多阻塞這段時間，逾時即關閉連線，
+     * 之後的寫入立即返回0，因此一次連線停滯最多讓MQTT任務阻塞一個逾時
+     * @param timeoutMs 逾時毫秒數
+     */
+    void setWriteTimeout(uint32_t timeoutMs);
+
+    // Client介面
+    int connect(IPAddress ip, uint16_t port) override;
+    int connect(const char* host, uint16_t port) override;
+    size_t write(uint8_t b) override;
+    size_t write(const uint8_t* buf, size_t size) override;
+    int available() override;
+    int read() override;
+    int read(uint8_t* buf, size_t size) override;
+    int peek() override;
+    void flush() override;
+    void stop() override;
+    uint8_t connected() override;
+    operator bool() override;
+
+    // 獲取socket描述符 (未連線時為-1)
+    int fd() const;
+    
+    // 獲取已收到但尚未被讀走的位元組數 (不讀取socket)
+    size_t buffered() const;
+    
+    // 獲取上一次送出PINGREQ的時間 (millis)
+    unsigned long getPingSentMillis() const;
+
+private:
+    static const size_t RX_BUFFER_SIZE = 256;
+    static const uint32_t BLOCKING_CONNECT_TIMEOUT = 5000;
+
+    int sock;                           // socket描述符
+    bool isConnected;                   // 連線是否可收發MQTT資料
+    bool tcpReady;                      // TCP連線是否已建立 (TLS握手前)
+    MqttTls* tls;                       // TLS加密層 (可為NULL)
+    bool swallowConnect;                // 是否丟棄下一個CONNECT封包
+    uint32_t writeTimeout;              // 寫入逾時
+    unsigned long pingSentMillis;       // 上一次送出PINGREQ的時間
+
+    uint8_t rxBuffer[RX_BUFFER_SIZE];   // 接收緩衝區
+    size_t rxStart;                     // 未讀資料起點
+    size_t rxEnd;                       // 未讀資料終點
+
+    MqttDnsQuery dnsQuery;              // DNS查詢狀態
+
+    // 封包監聽
+    // 封包ID + MQTT 5屬性長度 + 一個SUBSCRIBE封包所有過濾器的SUBACK原因碼
+    static const size_t SNIFF_BODY_SIZE = 3 + MQTT_SUBSCRIBE_BATCH_MAX;
+    MqttPacketListener packetListener;
+    void* listenerContext;
+    uint8_t sniffState;                 // 0: 固定標頭, 1: 剩餘長度, 2: 封包內容
+    uint8_t sniffHeader;
+    uint32_t sniffRemaining;
+    uint32_t sniffMultiplier;
+    uint8_t sniffBody[SNIFF_BODY_SIZE];
+    uint8_t sniffBodyLength;
+
+    // 解析被讀走的位元組
+    void sniff(uint8_t b);
+
+    // 非阻塞地把socket中的資料讀入接收緩衝區
+    void fillBuffer();
+
+    // 送出資料 (經由TLS或直接寫入socket)，返回已送出的位元組數，需等待時返回0，錯誤返回-1
+    int transmit(const uint8_t* buf, size_t size);
+
+    // 接收資料 (經由TLS或直接讀取socket)，返回讀取的位元組數，沒有資料時返回0，關閉或錯誤返回-1
+    int receive(uint8_t* buf, size_t size);
+
+    // 關閉socket
+    void closeSocket();
+};
+
+#endif // MQTT_LINK_H
@@ -0,0 +1,136 @@
+#ifndef MQTT_OUTBOX_H
+#define MQTT_OUTBOX_H
+
+#include <Arduino.h>
+
+// QoS 1負載的最大長度 (無法編碼的100個原始時序以整數陣列發布時約600位元組)
+static const size_t MQTT_OUTBOX_MAX_PAYLOAD = 640;
+
+// QoS 1 待送/待確認的訊息
+struct MqttOutboxEntry {
+    bool used;                  // 是否佔用
+    bool inFlight;              // 已送出，等待PUBACK
+    bool dup;                   // 重送時設定DUP旗標
+    bool retain;                // 是否保留
+    uint16_t packetId;          // 封包ID
+    uint16_t length;            // 負載長度
+    unsigned long sentAt;       // 最後一次送出的時間
+    char topic[96];             // 主題
+    uint8_t payload[MQTT_OUTBOX_MAX_PAYLOAD];  // 負載
+};
+
+/**
+ * MqttOutbox 類別 - QoS 1 發布的有界佇列與在途(in-flight)追蹤
+ * 發布時只複製到佇列即返回，由MQTT任務在視窗允許時送出，
+ * 收到PUBACK後釋放，重新連線後以DUP旗標重送所有尚未確認的訊息。
+ */
+class MqttOutbox {
+public:
+    // 佇列容量
+    static const uint8_t CAPACITY = 6;
+
+    /**
+     * 構造函數
+     * @param windowSize 同時等待PUBACK的最大訊息數
+     */
+    MqttOutbox(uint8_t windowSize = 4);
+    ~MqttOutbox();
+
+    /**
+     * 設置送出封包使用的協議等級 (MQTT 5的PUBLISH需要屬性欄位)
+     * @param version MQTT_VERSION_3_1_1 或 MQTT_VERSION_5
+     */
+    void setProtocolVersion(uint8_t version);
+
+    /**
+     * 設置伺服器的接收上限 (MQTT 5 CONNACK的Receive Maximum)，同時在途的訊息數不超過此值
+     * @param receiveMaximum 接收上限 (MQTT 3.1.1沒有此屬性，使用65535)
+     */
+    void setReceiveMaximum(uint16_t receiveMaximum);
+
+    /**
+     * 將訊息放入佇列 (可從任意任務呼叫)
+     * @param topic 主題
+     * @param payload 負載
+     * @param length 負載長度
+     * @param retain 是否保留
+     * @return 佇列已滿或訊息過大時返回false
+     */
+    bool enqueue(const char* topic, const uint8_t* payload, size_t length, bool retain);
+
+    /**
+     * 在視窗允許的範圍內送出排隊中的訊息 (只在MQTT任務中呼叫)
+     * 寫入socket時不持有鎖，其他任務的enqueue()不會等待網路
+     * @param out 寫入已連線MQTT串流的介面
+     * @return 本次送出的訊息數
+     */
+    uint8_t service(Print& out);
+
+    /**
+     * 收到PUBACK，釋放對應的訊息
+     * @param packetId 封包ID
+     */
+    void acknowledge(uint16_t packetId);
+
+    /**
+     * 重新連線後，將所有在途訊息標記為需以DUP重送
+     */
+    void markForRetransmit();
+
+    /**
+     * 獲取等待PUBACK的訊息數
+     * @return 在途數量
+     */
+    uint8_t getInFlight() const;
+
+    /**
+     * 獲取佇列中的訊息總數 (含在途)
+     * @return 訊息數
+     */
+    uint8_t getQueued() const;
+
+    /**
+     * 檢查是否有可以立即送出的訊息 (有未送出的訊息且視窗未滿)
+     * @return 有可送出的訊息時返回true
+     */
+    bool hasSendable() const;
+
+    /**
+     * 獲取累計重送次數
+     * @return 重送次數
+     */
+    uint32_t getRetransmitCount() const;
+
+    /**
+     * 獲取因佇列已滿而丟棄的訊息數
+     * @return 丟棄數量
+     */
+    uint32_t getDroppedCount() const;
+
+    /**
+     * 分配一個不與在途訊息衝突的封包ID (供SUBSCRIBE等其他封包使用)
+     * @return 封包ID
+     */
+    uint16_t reservePacketId();
+
+private:
+    MqttOutboxEntry entries[CAPACITY];
+    uint8_t windowSize;
+    uint16_t receiveMaximum;
+    uint8_t protocolVersion;
+    uint16_t nextPacketId;
+    uint32_t retransmitCount;
+    uint32_t droppedCount;
+    SemaphoreHandle_t lock;
+
+    // 分配未被使用的封包ID
+    uint16_t allocatePacketId();
+
+    // 目前允許的在途訊息數 (視窗與伺服器接收上限中較小者)
+    uint8_t window() const;
+
+    // 寫入單一訊息 (不持有鎖，呼叫前須已將訊息標記為在途)
+    bool send(Print& out, const MqttOutboxEntry& entry);
+};
+
+#endif // MQTT_OUTBOX_H
@@ -0,0 +1,166 @@
+#ifndef MQTT_PACKET_H
+#define MQTT_PACKET_H
+
+#include <Arduino.h>
+
+// MQTT控制封包類型 (固定標頭的高4位元)
+#define MQTT_PACKET_CONNECT     0x10
+#define MQTT_PACKET_CONNACK     0x20
+#define MQTT_PACKET_PUBLISH     0x30
+#define MQTT_PACKET_PUBACK      0x40
+#define MQTT_PACKET_SUBSCRIBE   0x80
+#define MQTT_PACKET_SUBACK      0x90
+#define MQTT_PACKET_UNSUBSCRIBE 0xA0
+#define MQTT_PACKET_UNSUBACK    0xB0
+#define MQTT_PACKET_PINGREQ     0xC0
+#define MQTT_PACKET_PINGRESP    0xD0
+#define MQTT_PACKET_DISCONNECT  0xE0
+
+// 一個SUBSCRIBE封包最多包含的過濾器數 (恢復訂閱時分批送出)
+#define MQTT_SUBSCRIBE_BATCH_MAX    16
+
+// 協議等級
+#define MQTT_VERSION_3_1_1      4
+#define MQTT_VERSION_5          5
+
+// MQTT 5屬性識別碼
+#define MQTT_PROP_SESSION_EXPIRY        0x11
+#define MQTT_PROP_ASSIGNED_CLIENT_ID    0x12
+#define MQTT_PROP_SERVER_KEEP_ALIVE     0x13
+#define MQTT_PROP_REASON_STRING         0x1F
+#define MQTT_PROP_RECEIVE_MAXIMUM       0x21
+#define MQTT_PROP_TOPIC_ALIAS_MAXIMUM   0x22
+#define MQTT_PROP_TOPIC_ALIAS           0x23
+#define MQTT_PROP_MAXIMUM_PACKET_SIZE   0x27
+
+// CONNECT封包的連線參數
+struct MqttConnectOptions {
+    const char* clientId;       // 客戶端ID
+    const char* username;       // 使用者名稱 (可為NULL)
+    const char* password;       // 密碼 (可為NULL)
+    const char* willTopic;      // 遺囑主題 (可為NULL)
+    const char* willMessage;    // 遺囑訊息
+    uint8_t willQos;            // 遺囑QoS
+    bool willRetain;            // 遺囑是否保留
+    bool cleanSession;          // 是否清除會話
+    uint16_t keepAlive;         // 心跳間隔 (秒)
+    uint8_t protocolVersion;    // MQTT_VERSION_3_1_1 或 MQTT_VERSION_5
+    uint32_t sessionExpiry;     // 會話保留秒數 (僅MQTT 5，0代表斷線即清除)
+};
+
+// MQTT 5 CONNACK的內容 (未提供的屬性維持協議預設值)
+struct Mqtt5Connack {
+    bool sessionPresent;        // 伺服器是否保留了先前的會話
+    uint8_t reasonCode;         // 原因碼 (0為成功)
+    uint16_t topicAliasMaximum; // 伺服器接受的主題別名數量 (0代表不支援)
+    uint16_t receiveMaximum;    // 伺服器同時處理的QoS 1訊息上限
+    uint16_t serverKeepAlive;   // 伺服器指定的心跳秒數 (0代表未指定)
+    uint32_t maximumPacketSize; // 伺服器接受的最大封包 (0代表無限制)
+};
+
+/**
+ * MqttPacket 類別 - 將MQTT 3.1.1 / 5控制封包直接編碼到呼叫者提供的緩衝區
+ * 所有函數都不配置記憶體，緩衝區不足時返回0
+ */
+class MqttPacket {
+public:
+    /**
+     * 編碼剩餘長度欄位
+     * @param length 剩餘長度
+     * @param out 輸出位置 (至少4個位元組)
+     * @return 使用的位元組數
+     */
+    static size_t encodeRemainingLength(uint32_t length, uint8_t* out);
+
+    /**
+     * 寫入長度前綴字串
+     * @param out 輸出位置
+     * @param str 字串
+     * @return 使用的位元組數
+     */
+    static size_t writeString(uint8_t* out, const char* str);
+
+    /**
+     * 建立CONNECT封包
+     * @param buffer 輸出緩衝區
+     * @param bufferSize 緩衝區大小
+     * @param options 連線參數
+     * @return 封包長度，緩衝區不足時返回0
+     */
+    static size_t buildConnect(uint8_t* buffer, size_t bufferSize, const MqttConnectOptions& options);
+
+    /**
+     * 建立PUBLISH封包的標頭 (固定標頭、主題與封包ID)，負載由呼叫者接著送出
+     * @param buffer 輸出緩衝區
+     * @param bufferSize 緩衝區大小
+     * @param topic 主題
+     * @param payloadLength 負載長度
+     * @param qos QoS等級 (0或1)
+     * @param retain 是否保留
+     * @param dup 是否為重送
+     * @param packetId 封包ID (QoS 0時忽略)
+     * @param version 協議等級，MQTT 5會加入屬性欄位
+     * @param topicAlias 主題別名 (僅MQTT 5，0代表不使用；別名已建立時topic可為空字串)
+     * @return 標頭長度，緩衝區不足時返回0
+     */
+    static size_t buildPublishHeader(uint8_t* buffer, size_t bufferSize, const char* topic, size_t payloadLength,
+                                     uint8_t qos, bool retain, bool dup, uint16_t packetId,
+                                     uint8_t version = MQTT_VERSION_3_1_1, uint16_t topicAlias = 0);
+
+    /**
+     * 建立只含一個主題過濾器的SUBSCRIBE或UNSUBSCRIBE封包
+     * @param buffer 輸出緩衝區
+     * @param bufferSize 緩衝區大小
+     * @param type MQTT_PACKET_SUBSCRIBE 或 MQTT_PACKET_UNSUBSCRIBE
+     * @param packetId 封包ID
+     * @param filter 主題過濾器
+     * @param qos 訂閱的QoS (UNSUBSCRIBE時忽略)
+     * @param version 協議等級，MQTT 5會加入屬性欄位
+     * @return 封包長度，緩衝區不足時返回0
+     */
+    static size_t buildSubscription(uint8_t* buffer, size_t bufferSize, uint8_t type, uint16_t packetId,
+                                    const char* filter, uint8_t qos, uint8_t version = MQTT_VERSION_3_1_1);
+
+    /**
+     * 建立包含多個主題過濾器的SUBSCRIBE封包 (重新連線後一次恢復所有訂閱)
+     * @param buffer 輸出緩衝區
+     * @param bufferSize 緩衝區大小
+     * @param packetId 封包ID
+     * @param filters 主題過濾器
+     * @param count 過濾器數量
+     * @param qos 所有過濾器使用的QoS
+     * @param version 協議等級，MQTT 5會加入屬性欄位
+     * @return 封包長度，沒有過濾器或緩衝區不足時返回0
+     */
+    static size_t buildSubscribe(uint8_t* buffer, size_t bufferSize, uint16_t packetId, const char* const* filters,
+                                 uint8_t count, uint8_t qos, uint8_t version = MQTT_VERSION_3_1_1);
+
+    /**
+     * 解碼剩餘長度欄位
+     * @param data 資料 (剩餘長度的第一個位元組)
+     * @param length 可讀取的長度
+     * @param value 輸出剩餘長度
+     * @return 使用的位元組數，資料不足返回0，格式錯誤返回-1
+     */
+    static int decodeRemainingLength(const uint8_t* data, size_t length, uint32_t* value);
+
+    /**
+     * 檢查緩衝區開頭是否為完整的CONNACK封包
+     * @param data 收到的資料
+     * @param length 資料長度
+     * @param returnCode 輸出CONNACK返回碼
+     * @return 是CONNACK時返回true
+     */
+    static bool parseConnack(const uint8_t* data, size_t length, uint8_t* returnCode);
+
+    /**
+     * 解析緩衝區開頭的MQTT 5 CONNACK封包 (含屬性)
+     * @param data 收到的資料
+     * @param length 資料長度
+     * @param connack 輸出CONNACK內容
+     * @return 封包總長度，資料不足返回0，不是有效的CONNACK返回-1
+     */
+    static int parseConnack5(const uint8_t* data, size_t length, Mqtt5Connack* connack);
+};
+
+#endif // MQTT_PACKET_H
@@ -0,0 +1,52 @@
+#ifndef MQTT_STATS_H
+#define MQTT_STATS_H
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include "LatencyHistogram.h"
+
+/**
+ * MqttStats 類別 - MQTT連線的計數器與延遲直方圖
+ * 只在MQTT任務中更新，診斷快照以精簡的JSON發布 (見encode)。
+ * 延遲區間 (直方圖的b陣列依序對應):
+ *   publish / inbound (微秒): 100, 250, 500, 1000, 2500, 5000, 10000, 25000, 50000, 100000, 250000, >250000
+ *   ping (毫秒): 10, 25, 50, 100, 250, 500, 1000, 2500, 5000, 10000, >10000
+ *   reconnect (毫秒): 100, 250, 500, 1000, 2500, 5000, 10000, 30000, 60000, 120000, >120000
+ *   tls (毫秒): 50, 100, 200, 400, 700, 1000, 1500, 2000, 3000, 5000, >5000
+ */
+class MqttStats {
+public:
+    MqttStats();
+
+    // 計數器
+    uint32_t publishOk;             // 成功寫入的QoS 0發布
+    uint32_t publishFailed;         // 失敗的QoS 0發布
+    uint32_t bytesOut;              // 發布的負載位元組數
+    uint32_t messagesIn;            // 收到的訊息數
+    uint32_t pubacks;               // 收到的PUBACK數
+    uint32_t pings;                 // 收到的PINGRESP數
+    uint32_t connectAttempts;       // 連線嘗試次數
+    uint32_t connectFailures;       // 連線失敗次數
+    uint32_t disconnects;           // 非預期斷線次數
+
+    // 延遲直方圖
+    LatencyHistogram publishMicros;     // 發布呼叫耗時
+    LatencyHistogram pingMillis;        // PINGREQ到PINGRESP的往返時間
+    LatencyHistogram reconnectMillis;   // 從斷線到重新連線完成的時間
+    LatencyHistogram inboundMicros;     // socket可讀到處理函數的時間
+    LatencyHistogram tlsFullMillis;     // TLS完整握手耗時 (只在使用TLS時輸出)
+    LatencyHistogram tlsResumedMillis;  // TLS會話恢復握手耗時 (只在使用TLS時輸出)
+
+    /**
+     * 寫入診斷快照
+     * @param doc 輸出文檔
+     */
+    void encode(JsonDocument& doc) const;
+
+    /**
+     * 清除所有計數器與直方圖
+     */
+    void reset();
+};
+
+#endif // MQTT_STATS_H
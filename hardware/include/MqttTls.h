@@ -0,0 +1,133 @@
+#ifndef MQTT_TLS_H
+#define MQTT_TLS_H
+
+#include <Arduino.h>
+#include <mbedtls/ssl.h>
+#include <mbedtls/net_sockets.h>
+#include <mbedtls/entropy.h>
+#include <mbedtls/ctr_drbg.h>
+#include <mbedtls/x509_crt.h>
+
+/**
+ * MqttTls 類別 - MqttLink使用的mbedTLS加密層
+ * 在非阻塞socket上分步完成握手，並保留上一次連線的TLS會話 (Session ID或Session Ticket)，
+ * 重新連線時以縮短握手恢復會話，省下金鑰交換與憑證驗證的運算。
+ * 會話同時序列化到RTC記憶體，軟體重啟或看門狗重啟後仍可恢復 (斷電後失效)。
+ */
+class MqttTls {
+public:
+    // 握手結果
+    enum HandshakeResult {
+        HANDSHAKE_PENDING = 0,  // 仍在進行中
+        HANDSHAKE_DONE = 1,     // 已完成
+        HANDSHAKE_FAILED = -1   // 失敗
+    };
+
+    MqttTls();
+    ~MqttTls();
+
+    /**
+     * 設定伺服器憑證與主機名稱 (每次連線前都可重新設定)
+     * @param caCert PEM格式的CA憑證，NULL代表不驗證伺服器 (只適合本地測試)
+     * @param hostname 伺服器主機名稱 (SNI與憑證驗證)
+     * @param resumeSessions 是否恢復先前的TLS會話
+     * @return 設定成功返回true
+     */
+    bool configure(const char* caCert, const char* hostname, bool resumeSessions = true);
+
+    /**
+     * 切換伺服器主機名稱 (改連其他伺服器時使用，主機不同時捨棄快取的會話)
+     * @param hostname 伺服器主機名稱 (需在連線期間保持有效)
+     */
+    void setHostname(const char* hostname);
+
+    /**
+     * 在已連線的TCP socket上開始握手
+     * @param sock socket描述符 (非阻塞)
+     * @return 成功返回true
+     */
+    bool begin(int sock);
+
+    /**
+     * 推進握手一步 (不阻塞)
+     * @return HANDSHAKE_PENDING / HANDSHAKE_DONE / HANDSHAKE_FAILED
+     */
+    HandshakeResult handshake();
+
+    /**
+     * 寫入應用資料
+     * @return 寫入的位元組數，需等待時返回0，錯誤返回-1
+     */
+    int send(const uint8_t* data, size_t length);
+
+    /**
+     * 讀取應用資料
+     * @return 讀取的位元組數，沒有資料時返回0，連線關閉或錯誤返回-1
+     */
+    int recv(uint8_t* data, size_t length);
+
+    /**
+     * 獲取已解密但尚未讀取的位元組數 (socket上看不到這些資料)
+     * @return 位元組數
+     */
+    size_t pending() const;
+
+    /**
+     * 結束本次連線 (保留已快取的會話)
+     */
+    void end();
+
+    /**
+     * 清除快取的會話 (包含RTC記憶體中的副本)
+     */
+    void clearSession();
+
+    // 是否有可恢復的會話
+    bool hasSession() const;
+
+    // 上一次握手是否為會話恢復
+    bool wasResumed() const;
+
+    // 獲取上一次握手耗時 (毫秒)
+    unsigned long getHandshakeMillis() const;
+
+    // 獲取完整握手次數
+    uint32_t getFullHandshakes() const;
+
+    // 獲取會話恢復次數
+    uint32_t getResumedHandshakes() const;
+
+private:
+    mbedtls_ssl_context ssl;
+    mbedtls_ssl_config config;
+    mbedtls_entropy_context entropy;
+    mbedtls_ctr_drbg_context drbg;
+    mbedtls_x509_crt caChain;
+    mbedtls_net_context net;
+    mbedtls_ssl_session session;        // 快取的會話
+
+    bool configured;                    // 共用設定是否已建立
+    bool active;                        // ssl是否已建立
+    bool sessionValid;                  // session是否可恢復
+    bool resume;                        // 是否恢復會話
+    bool resumed;                       // 上一次握手是否為恢復
+    bool offeredSession;                // 本次握手是否帶入快取的會話
+    bool sawCertificate;                // 本次握手是否收到伺服器憑證 (代表完整握手)
+    uint32_t hostHash;                  // 主機名稱雜湊，避免把會話用在其他伺服器
+    const char* host;                   // 伺服器主機名稱
+    unsigned long handshakeStart;       // 握手開始時間
+    unsigned long handshakeMillis;      // 上一次握手耗時
+    uint32_t fullCount;                 // 完整握手次數
+    uint32_t resumedCount;              // 會話恢復次數
+
+    // 將會話寫入RTC記憶體
+    void persistSession();
+
+    // 從RTC記憶體載入會話
+    void restoreSession();
+
+    // 輸出mbedTLS錯誤
+    static void logError(const char* action, int code);
+};
+
+#endif // MQTT_TLS_H
@@ -0,0 +1,44 @@
+#ifndef MQTT_TOPIC_TABLE_H
+#define MQTT_TOPIC_TABLE_H
+
+#include <Arduino.h>
+
+/**
+ * MqttTopicTable 結構 - 預先計算的MQTT主題表
+ * 只在房間ID變更時以build()重建，發布時直接使用固定緩衝區，不配置記憶體。
+ */
+struct MqttTopicTable {
+    char roomId[33];          // 建表時使用的房間ID（空字串代表未設置）
+    char roomTopic[96];       // <base>/<room>
+    char deviceTopic[128];    // <base>/<room>/<deviceId> 或 <base>/unknown/<deviceId>
+    char capabilityTopic[144];// <deviceTopic>/capabilities (保留訊息，公告支援的編碼)
+    char encodingTopic[144];  // <deviceTopic>/encoding (App指定偏好的編碼)
+    char configTopic[144];    // <deviceTopic>/config (執行期間調整遙測設定)
+    char diagTopic[144];      // <deviceTopic>/diag (保留訊息，診斷快照)
+    char logTopic[144];       // <deviceTopic>/log (轉送的警告與錯誤日誌)
+    char shadowTopic[144];    // <deviceTopic>/shadow (保留訊息，完整狀態)
+    char shadowDeltaTopic[152];// <deviceTopic>/shadow/delta (只含變動欄位)
+    char shadowGetTopic[152]; // <deviceTopic>/shadow/get (App要求重新發布完整狀態)
+    char shadowHistoryTopic[152];// <deviceTopic>/shadow/history (補傳的歷史樣本，不改變影子)
+    char commandRoomTopic[96];   // <command>/<room> (未設置房間時為空字串)
+    char commandDeviceTopic[128];// <command>/<room>/<deviceId> 或 <command>/unknown/<deviceId>
+
+    /**
+     * 重建所有主題
+     * @param baseTopic 遙測基本主題 (例如"esp32/sensors")
+     * @param commandTopic 命令主題前綴 (例如"esp32/cmd")
+     * @param room 房間ID (空字串代表未設置)
+     * @param deviceId 裝置ID
+     * @return 所有主題都完整寫入時返回true，有主題被截斷時返回false
+     */
+    bool build(const char* baseTopic, const char* commandTopic, const char* room, const char* deviceId);
+
+    /**
+     * 房間ID是否與建表時不同
+     * @param room 目前的房間ID
+     * @return 需要重建時返回true
+     */
+    bool roomChanged(const char* room) const;
+};
+
+#endif // MQTT_TOPIC_TABLE_H
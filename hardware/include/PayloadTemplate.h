@@ -0,0 +1,86 @@
+#ifndef PAYLOAD_TEMPLATE_H
+#define PAYLOAD_TEMPLATE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * PayloadTemplate 類別 - 預先序列化的固定格式訊息
+ * 靜態欄位 (鍵名、裝置ID等) 在建立範本時就序列化並跳脫，發布時只把數值以定點格式
+ * 寫入預留的位置，不需要建立JsonDocument，也不必對每個主題重複序列化。
+ * 數值格式與ArduinoJson 6 (以double儲存) 的serializeJson逐位元組相同；
+ * 超出可直接格式化的範圍 (NaN、無限大、需要指數表示) 時render()返回0，由呼叫端改用ArduinoJson。
+ * 不依賴Arduino核心，可在主機上編譯 (見bench/payload_template_bench.cpp)。
+ */
+class PayloadTemplate {
+public:
+    // 範本內容的最大長度 (不含數值)
+    static const size_t MAX_TEXT = 192;
+
+    // 最多的數值欄位數
+    static const uint8_t MAX_SLOTS = 4;
+
+    // formatNumber()需要的緩衝區大小
+    static const size_t NUMBER_BUFFER_SIZE = 24;
+
+    PayloadTemplate();
+
+    // 清除範本
+    void clear();
+
+    /**
+     * 加入原樣輸出的文字 (例如 {"temp": )
+     * @param text 文字
+     * @return 空間不足時返回false，範本變為無效
+     */
+    bool appendLiteral(const char* text);
+
+    /**
+     * 加入JSON字串 (加上引號並依ArduinoJson的規則跳脫)
+     * @param value 字串內容
+     * @return 空間不足時返回false，範本變為無效
+     */
+    bool appendString(const char* value);
+
+    /**
+     * 加入數值欄位 (依加入順序對應render()的values)
+     * @return 欄位已滿時返回false，範本變為無效
+     */
+    bool appendSlot();
+
+    // 範本是否完整建立 (沒有發生溢位)
+    bool isValid() const;
+
+    // 獲取數值欄位數
+    uint8_t getSlotCount() const;
+
+    /**
+     * 把數值填入範本
+     * @param values 數值 (數量需等於欄位數)
+     * @param count 數值數量
+     * @param buffer 輸出緩衝區 (不加結尾的NUL)
+     * @param bufferSize 緩衝區大小
+     * @return 輸出長度，範本無效、數值無法直接格式化或空間不足時返回0
+     */
+    size_t render(const double* values, uint8_t count, char* buffer, size_t bufferSize) const;
+
+    /**
+     * 以ArduinoJson相同的規則格式化數值 (整數部分 + 最多9位有效小數，去除結尾的0)
+     * @param value 數值
+     * @param buffer 輸出緩衝區 (至少NUMBER_BUFFER_SIZE，不加結尾的NUL)
+     * @return 輸出長度，NaN、無限大或需要指數表示時返回0
+     */
+    static size_t formatNumber(double value, char* buffer);
+
+private:
+    char text[MAX_TEXT];                // 所有靜態文字
+    size_t textLength;
+    size_t slotOffsets[MAX_SLOTS];      // 每個數值欄位在text中的位置
+    uint8_t slotCount;
+    bool valid;
+
+    // 寫入無號整數，返回長度
+    static size_t writeInteger(uint32_t value, char* buffer);
+};
+
+#endif // PAYLOAD_TEMPLATE_H
@@ -0,0 +1,70 @@
+#ifndef RECONNECT_POLICY_H
+#define RECONNECT_POLICY_H
+
+#include <Arduino.h>
+
+/**
+ * ReconnectPolicy 類別 - 指數退避加完全抖動(full jitter)的重連策略
+ * 第n次失敗後的等待時間為 [0, min(maxDelay, baseDelay * 2^n)] 之間的亂數，
+ * 亂數種子取自裝置ID，讓同時斷線的裝置群不會同步重連。
+ * 主動(乾淨)斷線後的第一次重連走快速路徑，只等待fastDelay。
+ */
+class ReconnectPolicy {
+public:
+    /**
+     * 構造函數
+     * @param baseDelay 退避基準時間 (毫秒)
+     * @param maxDelay 退避上限 (毫秒)
+     * @param fastDelay 乾淨斷線後的重連等待時間 (毫秒)
+     */
+    ReconnectPolicy(unsigned long baseDelay = 1000, unsigned long maxDelay = 60000, unsigned long fastDelay = 100);
+
+    /**
+     * 以裝置ID設定亂數種子
+     * @param deviceId 裝置ID (MAC位址)
+     */
+    void seed(const char* deviceId);
+
+    /**
+     * 設置退避參數
+     * @param baseDelay 退避基準時間 (毫秒)
+     * @param maxDelay 退避上限 (毫秒)
+     */
+    void configure(unsigned long baseDelay, unsigned long maxDelay);
+
+    /**
+     * 計算下一次重連前的等待時間，並累加失敗次數
+     * @return 等待毫秒數
+     */
+    unsigned long nextDelay();
+
+    /**
+     * 連線成功，重置失敗次數
+     */
+    void onConnected();
+
+    /**
+     * 連線中斷
+     * @param clean 是否為本端主動的乾淨斷線
+     */
+    void onDisconnected(bool clean);
+
+    /**
+     * 獲取連續失敗次數
+     * @return 失敗次數
+     */
+    uint8_t getAttempt() const;
+
+private:
+    unsigned long _baseDelay;
+    unsigned long _maxDelay;
+    unsigned long _fastDelay;
+    uint8_t _attempt;
+    bool _fastPath;
+    uint32_t _state;    // xorshift32亂數狀態
+
+    // 產生下一個亂數
+    uint32_t nextRandom();
+};
+
+#endif // RECONNECT_POLICY_H
@@ -0,0 +1,100 @@
+#ifndef SEQ_LOCK_H
+#define SEQ_LOCK_H
+
+#include <Arduino.h>
+#include <atomic>
+#include <type_traits>
+
+/**
+ * SeqLock 類別 - 單一寫入者的序號鎖
+ * 寫入者在更新前後各把序號加一 (奇數代表寫入中)，讀取者複製資料後
+ * 比對前後序號，不一致就重讀。讀取者永遠不會阻塞寫入者，也不會互相阻塞，
+ * 適合像感測器讀數這種小而常被讀取的快照。
+ * 資料以32位元字組的原子變數保存，T必須可直接複製且大小為4的倍數。
+ */
+template <typename T>
+class SeqLock {
+    static_assert(std::is_trivially_copyable<T>::value, "SeqLock資料必須可直接複製");
+    static_assert(sizeof(T) % sizeof(uint32_t) == 0, "SeqLock資料大小必須是4的倍數");
+
+    static const size_t WORDS = sizeof(T) / sizeof(uint32_t);
+
+public:
+    SeqLock() : sequence(0), retries(0) {
+        for (size_t i = 0; i < WORDS; i++) {
+            words[i].store(0, std::memory_order_relaxed);
+        }
+    }
+
+    /**
+     * 寫入新的快照 (只能由單一寫入者呼叫)
+     * @param value 資料
+     */
+    void write(const T& value) {
+        uint32_t raw[WORDS];
+        memcpy(raw, &value, sizeof(T));
+
+        uint32_t seq = sequence.load(std::memory_order_relaxed);
+        sequence.store(seq + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+
+        for (size_t i = 0; i < WORDS; i++) {
+            words[i].store(raw[i], std::memory_order_relaxed);
+        }
+
+        sequence.store(seq + 2, std::memory_order_release);
+    }
+
+    /**
+     * 讀取一致的快照 (任何任務都可呼叫)
+     * @return 資料
+     */
+    T read() const {
+        uint32_t raw[WORDS];
+        uint32_t before;
+        uint32_t after;
+
+        while (true) {
+            before = sequence.load(std::memory_order_acquire);
+            if ((before & 1) == 0) {
+                for (size_t i = 0; i < WORDS; i++) {
+                    raw[i] = words[i].load(std::memory_order_relaxed);
+                }
+                std::atomic_thread_fence(std::memory_order_acquire);
+                after = sequence.load(std::memory_order_relaxed);
+                if (before == after) {
+                    break;
+                }
+            }
+            // 與寫入者重疊，重讀
+            retries.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        T value;
+        memcpy(&value, raw, sizeof(T));
+        return value;
+    }
+
+    /**
+     * 獲取寫入次數
+     * @return 寫入次數
+     */
+    uint32_t getWriteCount() const {
+        return sequence.load(std::memory_order_relaxed) / 2;
+    }
+
+    /**
+     * 獲取讀取者因與寫入重疊而重讀的次數 (競爭指標)
+     * @return 重讀次數
+     */
+    uint32_t getRetryCount() const {
+        return retries.load(std::memory_order_relaxed);
+    }
+
+private:
+    std::atomic<uint32_t> sequence;             // 序號，奇數代表寫入中
+    std::atomic<uint32_t> words[WORDS];         // 資料
+    mutable std::atomic<uint32_t> retries;      // 重讀次數
+};
+
+#endif // SEQ_LOCK_H
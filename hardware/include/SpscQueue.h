@@ -0,0 +1,74 @@
+#ifndef SPSC_QUEUE_H
+#define SPSC_QUEUE_H
+
+#include <Arduino.h>
+#include <atomic>
+
+/**
+ * SpscQueue 類別 - 單一生產者/單一消費者的無鎖環形佇列
+ * 生產者只寫入tail、消費者只寫入head，以acquire/release順序交接資料，
+ * 兩端都不會阻塞。容量N必須是2的次方，實際可存放N-1筆。
+ */
+template <typename T, size_t N>
+class SpscQueue {
+    static_assert(N >= 2 && (N & (N - 1)) == 0, "SpscQueue容量必須是2的次方");
+
+public:
+    SpscQueue() : head(0), tail(0) {}
+
+    /**
+     * 放入一筆資料 (只能由生產者呼叫)
+     * @param item 資料
+     * @return 佇列已滿時返回false
+     */
+    bool push(const T& item) {
+        size_t currentTail = tail.load(std::memory_order_relaxed);
+        size_t nextTail = (currentTail + 1) & (N - 1);
+        if (nextTail == head.load(std::memory_order_acquire)) {
+            return false;
+        }
+
+        items[currentTail] = item;
+        tail.store(nextTail, std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * 取出一筆資料 (只能由消費者呼叫)
+     * @param item 輸出資料
+     * @return 佇列為空時返回false
+     */
+    bool pop(T& item) {
+        size_t currentHead = head.load(std::memory_order_relaxed);
+        if (currentHead == tail.load(std::memory_order_acquire)) {
+            return false;
+        }
+
+        item = items[currentHead];
+        head.store((currentHead + 1) & (N - 1), std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * 獲取目前的資料筆數 (另一端同時操作時只是近似值)
+     * @return 資料筆數
+     */
+    size_t size() const {
+        return (tail.load(std::memory_order_acquire) - head.load(std::memory_order_acquire)) & (N - 1);
+    }
+
+    /**
+     * 獲取可存放的最大筆數
+     * @return 容量
+     */
+    static constexpr size_t capacity() {
+        return N - 1;
+    }
+
+private:
+    T items[N];
+    std::atomic<size_t> head;   // 下一筆要讀取的位置 (消費者擁有)
+    std::atomic<size_t> tail;   // 下一筆要寫入的位置 (生產者擁有)
+};
+
+#endif // SPSC_QUEUE_H
@@ -88,6 +88,24 @@ public:
      */
     bool loadBool(const char* key, bool defaultValue = false);
 
+    /**
+     * 保存二進位資料
+     * @param key 鍵名
+     * @param data 資料指標
+     * @param length 資料長度
+     * @return 操作成功返回true
+     */
+    bool saveBytes(const char* key, const void* data, size_t length);
+
+    /**
+     * 讀取二進位資料
+     * @param key 鍵名
+     * @param buffer 輸出緩衝區
+     * @param maxLength 緩衝區大小
+     * @return 實際讀取的位元組數，鍵不存在時返回0
+     */
+    size_t loadBytes(const char* key, void* buffer, size_t maxLength);
+
     /**
      * 刪除指定的鍵
      * @param key 要刪除的鍵名
@@ -0,0 +1,84 @@
+#ifndef TELEMETRY_BATCHER_H
+#define TELEMETRY_BATCHER_H
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include "TelemetryBuffer.h"
+
+/**
+ * TelemetryBatcher 類別 - 將多筆遙測樣本打包成一則MQTT訊息
+ * 批次格式以第一筆樣本為基準，時間與數值皆以差值編碼：
+ * {"batch":N,"t0":<Unix秒>,"dt":[0,5000,...],"scale":10,"temp":[253,0,1,...],"humidity":[600,0,-1,...]}
+ * dt為與前一筆的毫秒差，temp/humidity第一項為放大scale倍的整數，其後為與前一筆的差值。
+ */
+class TelemetryBatcher {
+public:
+    // 單一批次最多可容納的樣本數
+    static const uint8_t MAX_BATCH_SIZE = 16;
+
+    // 數值放大倍數 (DHT11解析度為1，保留一位小數已足夠)
+    static const int VALUE_SCALE = 10;
+
+    TelemetryBatcher();
+
+    /**
+     * 設置批次參數
+     * @param batchSize 每批樣本數，小於等於1代表停用批次模式
+     * @param maxLatency 第一筆樣本最長等待時間 (毫秒)，超過即強制送出
+     */
+    void configure(uint8_t batchSize, unsigned long maxLatency);
+
+    /**
+     * 檢查是否啟用批次模式
+     * @return 批次大小大於1時返回true
+     */
+    bool isEnabled() const;
+
+    /**
+     * 加入一筆樣本
+     * @param sample 遙測樣本
+     */
+    void add(const TelemetrySample& sample);
+
+    /**
+     * 檢查批次是否已滿或已超過最長等待時間
+     * @param currentMillis 目前的millis()
+     * @return 應送出時返回true
+     */
+    bool isReady(unsigned long currentMillis) const;
+
+    /**
+     * 獲取批次中的樣本數
+     * @return 樣本數
+     */
+    size_t count() const;
+
+    /**
+     * 獲取批次中的樣本
+     * @param index 索引
+     * @return 樣本
+     */
+    const TelemetrySample& at(size_t index) const;
+
+    /**
+     * 將批次以差值格式寫入JSON文檔
+     * @param doc 輸出文檔
+     */
+    void encode(JsonDocument& doc) const;
+
+    /**
+     * 清空批次
+     */
+    void clear();
+
+private:
+    TelemetrySample _samples[MAX_BATCH_SIZE];
+    uint8_t _count;
+    uint8_t _batchSize;
+    unsigned long _maxLatency;
+
+    // 將數值轉為放大後的整數
+    static int32_t scaled(float value);
+};
+
+#endif // TELEMETRY_BATCHER_H
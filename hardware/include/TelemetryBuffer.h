@@ -0,0 +1,115 @@
+#ifndef TELEMETRY_BUFFER_H
+#define TELEMETRY_BUFFER_H
+
+#include <Arduino.h>
+#include "StorageManager.h"
+
+// 單筆遙測樣本
+struct TelemetrySample {
+    uint32_t timestamp;        // 取樣時間 (Unix秒，尚未校時則為0)
+    uint32_t capturedMillis;   // 取樣當下的millis()
+    float temperature;         // 溫度
+    float humidity;            // 濕度
+};
+
+/**
+ * TelemetryBuffer 類別 - MQTT斷線期間暫存遙測樣本的有界環形緩衝區
+ * RAM緩衝區滿時，若有設定Flash儲存空間，會將最舊的樣本整頁寫入Flash；
+ * 否則直接丟棄最舊的樣本並累計丟棄數量。
+ * Flash頁面在最後一筆樣本pop()後才刪除，送出途中重新開機時整頁重送 (可能重複，不會遺失)。
+ */
+class TelemetryBuffer {
+public:
+    // 每個Flash頁面保存的樣本數
+    static const size_t SPILL_PAGE_SAMPLES = 16;
+
+    /**
+     * 構造函數
+     * @param capacity RAM中可保存的樣本數
+     * @param spillStorage 溢出用的儲存空間 (可選)
+     * @param spillPages Flash中最多保存的頁面數
+     */
+    TelemetryBuffer(size_t capacity = 64, StorageManager* spillStorage = nullptr, size_t spillPages = 0);
+    ~TelemetryBuffer();
+
+    /**
+     * 初始化緩衝區，從Flash恢復上次未送出的頁面索引
+     */
+    void begin();
+
+    /**
+     * 加入一筆樣本，緩衝區滿時溢出到Flash或丟棄最舊樣本
+     * @param sample 要保存的樣本
+     */
+    void push(const TelemetrySample& sample);
+
+    /**
+     * 讀取最舊的一筆樣本但不移除
+     * @param sample 輸出樣本
+     * @param previousBoot 輸出樣本是否在上次開機時寫入Flash (此時capturedMillis沒有意義，可為nullptr)
+     * @return 有樣本時返回true
+     */
+    bool peek(TelemetrySample& sample, bool* previousBoot = nullptr);
+
+    /**
+     * 移除最舊的一筆樣本 (應在peek且成功送出後呼叫)
+     */
+    void pop();
+
+    /**
+     * 獲取目前排隊中的樣本數 (包含Flash中的頁面)
+     * @return 樣本數
+     */
+    size_t size() const;
+
+    /**
+     * 檢查緩衝區是否為空
+     * @return 沒有任何樣本時返回true
+     */
+    bool isEmpty() const;
+
+    /**
+     * 獲取因空間不足而被丟棄的樣本數
+     * @return 丟棄數量
+     */
+    uint32_t getDroppedCount() const;
+
+private:
+    TelemetrySample* _ring;      // RAM環形緩衝區
+    size_t _capacity;            // RAM容量
+    size_t _head;                // 最舊樣本的位置
+    size_t _count;               // RAM中的樣本數
+
+    StorageManager* _storage;    // 溢出用儲存空間
+    size_t _spillPages;          // Flash頁面上限
+    uint32_t _spillHead;         // 下一個寫入的頁面序號
+    uint32_t _spillTail;         // 最舊的頁面序號
+    uint32_t _bootSpillHead;     // 開機時的頁面序號 (較小的頁面在上次開機時寫入)
+
+    // 從Flash取回、正在送出的頁面 (_spillTail的副本，_pageCount為0時未載入)
+    TelemetrySample _page[SPILL_PAGE_SAMPLES];
+    size_t _pageCount;
+    size_t _pagePos;
+
+    uint32_t _dropped;           // 丟棄的樣本數
+
+    // 是否啟用Flash溢出
+    bool spillEnabled() const;
+
+    // 將RAM中最舊的一頁寫入Flash
+    bool spillOldestPage();
+
+    // 從Flash載入最舊的一頁，讀不到時刪除並跳過該頁
+    bool loadSpillPage();
+
+    // 載入的頁面已全部送出或被丟棄，從Flash刪除
+    void releaseSpillPage();
+
+    // 保存頁面索引
+    void saveSpillIndex();
+
+    // 生成頁面鍵名
+    void pageKey(uint32_t sequence, char* key, size_t keySize) const;
+};
+
+#endif // TELEMETRY_BUFFER_H
@@ -0,0 +1,75 @@
+#ifndef TELEMETRY_FILTER_H
+#define TELEMETRY_FILTER_H
+
+#include <Arduino.h>
+#include "TelemetryBuffer.h"
+
+/**
+ * TelemetryFilter 類別 - 變化才回報(report-on-change)的遙測過濾器
+ * 任一數值與上次回報值的差距達到該項的死區(deadband)才發布，
+ * 數值一直沒有變化時，每隔heartbeat毫秒仍會發布一次，讓App確認裝置仍在線。
+ * 預設停用，停用時每筆樣本都會發布。
+ */
+class TelemetryFilter {
+public:
+    TelemetryFilter();
+
+    /**
+     * 設置過濾參數
+     * @param temperatureDeadband 溫度死區 (°C)
+     * @param humidityDeadband 濕度死區 (%)
+     * @param heartbeat 最長靜默時間 (毫秒)
+     */
+    void configure(float temperatureDeadband, float humidityDeadband, unsigned long heartbeat);
+
+    /**
+     * 啟用或停用過濾 (重新啟用後第一筆樣本一定會發布)
+     * @param enabled 是否啟用
+     */
+    void setEnabled(bool enabled);
+
+    /**
+     * 檢查是否啟用過濾
+     * @return 啟用時返回true
+     */
+    bool isEnabled() const;
+
+    /**
+     * 判斷樣本是否需要發布，需要時記錄為最後回報值
+     * @param sample 遙測樣本
+     * @return 需要發布時返回true，被抑制時返回false並累加計數
+     */
+    bool shouldReport(const TelemetrySample& sample);
+
+    /**
+     * 獲取被抑制的發布次數
+     * @return 抑制次數
+     */
+    uint32_t getSuppressedCount() const;
+
+    /**
+     * 獲取因心跳而發布的次數
+     * @return 心跳次數
+     */
+    uint32_t getHeartbeatCount() const;
+
+    float getTemperatureDeadband() const;
+    float getHumidityDeadband() const;
+    unsigned long getHeartbeat() const;
+
+private:
+    bool _enabled;
+    bool _hasLast;
+    float _temperatureDeadband;
+    float _humidityDeadband;
+    unsigned long _heartbeat;
+
+    float _lastTemperature;
+    float _lastHumidity;
+    unsigned long _lastReportMillis;
+
+    uint32_t _suppressedCount;
+    uint32_t _heartbeatCount;
+};
+
+#endif // TELEMETRY_FILTER_H
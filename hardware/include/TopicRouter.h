@@ -0,0 +1,106 @@
+#ifndef TOPIC_ROUTER_H
+#define TOPIC_ROUTER_H
+
+#include <Arduino.h>
+#include <functional>
+
+// 主題處理函數 - payload為不擁有的視圖，只在呼叫期間有效
+typedef std::function<void(const char* topic, const uint8_t* payload, unsigned int length)> MqttTopicHandler;
+
+// 列舉已註冊過濾器時的回調
+typedef std::function<void(const char* filter)> MqttFilterVisitor;
+
+/**
+ * TopicRouter 類別 - 以主題層級字典樹(trie)分派收到的MQTT訊息
+ * 支援 + (單一層級) 與 # (其後所有層級) 萬用字元。每個節點的一般子節點依名稱排序，
+ * 分派時每一層以二分搜尋，成本為 層數 x log(子節點數)，與過濾器總數無關。
+ * 節點只在註冊時配置，分派時不配置記憶體也不複製負載。
+ */
+class TopicRouter {
+public:
+    // 過濾器的最大長度
+    static const size_t MAX_FILTER_LENGTH = 160;
+
+    TopicRouter();
+    ~TopicRouter();
+
+    /**
+     * 註冊主題過濾器的處理函數 (同一過濾器可註冊多個)
+     * @param filter 主題過濾器，例如 "esp32/+/ir" 或 "esp32/#"
+     * @param handler 處理函數
+     * @return 過濾器格式錯誤時返回false
+     */
+    bool add(const char* filter, MqttTopicHandler handler);
+
+    /**
+     * 移除過濾器的所有處理函數
+     * @param filter 主題過濾器
+     * @return 過濾器存在時返回true
+     */
+    bool remove(const char* filter);
+
+    /**
+     * 分派訊息到所有符合的處理函數
+     * @param topic 收到的主題
+     * @param payload 負載
+     * @param length 負載長度
+     * @return 呼叫的處理函數數量
+     */
+    size_t dispatch(const char* topic, const uint8_t* payload, unsigned int length) const;
+
+    /**
+     * 列舉所有已註冊的過濾器 (用於重新連線後重新訂閱)
+     * @param visitor 列舉回調
+     */
+    void forEachFilter(MqttFilterVisitor visitor) const;
+
+    /**
+     * 獲取已註冊的過濾器數量
+     * @return 過濾器數量
+     */
+    size_t size() const;
+
+    /**
+     * 檢查過濾器格式 (+ 與 # 必須單獨佔一個層級，# 只能在最後)
+     * @param filter 主題過濾器
+     * @return 格式正確時返回true
+     */
+    static bool isValidFilter(const char* filter);
+
+private:
+    struct HandlerEntry {
+        MqttTopicHandler handler;
+        HandlerEntry* next;
+    };
+
+    struct Node {
+        char* segment;          // 層級名稱 (根節點為NULL)
+        uint8_t segmentLength;
+        Node** children;        // 一般層級子節點 (依層級名稱排序)
+        uint16_t childCount;
+        uint16_t childCapacity;
+        Node* plusChild;        // + 子節點
+        Node* hashChild;        // # 子節點
+        HandlerEntry* handlers;
+    };
+
+    Node* root;
+    size_t filterCount;
+
+    static Node* createNode(const char* segment, size_t length);
+    static void destroyNode(Node* node);
+    static void clearHandlers(Node* node);
+
+    // 以二分搜尋尋找子節點，create為true時不存在則插入到排序位置
+    static Node* child(Node* parent, const char* segment, size_t length, bool create);
+
+    // 遞迴比對主題，level指向目前層級的開頭
+    static size_t match(const Node* node, const char* topic, const char* level, bool firstLevel,
+                        const uint8_t* payload, unsigned int length);
+
+    static size_t invoke(const Node* node, const char* topic, const uint8_t* payload, unsigned int length);
+
+    static void visit(const Node* node, char* path, size_t pathLength, bool isRoot, const MqttFilterVisitor& visitor);
+};
+
+#endif // TOPIC_ROUTER_H
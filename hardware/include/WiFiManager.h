@@ -65,6 +65,12 @@ public:
      */
     String getRoomID() const;
     
+    /**
+     * 獲取房間ID的C字串（不會配置新的String，適用於高頻呼叫路徑）
+     * @return 房間ID，如果未設置則返回空字串
+     */
+    const char* getRoomIDCStr() const;
+    
     /**
      * 檢查是否有設置房間ID
      * @return 如果有房間ID則返回true
@@ -0,0 +1,237 @@
+#include "BrokerPool.h"
+
+// 指數移動平均的權重 (新樣本佔30%)
+static const float EWMA_ALPHA = 0.3f;
+
+// 尚未量測時的預設值，讓未使用過的伺服器依順位排序
+static const float DEFAULT_CONNECT_MS = 500.0f;
+static const float DEFAULT_RTT_MS = 100.0f;
+
+// 失敗率的懲罰與恢復時間
+static const float FAILURE_PENALTY_MS = 3000.0f;
+static const unsigned long FAILURE_RECOVERY_MS = 300000;
+
+// 每個順位的懲罰，讓主要伺服器在健康狀況相近時優先
+static const float PRIORITY_PENALTY_MS = 250.0f;
+
+BrokerPool::BrokerPool()
+    : brokerCount(0),
+      active(0),
+      activeSince(0),
+      lastFailbackCheck(0),
+      switchCount(0),
+      probeTarget(-1),
+      failbackTarget(-1),
+      failingBack(false),
+      failbackFailures(0),
+      lastFailbackFailure(0) {
+    memset(brokers, 0, sizeof(brokers));
+}
+
+bool BrokerPool::add(const char* host, uint16_t port) {
+    if (brokerCount >= MAX_BROKERS || host == NULL || strlen(host) >= sizeof(brokers[0].host)) {
+        return false;
+    }
+
+    BrokerEndpoint& broker = brokers[brokerCount++];
+    memset(&broker, 0, sizeof(broker));
+    strcpy(broker.host, host);
+    broker.port = port;
+    broker.connectMillis = DEFAULT_CONNECT_MS;
+    broker.rttMillis = DEFAULT_RTT_MS;
+    return true;
+}
+
+uint8_t BrokerPool::count() const {
+    return brokerCount;
+}
+
+const BrokerEndpoint& BrokerPool::current() const {
+    return brokers[active];
+}
+
+uint8_t BrokerPool::currentIndex() const {
+    return active;
+}
+
+const BrokerEndpoint& BrokerPool::at(uint8_t index) const {
+    return brokers[index < brokerCount ? index : 0];
+}
+
+void BrokerPool::recordConnect(unsigned long now, unsigned long connectMillis) {
+    if (brokerCount == 0) {
+        return;
+    }
+
+    BrokerEndpoint& broker = brokers[active];
+    broker.connects++;
+    broker.failureRate *= 1.0f - EWMA_ALPHA;
+
+    // 第一次量測直接取代預設值
+    if (broker.connects == 1) {
+        broker.connectMillis = connectMillis;
+    } else {
+        broker.connectMillis += EWMA_ALPHA * ((float)connectMillis - broker.connectMillis);
+    }
+
+    activeSince = now;
+    lastFailbackCheck = now;
+    probeTarget = -1;
+    failbackTarget = -1;
+
+    // 回切成功，之後的回切恢復正常的等待時間
+    if (failingBack) {
+        failingBack = false;
+        failbackFailures = 0;
+    }
+}
+
+void BrokerPool::recordFailure(unsigned long now) {
+    if (brokerCount == 0) {
+        return;
+    }
+
+    BrokerEndpoint& broker = brokers[active];
+    broker.failures++;
+    broker.failureRate += EWMA_ALPHA * (1.0f - broker.failureRate);
+    broker.lastFailure = now != 0 ? now : 1;
+    probeTarget = -1;
+
+    if (failingBack) {
+        failingBack = false;
+        recordFailbackFailure(now);
+    }
+}
+
+void BrokerPool::recordFailbackFailure(unsigned long now) {
+    if (failbackFailures < MAX_FAILBACK_BACKOFF) {
+        failbackFailures++;
+    }
+    lastFailbackFailure = now;
+}
+
+void BrokerPool::recordRtt(unsigned long rttMillis) {
+    if (brokerCount == 0) {
+        return;
+    }
+
+    BrokerEndpoint& broker = brokers[active];
+    broker.rttMillis += EWMA_ALPHA * ((float)rttMillis - broker.rttMillis);
+}
+
+float BrokerPool::score(uint8_t index, unsigned long now) const {
+    const BrokerEndpoint& broker = brokers[index];
+
+    // 失敗的影響隨時間線性消退，長時間沒有嘗試的伺服器也能重新被選中
+    float failure = broker.failureRate;
+    if (broker.lastFailure != 0) {
+        unsigned long elapsed = now - broker.lastFailure;
+        failure *= elapsed >= FAILURE_RECOVERY_MS ? 0.0f : 1.0f - (float)elapsed / FAILURE_RECOVERY_MS;
+    }
+
+    return broker.connectMillis + broker.rttMillis * 2.0f + failure * FAILURE_PENALTY_MS +
+           index * PRIORITY_PENALTY_MS;
+}
+
+int8_t BrokerPool::bestAlternative(unsigned long now, bool requireStable) const {
+    int8_t best = -1;
+    float bestScore = 0;
+
+    for (uint8_t i = 0; i < brokerCount; i++) {
+        if (i == active) {
+            continue;
+        }
+        if (requireStable && brokers[i].lastFailure != 0 && now - brokers[i].lastFailure < HOLD_DOWN) {
+            continue;
+        }
+
+        float candidate = score(i, now);
+        if (best < 0 || candidate < bestScore) {
+            best = i;
+            bestScore = candidate;
+        }
+    }
+
+    // 必須比目前伺服器好一段差距才值得切換
+    if (best >= 0 && bestScore + SWITCH_MARGIN >= score(active, now)) {
+        return -1;
+    }
+    return best;
+}
+
+bool BrokerPool::selectForReconnect(unsigned long now) {
+    // 探測成功後的回切直接改用該伺服器
+    if (failbackTarget >= 0) {
+        active = failbackTarget;
+        failbackTarget = -1;
+        switchCount++;
+        return true;
+    }
+
+    int8_t best = bestAlternative(now, false);
+    if (best < 0) {
+        return false;
+    }
+
+    active = best;
+    switchCount++;
+    return true;
+}
+
+bool BrokerPool::shouldFailBack(unsigned long now) {
+    if (brokerCount < 2) {
+        return false;
+    }
+
+    // 探測確認候選伺服器可連線後才斷線
+    if (failbackTarget >= 0) {
+        failingBack = true;
+        return true;
+    }
+
+    if (probeTarget >= 0 || now - lastFailbackCheck < FAILBACK_CHECK_INTERVAL) {
+        return false;
+    }
+    lastFailbackCheck = now;
+
+    if (now - activeSince < MIN_DWELL) {
+        return false;
+    }
+    if (failbackFailures > 0 && now - lastFailbackFailure < (MIN_DWELL << failbackFailures)) {
+        return false;
+    }
+
+    probeTarget = bestAlternative(now, true);
+    return false;
+}
+
+int8_t BrokerPool::pendingProbe() const {
+    return probeTarget;
+}
+
+void BrokerPool::recordProbe(uint8_t index, unsigned long now, bool reachable) {
+    if (index >= brokerCount || index != probeTarget) {
+        return;
+    }
+    probeTarget = -1;
+
+    BrokerEndpoint& broker = brokers[index];
+    if (reachable) {
+        broker.lastProbe = now != 0 ? now : 1;
+        failbackTarget = index;
+        return;
+    }
+
+    broker.failures++;
+    broker.failureRate += EWMA_ALPHA * (1.0f - broker.failureRate);
+    broker.lastFailure = now != 0 ? now : 1;
+    recordFailbackFailure(now);
+}
+
+uint8_t BrokerPool::getFailbackFailures() const {
+    return failbackFailures;
+}
+
+uint32_t BrokerPool::getSwitchCount() const {
+    return switchCount;
+}
@@ -0,0 +1,117 @@
+#include "DeviceShadow.h"
+
+DeviceShadow::DeviceShadow()
+    : features(""),
+      temperature(0),
+      humidity(0),
+      hasReading(false),
+      dirty(0),
+      fullPending(true),
+      structureChanged(true),
+      version(0),
+      fullCount(0),
+      deltaCount(0) {
+    deviceId[0] = '\0';
+    roomId[0] = '\0';
+}
+
+bool DeviceShadow::setIdentity(const char* newDeviceId, const char* newRoomId, const char* newFeatures) {
+    if (newFeatures == NULL) {
+        newFeatures = "";
+    }
+
+    if (strncmp(deviceId, newDeviceId, sizeof(deviceId) - 1) == 0 &&
+        strncmp(roomId, newRoomId, sizeof(roomId) - 1) == 0 &&
+        strcmp(features, newFeatures) == 0) {
+        return false;
+    }
+
+    strncpy(deviceId, newDeviceId, sizeof(deviceId) - 1);
+    deviceId[sizeof(deviceId) - 1] = '\0';
+    strncpy(roomId, newRoomId, sizeof(roomId) - 1);
+    roomId[sizeof(roomId) - 1] = '\0';
+    features = newFeatures;
+
+    fullPending = true;
+    structureChanged = true;
+    return true;
+}
+
+bool DeviceShadow::setReading(float newTemperature, float newHumidity) {
+    uint8_t changed = 0;
+    if (!hasReading || newTemperature != temperature) {
+        changed |= FIELD_TEMPERATURE;
+    }
+    if (!hasReading || newHumidity != humidity) {
+        changed |= FIELD_HUMIDITY;
+    }
+
+    temperature = newTemperature;
+    humidity = newHumidity;
+    hasReading = true;
+    dirty |= changed;
+    return changed != 0;
+}
+
+bool DeviceShadow::needsFull() const {
+    return fullPending;
+}
+
+void DeviceShadow::requestFull() {
+    fullPending = true;
+}
+
+void DeviceShadow::encodeFull(JsonDocument& doc) const {
+    // 結構變更或帶有新讀數時才算新版本，單純重新同步沿用目前版本
+    doc["v"] = dirty != 0 || structureChanged ? version + 1 : version;
+    doc["deviceId"] = (const char*)deviceId;
+    doc["roomId"] = roomId[0] != '\0' ? (const char*)roomId : "unknown";
+    doc["features"] = features;
+    if (hasReading) {
+        doc["temp"] = temperature;
+        doc["humidity"] = humidity;
+    }
+}
+
+void DeviceShadow::commitFull() {
+    if (dirty != 0 || structureChanged) {
+        version++;
+    }
+    dirty = 0;
+    fullPending = false;
+    structureChanged = false;
+    fullCount++;
+}
+
+bool DeviceShadow::encodeDelta(JsonDocument& doc) const {
+    bool changed = dirty != 0;
+
+    doc["v"] = changed ? version + 1 : version;
+    if (dirty & FIELD_TEMPERATURE) {
+        doc["temp"] = temperature;
+    }
+    if (dirty & FIELD_HUMIDITY) {
+        doc["humidity"] = humidity;
+    }
+    return changed;
+}
+
+void DeviceShadow::commitDelta() {
+    if (dirty != 0) {
+        version++;
+    }
+    dirty = 0;
+    deltaCount++;
+}
+
+uint32_t DeviceShadow::getVersion() const {
+    return version;
+}
+
+uint32_t DeviceShadow::getFullCount() const {
+    return fullCount;
+}
+
+uint32_t DeviceShadow::getDeltaCount() const {
+    return deltaCount;
+}
@@ -6,19 +6,15 @@ DisplayManager::DisplayManager(
     WiFiManager* wifiManagerPtr, 
     BLEManager* bleManagerPtr,
     TimeManager* timeManagerPtr,
-    SemaphoreHandle_t* mutexPtr,
     long blinkInterval
 ) : display(displayPtr), 
     wifiManager(wifiManagerPtr), 
     bleManager(bleManagerPtr),
     timeManager(timeManagerPtr),
-    mutex(mutexPtr),
-    mqttIconBlinkInterval(blinkInterval) {
-    hasIRData = false;
-    irDisplayTimeout = 0;
-    irValue = 0;
-    irBits = 0;
-    irProtocol = "";
+    mqttIconBlinkInterval(blinkInterval),
+    shownIRSequence(0),
+    frameMicros(0),
+    maxFrameMicros(0) {
 }
 
 // 初始化顯示器
@@ -30,9 +26,7 @@ void DisplayManager::begin() {
 // 顯示主畫面 (溫度、濕度、連線狀態等)
 void DisplayManager::updateMainScreen(float temperature, float humidity, bool isMqttConnected, 
                                       bool isMqttTransmitting, unsigned long mqttIconBlinkMillis) {
-    if (*mutex != NULL) {
-        xSemaphoreTake(*mutex, portMAX_DELAY);
-    }
+    unsigned long frameStart = micros();
     
     display->clearBuffer();
     
@@ -80,11 +74,8 @@ void DisplayManager::updateMainScreen(float temperature, float humidity, bool is
         display->print(" [連接]");
     }
     
-    if (*mutex != NULL) {
-        xSemaphoreGive(*mutex);
-    }
-    
     display->sendBuffer();
+    recordFrame(frameStart);
 }
 
 // 顯示WiFi連接狀態畫面
@@ -168,39 +159,40 @@ void DisplayManager::updateIRData(const String& protocol, uint32_t value, uint16
     Serial.println("DisplayManager: 收到IR信號更新請求");
     Serial.printf("協議: %s, 值: 0x%08X, 位元數: %d\n", protocol.c_str(), value, bits);
     
-    this->irProtocol = protocol;
-    this->irValue = value;
-    this->irBits = bits;
-    this->irDisplayTimeout = millis() + 10000;  // 延長顯示時間至10秒
-    this->hasIRData = true;
+    IRDisplayData data;
+    memset(&data, 0, sizeof(data));
+    strncpy(data.protocol, protocol.c_str(), sizeof(data.protocol) - 1);
+    data.value = value;
+    data.bits = bits;
+    data.timeout = millis() + 10000;  // 延長顯示時間至10秒
+    irData.write(data);
     
-    Serial.printf("設置顯示超時至: %lu ms\n", this->irDisplayTimeout);
+    Serial.printf("設置顯示超時至: %lu ms\n", (unsigned long)data.timeout);
 }
 
 // 顯示紅外線接收資料畫面
 bool DisplayManager::showIRData() {
     // 檢查是否有IR資料要顯示以及是否過期
-    unsigned long currentTime = millis();
-    if (!hasIRData) {
+    uint32_t sequence = irData.getWriteCount();
+    if (sequence == shownIRSequence) {
         return false;
     }
     
-    if (currentTime > irDisplayTimeout) {
+    IRDisplayData data = irData.read();
+    unsigned long currentTime = millis();
+    if (currentTime > data.timeout) {
         Serial.println("DisplayManager: IR顯示超時，停止顯示IR數據");
-        hasIRData = false;
+        shownIRSequence = sequence;
         return false;
     }
     
     // 顯示剩餘時間
-    int remainingTime = (irDisplayTimeout - currentTime) / 1000;
+    int remainingTime = (data.timeout - currentTime) / 1000;
     if (remainingTime % 2 == 0) { // 每2秒輸出一次日誌
         Serial.printf("DisplayManager: 顯示IR數據中，剩餘 %d 秒\n", remainingTime);
     }
 
-    if (*mutex != NULL) {
-        xSemaphoreTake(*mutex, portMAX_DELAY);
-    }
-    
+    unsigned long frameStart = micros();
     display->clearBuffer();
     
     // 顯示標題
@@ -214,29 +206,44 @@ bool DisplayManager::showIRData() {
     // 顯示協議類型
     display->setCursor(0, 28);
     display->print("Protocol: ");
-    display->print(irProtocol);
+    display->print(data.protocol);
     
     // 顯示接收到的值 (十六進制)
     display->setCursor(0, 40);
     char hexValue[12];
-    sprintf(hexValue, "0x%08X", irValue);
+    sprintf(hexValue, "0x%08X", data.value);
     display->print("Value: ");
     display->print(hexValue);
     
     // 顯示位元數
     display->setCursor(0, 52);
     display->print("Bits: ");
-    display->print(irBits);
+    display->print(data.bits);
       // 顯示倒數計時
-    int remaining = (irDisplayTimeout - millis()) / 1000 + 1;
+    int remaining = (data.timeout - millis()) / 1000 + 1;
     display->setCursor(100, 64);
     display->print(remaining);
     display->print("s");
     
-    if (*mutex != NULL) {
-        xSemaphoreGive(*mutex);
-    }
-    
     display->sendBuffer();
+    recordFrame(frameStart);
     return true;
+}
+
+// 記錄一次畫面的耗時
+void DisplayManager::recordFrame(unsigned long startMicros) {
+    frameMicros = micros() - startMicros;
+    if (frameMicros > maxFrameMicros) {
+        maxFrameMicros = frameMicros;
+    }
+}
+
+// 獲取上一次畫面繪製與傳輸耗時 (微秒)
+unsigned long DisplayManager::getFrameMicros() const {
+    return frameMicros;
+}
+
+// 獲取最長畫面繪製與傳輸耗時 (微秒)
+unsigned long DisplayManager::getMaxFrameMicros() const {
+    return maxFrameMicros;
 }
\ No newline at end of file
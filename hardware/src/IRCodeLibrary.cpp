@@ -0,0 +1,401 @@
+#include "IRCodeLibrary.h"
+#include "Logger.h"
+#include "IRTimingCodec.h"
+
+// 索引的Flash鍵名
+static const char* INDEX_KEY = "index";
+
+// 紀錄格式版本 (1: 原始時序以uint16保存，2: 原始時序以IRTimingCodec編碼)
+static const uint8_t RECORD_VERSION_PLAIN = 1;
+static const uint8_t RECORD_VERSION = 2;
+
+// 紀錄標頭: 版本(1) 類型(1) 載波(2) 編碼值(4) 位元數(2) 重複(2) 時序數量(2)
+static const size_t RECORD_HEADER_SIZE = 14;
+
+// 紀錄最大長度 (可讀取舊版紀錄)
+static const size_t RECORD_MAX_SIZE = RECORD_HEADER_SIZE +
+    (IR_COMMAND_MAX_RAW * 2 > IR_COMMAND_MAX_ENCODED ? IR_COMMAND_MAX_RAW * 2 : IR_COMMAND_MAX_ENCODED);
+
+static void putU16(uint8_t* out, uint16_t value) {
+    out[0] = value & 0xFF;
+    out[1] = value >> 8;
+}
+
+static uint16_t getU16(const uint8_t* in) {
+    return (uint16_t)in[0] | ((uint16_t)in[1] << 8);
+}
+
+IRCodeLibrary::IRCodeLibrary(StorageManager* storage) {
+    _storage = storage;
+    _mutex = xSemaphoreCreateMutex();
+    _indexLoaded = false;
+    _count = 0;
+    _reservedId = -1;
+    _reservedName[0] = '\0';
+    _useCounter = 0;
+    _hits = 0;
+    _misses = 0;
+    _stores = 0;
+    _failures = 0;
+
+    for (size_t i = 0; i < CACHE_SIZE; i++) {
+        _cache[i].used = false;
+    }
+}
+
+IRCodeLibrary::~IRCodeLibrary() {
+    if (_mutex != NULL) {
+        vSemaphoreDelete(_mutex);
+    }
+}
+
+bool IRCodeLibrary::store(uint16_t id, const char* name, const IRCommand& cmd) {
+    if (name != nullptr && strlen(name) > NAME_MAX) {
+        LOG_W("IR碼名稱過長 (最多 %u 字元)", (unsigned)NAME_MAX);
+        return false;
+    }
+
+    uint8_t record[RECORD_MAX_SIZE];
+    size_t size = encodeRecord(cmd, record, sizeof(record));
+    if (size == 0) {
+        return false;
+    }
+
+    xSemaphoreTake(_mutex, portMAX_DELAY);
+    ensureIndex();
+
+    // 名稱不可與其他編號重複
+    if (name != nullptr && name[0] != '\0') {
+        for (size_t i = 0; i < _count; i++) {
+            if (_index[i].id != id && strcmp(_index[i].name, name) == 0) {
+                xSemaphoreGive(_mutex);
+                LOG_W("IR碼名稱 %s 已被編號 %u 使用", name, (unsigned)_index[i].id);
+                return false;
+            }
+        }
+        if (_reservedId >= 0 && _reservedId != id && strcmp(_reservedName, name) == 0) {
+            xSemaphoreGive(_mutex);
+            LOG_W("IR碼名稱 %s 已保留給學習中的編號 %d", name, (int)_reservedId);
+            return false;
+        }
+    }
+
+    int pos = findEntry(id);
+    if (pos < 0 && _count >= MAX_CODES) {
+        xSemaphoreGive(_mutex);
+        LOG_W("IR碼庫已滿 (%u 筆)", (unsigned)MAX_CODES);
+        return false;
+    }
+
+    char key[8];
+    makeKey(id, key, sizeof(key));
+    if (!_storage->saveBytes(key, record, size)) {
+        _failures++;
+        xSemaphoreGive(_mutex);
+        LOG_E("IR碼 %u 寫入Flash失敗", (unsigned)id);
+        return false;
+    }
+
+    if (pos < 0) {
+        pos = _count++;
+        _index[pos].id = id;
+        _index[pos].name[0] = '\0';
+    }
+    _index[pos].size = size;
+    if (name != nullptr) {
+        strncpy(_index[pos].name, name, NAME_MAX);
+        _index[pos].name[NAME_MAX] = '\0';
+    }
+    bool indexSaved = saveIndex();
+
+    // 學習的IR碼已保存，解除保留
+    if (_reservedId == id) {
+        _reservedId = -1;
+    }
+
+    _stores++;
+    cachePut(id, cmd);
+    LOG_I("已保存IR碼 %u %s (%u 位元組)", (unsigned)id, _index[pos].name, (unsigned)size);
+    xSemaphoreGive(_mutex);
+    return indexSaved;
+}
+
+bool IRCodeLibrary::load(uint16_t id, IRCommand& cmd) {
+    xSemaphoreTake(_mutex, portMAX_DELAY);
+
+    // 先查RAM快取，不需要載入索引
+    for (size_t i = 0; i < CACHE_SIZE; i++) {
+        if (_cache[i].used && _cache[i].id == id) {
+            _cache[i].lastUsed = ++_useCounter;
+            cmd = _cache[i].cmd;
+            _hits++;
+            xSemaphoreGive(_mutex);
+            return true;
+        }
+    }
+
+    _misses++;
+    ensureIndex();
+    int pos = findEntry(id);
+    if (pos < 0) {
+        _failures++;
+        xSemaphoreGive(_mutex);
+        LOG_W("找不到IR碼 %u", (unsigned)id);
+        return false;
+    }
+
+    uint8_t record[RECORD_MAX_SIZE];
+    char key[8];
+    makeKey(id, key, sizeof(key));
+    size_t length = _storage->loadBytes(key, record, sizeof(record));
+    if (!decodeRecord(record, length, cmd)) {
+        _failures++;
+        xSemaphoreGive(_mutex);
+        LOG_E("IR碼 %u 的Flash紀錄無效", (unsigned)id);
+        return false;
+    }
+
+    cachePut(id, cmd);
+    xSemaphoreGive(_mutex);
+    return true;
+}
+
+bool IRCodeLibrary::remove(uint16_t id) {
+    xSemaphoreTake(_mutex, portMAX_DELAY);
+    ensureIndex();
+
+    int pos = findEntry(id);
+    if (pos < 0) {
+        xSemaphoreGive(_mutex);
+        return false;
+    }
+
+    char key[8];
+    makeKey(id, key, sizeof(key));
+    _storage->deleteKey(key);
+
+    // 以最後一筆填補空位
+    _index[pos] = _index[--_count];
+    bool indexSaved = saveIndex();
+
+    for (size_t i = 0; i < CACHE_SIZE; i++) {
+        if (_cache[i].used && _cache[i].id == id) {
+            _cache[i].used = false;
+        }
+    }
+    xSemaphoreGive(_mutex);
+
+    LOG_I("已刪除IR碼 %u", (unsigned)id);
+    return indexSaved;
+}
+
+int32_t IRCodeLibrary::findId(const char* name) {
+    if (name == nullptr || name[0] == '\0') {
+        return -1;
+    }
+
+    xSemaphoreTake(_mutex, portMAX_DELAY);
+    ensureIndex();
+    int32_t id = -1;
+    for (size_t i = 0; i < _count; i++) {
+        if (strcmp(_index[i].name, name) == 0) {
+            id = _index[i].id;
+            break;
+        }
+    }
+    xSemaphoreGive(_mutex);
+    return id;
+}
+
+int32_t IRCodeLibrary::allocateId() {
+    xSemaphoreTake(_mutex, portMAX_DELAY);
+    ensureIndex();
+    int32_t id = nextFreeId();
+    xSemaphoreGive(_mutex);
+    return id;
+}
+
+int32_t IRCodeLibrary::reserve(int32_t id, const char* name) {
+    if (id > 0xFFFF || (name != nullptr && strlen(name) > NAME_MAX)) {
+        return -1;
+    }
+
+    xSemaphoreTake(_mutex, portMAX_DELAY);
+    ensureIndex();
+
+    // 新的學習取代舊的保留
+    _reservedId = -1;
+    if (id < 0) {
+        id = nextFreeId();
+    }
+    if (id >= 0) {
+        _reservedId = id;
+        strncpy(_reservedName, name != nullptr ? name : "", NAME_MAX);
+        _reservedName[NAME_MAX] = '\0';
+    }
+    xSemaphoreGive(_mutex);
+    return id;
+}
+
+void IRCodeLibrary::release(uint16_t id) {
+    xSemaphoreTake(_mutex, portMAX_DELAY);
+    if (_reservedId == id) {
+        _reservedId = -1;
+    }
+    xSemaphoreGive(_mutex);
+}
+
+IRCodeLibraryStats IRCodeLibrary::getStats() {
+    IRCodeLibraryStats stats;
+    xSemaphoreTake(_mutex, portMAX_DELAY);
+    stats.codes = _indexLoaded ? _count : 0;
+    stats.hits = _hits;
+    stats.misses = _misses;
+    stats.stores = _stores;
+    stats.failures = _failures;
+    xSemaphoreGive(_mutex);
+    return stats;
+}
+
+void IRCodeLibrary::ensureIndex() {
+    if (_indexLoaded) {
+        return;
+    }
+
+    size_t length = _storage->loadBytes(INDEX_KEY, _index, sizeof(_index));
+    if (length % sizeof(IndexEntry) != 0) {
+        LOG_W("IR碼索引長度無效，已重設");
+        length = 0;
+    }
+    _count = length / sizeof(IndexEntry);
+    for (size_t i = 0; i < _count; i++) {
+        _index[i].name[NAME_MAX] = '\0';
+    }
+    _indexLoaded = true;
+
+    LOG_I("IR碼庫已載入 %u 筆", (unsigned)_count);
+}
+
+bool IRCodeLibrary::saveIndex() {
+    if (_count == 0) {
+        _storage->deleteKey(INDEX_KEY);
+        return true;
+    }
+
+    if (!_storage->saveBytes(INDEX_KEY, _index, _count * sizeof(IndexEntry))) {
+        _failures++;
+        LOG_E("IR碼索引寫入Flash失敗");
+        return false;
+    }
+    return true;
+}
+
+int IRCodeLibrary::findEntry(uint16_t id) const {
+    for (size_t i = 0; i < _count; i++) {
+        if (_index[i].id == id) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+int32_t IRCodeLibrary::nextFreeId() const {
+    // 保留的編號不在索引中時也佔用一個位置
+    size_t used = _count + (_reservedId >= 0 && findEntry(_reservedId) < 0 ? 1 : 0);
+    if (used >= MAX_CODES) {
+        return -1;
+    }
+
+    // 佔用的編號少於MAX_CODES，0..MAX_CODES之間必有空位
+    for (uint16_t candidate = 0; candidate <= MAX_CODES; candidate++) {
+        if (candidate != _reservedId && findEntry(candidate) < 0) {
+            return candidate;
+        }
+    }
+    return -1;
+}
+
+void IRCodeLibrary::cachePut(uint16_t id, const IRCommand& cmd) {
+    size_t slot = 0;
+    for (size_t i = 0; i < CACHE_SIZE; i++) {
+        if (_cache[i].used && _cache[i].id == id) {
+            slot = i;
+            break;
+        }
+        if (!_cache[i].used) {
+            slot = i;
+        } else if (_cache[slot].used && _cache[i].lastUsed < _cache[slot].lastUsed) {
+            slot = i;
+        }
+    }
+
+    _cache[slot].used = true;
+    _cache[slot].id = id;
+    _cache[slot].lastUsed = ++_useCounter;
+    _cache[slot].cmd = cmd;
+}
+
+void IRCodeLibrary::makeKey(uint16_t id, char* key, size_t keySize) {
+    snprintf(key, keySize, "c%u", (unsigned)id);
+}
+
+size_t IRCodeLibrary::encodeRecord(const IRCommand& cmd, uint8_t* out, size_t outSize) {
+    size_t rawLength = cmd.type == IRCommandType::RAW ? cmd.rawLength : 0;
+    if (rawLength > IR_COMMAND_MAX_RAW || outSize < RECORD_HEADER_SIZE) {
+        return 0;
+    }
+
+    out[0] = RECORD_VERSION;
+    out[1] = (uint8_t)cmd.type;
+    putU16(out + 2, cmd.khz);
+    putU16(out + 4, cmd.value & 0xFFFF);
+    putU16(out + 6, cmd.value >> 16);
+    putU16(out + 8, cmd.bits);
+    putU16(out + 10, cmd.repeat);
+    putU16(out + 12, rawLength);
+    if (rawLength == 0) {
+        return RECORD_HEADER_SIZE;
+    }
+
+    // 原始時序以與MQTT相同的精簡格式保存
+    size_t encoded = IRTimingCodec::encode(cmd.raw, rawLength, cmd.khz, out + RECORD_HEADER_SIZE,
+                                           outSize - RECORD_HEADER_SIZE);
+    return encoded > 0 ? RECORD_HEADER_SIZE + encoded : 0;
+}
+
+bool IRCodeLibrary::decodeRecord(const uint8_t* data, size_t length, IRCommand& cmd) {
+    if (length < RECORD_HEADER_SIZE || data[1] > (uint8_t)IRCommandType::RC6) {
+        return false;
+    }
+
+    size_t rawLength = getU16(data + 12);
+    if (rawLength > IR_COMMAND_MAX_RAW) {
+        return false;
+    }
+
+    cmd.type = (IRCommandType)data[1];
+    cmd.khz = getU16(data + 2);
+    cmd.value = (uint32_t)getU16(data + 4) | ((uint32_t)getU16(data + 6) << 16);
+    cmd.bits = getU16(data + 8);
+    cmd.repeat = getU16(data + 10);
+    cmd.rawLength = rawLength;
+
+    if (data[0] == RECORD_VERSION_PLAIN) {
+        if (length != RECORD_HEADER_SIZE + rawLength * 2) {
+            return false;
+        }
+        for (size_t i = 0; i < rawLength; i++) {
+            cmd.raw[i] = getU16(data + RECORD_HEADER_SIZE + i * 2);
+        }
+        return true;
+    }
+
+    if (data[0] != RECORD_VERSION) {
+        return false;
+    }
+    if (rawLength == 0) {
+        return length == RECORD_HEADER_SIZE;
+    }
+    return IRTimingCodec::decode(data + RECORD_HEADER_SIZE, length - RECORD_HEADER_SIZE,
+                                 cmd.raw, IR_COMMAND_MAX_RAW, nullptr) == rawLength;
+}
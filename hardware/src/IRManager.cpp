@@ -1,6 +1,28 @@
 #include "IRManager.h"
+#include "Logger.h"
 #include "DisplayManager.h"  // 添加 DisplayManager 引用
 #include "MQTTManager.h"     // 添加 MQTTManager 引用
+#include "ConfigManager.h"
+#include "IRCodeLibrary.h"
+#include "IRTimingCodec.h"
+
+// IRrecv在最後一個邊緣之後靜默這段時間才完成捕獲 (毫秒)
+static const uint8_t IR_RECV_TIMEOUT_MS = 60;
+
+// 訊框進行中檢查是否捕獲完成的間隔 (毫秒)
+static const uint8_t IR_FRAME_POLL_MS = 2;
+
+// 邊緣喚醒模式下沒有通知時的保險檢查間隔 (毫秒)
+static const uint32_t IR_IDLE_CHECK_MS = 1000;
+
+// 輪詢模式的間隔 (毫秒)
+static const uint8_t IR_POLL_INTERVAL_MS = 10;
+
+// 學習模式預設等待時間 (秒)
+static const uint16_t IR_LEARN_TIMEOUT_S = 15;
+
+// 監看接收腳位的PCNT單元
+static const pcnt_unit_t IR_PCNT_UNIT = PCNT_UNIT_0;
 
 // 構造函數
 IRManager::IRManager(int irSendPin, int irRecvPin, const char* controlTopic, const char* receiveTopic) {
@@ -16,6 +38,38 @@ IRManager::IRManager(int irSendPin, int irRecvPin, const char* controlTopic, con
     receiverInitialized = false;
     irReceiverTaskHandle = NULL;
     
+    // 接收統計
+    edgeDriven = false;
+    frameStartMicros = 0;
+    rxFrames = 0;
+    rxWakeups = 0;
+    rxSpurious = 0;
+    rxDecodeCalls = 0;
+    rxBusyMicros = 0;
+    rxLastLatencyMicros = 0;
+    rxMaxLatencyMicros = 0;
+    
+    // 發射佇列統計
+    irTransmitTaskHandle = NULL;
+    txOverflowCount = 0;
+    txSentCount = 0;
+    lastEnqueueMicros = 0;
+    maxEnqueueMicros = 0;
+    lastQueueDelayMicros = 0;
+    lastEmitMicros = 0;
+    maxEmitMicros = 0;
+    
+    // 裝置群組 (未設置前屬於所有群組，群組命令不會被靜默略過)
+    groupMask = ALL_GROUPS;
+    groupFilteredCount = 0;
+    configManager = nullptr;
+    
+    // IR碼庫
+    codeLibrary = nullptr;
+    learning.id = -1;
+    learning.name[0] = '\0';
+    learning.deadline = 0;
+    
     // 創建互斥鎖
     irMutex = xSemaphoreCreateMutex();
 
@@ -48,7 +102,20 @@ void IRManager::begin() {
     // 初始化發射器
     irSender->begin();
     initialized = true;
-    Serial.println("IR發射器已初始化");
+    LOG_I("IR發射器已初始化");
+    
+    // 啟動IR發射任務，長的原始碼發射不會阻塞MQTT任務
+    if (irTransmitTaskHandle == NULL) {
+        xTaskCreatePinnedToCore(
+            irTransmitTask,         // 任務函數
+            "IRSendTask",           // 任務名稱
+            3072,                   // 堆棧大小
+            this,                   // 任務參數
+            2,                      // 任務優先級
+            &irTransmitTaskHandle,  // 任務句柄指針
+            1                       // 在核心1上執行
+        );
+    }
     
     // 如果接收引腳已設置，初始化接收器
     if (receiverPin > 0) {
@@ -66,7 +133,7 @@ void IRManager::beginReceiver(int pin) {
     }
     
     // 創建接收器（增加緩衝區大小至2048，並設置較長的接收超時，以提高捕獲能力）
-    irReceiver = new IRrecv(pin, 2048, 60, true);
+    irReceiver = new IRrecv(pin, 2048, IR_RECV_TIMEOUT_MS, true);
     irReceiver->enableIRIn();  // 啟動接收器
     
     // 設置接收器允許處理未知協議
@@ -74,7 +141,7 @@ void IRManager::beginReceiver(int pin) {
     irReceiver->setTolerance(25);  // 增加容錯率(%)，預設是25%
     
     receiverInitialized = true;
-    Serial.printf("IR接收器已增強模式初始化於引腳 %d\n", pin);
+    LOG_I("IR接收器已增強模式初始化於引腳 %d", pin);
 }
 
 // 獲取IR控制主題
@@ -88,83 +155,328 @@ const char* IRManager::getIRReceiveTopic() const {
 }
 
 // 處理MQTT消息
-bool IRManager::handleMQTTMessage(const char* topic, const char* payload) {
+bool IRManager::handleMQTTMessage(const char* topic, const uint8_t* payload, unsigned int length) {
     // 檢查是否是IR控制主題
     if (strcmp(topic, irControlTopic) != 0) {
         return false;
     }
     
-    // 解析 JSON 數據
-    StaticJsonDocument<200> doc;
-    DeserializationError error = deserializeJson(doc, payload);
+    return handleCommand(payload, length);
+}
+
+// 處理IR命令
+bool IRManager::handleCommand(const uint8_t* payload, unsigned int length) {
+    // 需容納最大的命令: 帶IR_COMMAND_MAX_RAW個時序的raw/store命令 ("data"陣列或base64的"code"字串)，
+    // 約2KB，放在靜態區而不佔用MQTT任務的堆疊 (只在MQTT任務中呼叫)
+    static const size_t CAPACITY = JSON_OBJECT_SIZE(12) + JSON_ARRAY_SIZE(IR_COMMAND_MAX_RAW) +
+                                   (IR_COMMAND_MAX_ENCODED + 2) / 3 * 4 + 1 + 96;
+    static StaticJsonDocument<CAPACITY> doc;
+    DeserializationError error = deserializeJson(doc, (const char*)payload, length);
     
     if (error) {
-        Serial.println("JSON解析錯誤");
+        LOG_W("IR命令JSON解析錯誤: %s (%u 位元組)", error.c_str(), length);
         return false;
     }
     
-    // 獲取命令類型
-    const char* command = doc["command"];
+    // 獲取命令類型 ("cmd"是較短的別名)
+    const char* command = doc["cmd"];
+    if (!command) {
+        command = doc["command"];
+    }
     
     if (!command) {
         return false;
     }
     
-    Serial.printf("收到IR命令: %s\n", command);
+    // 設置本裝置所屬的群組
+    if (strcmp(command, "groups") == 0) {
+        setGroupMask(doc["groups"] | 0u);
+        return true;
+    }
+    
+    // 指定群組的命令，只有屬於其中任一群組的裝置發射
+    uint32_t groups = doc["groups"] | 0u;
+    if (groups != 0 && (groups & groupMask) == 0) {
+        // 第一次略過時以資訊等級記錄，之後只計入統計
+        if (groupFilteredCount++ == 0) {
+            LOG_I("IR命令群組 0x%X 不含本裝置 (0x%X)，略過", (unsigned)groups, (unsigned)groupMask);
+        } else {
+            LOG_D("IR命令群組 0x%X 不含本裝置 (0x%X)，略過", (unsigned)groups, (unsigned)groupMask);
+        }
+        return false;
+    }
+    
+    LOG_D("收到IR命令: %s", command);
+    
+    unsigned long enqueueStart = micros();
+    
+    bool result = false;
+    if (handleLibraryCommand(command, doc.as<JsonVariantConst>(), enqueueStart, result)) {
+        return result;
+    }
     
-    if (strcmp(command, "raw") == 0 && doc.containsKey("data")) {
+    IRCommand cmd;
+    if (!parseCommand(command, doc.as<JsonVariantConst>(), cmd)) {
+        return false;
+    }
+    
+    // 交給IR發射任務送出，不在MQTT回調中等待發射完成
+    return enqueueCommand(cmd, enqueueStart);
+}
+
+// 依命令類型解析協議值或原始時序
+bool IRManager::parseCommand(const char* type, JsonVariantConst source, IRCommand& cmd) {
+    cmd.value = 0;
+    cmd.bits = 0;
+    cmd.rawLength = 0;
+    cmd.khz = 38;
+    cmd.repeat = 0;
+    
+    if (type == nullptr) {
+        return false;
+    }
+    
+    if (strcmp(type, "raw") == 0 && source.containsKey("code")) {
+        // IRTimingCodec編碼的原始時序 (base64)，載波頻率包含在編碼中
+        const char* code = source["code"];
+        uint8_t encoded[IR_COMMAND_MAX_ENCODED];
+        size_t length = code != nullptr ? IRTimingCodec::fromBase64(code, strlen(code), encoded, sizeof(encoded)) : 0;
+        cmd.type = IRCommandType::RAW;
+        cmd.rawLength = IRTimingCodec::decode(encoded, length, cmd.raw, IR_COMMAND_MAX_RAW, &cmd.khz);
+        if (cmd.rawLength == 0) {
+            return false;
+        }
+    }
+    else if (strcmp(type, "raw") == 0 && source.containsKey("data")) {
         // 處理原始IR數據發送
-        JsonArray rawData = doc["data"].as<JsonArray>();
-        if (!rawData.isNull()) {
-            uint16_t rawCodes[100]; // 假設最多100個代碼
-            int i = 0;
-            for (JsonVariant value : rawData) {
-                if (i < 100) {
-                    rawCodes[i++] = value.as<uint16_t>();
-                }
+        JsonArrayConst rawData = source["data"].as<JsonArrayConst>();
+        if (rawData.isNull()) {
+            return false;
+        }
+        cmd.type = IRCommandType::RAW;
+        for (JsonVariantConst value : rawData) {
+            if (cmd.rawLength < IR_COMMAND_MAX_RAW) {
+                cmd.raw[cmd.rawLength++] = value.as<uint16_t>();
             }
-            // 發送原始IR代碼
-            uint16_t khz = doc["khz"] | 38; // 默認38kHz
-            irSender->sendRaw(rawCodes, i, khz);
-            Serial.println("發送原始IR代碼");
         }
+        cmd.khz = source["khz"] | 38; // 默認38kHz
     } 
-    else if (strcmp(command, "nec") == 0 && doc.containsKey("value")) {
-        // 發送NEC格式命令
-        uint32_t code = doc["value"];
-        uint16_t bits = doc["bits"] | 32; // 默認32位
-        irSender->sendNEC(code, bits);
-        Serial.printf("發送NEC命令: 0x%08X, %d位\n", code, bits);
-    }
-    else if (strcmp(command, "sony") == 0 && doc.containsKey("value")) {
-        // 發送Sony格式命令
-        uint32_t code = doc["value"];
-        uint16_t bits = doc["bits"] | 12; // 默認12位
-        uint8_t repeat = doc["repeat"] | 2; // 默認2次重複
-        irSender->sendSony(code, bits, repeat);
-        Serial.printf("發送Sony命令: 0x%08X, %d位\n", code, bits);
-    }
-    else if (strcmp(command, "rc5") == 0 && doc.containsKey("value")) {
-        // 發送RC5格式命令
-        uint32_t code = doc["value"];
-        uint16_t bits = doc["bits"] | 12; // 默認12位
-        irSender->sendRC5(code, bits);
-        Serial.printf("發送RC5命令: 0x%08X, %d位\n", code, bits);
-    }
-    else if (strcmp(command, "rc6") == 0 && doc.containsKey("value")) {
-        // 發送RC6格式命令
-        uint32_t code = doc["value"];
-        uint16_t bits = doc["bits"] | 20; // 默認20位
-        irSender->sendRC6(code, bits);
-        Serial.printf("發送RC6命令: 0x%08X, %d位\n", code, bits);
+    else if (strcmp(type, "nec") == 0 && source.containsKey("value")) {
+        cmd.type = IRCommandType::NEC;
+        cmd.value = source["value"];
+        cmd.bits = source["bits"] | 32; // 默認32位
+    }
+    else if (strcmp(type, "sony") == 0 && source.containsKey("value")) {
+        cmd.type = IRCommandType::SONY;
+        cmd.value = source["value"];
+        cmd.bits = source["bits"] | 12; // 默認12位
+        cmd.repeat = source["repeat"] | 2; // 默認2次重複
+    }
+    else if (strcmp(type, "rc5") == 0 && source.containsKey("value")) {
+        cmd.type = IRCommandType::RC5;
+        cmd.value = source["value"];
+        cmd.bits = source["bits"] | 12; // 默認12位
+    }
+    else if (strcmp(type, "rc6") == 0 && source.containsKey("value")) {
+        cmd.type = IRCommandType::RC6;
+        cmd.value = source["value"];
+        cmd.bits = source["bits"] | 20; // 默認20位
     }
     else {
         return false;
     }
+    return true;
+}
+
+// 處理碼庫命令
+bool IRManager::handleLibraryCommand(const char* command, JsonVariantConst doc, unsigned long startMicros, bool& result) {
+    bool play = strcmp(command, "play") == 0;
+    bool store = strcmp(command, "store") == 0;
+    bool learn = strcmp(command, "learn") == 0;
+    bool remove = strcmp(command, "delete") == 0;
+    if (!play && !store && !learn && !remove) {
+        return false;
+    }
     
+    result = false;
+    if (codeLibrary == nullptr) {
+        LOG_W("未設置IR碼庫，略過 %s 命令", command);
+        return true;
+    }
+    
+    // 以編號或名稱指定IR碼，保存新的IR碼時自動分配編號
+    const char* name = doc["name"];
+    int32_t id = doc["id"] | -1;
+    if (id < 0 && name != nullptr) {
+        id = codeLibrary->findId(name);
+    }
+    if (id < 0 && store) {
+        id = codeLibrary->allocateId();
+    }
+    if (learn) {
+        if (!receiverInitialized) {
+            LOG_W("IR接收器未初始化，無法學習");
+            return true;
+        }
+        // 在訊框到達前保留編號，期間不帶編號的store不會分配到同一個編號而被學習結果覆寫
+        id = codeLibrary->reserve(id, name);
+    }
+    if (id < 0 || id > 0xFFFF) {
+        LOG_W("IR碼 %s 命令缺少有效的編號或名稱", command);
+        return true;
+    }
+    
+    if (play) {
+        // 重放只需查詢快取或讀取一筆Flash紀錄，不需要解析時序
+        IRCommand cmd;
+        if (codeLibrary->load(id, cmd)) {
+            result = enqueueCommand(cmd, startMicros);
+        }
+    } else if (store) {
+        IRCommand cmd;
+        if (parseCommand(doc["type"], doc, cmd)) {
+            result = codeLibrary->store(id, name, cmd);
+        } else {
+            LOG_W("IR碼 %d 的內容無效", (int)id);
+        }
+    } else if (learn) {
+        // 以SPSC佇列交給接收任務，名稱與期限隨編號一起發布到另一個核心
+        IRLearnRequest request;
+        request.id = id;
+        strncpy(request.name, name != nullptr ? name : "", sizeof(request.name) - 1);
+        request.name[sizeof(request.name) - 1] = '\0';
+        request.deadline = millis() + (uint32_t)(doc["timeout"] | IR_LEARN_TIMEOUT_S) * 1000;
+        result = learnQueue.push(request);
+        if (result) {
+            LOG_I("IR學習模式: 下一個訊框將保存為 %d", (int)id);
+        } else {
+            codeLibrary->release(id);
+            LOG_W("IR學習請求過於頻繁，略過編號 %d", (int)id);
+        }
+    } else {
+        result = codeLibrary->remove(id);
+    }
+    return true;
+}
+
+// 將命令放入發射佇列 (只由MQTT任務呼叫)
+bool IRManager::enqueueCommand(IRCommand& cmd, unsigned long startMicros) {
+    cmd.enqueuedMicros = micros();
+    
+    if (!txQueue.push(cmd)) {
+        txOverflowCount++;
+        LOG_W("IR發射佇列已滿，丟棄命令 (累計 %u)", (unsigned)txOverflowCount);
+        return false;
+    }
+    
+    if (irTransmitTaskHandle != NULL) {
+        xTaskNotifyGive(irTransmitTaskHandle);
+    }
+    
+    lastEnqueueMicros = micros() - startMicros;
+    if (lastEnqueueMicros > maxEnqueueMicros) {
+        maxEnqueueMicros = lastEnqueueMicros;
+    }
     return true;
 }
 
+// 送出單一命令 (在IR發射任務中執行)
+void IRManager::transmit(const IRCommand& cmd) {
+    switch (cmd.type) {
+        case IRCommandType::RAW:
+            irSender->sendRaw(cmd.raw, cmd.rawLength, cmd.khz);
+            LOG_D("發送原始IR代碼");
+            break;
+        case IRCommandType::NEC:
+            irSender->sendNEC(cmd.value, cmd.bits);
+            LOG_D("發送NEC命令: 0x%08X, %d位", cmd.value, cmd.bits);
+            break;
+        case IRCommandType::SONY:
+            irSender->sendSony(cmd.value, cmd.bits, cmd.repeat);
+            LOG_D("發送Sony命令: 0x%08X, %d位", cmd.value, cmd.bits);
+            break;
+        case IRCommandType::RC5:
+            irSender->sendRC5(cmd.value, cmd.bits);
+            LOG_D("發送RC5命令: 0x%08X, %d位", cmd.value, cmd.bits);
+            break;
+        case IRCommandType::RC6:
+            irSender->sendRC6(cmd.value, cmd.bits);
+            LOG_D("發送RC6命令: 0x%08X, %d位", cmd.value, cmd.bits);
+            break;
+    }
+}
+
+// IR發射任務 - 等待通知後依序送出佇列中的命令
+void IRManager::irTransmitTask(void* parameter) {
+    IRManager* irManager = static_cast<IRManager*>(parameter);
+    
+    // 命令結構較大，使用靜態儲存避免佔用任務堆疊
+    static IRCommand cmd;
+    
+    while (true) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        
+        while (irManager->txQueue.pop(cmd)) {
+            unsigned long emitStart = micros();
+            irManager->lastQueueDelayMicros = emitStart - cmd.enqueuedMicros;
+            
+            irManager->transmit(cmd);
+            
+            irManager->lastEmitMicros = micros() - emitStart;
+            if (irManager->lastEmitMicros > irManager->maxEmitMicros) {
+                irManager->maxEmitMicros = irManager->lastEmitMicros;
+            }
+            irManager->txSentCount++;
+        }
+    }
+}
+
+// 獲取IR發射統計
+IRTransmitStats IRManager::getTransmitStats() const {
+    IRTransmitStats stats;
+    stats.queued = txQueue.size();
+    stats.sent = txSentCount;
+    stats.overflow = txOverflowCount;
+    stats.lastEnqueueMicros = lastEnqueueMicros;
+    stats.maxEnqueueMicros = maxEnqueueMicros;
+    stats.lastQueueDelayMicros = lastQueueDelayMicros;
+    stats.lastEmitMicros = lastEmitMicros;
+    stats.maxEmitMicros = maxEmitMicros;
+    stats.groupFiltered = groupFilteredCount;
+    return stats;
+}
+
+// 設置保存群組設定的ConfigManager
+void IRManager::setConfigManager(ConfigManager* config) {
+    configManager = config;
+    if (configManager != nullptr) {
+        groupMask = (uint32_t)configManager->loadInt("ir_groups", (int)ALL_GROUPS);
+    }
+}
+
+// 設置IR碼庫
+void IRManager::setCodeLibrary(IRCodeLibrary* library) {
+    codeLibrary = library;
+}
+
+// 設置本裝置所屬的群組
+void IRManager::setGroupMask(uint32_t mask) {
+    if (mask == groupMask) {
+        return;
+    }
+    
+    groupMask = mask;
+    if (configManager != nullptr) {
+        configManager->saveInt("ir_groups", (int)mask);
+    }
+    LOG_I("IR群組已設置為 0x%X", (unsigned)mask);
+}
+
+// 獲取本裝置所屬的群組
+uint32_t IRManager::getGroupMask() const {
+    return groupMask;
+}
+
 // 發送原始IR數據
 void IRManager::sendRawData(uint16_t* data, uint16_t len, uint16_t khz) {
     if (!initialized) {
@@ -226,6 +538,7 @@ bool IRManager::read() {
     
     xSemaphoreTake(irMutex, portMAX_DELAY);
     bool hasData = irReceiver->decode(&results);
+    rxDecodeCalls++;
     
     if (hasData) {
         // 準備接收下一個信號
@@ -238,17 +551,23 @@ bool IRManager::read() {
 }
 
 // 解析接收到的IR數據並發送到MQTT
-void IRManager::publishIRReceived(MQTTManager* mqttManager) {
+bool IRManager::publishIRReceived(MQTTManager* mqttManager) {
     if (!receiverInitialized) {
-        return;
-    }    if (read()) {
-        // 在Serial Monitor上顯示詳細的解碼結果
-        Serial.println("\n================ IR 信號接收 ================");
-        Serial.printf("協議類型: %s\n", IRManager::typeToString(results.decode_type));
-        Serial.printf("位元數: %d\n", results.bits);
+        return false;
+    }
+    
+    unsigned long start = micros();
+    updateLearning();
+    bool received = read();
+    
+    if (received) {
+        // 輸出解碼結果 (由日誌任務非同步輸出)
+        LOG_I("IR信號接收 協議類型: %s 位元數: %d", IRManager::typeToString(results.decode_type), results.bits);
         
-        // 創建JSON對象來存儲IR數據
-        StaticJsonDocument<512> doc;
+        // 創建JSON對象來存儲IR數據，需容納無法編碼時的原始時序陣列 (靜態配置，只在IR接收任務中呼叫)
+        static const size_t CAPACITY = JSON_OBJECT_SIZE(8) + JSON_ARRAY_SIZE(IR_COMMAND_MAX_RAW);
+        static StaticJsonDocument<CAPACITY> doc;
+        doc.clear();
         
         // 將解碼類型轉換為字符串
         String typeStr = IRManager::typeToString(results.decode_type);
@@ -274,60 +593,239 @@ void IRManager::publishIRReceived(MQTTManager* mqttManager) {
                 doc["address"] = results.address;
                 doc["command"] = results.command;
                 
-                // 在Serial上顯示詳細值
-                Serial.printf("十六進制值: 0x%08X\n", results.value);
-                Serial.printf("十進制值: %u\n", results.value);
-                Serial.printf("位址: 0x%04X\n", results.address);
-                Serial.printf("指令: 0x%04X\n", results.command);
+                LOG_D("值: 0x%08X (%u) 位址: 0x%04X 指令: 0x%04X",
+                      (uint32_t)results.value, (uint32_t)results.value, results.address, results.command);
                 break;
             
             case decode_type_t::UNKNOWN:
             default:
-                // 對於未知編碼或原始數據，保存並顯示原始時序
-                Serial.println("未知協議，顯示原始時序數據:");
-                Serial.printf("原始數據長度: %d\n", results.rawlen - 1);
-                Serial.println("原始值: ");
+                // 對於未知編碼或原始數據，以IRTimingCodec編碼原始時序 (可直接作為raw命令的code重放)
+                LOG_I("未知協議，原始數據長度: %d", results.rawlen - 1);
                 
-                JsonArray rawData = doc.createNestedArray("raw");
-                // 限制原始數據大小以避免緩衝區溢出
-                int max_count = min((int)results.rawlen, 100);
-                for (int i = 1; i < max_count; i++) {
-                    unsigned int value = results.rawbuf[i] * RAWTICK;
-                    rawData.add(value);
-                    Serial.printf("%d ", value);
-                    if (i % 10 == 0) Serial.println(); // 每10個數值換行
+                static IRCommand captured;
+                static uint8_t encoded[IR_COMMAND_MAX_ENCODED];
+                static char codeText[(IR_COMMAND_MAX_ENCODED + 2) / 3 * 4 + 1];
+                captureCommand(captured);
+                size_t encodedLength = IRTimingCodec::encode(captured.raw, captured.rawLength, captured.khz,
+                                                             encoded, sizeof(encoded));
+                if (encodedLength > 0 && IRTimingCodec::toBase64(encoded, encodedLength, codeText, sizeof(codeText)) > 0) {
+                    doc["code"] = (const char*)codeText;
+                } else {
+                    // 長度種類超過字典上限 (雜訊多或很長的訊框) 時無法編碼，改以舊格式的整數陣列發布
+                    JsonArray rawData = doc.createNestedArray("raw");
+                    for (uint16_t i = 0; i < captured.rawLength; i++) {
+                        rawData.add(captured.raw[i]);
+                    }
                 }
-                Serial.println();
                 doc["rawlen"] = results.rawlen - 1;
+                
+#if AIOT_LOG_LEVEL >= AIOT_LOG_LEVEL_VERBOSE
+                // 原始時序只在VERBOSE等級編譯，每行10個數值 (限制數量以避免緩衝區溢出)
+                int max_count = min((int)results.rawlen, 100);
+                for (int i = 1; i < max_count; i += 10) {
+                    char line[64];
+                    size_t pos = 0;
+                    for (int j = i; j < max_count && j < i + 10; j++) {
+                        pos += snprintf(line + pos, sizeof(line) - pos, "%u ", results.rawbuf[j] * RAWTICK);
+                    }
+                    LOG_V("原始值: %s", line);
+                }
+#endif
                 break;
         }
         
-        // 顯示用於重放的代碼示例
-        Serial.println("\n用於重放的MQTT JSON指令:");
-        if (results.decode_type == decode_type_t::NEC) {
-            Serial.printf("{\n  \"command\": \"nec\",\n  \"value\": %u,\n  \"bits\": %d\n}\n", 
-                         results.value, results.bits);
-        } else if (results.decode_type == decode_type_t::SONY) {
-            Serial.printf("{\n  \"command\": \"sony\",\n  \"value\": %u,\n  \"bits\": %d\n}\n", 
-                         results.value, results.bits);
-        } else if (results.decode_type == decode_type_t::RC5) {
-            Serial.printf("{\n  \"command\": \"rc5\",\n  \"value\": %u,\n  \"bits\": %d\n}\n", 
-                         results.value, results.bits);
-        } else if (results.decode_type == decode_type_t::RC6) {
-            Serial.printf("{\n  \"command\": \"rc6\",\n  \"value\": %u,\n  \"bits\": %d\n}\n", 
-                         results.value, results.bits);
+        // 顯示用於重放的MQTT JSON指令
+        const char* replayCommand = NULL;
+        switch (results.decode_type) {
+            case decode_type_t::NEC: replayCommand = "nec"; break;
+            case decode_type_t::SONY: replayCommand = "sony"; break;
+            case decode_type_t::RC5: replayCommand = "rc5"; break;
+            case decode_type_t::RC6: replayCommand = "rc6"; break;
+            default: break;
         }
-        Serial.println("===============================================");
-          // 只有在MQTT連接時才發布
-        if (mqttManager && mqttManager->isConnected()) {
-            // 使用JSON發布
-            mqttManager->publishJson(irReceiveTopic, doc);
-            
-            Serial.printf("已發佈IR接收數據到主題: %s\n", irReceiveTopic);
+        if (replayCommand != NULL) {
+            LOG_D("重放指令: {\"command\":\"%s\",\"value\":%u,\"bits\":%d}",
+                  replayCommand, (uint32_t)results.value, results.bits);
+        }
+        
+        // 學習模式: 保存到碼庫，並在接收數據中附上編號
+        int32_t id = learning.id;
+        if (id >= 0 && codeLibrary != nullptr) {
+            learning.id = -1;
+            static IRCommand learned;
+            captureCommand(learned);
+            if (codeLibrary->store(id, learning.name, learned)) {
+                doc["learned"] = id;
+            } else {
+                codeLibrary->release(id);
+            }
+        }
+        
+        // 以QoS 1排入佇列，斷線期間也會保留到重新連線後送出
+        if (mqttManager) {
+            if (mqttManager->publishJson(irReceiveTopic, doc, false, 1)) {
+                LOG_D("已排入IR接收數據到主題: %s", irReceiveTopic);
+            }
+        }
+        
+        // 從訊框第一個邊緣到排入發布佇列的時間 (包含訊框長度與IRrecv的靜默逾時)
+        unsigned long frameStart = frameStartMicros;
+        if (frameStart != 0) {
+            rxLastLatencyMicros = micros() - frameStart;
+            if (rxLastLatencyMicros > rxMaxLatencyMicros) {
+                rxMaxLatencyMicros = rxLastLatencyMicros;
+            }
+        }
+        rxFrames++;
+        resetFrame();
+    }
+    
+    rxBusyMicros += micros() - start;
+    return received;
+}
+
+// 取出最新的學習請求並處理逾時
+void IRManager::updateLearning() {
+    // 連續的學習請求以最後一個為準 (碼庫的保留也已被取代)
+    IRLearnRequest request;
+    while (learnQueue.pop(request)) {
+        learning = request;
+    }
+    
+    if (learning.id >= 0 && (long)(millis() - learning.deadline) > 0) {
+        LOG_W("IR學習 %d 已逾時", (int)learning.id);
+        if (codeLibrary != nullptr) {
+            codeLibrary->release(learning.id);
+        }
+        learning.id = -1;
+    }
+}
+
+// 將接收到的訊框轉為可重放的命令 (可直接發射的協議保留編碼值，其餘保存原始時序)
+void IRManager::captureCommand(IRCommand& cmd) const {
+    cmd.value = (uint32_t)results.value;
+    cmd.bits = results.bits;
+    cmd.repeat = 0;
+    cmd.khz = 38;
+    cmd.rawLength = 0;
+    
+    switch (results.decode_type) {
+        case decode_type_t::NEC: cmd.type = IRCommandType::NEC; return;
+        case decode_type_t::SONY: cmd.type = IRCommandType::SONY; cmd.repeat = 2; return;
+        case decode_type_t::RC5: cmd.type = IRCommandType::RC5; return;
+        case decode_type_t::RC6: cmd.type = IRCommandType::RC6; return;
+        default: break;
+    }
+    
+    cmd.type = IRCommandType::RAW;
+    cmd.value = 0;
+    cmd.bits = 0;
+    for (uint16_t i = 1; i < results.rawlen && cmd.rawLength < IR_COMMAND_MAX_RAW; i++) {
+        uint32_t duration = (uint32_t)results.rawbuf[i] * RAWTICK;
+        cmd.raw[cmd.rawLength++] = duration > 0xFFFF ? 0xFFFF : duration;
+    }
+}
+
+// PCNT中斷: 訊框的第一個邊緣
+void IRAM_ATTR IRManager::onReceiveEdge(void* arg) {
+    IRManager* irManager = static_cast<IRManager*>(arg);
+    if (irManager->frameStartMicros == 0) {
+        irManager->frameStartMicros = micros();
+    }
+    
+    if (irManager->edgeDriven && irManager->irReceiverTaskHandle != NULL) {
+        BaseType_t woken = pdFALSE;
+        vTaskNotifyGiveFromISR(irManager->irReceiverTaskHandle, &woken);
+        portYIELD_FROM_ISR(woken);
+    }
+}
+
+// 以PCNT監看接收腳位的邊緣
+bool IRManager::beginEdgeInterrupt(int pin) {
+    pcnt_config_t config = {};
+    config.pulse_gpio_num = pin;
+    config.ctrl_gpio_num = PCNT_PIN_NOT_USED;
+    config.lctrl_mode = PCNT_MODE_KEEP;
+    config.hctrl_mode = PCNT_MODE_KEEP;
+    config.pos_mode = PCNT_COUNT_INC;
+    config.neg_mode = PCNT_COUNT_INC;
+    config.counter_h_lim = 32767;
+    config.counter_l_lim = 0;
+    config.unit = IR_PCNT_UNIT;
+    config.channel = PCNT_CHANNEL_0;
+    
+    if (pcnt_unit_config(&config) != ESP_OK) {
+        return false;
+    }
+    
+    // 濾掉短於約12us的突波 (APB 80MHz)，並在計數到1 (訊框第一個邊緣) 時中斷
+    pcnt_set_filter_value(IR_PCNT_UNIT, 1000);
+    pcnt_filter_enable(IR_PCNT_UNIT);
+    pcnt_set_event_value(IR_PCNT_UNIT, PCNT_EVT_THRES_0, 1);
+    pcnt_event_enable(IR_PCNT_UNIT, PCNT_EVT_THRES_0);
+    pcnt_counter_pause(IR_PCNT_UNIT);
+    pcnt_counter_clear(IR_PCNT_UNIT);
+    
+    esp_err_t err = pcnt_isr_service_install(0);
+    if (err != ESP_OK && err != ESP_ERR_INVALID_STATE) {
+        return false;
+    }
+    if (pcnt_isr_handler_add(IR_PCNT_UNIT, onReceiveEdge, this) != ESP_OK) {
+        return false;
+    }
+    
+    pcnt_intr_enable(IR_PCNT_UNIT);
+    pcnt_counter_resume(IR_PCNT_UNIT);
+    return true;
+}
+
+// 訊框處理完畢，準備偵測下一個訊框
+void IRManager::resetFrame() {
+    frameStartMicros = 0;
+    pcnt_counter_clear(IR_PCNT_UNIT);
+}
+
+// 等待目前訊框結束並發布
+bool IRManager::serviceFrame(MQTTManager* mqttManager) {
+    // 捕獲最早在最後一個邊緣之後IR_RECV_TIMEOUT_MS才完成，先休眠這段時間
+    vTaskDelay(pdMS_TO_TICKS(IR_RECV_TIMEOUT_MS));
+    
+    int16_t lastCount = -1;
+    unsigned long quietSince = millis();
+    while (true) {
+        if (publishIRReceived(mqttManager)) {
+            return true;
+        }
+        
+        // 邊緣停止超過兩倍逾時仍沒有訊框，代表是雜訊 (IRrecv已自行丟棄)
+        int16_t count = 0;
+        pcnt_get_counter_value(IR_PCNT_UNIT, &count);
+        if (count != lastCount) {
+            lastCount = count;
+            quietSince = millis();
+        } else if (millis() - quietSince >= IR_RECV_TIMEOUT_MS * 2) {
+            resetFrame();
+            return false;
         }
+        
+        vTaskDelay(pdMS_TO_TICKS(IR_FRAME_POLL_MS));
     }
 }
 
+// 獲取IR接收統計
+IRReceiveStats IRManager::getReceiveStats() const {
+    IRReceiveStats stats;
+    stats.edgeDriven = edgeDriven;
+    stats.frames = rxFrames;
+    stats.wakeups = rxWakeups;
+    stats.spurious = rxSpurious;
+    stats.decodeCalls = rxDecodeCalls;
+    stats.busyMicros = rxBusyMicros;
+    stats.lastLatencyMicros = rxLastLatencyMicros;
+    stats.maxLatencyMicros = rxMaxLatencyMicros;
+    return stats;
+}
+
 // IR接收任務（靜態方法，用於FreeRTOS任務）
 void IRManager::irReceiverTask(void* parameter) {
     // 獲取傳入參數
@@ -344,21 +842,39 @@ void IRManager::irReceiverTask(void* parameter) {
     // 釋放參數結構體內存
     delete params;
     
-    Serial.println("IR接收任務已啟動");    // 任務主循環
+    // 任務主循環
     while (true) {
-        // 檢查並發佈接收到的IR數據
-        irManager->publishIRReceived(mqttManager);
+        if (irManager->edgeDriven) {
+            // 沒有IR信號時一直阻塞，訊框的第一個邊緣才會喚醒；逾時只是漏接通知時的保險
+            if (ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(IR_IDLE_CHECK_MS)) > 0) {
+                irManager->rxWakeups++;
+                if (!irManager->serviceFrame(mqttManager)) {
+                    irManager->rxSpurious++;
+                }
+            } else {
+                irManager->publishIRReceived(mqttManager);
+            }
+            continue;
+        }
         
-        // 使用更短的延遲，提高IR信號捕獲的靈敏度
-        vTaskDelay(10 / portTICK_PERIOD_MS);
+        // 定時輪詢
+        irManager->rxWakeups++;
+        if (!irManager->publishIRReceived(mqttManager)) {
+            // 雜訊觸發的邊緣不會產生訊框，過久未完成就重新計時
+            unsigned long frameStart = irManager->frameStartMicros;
+            if (frameStart != 0 && micros() - frameStart > 500000) {
+                irManager->resetFrame();
+            }
+        }
+        vTaskDelay(pdMS_TO_TICKS(IR_POLL_INTERVAL_MS));
     }
 }
 
 // 啟動IR接收任務
-void IRManager::startReceiverTask(MQTTManager* mqttManager) {
+void IRManager::startReceiverTask(MQTTManager* mqttManager, bool edgeWake) {
     // 確保接收器已初始化
     if (!receiverInitialized) {
-        Serial.println("IR接收器未初始化，無法啟動接收任務");
+        LOG_W("IR接收器未初始化，無法啟動接收任務");
         return;
     }
     
@@ -384,7 +900,14 @@ void IRManager::startReceiverTask(MQTTManager* mqttManager) {
         0                       // 在核心0上執行
     );
     
-    Serial.println("IR接收任務已啟動");
+    // 任務建立後才啟用中斷；輪詢模式仍以邊緣時間量測延遲
+    bool edgeReady = beginEdgeInterrupt(receiverPin);
+    if (!edgeReady) {
+        LOG_W("無法設置IR邊緣中斷，改為定時輪詢");
+    }
+    edgeDriven = edgeWake && edgeReady;
+    
+    LOG_I("IR接收任務已啟動 (%s)", edgeDriven ? "邊緣中斷喚醒" : "定時輪詢");
 }
 
 // 將解碼類型轉換為字符串的靜態方法
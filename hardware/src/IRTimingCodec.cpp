@@ -0,0 +1,315 @@
+#include "IRTimingCodec.h"
+
+static const char BASE64_ALPHABET[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+// 寫入varint，空間不足時返回false
+static bool putVarint(uint8_t* out, size_t outSize, size_t& pos, uint32_t value) {
+    do {
+        if (pos >= outSize) {
+            return false;
+        }
+        uint8_t byte = value & 0x7F;
+        value >>= 7;
+        out[pos++] = value != 0 ? (byte | 0x80) : byte;
+    } while (value != 0);
+    return true;
+}
+
+// 讀取varint (最多5個位元組)，資料不完整時返回false
+static bool getVarint(const uint8_t* data, size_t length, size_t& pos, uint32_t& value) {
+    value = 0;
+    for (uint8_t shift = 0; shift < 35; shift += 7) {
+        if (pos >= length) {
+            return false;
+        }
+        uint8_t byte = data[pos++];
+        value |= (uint32_t)(byte & 0x7F) << shift;
+        if ((byte & 0x80) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// 表示0..maxValue需要的位元數
+static uint8_t bitsFor(uint32_t maxValue) {
+    uint8_t bits = 0;
+    while (maxValue >> bits) {
+        bits++;
+    }
+    return bits;
+}
+
+// 微秒轉為載波週期數 (四捨五入)
+static uint32_t toTicks(uint16_t micros, uint16_t khz) {
+    return ((uint32_t)micros * khz + 500) / 1000;
+}
+
+// 載波週期數轉為微秒 (四捨五入)
+static uint32_t toMicros(uint32_t ticks, uint16_t khz) {
+    return (ticks * 1000 + khz / 2) / khz;
+}
+
+// 同一類 (標記或間隔) 中最接近的字典索引，沒有同類長度時返回dictSize
+static uint8_t nearest(const uint32_t* dict, const bool* isMark, uint8_t dictSize, uint32_t ticks, bool mark) {
+    uint8_t best = dictSize;
+    uint32_t bestDistance = UINT32_MAX;
+    for (uint8_t i = 0; i < dictSize; i++) {
+        if (isMark[i] != mark) {
+            continue;
+        }
+        uint32_t distance = dict[i] > ticks ? dict[i] - ticks : ticks - dict[i];
+        if (distance < bestDistance) {
+            bestDistance = distance;
+            best = i;
+        }
+    }
+    return best;
+}
+
+size_t IRTimingCodec::maxEncodedSize(size_t count) {
+    // 標頭 + 時序數量 + 字典 + 每個配對最多3個位元組
+    return 4 + 5 + MAX_DICT * 3 + ((count + 1) / 2) * 3;
+}
+
+size_t IRTimingCodec::encode(const uint16_t* timings, size_t count, uint16_t khz, uint8_t* out, size_t outSize) {
+    if (timings == nullptr || count == 0 || khz == 0 || khz > 255 || out == nullptr) {
+        return 0;
+    }
+
+    // 標記與間隔分開分群 (接收器輸出的標記通常偏長、間隔偏短)，
+    // 依出現順序與目前群組平均相差12.5%以內的合併，字典值為群組平均
+    uint32_t dict[MAX_DICT];
+    bool isMark[MAX_DICT];
+    uint32_t sums[MAX_DICT];
+    uint16_t members[MAX_DICT];
+    uint8_t dictSize = 0;
+    for (size_t i = 0; i < count; i++) {
+        uint32_t ticks = toTicks(timings[i], khz);
+        bool mark = (i & 1) == 0;
+        uint8_t group = nearest(dict, isMark, dictSize, ticks, mark);
+        if (group < dictSize) {
+            uint32_t tolerance = dict[group] / 8 > 1 ? dict[group] / 8 : 1;
+            uint32_t distance = dict[group] > ticks ? dict[group] - ticks : ticks - dict[group];
+            if (distance > tolerance) {
+                group = dictSize;
+            }
+        }
+        if (group == dictSize) {
+            if (dictSize >= MAX_DICT) {
+                return 0;
+            }
+            isMark[dictSize] = mark;
+            sums[dictSize] = 0;
+            members[dictSize] = 0;
+            dictSize++;
+        }
+        sums[group] += ticks;
+        members[group]++;
+        dict[group] = (sums[group] + members[group] / 2) / members[group];
+    }
+
+    // 以最終的平均重新分配一次，減少依出現順序分群造成的偏差
+    for (uint8_t j = 0; j < dictSize; j++) {
+        sums[j] = 0;
+        members[j] = 0;
+    }
+    for (size_t i = 0; i < count; i++) {
+        uint32_t ticks = toTicks(timings[i], khz);
+        uint8_t group = nearest(dict, isMark, dictSize, ticks, (i & 1) == 0);
+        sums[group] += ticks;
+        members[group]++;
+    }
+    for (uint8_t j = 0; j < dictSize; j++) {
+        if (members[j] > 0) {
+            dict[j] = (sums[j] + members[j] / 2) / members[j];
+        }
+    }
+
+    // 字典先列出標記再列出間隔，配對只需要標記數 x 間隔數個符號
+    uint8_t position[MAX_DICT];
+    uint8_t markCount = 0;
+    uint8_t spaceCount = 0;
+    for (uint8_t j = 0; j < dictSize; j++) {
+        position[j] = isMark[j] ? markCount++ : spaceCount++;
+    }
+
+    size_t pos = 0;
+    if (outSize < 2) {
+        return 0;
+    }
+    out[pos++] = VERSION;
+    out[pos++] = (uint8_t)khz;
+    if (!putVarint(out, outSize, pos, count) || pos + 2 > outSize) {
+        return 0;
+    }
+    out[pos++] = markCount;
+    out[pos++] = spaceCount;
+    for (uint8_t kind = 0; kind < 2; kind++) {
+        for (uint8_t j = 0; j < dictSize; j++) {
+            if (isMark[j] == (kind == 0) && !putVarint(out, outSize, pos, dict[j])) {
+                return 0;
+            }
+        }
+    }
+
+    // 標記/間隔配對，連續相同的配對合併為一個游程
+    uint32_t spaces = spaceCount > 0 ? spaceCount : 1;
+    uint8_t symbolBits = bitsFor((uint32_t)markCount * spaces - 1);
+    uint32_t runSymbol = 0;
+    uint32_t runLength = 0;
+    for (size_t i = 0; i < count; i += 2) {
+        uint32_t mark = position[nearest(dict, isMark, dictSize, toTicks(timings[i], khz), true)];
+        // 時序數量為奇數時最後一個間隔不存在，以索引0補位，解碼時捨棄
+        uint32_t space = i + 1 < count ? position[nearest(dict, isMark, dictSize, toTicks(timings[i + 1], khz), false)] : 0;
+        uint32_t symbol = mark * spaces + space;
+
+        if (runLength > 0 && symbol == runSymbol) {
+            runLength++;
+            continue;
+        }
+        if (runLength > 0 && !putVarint(out, outSize, pos, ((runLength - 1) << symbolBits) | runSymbol)) {
+            return 0;
+        }
+        runSymbol = symbol;
+        runLength = 1;
+    }
+    if (!putVarint(out, outSize, pos, ((runLength - 1) << symbolBits) | runSymbol)) {
+        return 0;
+    }
+    return pos;
+}
+
+size_t IRTimingCodec::decode(const uint8_t* data, size_t length, uint16_t* timings, size_t maxCount, uint16_t* khz) {
+    if (data == nullptr || timings == nullptr || length < 4 || data[0] != VERSION || data[1] == 0) {
+        return 0;
+    }
+
+    uint16_t carrier = data[1];
+    size_t pos = 2;
+    uint32_t count = 0;
+    if (!getVarint(data, length, pos, count) || count == 0 || count > maxCount || pos + 2 > length) {
+        return 0;
+    }
+
+    uint8_t markCount = data[pos++];
+    uint8_t spaceCount = data[pos++];
+    if (markCount == 0 || (uint16_t)markCount + spaceCount > MAX_DICT || (spaceCount == 0 && count > 1)) {
+        return 0;
+    }
+    uint8_t dictSize = markCount + spaceCount;
+    uint16_t dict[MAX_DICT];
+    for (uint8_t j = 0; j < dictSize; j++) {
+        uint32_t ticks = 0;
+        if (!getVarint(data, length, pos, ticks)) {
+            return 0;
+        }
+        uint32_t micros = toMicros(ticks, carrier);
+        dict[j] = micros > 0xFFFF ? 0xFFFF : micros;
+    }
+
+    uint32_t spaces = spaceCount > 0 ? spaceCount : 1;
+    uint8_t symbolBits = bitsFor((uint32_t)markCount * spaces - 1);
+    uint32_t symbolMask = ((uint32_t)1 << symbolBits) - 1;
+    size_t produced = 0;
+    while (produced < count) {
+        uint32_t token = 0;
+        if (!getVarint(data, length, pos, token)) {
+            return 0;
+        }
+        uint32_t symbol = token & symbolMask;
+        uint32_t run = (token >> symbolBits) + 1;
+        if (symbol >= (uint32_t)markCount * spaces || run > (count - produced + 1) / 2) {
+            return 0;
+        }
+
+        uint16_t mark = dict[symbol / spaces];
+        uint16_t space = spaceCount > 0 ? dict[markCount + symbol % spaces] : 0;
+        for (uint32_t r = 0; r < run; r++) {
+            timings[produced++] = mark;
+            if (produced < count) {
+                timings[produced++] = space;
+            }
+        }
+    }
+
+    if (khz != nullptr) {
+        *khz = carrier;
+    }
+    return count;
+}
+
+size_t IRTimingCodec::base64Length(size_t length) {
+    return (length + 2) / 3 * 4;
+}
+
+size_t IRTimingCodec::toBase64(const uint8_t* data, size_t length, char* out, size_t outSize) {
+    size_t textLength = base64Length(length);
+    if (out == nullptr || textLength + 1 > outSize) {
+        return 0;
+    }
+
+    size_t pos = 0;
+    for (size_t i = 0; i < length; i += 3) {
+        uint32_t block = (uint32_t)data[i] << 16;
+        if (i + 1 < length) {
+            block |= (uint32_t)data[i + 1] << 8;
+        }
+        if (i + 2 < length) {
+            block |= data[i + 2];
+        }
+        out[pos++] = BASE64_ALPHABET[(block >> 18) & 0x3F];
+        out[pos++] = BASE64_ALPHABET[(block >> 12) & 0x3F];
+        out[pos++] = i + 1 < length ? BASE64_ALPHABET[(block >> 6) & 0x3F] : '=';
+        out[pos++] = i + 2 < length ? BASE64_ALPHABET[block & 0x3F] : '=';
+    }
+    out[pos] = '\0';
+    return pos;
+}
+
+// base64字元的值，無效字元返回-1
+static int base64Value(char c) {
+    if (c >= 'A' && c <= 'Z') return c - 'A';
+    if (c >= 'a' && c <= 'z') return c - 'a' + 26;
+    if (c >= '0' && c <= '9') return c - '0' + 52;
+    if (c == '+') return 62;
+    if (c == '/') return 63;
+    return -1;
+}
+
+size_t IRTimingCodec::fromBase64(const char* text, size_t length, uint8_t* out, size_t outSize) {
+    if (text == nullptr || out == nullptr || length == 0 || length % 4 != 0) {
+        return 0;
+    }
+
+    size_t pos = 0;
+    for (size_t i = 0; i < length; i += 4) {
+        bool last = i + 4 == length;
+        uint8_t padding = 0;
+        uint32_t block = 0;
+        for (size_t j = 0; j < 4; j++) {
+            char c = text[i + j];
+            int value = 0;
+            // 補位只能出現在最後一組的最後兩個字元
+            if (c == '=' && last && j >= 2 && (j == 3 || text[i + 3] == '=')) {
+                padding++;
+            } else if (padding > 0 || (value = base64Value(c)) < 0) {
+                return 0;
+            }
+            block = (block << 6) | (uint32_t)value;
+        }
+
+        size_t bytes = 3 - padding;
+        if (pos + bytes > outSize) {
+            return 0;
+        }
+        out[pos++] = (block >> 16) & 0xFF;
+        if (bytes > 1) {
+            out[pos++] = (block >> 8) & 0xFF;
+        }
+        if (bytes > 2) {
+            out[pos++] = block & 0xFF;
+        }
+    }
+    return pos;
+}
@@ -0,0 +1,67 @@
+#include "LatencyHistogram.h"
+
+LatencyHistogram::LatencyHistogram(const uint32_t* bounds, uint8_t boundCount)
+    : _bounds(bounds),
+      _bucketCount(boundCount + 1 < MAX_BUCKETS ? boundCount + 1 : MAX_BUCKETS) {
+    reset();
+}
+
+void LatencyHistogram::record(uint32_t value) {
+    uint8_t bucket = 0;
+    while (bucket < _bucketCount - 1 && value > _bounds[bucket]) {
+        bucket++;
+    }
+
+    _buckets[bucket]++;
+    _count++;
+    _sum += value;
+    if (value > _max) {
+        _max = value;
+    }
+}
+
+void LatencyHistogram::reset() {
+    memset(_buckets, 0, sizeof(_buckets));
+    _count = 0;
+    _max = 0;
+    _sum = 0;
+}
+
+uint32_t LatencyHistogram::getCount() const {
+    return _count;
+}
+
+uint32_t LatencyHistogram::getMax() const {
+    return _max;
+}
+
+uint32_t LatencyHistogram::getMean() const {
+    return _count > 0 ? (uint32_t)(_sum / _count) : 0;
+}
+
+uint32_t LatencyHistogram::percentile(uint8_t percent) const {
+    if (_count == 0) {
+        return 0;
+    }
+
+    uint32_t target = ((uint64_t)_count * percent + 99) / 100;
+    uint32_t seen = 0;
+    for (uint8_t i = 0; i < _bucketCount - 1; i++) {
+        seen += _buckets[i];
+        if (seen >= target) {
+            return _bounds[i] < _max ? _bounds[i] : _max;
+        }
+    }
+    return _max;
+}
+
+void LatencyHistogram::encode(JsonObject obj) const {
+    obj["n"] = _count;
+    obj["avg"] = getMean();
+    obj["max"] = _max;
+
+    JsonArray buckets = obj.createNestedArray("b");
+    for (uint8_t i = 0; i < _bucketCount; i++) {
+        buckets.add(_buckets[i]);
+    }
+}
@@ -0,0 +1,347 @@
+#include "Logger.h"
+
+// 環形佇列容量 (必須是2的次方)
+static const size_t LOG_QUEUE_SIZE = 32;
+static const size_t LOG_QUEUE_MASK = LOG_QUEUE_SIZE - 1;
+
+// 每個位置以序號標記狀態: 序號等於寫入位置代表可寫入，等於寫入位置+1代表可讀取
+// ESP32上每個位置連同序號剛好128位元組，佇列共4 KB
+struct LogSlot {
+    std::atomic<size_t> sequence;
+    LogRecord record;
+};
+
+static LogSlot logSlots[LOG_QUEUE_SIZE];
+static std::atomic<size_t> enqueuePos(0);
+static size_t dequeuePos = 0;               // 只有輸出任務讀取
+static std::atomic<bool> slotsReady(false);
+static std::atomic<uint32_t> droppedCount(0);
+
+static TaskHandle_t drainTaskHandle = NULL;
+static LogSink logSink;
+static uint8_t sinkLevel = AIOT_LOG_LEVEL_WARN;
+static uint8_t sinkBurst = 5;
+static unsigned long sinkRefillMs = 2000;
+static uint8_t sinkTokens = 5;
+static unsigned long sinkLastRefill = 0;
+static uint32_t sinkThrottledCount = 0;
+
+static const char LEVEL_CHARS[] = {'N', 'E', 'W', 'I', 'D', 'V'};
+
+// 初始化各位置的序號 (第一次使用時執行，讓begin()之前的日誌也能寫入)
+static void initSlots() {
+    if (slotsReady.load(std::memory_order_acquire)) {
+        return;
+    }
+
+    static std::atomic<bool> initializing(false);
+    bool expected = false;
+    if (initializing.compare_exchange_strong(expected, true)) {
+        for (size_t i = 0; i < LOG_QUEUE_SIZE; i++) {
+            logSlots[i].sequence.store(i, std::memory_order_relaxed);
+        }
+        slotsReady.store(true, std::memory_order_release);
+    } else {
+        while (!slotsReady.load(std::memory_order_acquire)) {
+        }
+    }
+}
+
+void Logger::begin(UBaseType_t priority, BaseType_t core) {
+    initSlots();
+
+    if (drainTaskHandle != NULL) {
+        return;
+    }
+
+    xTaskCreatePinnedToCore(
+        drainTask,          // 任務函數
+        "LogTask",          // 任務名稱
+        3072,               // 堆棧大小
+        NULL,               // 任務參數
+        priority,           // 任務優先級
+        &drainTaskHandle,   // 任務句柄指針
+        core                // 執行的核心
+    );
+}
+
+void Logger::setSink(LogSink sink, uint8_t minLevel, uint8_t burst, unsigned long refillMs) {
+    logSink = sink;
+    sinkLevel = minLevel;
+    sinkBurst = burst > 0 ? burst : 1;
+    sinkRefillMs = refillMs;
+    sinkTokens = sinkBurst;
+    sinkLastRefill = millis();
+}
+
+uint32_t Logger::getDroppedCount() {
+    return droppedCount.load(std::memory_order_relaxed);
+}
+
+uint32_t Logger::getSinkThrottledCount() {
+    return sinkThrottledCount;
+}
+
+LogRecord* Logger::claim() {
+    initSlots();
+
+    size_t pos = enqueuePos.load(std::memory_order_relaxed);
+    while (true) {
+        LogSlot& slot = logSlots[pos & LOG_QUEUE_MASK];
+        size_t sequence = slot.sequence.load(std::memory_order_acquire);
+        intptr_t diff = (intptr_t)sequence - (intptr_t)pos;
+
+        if (diff == 0) {
+            if (enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                return &slot.record;
+            }
+        } else if (diff < 0) {
+            // 佇列已滿
+            droppedCount.fetch_add(1, std::memory_order_relaxed);
+            return NULL;
+        } else {
+            pos = enqueuePos.load(std::memory_order_relaxed);
+        }
+    }
+}
+
+void Logger::commit(LogRecord* record) {
+    LogSlot* slot = reinterpret_cast<LogSlot*>(reinterpret_cast<uint8_t*>(record) - offsetof(LogSlot, record));
+    size_t pos = slot->sequence.load(std::memory_order_relaxed);
+    slot->sequence.store(pos + 1, std::memory_order_release);
+}
+
+void Logger::put(LogRecord& record, uint8_t type, const void* data, size_t size) {
+    if (record.length + 1 + size > sizeof(record.args)) {
+        record.truncated = 1;
+        return;
+    }
+
+    record.args[record.length++] = type;
+    memcpy(record.args + record.length, data, size);
+    record.length += size;
+}
+
+void Logger::pack(LogRecord& record, const char* value) {
+    if (value == NULL) {
+        value = "(null)";
+    }
+
+    // 至少需要類型標記與結尾的NUL
+    size_t available = sizeof(record.args) - record.length;
+    if (available < 2) {
+        record.truncated = 1;
+        return;
+    }
+
+    size_t length = strlen(value);
+    if (length > available - 2) {
+        length = available - 2;
+        record.truncated = 1;
+    }
+
+    record.args[record.length++] = ARG_STRING;
+    memcpy(record.args + record.length, value, length);
+    record.length += length;
+    record.args[record.length++] = '\0';
+}
+
+bool Logger::drainOne(char* line, size_t size, uint8_t* level) {
+    LogSlot& slot = logSlots[dequeuePos & LOG_QUEUE_MASK];
+    size_t sequence = slot.sequence.load(std::memory_order_acquire);
+    if (sequence != dequeuePos + 1) {
+        return false;
+    }
+
+    render(slot.record, line, size);
+    *level = slot.record.level;
+
+    // 釋放位置給下一輪的生產者
+    slot.sequence.store(dequeuePos + LOG_QUEUE_SIZE, std::memory_order_release);
+    dequeuePos++;
+    return true;
+}
+
+void Logger::drainTask(void* parameter) {
+    static char line[256];
+    uint32_t reportedDrops = 0;
+
+    while (true) {
+        uint8_t level;
+        while (drainOne(line, sizeof(line), &level)) {
+            Serial.println(line);
+
+            if (!logSink || level > sinkLevel) {
+                continue;
+            }
+
+            // 令牌桶限速，避免日誌佔滿MQTT頻寬
+            unsigned long now = millis();
+            if (sinkRefillMs > 0 && now - sinkLastRefill >= sinkRefillMs) {
+                unsigned long refill = (now - sinkLastRefill) / sinkRefillMs;
+                sinkTokens = (uint8_t)min((unsigned long)sinkBurst, sinkTokens + refill);
+                sinkLastRefill += refill * sinkRefillMs;
+            }
+
+            if (sinkTokens > 0 && logSink(level, line)) {
+                sinkTokens--;
+            } else {
+                sinkThrottledCount++;
+            }
+        }
+
+        uint32_t drops = droppedCount.load(std::memory_order_relaxed);
+        if (drops != reportedDrops) {
+            Serial.printf("[W] 日誌佇列已滿，丟棄 %u 筆\n", (unsigned)(drops - reportedDrops));
+            reportedDrops = drops;
+        }
+
+        vTaskDelay(pdMS_TO_TICKS(20));
+    }
+}
+
+// 依參數類型調整轉換字元，格式字串與參數不符時也不會讀錯記憶體
+static char conversionFor(uint8_t type, char conversion) {
+    bool isFloat = strchr("fFeEgGaA", conversion) != NULL;
+
+    switch (type) {
+        case Logger::ARG_DOUBLE:
+            return isFloat ? conversion : 'g';
+        case Logger::ARG_STRING:
+            return 's';
+        case Logger::ARG_POINTER:
+            return 'p';
+        default:
+            if (isFloat || conversion == 's' || conversion == 'p') {
+                return type == Logger::ARG_INT || type == Logger::ARG_INT64 ? 'd' : 'u';
+            }
+            return conversion;
+    }
+}
+
+size_t Logger::render(const LogRecord& record, char* out, size_t size) {
+    uint8_t levelIndex = record.level < sizeof(LEVEL_CHARS) ? record.level : 0;
+    int written = snprintf(out, size, "[%c][%lu] ", LEVEL_CHARS[levelIndex], (unsigned long)record.timestamp);
+    size_t pos = written > 0 ? (size_t)written : 0;
+    if (pos >= size) {
+        pos = size - 1;
+    }
+
+    const char* f = record.format;
+    size_t argPos = 0;
+
+    while (*f != '\0' && pos + 1 < size) {
+        if (*f != '%') {
+            out[pos++] = *f++;
+            continue;
+        }
+
+        if (f[1] == '%') {
+            out[pos++] = '%';
+            f += 2;
+            continue;
+        }
+
+        // 複製旗標、寬度與精度，略過長度修飾字元，再依實際參數類型補上
+        char spec[16];
+        size_t specLength = 0;
+        spec[specLength++] = *f++;
+        while (*f != '\0' && strchr("-+ #0123456789.", *f) != NULL && specLength < sizeof(spec) - 4) {
+            spec[specLength++] = *f++;
+        }
+        while (*f != '\0' && strchr("hlLqjzt", *f) != NULL) {
+            f++;
+        }
+        if (*f == '\0') {
+            break;
+        }
+        char conversion = *f++;
+
+        if (argPos >= record.length) {
+            continue;
+        }
+
+        uint8_t type = record.args[argPos++];
+        const uint8_t* value = record.args + argPos;
+        char converted = conversionFor(type, conversion);
+        if (type == ARG_INT64 || type == ARG_UINT64) {
+            spec[specLength++] = 'l';
+            spec[specLength++] = 'l';
+        }
+        spec[specLength++] = converted;
+        spec[specLength] = '\0';
+
+        size_t remaining = size - pos;
+        int n = 0;
+        switch (type) {
+            case ARG_INT: {
+                int32_t v;
+                memcpy(&v, value, sizeof(v));
+                argPos += sizeof(v);
+                n = conversion == 'c' ? snprintf(out + pos, remaining, "%c", (char)v)
+                                      : snprintf(out + pos, remaining, spec, (int)v);
+                break;
+            }
+            case ARG_UINT: {
+                uint32_t v;
+                memcpy(&v, value, sizeof(v));
+                argPos += sizeof(v);
+                n = snprintf(out + pos, remaining, spec, (unsigned int)v);
+                break;
+            }
+            case ARG_INT64: {
+                int64_t v;
+                memcpy(&v, value, sizeof(v));
+                argPos += sizeof(v);
+                n = snprintf(out + pos, remaining, spec, (long long)v);
+                break;
+            }
+            case ARG_UINT64: {
+                uint64_t v;
+                memcpy(&v, value, sizeof(v));
+                argPos += sizeof(v);
+                n = snprintf(out + pos, remaining, spec, (unsigned long long)v);
+                break;
+            }
+            case ARG_DOUBLE: {
+                double v;
+                memcpy(&v, value, sizeof(v));
+                argPos += sizeof(v);
+                n = snprintf(out + pos, remaining, spec, v);
+                break;
+            }
+            case ARG_STRING: {
+                const char* v = (const char*)value;
+                argPos += strlen(v) + 1;
+                n = snprintf(out + pos, remaining, spec, v);
+                break;
+            }
+            case ARG_POINTER: {
+                const void* v;
+                memcpy(&v, value, sizeof(v));
+                argPos += sizeof(v);
+                n = snprintf(out + pos, remaining, spec, v);
+                break;
+            }
+            default:
+                // 無法辨識的類型，停止解析其餘參數
+                argPos = record.length;
+                break;
+        }
+
+        if (n > 0) {
+            pos += (size_t)n < remaining ? (size_t)n : remaining - 1;
+        }
+    }
+
+    // 去掉結尾換行，輸出時由println補上
+    while (pos > 0 && out[pos - 1] == '\n') {
+        pos--;
+    }
+    if (record.truncated && pos + 4 < size) {
+        memcpy(out + pos, " ...", 4);
+        pos += 4;
+    }
+    out[pos] = '\0';
+    return pos;
+}
@@ -1,10 +1,20 @@
 #include "MQTTManager.h"
+#include "MqttPacket.h"
+#include "Logger.h"
+#include <time.h>
+#include <limits.h>
+#include <lwip/sockets.h>
+#include <esp_vfs_eventfd.h>
+
+// 遺囑與在線狀態主題
+static const char* STATUS_TOPIC = "esp32/status";
+
+// 定址命令主題的前綴 (與遙測的基本主題分開)
+static const char* COMMAND_TOPIC = "esp32/cmd";
 
 // 建構函數
 MQTTManager::MQTTManager(
-    WiFiClient* wifiClientPtr, 
     WiFiManager* wifiManagerPtr,
-    SemaphoreHandle_t* mutexPtr,
     const char* server,
     int port,
     const char* baseTopic,
@@ -12,23 +22,68 @@ MQTTManager::MQTTManager(
     long reconnectInterval,
     long publishInterval,
     long blinkInterval
-) : wifiClient(wifiClientPtr),
-    wifiManager(wifiManagerPtr),
-    mqttServer(server),
-    mqttPort(port),
-    mqttTopic(baseTopic),
-    clientIdPrefix(clientPrefix),
-    mutex(mutexPtr),
+) : wifiManager(wifiManagerPtr),
     lastMqttReconnectAttempt(0),
+    reconnectPolicy(reconnectInterval, 60000),
+    reconnectDelay(0),
     lastMqttPublish(0),
-    mqttReconnectInterval(reconnectInterval),
     mqttPublishInterval(publishInterval),
-    mqttIconBlinkInterval(blinkInterval),
     isMqttConnected(false),
     isMqttTransmitting(false),
-    mqttIconBlinkMillis(0) {
+    mqttIconBlinkMillis(0),
+    mqttIconBlinkInterval(blinkInterval),
+    connectStartedMillis(0),
+    probeState(MqttConnectState::IDLE),
+    probeStateSince(0),
+    mqttTopic(baseTopic),
+    clientIdPrefix(clientPrefix),
+    connectState(MqttConnectState::IDLE),
+    connectStateSince(0),
+    dnsTimeout(5000),
+    tcpTimeout(5000),
+    connackTimeout(5000),
+    persistentSession(false),
+    subscriptionQos(0),
+    subscribePacketId(0),
+    restoredSubscriptions(0),
+    lastLoopMicros(0),
+    maxLoopMicros(0),
+    eventFd(-1),
+    wakeupCount(0),
+    busyMicros(0),
+    socketReadyMicros(0),
+    lastInboundLatencyMicros(0),
+    maxInboundLatencyMicros(0),
+    disconnectedSince(0),
+    diagInterval(60000),
+    lastDiagPublish(0),
+    telemetryBuffer(nullptr),
+    replayBatchSize(5),
+    replayInterval(1000),
+    lastReplay(0),
+    partialSampleCount(0),
+    templateEnabled(false),
+    templatePublishes(0),
+    shadowEnabled(false),
+    lastShadowFull(0),
+    encodingRuleCount(0),
+    defaultEncoding(PayloadEncoding::JSON),
+    scopedRouteCount(0) {
     
-    mqttClient = new PubSubClient(*wifiClientPtr);
+    mqttClient = new PubSubClient(link);
+    // PubSubClient預設256位元組，帶原始時序的IR命令會在到達IRManager前被丟棄
+    mqttClient->setBufferSize(Mqtt5Client::BUFFER_SIZE);
+    mqtt5Client = nullptr;
+    tls = nullptr;
+    protocolVersion = MQTT_VERSION_3_1_1;
+    sessionExpiry = 0;
+    link.setPacketListener(handlePacket, this);
+    memset(&topics, 0, sizeof(topics));
+    clientId[0] = '\0';
+    
+    if (!brokers.add(server, port)) {
+        LOG_E("MQTT伺服器地址過長: %s", server);
+    }
 }
 
 // 析構函數
@@ -39,86 +94,427 @@ MQTTManager::~MQTTManager() {
         }
         delete mqttClient;
     }
+    
+    if (mqtt5Client) {
+        mqtt5Client->disconnect();
+        delete mqtt5Client;
+    }
+    
+    if (tls) {
+        link.setTls(nullptr);
+        delete tls;
+    }
 }
 
 // 初始化MQTT服務
 void MQTTManager::begin(const String& deviceIdentifier) {
     deviceId = deviceIdentifier;
+    rebuildTopicTable();
+    
+    // 基本命令主題 (沒有處理函數，交給使用者回調函數)
+    subscribe("esp32/commands");
+    
+    // 以裝置ID作為重連抖動的亂數種子，避免裝置群同步重連
+    reconnectPolicy.seed(deviceId.c_str());
     
-    mqttClient->setServer(mqttServer, mqttPort);
+    // 建立喚醒用的eventfd (VFS已註冊時會返回ESP_ERR_INVALID_STATE，可忽略)
+    if (eventFd < 0) {
+        esp_vfs_eventfd_config_t eventfdConfig = ESP_VFS_EVENTD_CONFIG_DEFAULT();
+        esp_err_t err = esp_vfs_eventfd_register(&eventfdConfig);
+        if (err == ESP_OK || err == ESP_ERR_INVALID_STATE) {
+            eventFd = eventfd(0, 0);
+        }
+        if (eventFd < 0) {
+            LOG_W("無法建立eventfd，MQTT任務改為定時輪詢");
+        }
+    }
+    
+    mqttClient->setServer(brokers.current().host, brokers.current().port);
+    mqttClient->setKeepAlive(KEEPALIVE_SECONDS);
     mqttClient->setCallback([this](char* topic, byte* payload, unsigned int length) {
         handleCallback(topic, payload, length, this);
     });
     
+    if (mqtt5Client) {
+        mqtt5Client->setKeepAlive(KEEPALIVE_SECONDS);
+        mqtt5Client->setCallback([this](char* topic, uint8_t* payload, unsigned int length) {
+            handleCallback(topic, payload, length, this);
+        });
+    }
+    
     connect();
     
-    Serial.println("MQTT管理器已初始化");
+    LOG_I("MQTT管理器已初始化");
+}
+
+// 重建主題表
+void MQTTManager::rebuildTopicTable() {
+    const char* roomId = wifiManager->getRoomIDCStr();
+    
+    // 裝置主題改變時，先取消舊主題的訂閱與處理函數
+    if (topics.deviceTopic[0] != '\0') {
+        off(topics.encodingTopic);
+        off(topics.configTopic);
+        off(topics.shadowGetTopic);
+        for (uint8_t i = 0; i < scopedRouteCount; i++) {
+            off(scopedRoutes[i].deviceFilter);
+            if (scopedRoutes[i].roomFilter[0] != '\0') {
+                off(scopedRoutes[i].roomFilter);
+            }
+        }
+    }
+    
+    if (!topics.build(mqttTopic, COMMAND_TOPIC, roomId, deviceId.c_str())) {
+        LOG_W("MQTT主題過長，已被截斷");
+    }
+    
+    // 房間變更屬於結構變更，影子需要在新主題重新發布完整狀態
+    shadow.setIdentity(deviceId.c_str(), topics.roomId, "ir_control");
+    rebuildSampleTemplate();
+    
+    LOG_I("MQTT主題表已更新: %s", topics.deviceTopic);
+    
+    registerDeviceRoutes();
+    for (uint8_t i = 0; i < scopedRouteCount; i++) {
+        registerScopedRoute(scopedRoutes[i]);
+    }
+    reserveTopicAliases();
+    
+    // 已連線時立即在新主題公告支援的編碼
+    if (clientConnected()) {
+        announceCapabilities();
+        if (shadowEnabled) {
+            publishShadowFull();
+        }
+    }
+}
+
+// 註冊裝置主題下的處理函數 (已連線時on()會立即訂閱)
+void MQTTManager::registerDeviceRoutes() {
+    on(topics.encodingTopic, [this](const char* topic, const uint8_t* payload, unsigned int length) {
+        handleEncodingMessage(payload, length);
+    });
+    on(topics.configTopic, [this](const char* topic, const uint8_t* payload, unsigned int length) {
+        handleConfigMessage(payload, length);
+    });
+    on(topics.shadowGetTopic, [this](const char* topic, const uint8_t* payload, unsigned int length) {
+        handleShadowGet();
+    });
+}
+
+// 以目前的主題表註冊定址命令主題
+void MQTTManager::registerScopedRoute(ScopedRoute& route) {
+    snprintf(route.deviceFilter, sizeof(route.deviceFilter), "%s/%s", topics.commandDeviceTopic, route.suffix);
+    on(route.deviceFilter, route.handler);
+    
+    if (topics.commandRoomTopic[0] != '\0') {
+        snprintf(route.roomFilter, sizeof(route.roomFilter), "%s/%s", topics.commandRoomTopic, route.suffix);
+        on(route.roomFilter, route.handler);
+    } else {
+        route.roomFilter[0] = '\0';
+    }
+}
+
+// 註冊依裝置與房間定址的命令主題
+bool MQTTManager::onScoped(const char* suffix, MqttTopicHandler handler) {
+    if (scopedRouteCount >= MAX_SCOPED_ROUTES || strlen(suffix) >= sizeof(scopedRoutes[0].suffix) || !handler) {
+        LOG_W("無法註冊定址命令主題: %s", suffix);
+        return false;
+    }
+    
+    ScopedRoute& route = scopedRoutes[scopedRouteCount++];
+    strcpy(route.suffix, suffix);
+    route.handler = handler;
+    route.deviceFilter[0] = '\0';
+    route.roomFilter[0] = '\0';
+    
+    // 主題表已建立時立即註冊，否則在begin()建表時註冊
+    if (topics.deviceTopic[0] != '\0') {
+        registerScopedRoute(route);
+    }
+    return true;
+}
+
+// 檢查房間ID是否變更，必要時重建主題表
+void MQTTManager::refreshTopicTable() {
+    if (topics.roomChanged(wifiManager->getRoomIDCStr())) {
+        rebuildTopicTable();
+    }
 }
 
 // 靜態回調處理函數
 void MQTTManager::handleCallback(char* topic, byte* payload, unsigned int length, void* instance) {
     // 確保實例有效
     MQTTManager* mqttManager = static_cast<MQTTManager*>(instance);
-    if (mqttManager && mqttManager->userCallback) {
+    if (mqttManager == nullptr) {
+        return;
+    }
+    
+    mqttManager->stats.messagesIn++;
+    
+    // 記錄socket可讀到開始處理的延遲
+    if (mqttManager->socketReadyMicros != 0) {
+        mqttManager->lastInboundLatencyMicros = micros() - mqttManager->socketReadyMicros;
+        mqttManager->stats.inboundMicros.record(mqttManager->lastInboundLatencyMicros);
+        if (mqttManager->lastInboundLatencyMicros > mqttManager->maxInboundLatencyMicros) {
+            mqttManager->maxInboundLatencyMicros = mqttManager->lastInboundLatencyMicros;
+        }
+        mqttManager->socketReadyMicros = 0;
+    }
+    
+    // 負載直接指向PubSubClient的接收緩衝區，不複製
+    if (mqttManager->router.dispatch(topic, payload, length) > 0) {
+        return;
+    }
+    
+    if (mqttManager->userCallback) {
         mqttManager->userCallback(topic, payload, length);
     }
 }
 
+// 處理MqttLink攔截到的封包 (PubSubClient讀取時同步呼叫)
+void MQTTManager::handlePacket(uint8_t header, const uint8_t* body, size_t bodyLength, void* instance) {
+    MQTTManager* mqttManager = static_cast<MQTTManager*>(instance);
+    if ((header & 0xF0) == MQTT_PACKET_PUBACK && bodyLength >= 2) {
+        uint16_t packetId = ((uint16_t)body[0] << 8) | body[1];
+        mqttManager->outbox.acknowledge(packetId);
+        mqttManager->stats.pubacks++;
+        
+        // MQTT 5的PUBACK可帶原因碼，伺服器拒收時重送也不會成功，只記錄原因
+        if (bodyLength >= 3 && body[2] >= 0x80) {
+            LOG_W("QoS 1訊息 %u 被伺服器拒收，原因碼 0x%02X: %s", packetId, body[2],
+                  Mqtt5Client::describeReason(body[2]));
+        }
+    } else if ((header & 0xF0) == MQTT_PACKET_SUBACK && bodyLength >= 3 &&
+               mqttManager->protocolVersion == MQTT_VERSION_3_1_1) {
+        // MQTT 5的SUBACK由Mqtt5Client檢查
+        for (size_t i = 2; i < bodyLength; i++) {
+            if (body[i] == 0x80) {
+                LOG_W("SUBSCRIBE %u 的第 %u 個過濾器被伺服器拒絕",
+                      ((uint16_t)body[0] << 8) | body[1], (unsigned)(i - 1));
+            }
+        }
+    } else if ((header & 0xF0) == MQTT_PACKET_PINGRESP) {
+        mqttManager->stats.pings++;
+        unsigned long rtt = millis() - mqttManager->link.getPingSentMillis();
+        mqttManager->stats.pingMillis.record(rtt);
+        mqttManager->brokers.recordRtt(rtt);
+    }
+}
+
 // 設置使用者回調函數
 void MQTTManager::setCallback(MqttCallbackFunction callback) {
     userCallback = callback;
 }
 
-// 訂閱主題
-bool MQTTManager::subscribe(const char* topic) {
-    if (mqttClient->connected()) {
-        return mqttClient->subscribe(topic);
+// 註冊主題過濾器的處理函數
+bool MQTTManager::on(const char* filter, MqttTopicHandler handler) {
+    if (!router.add(filter, handler)) {
+        LOG_W("無效的主題過濾器: %s", filter);
+        return false;
     }
-    return false;
+    
+    if (clientConnected()) {
+        clientSubscribe(filter);
+    }
+    return true;
+}
+
+// 移除主題過濾器的處理函數並取消訂閱
+bool MQTTManager::off(const char* filter) {
+    if (!router.remove(filter)) {
+        return false;
+    }
+    
+    if (clientConnected()) {
+        clientUnsubscribe(filter);
+    }
+    return true;
+}
+
+// 訂閱主題 (沒有處理函數，轉交給使用者回調函數)
+bool MQTTManager::subscribe(const char* topic) {
+    return on(topic, [this](const char* topic, const uint8_t* payload, unsigned int length) {
+        if (userCallback) {
+            userCallback(topic, (byte*)payload, length);
+        }
+    });
 }
 
 // 取消訂閱主題
 bool MQTTManager::unsubscribe(const char* topic) {
-    if (mqttClient->connected()) {
-        return mqttClient->unsubscribe(topic);
-    }
-    return false;
+    return off(topic);
 }
 
 // 發布消息
 bool MQTTManager::publish(const char* topic, const char* payload, bool retain) {
-    if (mqttClient->connected()) {
-        bool result = mqttClient->publish(topic, payload, retain);
+    return publish(topic, (const uint8_t*)payload, strlen(payload), retain);
+}
+
+// 發布二進位消息
+bool MQTTManager::publish(const char* topic, const uint8_t* payload, size_t length, bool retain) {
+    if (clientConnected()) {
+        unsigned long publishStart = micros();
+        bool result = clientPublish(topic, payload, length, retain);
+        stats.publishMicros.record(micros() - publishStart);
         
         if (result) {
-            if (mutex != NULL) {
-                xSemaphoreTake(*mutex, portMAX_DELAY);
-            }
+            stats.publishOk++;
+            stats.bytesOut += length;
             
-            isMqttTransmitting = true;
-            mqttIconBlinkMillis = millis();
-            
-            if (mutex != NULL) {
-                xSemaphoreGive(*mutex);
-            }
+            // 先更新時間再設旗標，讀取端看到旗標時時間必定是新的
+            mqttIconBlinkMillis.store(millis(), std::memory_order_relaxed);
+            isMqttTransmitting.store(true, std::memory_order_release);
             
-            Serial.printf("成功發布到主題: %s\n", topic);
+            LOG_D("成功發布到主題: %s", topic);
         } else {
-            Serial.printf("發布失敗，主題: %s\n", topic);
+            stats.publishFailed++;
+            LOG_W("發布失敗，主題: %s", topic);
         }
         
         return result;
     }
     
-    Serial.println("MQTT未連接，無法發布消息");
+    LOG_D("MQTT未連接，無法發布消息");
     return false;
 }
 
-// 發布JSON格式的數據
-bool MQTTManager::publishJson(const char* topic, JsonDocument& doc, bool retain) {
-    char jsonBuffer[512];
-    serializeJson(doc, jsonBuffer);
-    return publish(topic, jsonBuffer, retain);
+// 以QoS 1發布消息
+bool MQTTManager::publishQos1(const char* topic, const uint8_t* payload, size_t length, bool retain) {
+    // 未連線時也先排隊，重新連線後送出
+    if (!outbox.enqueue(topic, payload, length, retain)) {
+        LOG_W("QoS 1佇列已滿，丟棄主題: %s", topic);
+        return false;
+    }
+    
+    // 通常由其他任務呼叫，喚醒MQTT任務送出
+    notify();
+    return true;
+}
+
+// 轉送一行日誌 (日誌任務是佇列唯一的生產者)
+bool MQTTManager::forwardLog(const char* line) {
+    // 斷線期間不排隊，也不輸出日誌，避免與連線相關的警告再次轉送
+    if (!isMqttConnected.load(std::memory_order_acquire)) {
+        return false;
+    }
+    
+    MqttLogLine entry;
+    strncpy(entry.text, line, sizeof(entry.text) - 1);
+    entry.text[sizeof(entry.text) - 1] = '\0';
+    if (!logQueue.push(entry)) {
+        return false;
+    }
+    
+    notify();
+    return true;
+}
+
+// 以QoS 0發布排隊中的日誌 (只在MQTT任務中呼叫)
+void MQTTManager::drainLogQueue(bool publishLines) {
+    MqttLogLine entry;
+    while (logQueue.pop(entry)) {
+        // 發布失敗時直接丟棄，不再輸出日誌
+        if (publishLines && clientConnected()) {
+            clientPublish(topics.logTopic, (const uint8_t*)entry.text, strlen(entry.text), false);
+        }
+    }
+}
+
+// 發布JSON文檔
+bool MQTTManager::publishJson(const char* topic, JsonDocument& doc, bool retain, uint8_t qos) {
+    uint8_t buffer[MQTT_OUTBOX_MAX_PAYLOAD];
+    size_t length = serializeFor(topic, doc, buffer, sizeof(buffer));
+    
+    if (qos > 0) {
+        return publishQos1(topic, buffer, length, retain);
+    }
+    return publish(topic, buffer, length, retain);
+}
+
+// 序列化JSON文檔到緩衝區
+size_t MQTTManager::serializeFor(const char* topic, JsonDocument& doc, uint8_t* buffer, size_t bufferSize) const {
+    if (encodingFor(topic) == PayloadEncoding::MSGPACK) {
+        return serializeMsgPack(doc, buffer, bufferSize);
+    }
+    return serializeJson(doc, (char*)buffer, bufferSize);
+}
+
+// 設置預設編碼
+void MQTTManager::setDefaultEncoding(PayloadEncoding encoding) {
+    defaultEncoding = encoding;
+}
+
+// 設置特定主題前綴使用的編碼
+bool MQTTManager::setTopicEncoding(const char* topicPrefix, PayloadEncoding encoding) {
+    // 已存在的前綴直接更新
+    for (uint8_t i = 0; i < encodingRuleCount; i++) {
+        if (strcmp(encodingRules[i].prefix, topicPrefix) == 0) {
+            encodingRules[i].encoding = encoding;
+            return true;
+        }
+    }
+    
+    if (encodingRuleCount >= MAX_ENCODING_RULES || strlen(topicPrefix) >= sizeof(encodingRules[0].prefix)) {
+        return false;
+    }
+    
+    TopicEncodingRule& rule = encodingRules[encodingRuleCount++];
+    strcpy(rule.prefix, topicPrefix);
+    rule.encoding = encoding;
+    return true;
+}
+
+// 查詢主題使用的編碼 (最長前綴優先)
+PayloadEncoding MQTTManager::encodingFor(const char* topic) const {
+    PayloadEncoding encoding = defaultEncoding;
+    size_t bestLength = 0;
+    
+    for (uint8_t i = 0; i < encodingRuleCount; i++) {
+        size_t prefixLength = strlen(encodingRules[i].prefix);
+        if (prefixLength > bestLength && strncmp(topic, encodingRules[i].prefix, prefixLength) == 0) {
+            encoding = encodingRules[i].encoding;
+            bestLength = prefixLength;
+        }
+    }
+    
+    return encoding;
+}
+
+// 公告支援的編碼
+void MQTTManager::announceCapabilities() {
+    char capabilities[112];
+    snprintf(capabilities, sizeof(capabilities),
+             "{\"encodings\":[\"json\",\"msgpack\"],\"default\":\"%s\",\"device\":\"%s\"}",
+             defaultEncoding == PayloadEncoding::MSGPACK ? "msgpack" : "json",
+             encodingFor(topics.deviceTopic) == PayloadEncoding::MSGPACK ? "msgpack" : "json");
+    
+    clientPublish(topics.capabilityTopic, (const uint8_t*)capabilities, strlen(capabilities), true);
+}
+
+// 處理編碼協商訊息 (App以保留訊息發布 "json" 或 "msgpack")
+void MQTTManager::handleEncodingMessage(const uint8_t* payload, unsigned int length) {
+    PayloadEncoding encoding;
+    if (length == 7 && memcmp(payload, "msgpack", 7) == 0) {
+        encoding = PayloadEncoding::MSGPACK;
+    } else if (length == 4 && memcmp(payload, "json", 4) == 0) {
+        encoding = PayloadEncoding::JSON;
+    } else {
+        LOG_W("未知的編碼協商內容，忽略");
+        return;
+    }
+    
+    // 協商只作用於本裝置主題，房間/全域主題仍依預設編碼，避免 JSON 訂閱者收到二進位資料
+    if (encodingFor(topics.deviceTopic) == encoding) {
+        return;
+    }
+    if (!setTopicEncoding(topics.deviceTopic, encoding)) {
+        LOG_W("編碼規則已滿，無法切換裝置主題編碼");
+        return;
+    }
+    
+    LOG_I("裝置主題編碼已切換為: %s", encoding == PayloadEncoding::MSGPACK ? "msgpack" : "json");
+    announceCapabilities();
 }
 
 // 發布標準傳感器數據
@@ -129,200 +525,1359 @@ bool MQTTManager::publishSensorData(float temperature, float humidity) {
     
     lastMqttPublish = millis();
     
-    // 創建JSON文檔
-    StaticJsonDocument<200> doc;
+    // 建立樣本 (已校時則記錄Unix時間)
+    TelemetrySample sample;
+    time_t now = time(nullptr);
+    sample.timestamp = now > 1600000000 ? (uint32_t)now : 0;
+    sample.capturedMillis = millis();
+    sample.temperature = temperature;
+    sample.humidity = humidity;
     
-    doc["temp"] = temperature;
-    doc["humidity"] = humidity;
-    doc["deviceId"] = deviceId;
-    doc["features"] = "ir_control";  // 添加表明支持IR控制的特性標記
+    // 變化才回報: 數值在死區內且未到心跳時間則不發布
+    if (!telemetryFilter.shouldReport(sample)) {
+        return true;
+    }
     
-    // 添加房間ID (如果有)
-    if (wifiManager->hasRoomID()) {
-        doc["roomId"] = wifiManager->getRoomID();
-    } else {
-        doc["roomId"] = "unknown";
+    // 批次模式: 累積到批次大小或等待逾時後一次送出
+    if (batcher.isEnabled()) {
+        batcher.add(sample);
+        if (batcher.isReady(sample.capturedMillis)) {
+            return flushBatch();
+        }
+        return true;
     }
     
-    // 發布到主題，使用房間ID作為分類
-    String topic = mqttTopic;
+    // MQTT未連接時暫存樣本，待重新連線後補傳
+    if (!clientConnected() && telemetryBuffer != nullptr) {
+        telemetryBuffer->push(sample);
+        return false;
+    }
     
-    if (wifiManager->hasRoomID()) {
-        // 使用房間ID作為MQTT的主要分類方式
-        topic = String(mqttTopic) + "/" + wifiManager->getRoomID();
-        
-        // 也發布到包含裝置ID的主題，讓App可以追蹤個別裝置
-        String deviceTopic = topic + "/" + deviceId;
-        bool result1 = publishJson(deviceTopic.c_str(), doc);
-        Serial.println("發送數據到房間和裝置主題: " + deviceTopic);
-        
-        // 發布到主題
-        bool result2 = publishJson(topic.c_str(), doc);
-        Serial.println("發送數據到主題: " + topic);
-        
-        return result1 && result2;
-    } else {
-        // 如果沒有房間ID，則使用裝置ID作為分類
-        topic = String(mqttTopic) + "/unknown/" + deviceId;
-        
-        // 發布到主題
-        bool result = publishJson(topic.c_str(), doc);
-        Serial.println("發送數據到主題: " + topic);
-        
-        return result;
+    uint8_t pendingTopics = SAMPLE_ALL_TOPICS;
+    if (publishSample(sample, false, false, &pendingTopics)) {
+        return true;
+    }
+    
+    // 仍判定為已連線但發布失敗 (例如斷線前的寫入逾時) 也暫存，補傳時只重送失敗的主題
+    if (telemetryBuffer != nullptr) {
+        telemetryBuffer->push(sample);
+        rememberPartialSample(sample, pendingTopics);
     }
+    return false;
 }
 
-// 檢查並維護MQTT連接
-bool MQTTManager::loop() {
-    unsigned long currentMillis = millis();
+// 發布單筆遙測樣本
+bool MQTTManager::publishSample(const TelemetrySample& sample, bool replay, bool previousBoot,
+                                uint8_t* pendingTopics) {
+    refreshTopicTable();
     
-    // 檢查傳輸圖示是否需要關閉
-    if (isMqttTransmitting && currentMillis - mqttIconBlinkMillis >= mqttIconBlinkInterval) {
-        if (mutex != NULL) {
-            xSemaphoreTake(*mutex, portMAX_DELAY);
-        }
-        
-        isMqttTransmitting = false;
-        
-        if (mutex != NULL) {
-            xSemaphoreGive(*mutex);
-        }
-    }
+    uint8_t allTopics = SAMPLE_ALL_TOPICS;
+    uint8_t& pending = pendingTopics != nullptr ? *pendingTopics : allTopics;
     
-    // MQTT連接檢查
-    if (!mqttClient->connected()) {
-        isMqttConnected = false;
-        
-        if (currentMillis - lastMqttReconnectAttempt >= mqttReconnectInterval) {
-            lastMqttReconnectAttempt = currentMillis;
-            
-            if (connect()) {
-                lastMqttReconnectAttempt = 0;
-                isMqttConnected = true;
-                return true;
-            }
+    if (shadowEnabled) {
+        // 影子模式只有一個目標主題
+        if (!publishShadowSample(sample, replay, previousBoot)) {
             return false;
         }
-    } else {
-        isMqttConnected = true;
-        mqttClient->loop();
+        pending = 0;
         return true;
     }
     
-    return false;
-}
-
-// 嘗試連接MQTT伺服器
-bool MQTTManager::connect() {
-    if (!wifiManager->isConnected()) {
-        Serial.println("WiFi未連接，無法連接MQTT");
-        return false;
+    // 沒有房間ID時只發布到裝置主題
+    bool hasRoom = topics.roomId[0] != '\0';
+    if (!hasRoom) {
+        pending &= ~SAMPLE_ROOM_TOPIC;
     }
     
-    if (mqttClient->connected()) {
-        return true;
+    bool result;
+    if (!replay && publishTemplatedSample(sample, pending, &result)) {
+        return result;
     }
     
-    // 生成唯一的客戶端ID
-    char uniqueClientId[25];
-    sprintf(uniqueClientId, "%s%08X", clientIdPrefix, random(0xFFFFFFFF));
+    // 創建JSON文檔（字串欄位以指標方式引用，不複製）
+    StaticJsonDocument<256> doc;
+    
+    doc["temp"] = sample.temperature;
+    doc["humidity"] = sample.humidity;
+    doc["deviceId"] = deviceId.c_str();
+    doc["features"] = "ir_control";  // 添加表明支持IR控制的特性標記
+    
+    // 添加房間ID (如果有)
+    doc["roomId"] = hasRoom ? (const char*)topics.roomId : "unknown";
     
-    // 設置遺囑消息
-    const char* willTopic = "esp32/status";
-    const char* willMessage = "offline";
-    bool willRetain = true;
+    // 補傳的樣本附帶取樣時間與佇列狀態
+    if (replay) {
+        doc["replay"] = true;
+        addReplayTime(doc, sample, previousBoot);
+        doc["queued"] = telemetryBuffer != nullptr ? telemetryBuffer->size() : 0;
+        doc["dropped"] = telemetryBuffer != nullptr ? telemetryBuffer->getDroppedCount() : 0;
+    }
     
-    Serial.printf("嘗試連接MQTT伺服器 %s:%d 使用ID: %s\n", mqttServer, mqttPort, uniqueClientId);
+    // 發布到包含裝置ID的主題，讓App可以追蹤個別裝置 (沒有房間ID時也以此分類)
+    if ((pending & SAMPLE_DEVICE_TOPIC) && publishJson(topics.deviceTopic, doc)) {
+        pending &= ~SAMPLE_DEVICE_TOPIC;
+    }
     
-    if (mqttClient->connect(uniqueClientId, NULL, NULL, willTopic, 0, willRetain, willMessage)) {
-        Serial.println("MQTT伺服器連接成功");
-        
-        // 訂閱基本命令主題
-        mqttClient->subscribe("esp32/commands");
-        
-        // 發布在線狀態
-        mqttClient->publish("esp32/status", "online", true);
-        
-        return true;
-    } else {
-        int state = mqttClient->state();
-        Serial.printf("MQTT連接失敗，錯誤碼: %d\n", state);
-        
-        switch (state) {
-            case -4: Serial.println("連接超時"); break;
-            case -3: Serial.println("伺服器不可用"); break;
-            case -2: Serial.println("錯誤的網絡連接"); break;
-            case -1: Serial.println("客戶端不可用"); break;
-            case 1: Serial.println("協議版本錯誤"); break;
-            case 2: Serial.println("客戶端ID被拒絕"); break;
-            case 3: Serial.println("伺服器不可用"); break;
-            case 4: Serial.println("用戶名/密碼錯誤"); break;
-            case 5: Serial.println("未授權"); break;
-            default: Serial.println("未知錯誤"); break;
-        }
-        
-        return false;
+    // 使用房間ID作為MQTT的主要分類方式
+    if ((pending & SAMPLE_ROOM_TOPIC) && publishJson(topics.roomTopic, doc)) {
+        pending &= ~SAMPLE_ROOM_TOPIC;
     }
+    return pending == 0;
 }
 
-// 獲取連接狀態
-bool MQTTManager::isConnected() const {
-    return isMqttConnected;
+// 記錄只發布到部分主題的暫存樣本
+void MQTTManager::rememberPartialSample(const TelemetrySample& sample, uint8_t pendingTopics) {
+    if (pendingTopics == SAMPLE_ALL_TOPICS) {
+        return;
+    }
+    
+    // 紀錄已滿時捨棄最舊的一筆 (該樣本補傳時會重送到所有主題)
+    if (partialSampleCount >= MAX_PARTIAL_SAMPLES) {
+        memmove(partialSamples, partialSamples + 1, sizeof(PartialSample) * (MAX_PARTIAL_SAMPLES - 1));
+        partialSampleCount--;
+    }
+    partialSamples[partialSampleCount].capturedMillis = sample.capturedMillis;
+    partialSamples[partialSampleCount].pendingTopics = pendingTopics;
+    partialSampleCount++;
 }
 
-// 獲取傳輸狀態
-bool MQTTManager::isTransmitting() const {
-    return isMqttTransmitting;
+// 取出暫存樣本尚未成功的主題
+uint8_t MQTTManager::takePartialSample(const TelemetrySample& sample, bool previousBoot) {
+    // 上次開機的樣本millis()已失效，不會有這次開機的紀錄
+    if (previousBoot) {
+        return SAMPLE_ALL_TOPICS;
+    }
+    
+    for (uint8_t i = 0; i < partialSampleCount; i++) {
+        if (partialSamples[i].capturedMillis == sample.capturedMillis) {
+            uint8_t pendingTopics = partialSamples[i].pendingTopics;
+            partialSamples[i] = partialSamples[--partialSampleCount];
+            return pendingTopics;
+        }
+    }
+    return SAMPLE_ALL_TOPICS;
 }
 
-// 獲取傳輸圖標閃爍時間
-unsigned long MQTTManager::getIconBlinkMillis() const {
-    return mqttIconBlinkMillis;
+// 重建單筆遙測的範本，欄位順序與publishSample()的JsonDocument相同
+void MQTTManager::rebuildSampleTemplate() {
+    sampleTemplate.clear();
+    sampleTemplate.appendLiteral("{\"temp\":");
+    sampleTemplate.appendSlot();
+    sampleTemplate.appendLiteral(",\"humidity\":");
+    sampleTemplate.appendSlot();
+    sampleTemplate.appendLiteral(",\"deviceId\":");
+    sampleTemplate.appendString(deviceId.c_str());
+    sampleTemplate.appendLiteral(",\"features\":\"ir_control\",\"roomId\":");
+    sampleTemplate.appendString(topics.roomId[0] != '\0' ? topics.roomId : "unknown");
+    sampleTemplate.appendLiteral("}");
+    
+    if (!sampleTemplate.isValid()) {
+        LOG_W("遙測範本過長，改用ArduinoJson序列化");
+    }
 }
 
-// 設置傳輸狀態
-void MQTTManager::setTransmitting(bool state) {
-    if (mutex != NULL) {
-        xSemaphoreTake(*mutex, portMAX_DELAY);
+// 以範本發布單筆遙測
+bool MQTTManager::publishTemplatedSample(const TelemetrySample& sample, uint8_t& pendingTopics, bool* result) {
+    if (!templateEnabled) {
+        return false;
     }
     
-    isMqttTransmitting = state;
+    bool hasRoom = topics.roomId[0] != '\0';
+    if (encodingFor(topics.deviceTopic) != PayloadEncoding::JSON ||
+        (hasRoom && encodingFor(topics.roomTopic) != PayloadEncoding::JSON)) {
+        return false;
+    }
     
-    if (state) {
-        mqttIconBlinkMillis = millis();
+    // 與JsonDocument相同，float先轉為double再格式化
+    double values[2] = { sample.temperature, sample.humidity };
+    char buffer[256];
+    size_t length = sampleTemplate.render(values, 2, buffer, sizeof(buffer));
+    if (length == 0) {
+        return false;
     }
+    templatePublishes++;
     
-    if (mutex != NULL) {
-        xSemaphoreGive(*mutex);
+    // 兩個主題的內容相同，只格式化一次
+    if ((pendingTopics & SAMPLE_DEVICE_TOPIC) && publish(topics.deviceTopic, (const uint8_t*)buffer, length, false)) {
+        pendingTopics &= ~SAMPLE_DEVICE_TOPIC;
     }
+    if ((pendingTopics & SAMPLE_ROOM_TOPIC) && publish(topics.roomTopic, (const uint8_t*)buffer, length, false)) {
+        pendingTopics &= ~SAMPLE_ROOM_TOPIC;
+    }
+    *result = pendingTopics == 0;
+    return true;
 }
 
-// 獲取客戶端實例
-PubSubClient* MQTTManager::getClient() {
-    return mqttClient;
+// 設置是否以預先序列化範本發布單筆遙測
+void MQTTManager::setSampleTemplate(bool enabled) {
+    templateEnabled = enabled;
 }
 
-// 獲取基礎主題
-String MQTTManager::getBaseTopic() const {
-    return String(mqttTopic);
+// 獲取以預先序列化範本發布的遙測次數
+uint32_t MQTTManager::getTemplatePublishCount() const {
+    return templatePublishes;
 }
 
-// 生成完整的設備主題路徑
-String MQTTManager::getDeviceTopic(const String& suffix) const {
-    String baseTopic = getBaseTopic();
-    
-    if (wifiManager->hasRoomID()) {
-        baseTopic += "/" + wifiManager->getRoomID();
+// 補傳樣本的取樣時間
+void MQTTManager::addReplayTime(JsonDocument& doc, const TelemetrySample& sample, bool previousBoot) const {
+    if (sample.timestamp != 0) {
+        doc["ts"] = sample.timestamp;
+    } else if (previousBoot) {
+        // capturedMillis屬於上一次開機，與目前的millis()相減沒有意義
+        doc["prevBoot"] = true;
     } else {
-        baseTopic += "/unknown";
+        doc["age"] = millis() - sample.capturedMillis;
+    }
+}
+
+// 以裝置影子發布樣本
+bool MQTTManager::publishShadowSample(const TelemetrySample& sample, bool replay, bool previousBoot) {
+    // 補傳的是斷線期間的舊讀數，不改變影子狀態與版本，只以歷史訊息發布
+    if (replay) {
+        StaticJsonDocument<128> doc;
+        doc["temp"] = sample.temperature;
+        doc["humidity"] = sample.humidity;
+        doc["replay"] = true;
+        addReplayTime(doc, sample, previousBoot);
+        return publishJson(topics.shadowHistoryTopic, doc);
     }
     
-    baseTopic += "/" + deviceId;
+    shadow.setReading(sample.temperature, sample.humidity);
     
-    if (suffix.length() > 0) {
-        baseTopic += "/" + suffix;
+    // 尚未發布過或結構變更時，完整狀態已包含這筆讀數
+    if (shadow.needsFull()) {
+        return publishShadowFull();
+    }
+    
+    StaticJsonDocument<192> doc;
+    shadow.encodeDelta(doc);
+    
+    // 發布成功後才遞增版本並清除待發布的欄位，失敗時變動併入下一次差異
+    if (!publishJson(topics.shadowDeltaTopic, doc)) {
+        return false;
+    }
+    shadow.commitDelta();
+    return true;
+}
+
+// 發布完整狀態
+bool MQTTManager::publishShadowFull() {
+    StaticJsonDocument<256> doc;
+    shadow.encodeFull(doc);
+    lastShadowFull = millis();
+    
+    // 以QoS 1保留，App隨時訂閱都能取得最新的完整狀態；佇列已滿時維持待發布，下一筆樣本再試
+    if (!publishJson(topics.shadowTopic, doc, true, 1)) {
+        return false;
+    }
+    shadow.commitFull();
+    return true;
+}
+
+// 處理App的重新同步要求
+void MQTTManager::handleShadowGet() {
+    if (!shadowEnabled) {
+        return;
     }
     
-    return baseTopic;
+    shadow.requestFull();
+    
+    // 多個App同時要求時，一秒內只發布一次，其餘留給下一筆樣本
+    if (millis() - lastShadowFull >= 1000) {
+        LOG_I("App要求重新同步，發布完整狀態 (版本 %u)", (unsigned)shadow.getVersion());
+        publishShadowFull();
+    }
+}
+
+// 設置裝置影子模式
+void MQTTManager::setShadowMode(bool enabled) {
+    bool wasEnabled = shadowEnabled;
+    shadowEnabled = enabled;
+    
+    // 停用期間的讀數沒有發布差異，重新啟用時先發布完整狀態
+    if (enabled && !wasEnabled) {
+        shadow.requestFull();
+        if (clientConnected()) {
+            publishShadowFull();
+        }
+    }
+    
+    LOG_I("裝置影子模式: %s", enabled ? "啟用" : "停用");
+}
+
+// 是否使用裝置影子模式
+bool MQTTManager::isShadowMode() const {
+    return shadowEnabled;
+}
+
+// 獲取裝置影子
+const DeviceShadow& MQTTManager::getShadow() const {
+    return shadow;
+}
+
+// 送出目前累積的批次
+bool MQTTManager::flushBatch() {
+    if (batcher.count() == 0) {
+        return true;
+    }
+    
+    // 未連接時逐筆轉存，重新連線後再以單筆格式補傳
+    if (!clientConnected()) {
+        if (telemetryBuffer != nullptr) {
+            for (size_t i = 0; i < batcher.count(); i++) {
+                telemetryBuffer->push(batcher.at(i));
+            }
+        }
+        batcher.clear();
+        return false;
+    }
+    
+    refreshTopicTable();
+    
+    // 只在mqttTask中呼叫，使用靜態文檔避免佔用任務堆疊
+    static StaticJsonDocument<1024> doc;
+    doc.clear();
+    
+    doc["deviceId"] = deviceId.c_str();
+    doc["roomId"] = topics.roomId[0] != '\0' ? (const char*)topics.roomId : "unknown";
+    doc["features"] = "ir_control";
+    batcher.encode(doc);
+    batcher.clear();
+    
+    // 批次訊息只發布一次到裝置主題
+    return publishJson(topics.deviceTopic, doc);
+}
+
+// 設置批次模式
+void MQTTManager::setBatchMode(uint8_t batchSize, unsigned long maxLatency) {
+    // 以舊設定送出尚未發布的樣本
+    flushBatch();
+    batcher.configure(batchSize, maxLatency);
+}
+
+// 以限速批次補傳斷線期間暫存的樣本
+void MQTTManager::drainTelemetryBuffer(unsigned long currentMillis) {
+    if (telemetryBuffer == nullptr || telemetryBuffer->isEmpty()) {
+        return;
+    }
+    
+    if (currentMillis - lastReplay < replayInterval) {
+        return;
+    }
+    lastReplay = currentMillis;
+    
+    TelemetrySample sample;
+    bool previousBoot = false;
+    for (uint8_t i = 0; i < replayBatchSize && telemetryBuffer->peek(sample, &previousBoot); i++) {
+        uint8_t pendingTopics = takePartialSample(sample, previousBoot);
+        if (!publishSample(sample, true, previousBoot, &pendingTopics)) {
+            // 發布失敗則保留樣本，下次只重送失敗的主題，已成功的主題不會重複
+            rememberPartialSample(sample, pendingTopics);
+            break;
+        }
+        telemetryBuffer->pop();
+    }
+    
+    if (telemetryBuffer->isEmpty()) {
+        LOG_I("遙測補傳完成，累計丟棄 %u 筆", (unsigned)telemetryBuffer->getDroppedCount());
+    }
+}
+
+// 處理遙測設定訊息
+// 格式: {"reportOnChange":true,"tempDeadband":1,"humidityDeadband":2,"heartbeat":300000}，未提供的欄位維持原值
+void MQTTManager::handleConfigMessage(const uint8_t* payload, unsigned int length) {
+    StaticJsonDocument<192> doc;
+    DeserializationError error = deserializeJson(doc, (const char*)payload, length);
+    if (error) {
+        LOG_W("遙測設定JSON解析錯誤");
+        return;
+    }
+    
+    bool enabled = doc["reportOnChange"] | telemetryFilter.isEnabled();
+    float temperatureDeadband = doc["tempDeadband"] | telemetryFilter.getTemperatureDeadband();
+    float humidityDeadband = doc["humidityDeadband"] | telemetryFilter.getHumidityDeadband();
+    unsigned long heartbeat = doc["heartbeat"] | telemetryFilter.getHeartbeat();
+    
+    setReportOnChange(enabled, temperatureDeadband, humidityDeadband, heartbeat);
+    
+    if (doc.containsKey("shadow")) {
+        setShadowMode(doc["shadow"].as<bool>());
+    }
+}
+
+// 設置變化才回報模式
+void MQTTManager::setReportOnChange(bool enabled, float temperatureDeadband, float humidityDeadband,
+                                    unsigned long heartbeat) {
+    telemetryFilter.configure(temperatureDeadband, humidityDeadband, heartbeat);
+    telemetryFilter.setEnabled(enabled);
+    
+    LOG_I("變化才回報: %s 溫度死區 %.1f 濕度死區 %.1f 心跳 %lu ms",
+                  enabled ? "啟用" : "停用", temperatureDeadband, humidityDeadband, heartbeat);
+}
+
+// 獲取被變化才回報模式抑制的發布次數
+uint32_t MQTTManager::getSuppressedCount() const {
+    return telemetryFilter.getSuppressedCount();
+}
+
+// 設置斷線期間使用的遙測緩衝區
+void MQTTManager::setTelemetryBuffer(TelemetryBuffer* buffer) {
+    telemetryBuffer = buffer;
+}
+
+// 設置補傳速率
+void MQTTManager::setReplayRate(uint8_t batchSize, unsigned long interval) {
+    replayBatchSize = batchSize > 0 ? batchSize : 1;
+    replayInterval = interval;
+}
+
+// 獲取待補傳的樣本數
+size_t MQTTManager::getBacklogDepth() const {
+    return telemetryBuffer != nullptr ? telemetryBuffer->size() : 0;
+}
+
+// 獲取因緩衝區已滿而丟棄的樣本數
+uint32_t MQTTManager::getBacklogDropped() const {
+    return telemetryBuffer != nullptr ? telemetryBuffer->getDroppedCount() : 0;
+}
+
+// 檢查並維護MQTT連接
+bool MQTTManager::loop() {
+    unsigned long loopStart = micros();
+    unsigned long currentMillis = millis();
+    
+    // 檢查傳輸圖示是否需要關閉
+    if (isMqttTransmitting.load(std::memory_order_acquire) &&
+        currentMillis - mqttIconBlinkMillis.load(std::memory_order_relaxed) >= mqttIconBlinkInterval) {
+        isMqttTransmitting.store(false, std::memory_order_relaxed);
+    }
+    
+    // 房間ID變更時更新主題表
+    refreshTopicTable();
+    
+    // 批次逾時則強制送出
+    if (batcher.isReady(currentMillis)) {
+        flushBatch();
+    }
+    
+    // MQTT連接檢查
+    if (clientConnected()) {
+        isMqttConnected = true;
+        if (mqtt5Client) {
+            mqtt5Client->loop();
+        } else {
+            mqttClient->loop();
+        }
+        
+        // 在視窗允許的範圍內送出QoS 1訊息 (只寫入socket，不等待PUBACK)
+        if (clientConnected() && outbox.service(link) > 0) {
+            setTransmitting(true);
+        }
+        
+        // 轉送日誌任務排入的日誌
+        drainLogQueue(true);
+        
+        // 連線期間逐步補傳暫存的樣本
+        drainTelemetryBuffer(currentMillis);
+        
+        // 定期發布診斷快照
+        if (diagInterval > 0 && currentMillis - lastDiagPublish >= diagInterval) {
+            publishDiagnostics();
+        }
+        
+        // 使用備援伺服器時，定期檢查是否回切到更健康的伺服器 (先探測確認候選伺服器可連線)
+        if (brokers.shouldFailBack(currentMillis)) {
+            LOG_I("其他MQTT伺服器已可連線且狀況較佳，中斷 %s 後重新選擇", brokers.current().host);
+            disconnect();
+        }
+        serviceBrokerProbe(currentMillis);
+    } else {
+        isMqttConnected = false;
+        serviceBrokerProbe(currentMillis);
+        
+        if (connectState == MqttConnectState::CONNECTED) {
+            // 非預期斷線，第一次重連也要加入抖動
+            link.stop();
+            connectState = MqttConnectState::IDLE;
+            reconnectPolicy.onDisconnected(false);
+            reconnectDelay = reconnectPolicy.nextDelay();
+            lastMqttReconnectAttempt = currentMillis;
+            disconnectedSince = currentMillis;
+            stats.disconnects++;
+            brokers.recordFailure(currentMillis);
+            drainLogQueue(false);
+            LOG_W("MQTT連線中斷，%lu ms後重連", reconnectDelay);
+        }
+        
+        if (connectState == MqttConnectState::IDLE) {
+            if (currentMillis - lastMqttReconnectAttempt >= reconnectDelay) {
+                lastMqttReconnectAttempt = currentMillis;
+                startConnect(currentMillis);
+            }
+        } else {
+            advanceConnect(currentMillis);
+        }
+    }
+    
+    // 記錄本次loop()耗時
+    lastLoopMicros = micros() - loopStart;
+    if (lastLoopMicros > maxLoopMicros) {
+        maxLoopMicros = lastLoopMicros;
+    }
+    busyMicros += lastLoopMicros;
+    
+    return isMqttConnected;
+}
+
+// 計算距離下一個需要處理的期限的毫秒數
+unsigned long MQTTManager::nextWakeDelay(unsigned long currentMillis) const {
+    // 收發緩衝區中已有待處理的資料，不等待
+    if (link.buffered() > 0 || (clientConnected() && (outbox.hasSendable() || logQueue.size() > 0))) {
+        return 0;
+    }
+    
+    unsigned long delayMs = ULONG_MAX;
+    
+    // 以剩餘時間更新最近的期限
+    auto until = [&](unsigned long since, unsigned long interval) {
+        unsigned long elapsed = currentMillis - since;
+        unsigned long remaining = elapsed >= interval ? 0 : interval - elapsed;
+        if (remaining < delayMs) {
+            delayMs = remaining;
+        }
+    };
+    
+    switch (connectState) {
+        case MqttConnectState::CONNECTED:
+            // PubSubClient在loop()中判斷是否需要送出PINGREQ，至少每1/3心跳間隔檢查一次
+            until(currentMillis, KEEPALIVE_SECONDS * 1000UL / 3);
+            if (telemetryBuffer != nullptr && !telemetryBuffer->isEmpty()) {
+                until(lastReplay, replayInterval);
+            }
+            if (diagInterval > 0) {
+                until(lastDiagPublish, diagInterval);
+            }
+            if (probeState != MqttConnectState::IDLE) {
+                until(currentMillis, 20);
+            }
+            break;
+        case MqttConnectState::IDLE:
+            until(lastMqttReconnectAttempt, reconnectDelay);
+            break;
+        default:
+            // DNS回調與TCP連線沒有可等待的事件，以短間隔推進狀態機
+            until(currentMillis, 20);
+            break;
+    }
+    
+    until(lastMqttPublish, mqttPublishInterval);
+    
+    if (isMqttTransmitting) {
+        until(mqttIconBlinkMillis.load(std::memory_order_relaxed), mqttIconBlinkInterval);
+    }
+    
+    // 批次的最長等待時間以秒為單位設定，不需精確
+    if (batcher.count() > 0) {
+        until(currentMillis, 1000);
+    }
+    
+    return delayMs;
+}
+
+// 阻塞直到有事件或到達下一個期限
+void MQTTManager::waitForEvent(unsigned long maxWaitMs) {
+    unsigned long delayMs = nextWakeDelay(millis());
+    if (delayMs > maxWaitMs) {
+        delayMs = maxWaitMs;
+    }
+    
+    if (delayMs == 0) {
+        wakeupCount++;
+        return;
+    }
+    
+    if (eventFd < 0) {
+        vTaskDelay(pdMS_TO_TICKS(delayMs > 10 ? 10 : delayMs));
+        wakeupCount++;
+        return;
+    }
+    
+    int sock = link.fd();
+    fd_set readSet;
+    FD_ZERO(&readSet);
+    FD_SET(eventFd, &readSet);
+    int maxFd = eventFd;
+    
+    // 等待CONNACK或已連線時才監聽socket
+    if (sock >= 0 && (connectState == MqttConnectState::AWAIT_CONNACK || connectState == MqttConnectState::CONNECTED)) {
+        FD_SET(sock, &readSet);
+        if (sock > maxFd) {
+            maxFd = sock;
+        }
+    }
+    
+    struct timeval timeout = {(long)(delayMs / 1000), (long)((delayMs % 1000) * 1000)};
+    int ready = select(maxFd + 1, &readSet, NULL, NULL, &timeout);
+    wakeupCount++;
+    
+    if (ready <= 0) {
+        return;
+    }
+    
+    if (FD_ISSET(eventFd, &readSet)) {
+        uint64_t value;
+        read(eventFd, &value, sizeof(value));
+    }
+    
+    if (sock >= 0 && FD_ISSET(sock, &readSet)) {
+        socketReadyMicros = micros();
+    }
+}
+
+// 喚醒在waitForEvent()中等待的MQTT任務
+void MQTTManager::notify() {
+    if (eventFd >= 0) {
+        uint64_t value = 1;
+        write(eventFd, &value, sizeof(value));
+    }
+}
+
+// 檢查是否到了下一次發布傳感器數據的時間
+bool MQTTManager::isPublishDue() const {
+    return millis() - lastMqttPublish >= mqttPublishInterval;
+}
+
+// 設置診斷快照的發布間隔
+void MQTTManager::setDiagnosticsInterval(unsigned long interval) {
+    diagInterval = interval;
+}
+
+// 發布診斷快照
+bool MQTTManager::publishDiagnostics() {
+    lastDiagPublish = millis();
+    
+    // 只在mqttTask中呼叫，使用靜態文檔避免佔用任務堆疊
+    static StaticJsonDocument<1024> doc;
+    doc.clear();
+    stats.encode(doc);
+    doc["inflight"] = outbox.getInFlight();
+    doc["backlog"] = getBacklogDepth();
+    if (mqtt5Client) {
+        doc["aliasSaved"] = mqtt5Client->getAliasBytesSaved();
+        doc["reason"] = mqtt5Client->getLastReasonCode();
+    }
+    doc["subs"] = restoredSubscriptions;
+    if (shadowEnabled) {
+        doc["shadowVer"] = shadow.getVersion();
+    }
+    if (brokers.count() > 1) {
+        doc["broker"] = brokers.currentIndex();
+        doc["brokerSwitches"] = brokers.getSwitchCount();
+    }
+    
+    static char buffer[768];
+    size_t length = serializeJson(doc, buffer, sizeof(buffer));
+    return publish(topics.diagTopic, (const uint8_t*)buffer, length, true);
+}
+
+// 獲取診斷統計
+const MqttStats& MQTTManager::getStats() const {
+    return stats;
+}
+
+// 獲取waitForEvent()喚醒次數
+uint32_t MQTTManager::getWakeupCount() const {
+    return wakeupCount;
+}
+
+// 獲取loop()累計耗時
+uint64_t MQTTManager::getBusyMicros() const {
+    return busyMicros;
+}
+
+// 獲取上一則訊息從socket可讀到處理函數的延遲
+unsigned long MQTTManager::getInboundLatencyMicros() const {
+    return lastInboundLatencyMicros;
+}
+
+// 獲取上述延遲的最大值
+unsigned long MQTTManager::getMaxInboundLatencyMicros() const {
+    return maxInboundLatencyMicros;
+}
+
+// 以阻塞方式連接MQTT伺服器 (只在開機初始化時使用)
+bool MQTTManager::connect() {
+    if (clientConnected()) {
+        return true;
+    }
+    
+    if (connectState == MqttConnectState::IDLE && !startConnect(millis())) {
+        return false;
+    }
+    
+    // 最長等待時間為各階段逾時的總和
+    while (connectState != MqttConnectState::IDLE && connectState != MqttConnectState::CONNECTED) {
+        advanceConnect(millis());
+        delay(10);
+    }
+    
+    return isMqttConnected;
+}
+
+// 主動乾淨斷線
+void MQTTManager::disconnect() {
+    if (clientConnected()) {
+        clientPublish(STATUS_TOPIC, (const uint8_t*)"offline", 7, true);
+        if (mqtt5Client) {
+            mqtt5Client->disconnect();
+        } else {
+            mqttClient->disconnect();
+        }
+    }
+    
+    link.stop();
+    connectState = MqttConnectState::IDLE;
+    isMqttConnected = false;
+    
+    reconnectPolicy.onDisconnected(true);
+    reconnectDelay = reconnectPolicy.nextDelay();
+    lastMqttReconnectAttempt = millis();
+    disconnectedSince = lastMqttReconnectAttempt;
+}
+
+// 設置重連退避的基準時間與上限
+void MQTTManager::setReconnectBackoff(unsigned long baseDelay, unsigned long maxDelay) {
+    reconnectPolicy.configure(baseDelay, maxDelay);
+}
+
+// 開始新的連線嘗試
+bool MQTTManager::startConnect(unsigned long currentMillis) {
+    if (!wifiManager->isConnected()) {
+        LOG_W("WiFi未連接，無法連接MQTT");
+        reconnectDelay = reconnectPolicy.nextDelay();
+        return false;
+    }
+    
+    stats.connectAttempts++;
+    if (disconnectedSince == 0) {
+        disconnectedSince = currentMillis;
+    }
+    
+    // 依健康分數選擇伺服器
+    uint8_t previous = brokers.currentIndex();
+    if (brokers.selectForReconnect(currentMillis)) {
+        LOG_I("MQTT伺服器切換: %s -> %s", brokers.at(previous).host, brokers.current().host);
+    }
+    const BrokerEndpoint& broker = brokers.current();
+    if (tls) {
+        tls->setHostname(broker.host);
+    }
+    connectStartedMillis = currentMillis;
+    // MQTT 3.1.1沒有接收上限，MQTT 5在CONNACK後改用伺服器公告的值
+    outbox.setReceiveMaximum(0xFFFF);
+    
+    // 保留會話時使用固定的客戶端ID，伺服器才能找回同一個會話；否則每次生成唯一的客戶端ID
+    if (persistentSession) {
+        snprintf(clientId, sizeof(clientId), "%s%s", clientIdPrefix, deviceId.c_str());
+    } else {
+        snprintf(clientId, sizeof(clientId), "%s%08lX", clientIdPrefix, (unsigned long)random(0xFFFFFFFF));
+    }
+    
+    LOG_I("嘗試連接MQTT伺服器 %s:%u 使用ID: %s", broker.host, broker.port, clientId);
+    
+    if (!link.beginResolve(broker.host)) {
+        failConnect("DNS查詢失敗");
+        return false;
+    }
+    
+    enterConnectState(MqttConnectState::RESOLVING, currentMillis);
+    return true;
+}
+
+// 推進連線狀態機一步
+bool MQTTManager::advanceConnect(unsigned long currentMillis) {
+    unsigned long elapsed = currentMillis - connectStateSince;
+    
+    switch (connectState) {
+        case MqttConnectState::RESOLVING: {
+            MqttLink::PollResult result = link.pollResolve(brokerAddress);
+            if (result == MqttLink::POLL_DONE) {
+                if (link.beginConnect(brokerAddress, brokers.current().port)) {
+                    enterConnectState(MqttConnectState::CONNECTING, currentMillis);
+                } else {
+                    failConnect("無法建立TCP連線");
+                }
+            } else if (result == MqttLink::POLL_FAILED) {
+                failConnect("DNS解析失敗");
+            } else if (elapsed >= dnsTimeout) {
+                failConnect("DNS解析逾時");
+            }
+            break;
+        }
+        
+        case MqttConnectState::CONNECTING: {
+            MqttLink::PollResult result = link.pollConnect();
+            if (result == MqttLink::POLL_DONE) {
+                if (tls) {
+                    LatencyHistogram& histogram = tls->wasResumed() ? stats.tlsResumedMillis : stats.tlsFullMillis;
+                    histogram.record(tls->getHandshakeMillis());
+                }
+                
+                if (sendConnect()) {
+                    enterConnectState(MqttConnectState::AWAIT_CONNACK, currentMillis);
+                } else {
+                    failConnect("送出CONNECT失敗");
+                }
+            } else if (result == MqttLink::POLL_FAILED) {
+                failConnect("TCP連線失敗");
+            } else if (elapsed >= tcpTimeout) {
+                failConnect("TCP連線逾時");
+            }
+            break;
+        }
+        
+        case MqttConnectState::AWAIT_CONNACK: {
+            if (mqtt5Client) {
+                acceptConnack(currentMillis);
+                return connectState == MqttConnectState::CONNECTED;
+            }
+            
+            uint8_t header[4];
+            size_t received = link.peekBuffered(header, sizeof(header));
+            uint8_t returnCode;
+            
+            if (MqttPacket::parseConnack(header, received, &returnCode)) {
+                if (returnCode != 0) {
+                    logConnectError(returnCode);
+                    failConnect("伺服器拒絕連線");
+                    break;
+                }
+                
+                if (persistentSession) {
+                    LOG_I("MQTT會話%s", (header[2] & 0x01) ? "已恢復" : "為新會話");
+                }
+                
+                // CONNACK已在緩衝區中，交由PubSubClient讀取並進入已連線狀態
+                link.suppressNextConnect();
+                if (mqttClient->connect(clientId, NULL, NULL, STATUS_TOPIC, 0, true, "offline", !persistentSession)) {
+                    enterConnectState(MqttConnectState::CONNECTED, currentMillis);
+                    onConnected();
+                    return true;
+                }
+                logConnectError(mqttClient->state());
+                failConnect("CONNACK交接失敗");
+            } else if (received >= sizeof(header) || (received > 0 && header[0] != MQTT_PACKET_CONNACK)) {
+                failConnect("收到無效的CONNACK");
+            } else if (!link.connected()) {
+                failConnect("等待CONNACK時連線中斷");
+            } else if (elapsed >= connackTimeout) {
+                failConnect("等待CONNACK逾時");
+            }
+            break;
+        }
+        
+        case MqttConnectState::CONNECTED:
+            return true;
+        
+        case MqttConnectState::IDLE:
+        default:
+            break;
+    }
+    
+    return false;
+}
+
+// 切換連線階段
+void MQTTManager::enterConnectState(MqttConnectState state, unsigned long currentMillis) {
+    connectState = state;
+    connectStateSince = currentMillis;
+}
+
+// 連線失敗，回到閒置狀態等待重連
+void MQTTManager::failConnect(const char* reason) {
+    stats.connectFailures++;
+    brokers.recordFailure(millis());
+    link.stop();
+    connectState = MqttConnectState::IDLE;
+    reconnectDelay = reconnectPolicy.nextDelay();
+    lastMqttReconnectAttempt = millis();
+    LOG_W("MQTT連接失敗: %s，%lu ms後重試", reason, reconnectDelay);
+}
+
+// 推進回切前的候選伺服器探測，TCP連線建立即視為可連線，斷線期間放棄探測
+void MQTTManager::serviceBrokerProbe(unsigned long currentMillis) {
+    int8_t target = isMqttConnected ? brokers.pendingProbe() : -1;
+    if (target < 0) {
+        if (probeState != MqttConnectState::IDLE) {
+            probeLink.stop();
+            probeState = MqttConnectState::IDLE;
+        }
+        return;
+    }
+    
+    const BrokerEndpoint& broker = brokers.at(target);
+    unsigned long elapsed = currentMillis - probeStateSince;
+    
+    switch (probeState) {
+        case MqttConnectState::IDLE:
+            LOG_I("探測MQTT伺服器 %s:%u 是否已恢復", broker.host, broker.port);
+            if (!probeLink.beginResolve(broker.host)) {
+                finishBrokerProbe(currentMillis, false);
+                break;
+            }
+            probeState = MqttConnectState::RESOLVING;
+            probeStateSince = currentMillis;
+            break;
+        
+        case MqttConnectState::RESOLVING: {
+            MqttLink::PollResult result = probeLink.pollResolve(probeAddress);
+            if (result == MqttLink::POLL_DONE) {
+                if (probeLink.beginConnect(probeAddress, broker.port)) {
+                    probeState = MqttConnectState::CONNECTING;
+                    probeStateSince = currentMillis;
+                } else {
+                    finishBrokerProbe(currentMillis, false);
+                }
+            } else if (result == MqttLink::POLL_FAILED || elapsed >= dnsTimeout) {
+                finishBrokerProbe(currentMillis, false);
+            }
+            break;
+        }
+        
+        case MqttConnectState::CONNECTING: {
+            MqttLink::PollResult result = probeLink.pollConnect();
+            if (result == MqttLink::POLL_DONE) {
+                finishBrokerProbe(currentMillis, true);
+            } else if (result == MqttLink::POLL_FAILED || elapsed >= tcpTimeout) {
+                finishBrokerProbe(currentMillis, false);
+            }
+            break;
+        }
+        
+        default:
+            finishBrokerProbe(currentMillis, false);
+            break;
+    }
+}
+
+// 結束探測並把結果交給BrokerPool
+void MQTTManager::finishBrokerProbe(unsigned long currentMillis, bool reachable) {
+    int8_t target = brokers.pendingProbe();
+    probeLink.stop();
+    probeState = MqttConnectState::IDLE;
+    if (target < 0) {
+        return;
+    }
+    
+    brokers.recordProbe(target, currentMillis, reachable);
+    if (!reachable) {
+        LOG_W("MQTT伺服器 %s 仍無法連線，%lu 分鐘後再探測", brokers.at(target).host,
+              (BrokerPool::MIN_DWELL << brokers.getFailbackFailures()) / 60000);
+    }
+}
+
+// 直接送出CONNECT封包
+bool MQTTManager::sendConnect() {
+    MqttConnectOptions options;
+    options.clientId = clientId;
+    options.username = NULL;
+    options.password = NULL;
+    options.willTopic = STATUS_TOPIC;
+    options.willMessage = "offline";
+    options.willQos = 0;
+    options.willRetain = true;
+    options.cleanSession = !persistentSession;
+    options.keepAlive = KEEPALIVE_SECONDS;
+    options.protocolVersion = protocolVersion;
+    options.sessionExpiry = sessionExpiry;
+    
+    // 保留會話時不清除先前的訂閱與未確認訊息
+    if (protocolVersion == MQTT_VERSION_5) {
+        if (persistentSession && options.sessionExpiry == 0) {
+            options.sessionExpiry = DEFAULT_SESSION_EXPIRY;
+        }
+        if (options.sessionExpiry > 0) {
+            options.cleanSession = false;
+        }
+    }
+    
+    uint8_t packet[128];
+    size_t length = MqttPacket::buildConnect(packet, sizeof(packet), options);
+    if (length == 0) {
+        return false;
+    }
+    
+    return link.write(packet, length) == length;
+}
+
+// 處理緩衝區中的MQTT 5 CONNACK
+void MQTTManager::acceptConnack(unsigned long currentMillis) {
+    Mqtt5Connack connack;
+    int result = mqtt5Client->acceptConnack(connack);
+    
+    if (result > 0) {
+        if (connack.reasonCode >= 0x80) {
+            LOG_E("MQTT 5連線被拒絕，原因碼 0x%02X: %s", connack.reasonCode,
+                  Mqtt5Client::describeReason(connack.reasonCode));
+            failConnect("伺服器拒絕連線");
+            return;
+        }
+        
+        LOG_I("MQTT 5會話%s，主題別名上限: %u，接收上限: %u",
+              connack.sessionPresent ? "已恢復" : "為新會話", connack.topicAliasMaximum, connack.receiveMaximum);
+        outbox.setReceiveMaximum(connack.receiveMaximum);
+        enterConnectState(MqttConnectState::CONNECTED, currentMillis);
+        onConnected();
+    } else if (result < 0) {
+        failConnect("收到無效的CONNACK");
+    } else if (!link.connected()) {
+        failConnect("等待CONNACK時連線中斷");
+    } else if (currentMillis - connectStateSince >= connackTimeout) {
+        failConnect("等待CONNACK逾時");
+    }
+}
+
+// 目前協議的連線狀態
+bool MQTTManager::clientConnected() const {
+    return mqtt5Client ? mqtt5Client->connected() : mqttClient->connected();
+}
+
+// 以目前協議發布QoS 0訊息
+bool MQTTManager::clientPublish(const char* topic, const uint8_t* payload, size_t length, bool retain) {
+    if (mqtt5Client) {
+        return mqtt5Client->publish(topic, payload, length, retain);
+    }
+    return mqttClient->publish(topic, payload, length, retain);
+}
+
+// 訂閱主題 (封包ID由QoS 1佇列分配，不使用PubSubClient與Mqtt5Client各自的計數器)
+bool MQTTManager::clientSubscribe(const char* filter) {
+    return sendSubscribeBatch(&filter, 1);
+}
+
+// 取消訂閱主題
+bool MQTTManager::clientUnsubscribe(const char* filter) {
+    return sendUnsubscribe(filter);
+}
+
+// 以批次SUBSCRIBE恢復訂閱登記表中的所有過濾器
+bool MQTTManager::restoreSubscriptions() {
+    static const uint8_t MAX_BATCH = MQTT_SUBSCRIBE_BATCH_MAX;
+    
+    // 列舉時過濾器字串只在回調期間有效，先複製到暫存區 (只在mqttTask中呼叫，使用靜態緩衝區)
+    static char names[512];
+    const char* filters[MAX_BATCH];
+    size_t used = 0;
+    uint8_t count = 0;
+    uint8_t packets = 0;
+    bool result = true;
+    
+    restoredSubscriptions = 0;
+    
+    auto flush = [&]() {
+        if (count == 0) {
+            return;
+        }
+        result = sendSubscribeBatch(filters, count) && result;
+        restoredSubscriptions += count;
+        packets++;
+        count = 0;
+        used = 0;
+    };
+    
+    router.forEachFilter([&](const char* filter) {
+        size_t length = strlen(filter) + 1;
+        if (count >= MAX_BATCH || used + length > sizeof(names)) {
+            flush();
+        }
+        memcpy(names + used, filter, length);
+        filters[count++] = names + used;
+        used += length;
+    });
+    flush();
+    
+    if (restoredSubscriptions > 0) {
+        LOG_I("已恢復 %u 個訂閱 (%u 個SUBSCRIBE封包，QoS %u)", restoredSubscriptions, packets, subscriptionQos);
+    }
+    return result;
+}
+
+// 送出一個批次SUBSCRIBE封包
+bool MQTTManager::sendSubscribeBatch(const char* const* filters, uint8_t count) {
+    static uint8_t packet[600];
+    
+    // 與QoS 1佇列共用封包ID，避免和在途的PUBLISH衝突
+    subscribePacketId = outbox.reservePacketId();
+    size_t length = MqttPacket::buildSubscribe(packet, sizeof(packet), subscribePacketId, filters, count,
+                                               subscriptionQos, protocolVersion);
+    if (length == 0) {
+        LOG_W("SUBSCRIBE封包過長，無法恢復訂閱");
+        return false;
+    }
+    
+    return link.write(packet, length) == length;
+}
+
+// 送出UNSUBSCRIBE封包
+bool MQTTManager::sendUnsubscribe(const char* filter) {
+    uint8_t packet[TopicRouter::MAX_FILTER_LENGTH + 12];
+    size_t length = MqttPacket::buildSubscription(packet, sizeof(packet), MQTT_PACKET_UNSUBSCRIBE,
+                                                  outbox.reservePacketId(), filter, 0, protocolVersion);
+    if (length == 0) {
+        return false;
+    }
+    
+    return link.write(packet, length) == length;
+}
+
+// 設置保留會話
+void MQTTManager::setPersistentSession(bool enabled) {
+    persistentSession = enabled;
+    subscriptionQos = enabled ? 1 : 0;
+}
+
+// 是否保留會話
+bool MQTTManager::isPersistentSession() const {
+    return persistentSession;
+}
+
+// 獲取最近一次連線恢復的訂閱數
+uint8_t MQTTManager::getRestoredSubscriptions() const {
+    return restoredSubscriptions;
+}
+
+// 遙測每個發布間隔都會送到裝置主題與房間主題，改用別名可省下與負載相當的主題字串
+void MQTTManager::reserveTopicAliases() {
+    if (!mqtt5Client) {
+        return;
+    }
+    
+    mqtt5Client->clearAliases();
+    mqtt5Client->reserveAlias(topics.deviceTopic);
+    if (topics.roomTopic[0] != '\0') {
+        mqtt5Client->reserveAlias(topics.roomTopic);
+    }
+}
+
+// 選擇MQTT協議等級
+bool MQTTManager::setProtocolVersion(uint8_t version, uint32_t sessionExpirySeconds) {
+    if (version != MQTT_VERSION_3_1_1 && version != MQTT_VERSION_5) {
+        return false;
+    }
+    
+    protocolVersion = version;
+    sessionExpiry = version == MQTT_VERSION_5 ? sessionExpirySeconds : 0;
+    outbox.setProtocolVersion(version);
+    
+    if (version == MQTT_VERSION_5 && mqtt5Client == nullptr) {
+        mqtt5Client = new Mqtt5Client(link);
+    } else if (version == MQTT_VERSION_3_1_1 && mqtt5Client != nullptr) {
+        delete mqtt5Client;
+        mqtt5Client = nullptr;
+    }
+    
+    return true;
+}
+
+// 啟用TLS
+bool MQTTManager::setTls(const char* caCert, bool resumeSessions) {
+    if (tls == nullptr) {
+        tls = new MqttTls();
+    }
+    
+    if (!tls->configure(caCert, brokers.current().host, resumeSessions)) {
+        link.setTls(nullptr);
+        delete tls;
+        tls = nullptr;
+        return false;
+    }
+    
+    link.setTls(tls);
+    
+    // 完整握手在ESP32上需要數百毫秒到數秒，TCP階段的逾時包含握手時間
+    if (tcpTimeout < 10000) {
+        tcpTimeout = 10000;
+    }
+    return true;
+}
+
+// 獲取TLS加密層
+const MqttTls* MQTTManager::getTls() const {
+    return tls;
+}
+
+// 加入備援伺服器
+bool MQTTManager::addBroker(const char* host, uint16_t port) {
+    if (!brokers.add(host, port)) {
+        LOG_W("無法加入MQTT伺服器 %s (清單已滿或地址過長)", host);
+        return false;
+    }
+    LOG_I("加入備援MQTT伺服器 %s:%u", host, port);
+    return true;
+}
+
+// 獲取伺服器清單與健康狀態
+const BrokerPool& MQTTManager::getBrokerPool() const {
+    return brokers;
+}
+
+// 獲取使用的協議等級
+uint8_t MQTTManager::getProtocolVersion() const {
+    return protocolVersion;
+}
+
+// 獲取最近一次MQTT 5失敗的原因碼
+uint8_t MQTTManager::getLastReasonCode() const {
+    return mqtt5Client ? mqtt5Client->getLastReasonCode() : 0;
+}
+
+// 獲取MQTT 5主題別名省下的位元組數
+uint32_t MQTTManager::getAliasBytesSaved() const {
+    return mqtt5Client ? mqtt5Client->getAliasBytesSaved() : 0;
+}
+
+// 連線完成後的訂閱與狀態發布
+void MQTTManager::onConnected() {
+    LOG_I("MQTT伺服器連接成功");
+    
+    isMqttConnected = true;
+    reconnectPolicy.onConnected();
+    
+    unsigned long now = millis();
+    brokers.recordConnect(now, now - connectStartedMillis);
+    
+    // 從斷線(或第一次嘗試)到連線完成的時間
+    if (disconnectedSince != 0) {
+        stats.reconnectMillis.record(millis() - disconnectedSince);
+        disconnectedSince = 0;
+    }
+    
+    // 未確認的QoS 1訊息在下一次loop()以DUP旗標重送
+    outbox.markForRetransmit();
+    
+    // 發布在線狀態
+    clientPublish(STATUS_TOPIC, (const uint8_t*)"online", 6, true);
+    
+    // 以單一批次SUBSCRIBE恢復訂閱登記表 (保留會話時伺服器可能已有訂閱，重送無副作用)
+    restoreSubscriptions();
+    
+    // 公告支援的編碼
+    announceCapabilities();
+    
+    // 每次連線都發布完整狀態，斷線期間App可能錯過差異訊息
+    if (shadowEnabled) {
+        shadow.requestFull();
+        publishShadowFull();
+    }
+}
+
+// 輸出連線錯誤碼說明
+void MQTTManager::logConnectError(int state) {
+    const char* description;
+    switch (state) {
+        case -4: description = "連接超時"; break;
+        case -3: description = "伺服器不可用"; break;
+        case -2: description = "錯誤的網絡連接"; break;
+        case -1: description = "客戶端不可用"; break;
+        case 1: description = "協議版本錯誤"; break;
+        case 2: description = "客戶端ID被拒絕"; break;
+        case 3: description = "伺服器不可用"; break;
+        case 4: description = "用戶名/密碼錯誤"; break;
+        case 5: description = "未授權"; break;
+        default: description = "未知錯誤"; break;
+    }
+    
+    LOG_E("MQTT連接失敗，錯誤碼: %d (%s)", state, description);
+}
+
+// 設置連線各階段的逾時
+void MQTTManager::setConnectTimeouts(unsigned long dnsMs, unsigned long tcpMs, unsigned long connackMs) {
+    dnsTimeout = dnsMs;
+    tcpTimeout = tcpMs;
+    connackTimeout = connackMs;
+}
+
+// 獲取連線狀態機目前階段
+MqttConnectState MQTTManager::getConnectState() const {
+    return connectState;
+}
+
+// 獲取上一次loop()耗時
+unsigned long MQTTManager::getLastLoopMicros() const {
+    return lastLoopMicros;
+}
+
+// 獲取loop()最長耗時
+unsigned long MQTTManager::getMaxLoopMicros() const {
+    return maxLoopMicros;
+}
+
+// 獲取等待PUBACK的QoS 1訊息數
+uint8_t MQTTManager::getInFlightDepth() const {
+    return outbox.getInFlight();
+}
+
+// 獲取QoS 1佇列中的訊息數
+uint8_t MQTTManager::getOutboxDepth() const {
+    return outbox.getQueued();
+}
+
+// 獲取QoS 1累計重送次數
+uint32_t MQTTManager::getRetransmitCount() const {
+    return outbox.getRetransmitCount();
+}
+
+// 獲取QoS 1因佇列已滿而丟棄的訊息數
+uint32_t MQTTManager::getOutboxDropped() const {
+    return outbox.getDroppedCount();
+}
+
+// 獲取連接狀態
+bool MQTTManager::isConnected() const {
+    return isMqttConnected;
+}
+
+// 獲取傳輸狀態
+bool MQTTManager::isTransmitting() const {
+    return isMqttTransmitting.load(std::memory_order_acquire);
+}
+
+// 獲取傳輸圖標閃爍時間
+unsigned long MQTTManager::getIconBlinkMillis() const {
+    return mqttIconBlinkMillis.load(std::memory_order_relaxed);
+}
+
+// 設置傳輸狀態
+void MQTTManager::setTransmitting(bool state) {
+    if (state) {
+        mqttIconBlinkMillis.store(millis(), std::memory_order_relaxed);
+    }
+    
+    isMqttTransmitting.store(state, std::memory_order_release);
+}
+
+// 獲取客戶端實例
+PubSubClient* MQTTManager::getClient() {
+    return mqttClient;
+}
+
+// 獲取基礎主題
+String MQTTManager::getBaseTopic() const {
+    return String(mqttTopic);
+}
+
+// 生成完整的設備主題路徑
+String MQTTManager::getDeviceTopic(const String& suffix) const {
+    String result = topics.deviceTopic;
+    
+    if (suffix.length() > 0) {
+        result += "/" + suffix;
+    }
+    
+    return result;
+}
+
+// 獲取預先計算的設備主題（不產生配置）
+const char* MQTTManager::getDeviceTopicCStr() const {
+    return topics.deviceTopic;
 }
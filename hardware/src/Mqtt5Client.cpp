@@ -0,0 +1,417 @@
+#include "Mqtt5Client.h"
+#include "Logger.h"
+
+Mqtt5Client::Mqtt5Client(MqttLink& linkRef)
+    : link(linkRef),
+      sessionUp(false),
+      keepAlive(15),
+      aliasMaximum(0),
+      maximumPacketSize(0),
+      nextPacketId(1),
+      lastOutbound(0),
+      lastInbound(0),
+      pingOutstanding(false),
+      lastReasonCode(0),
+      aliasHits(0),
+      aliasBytesSaved(0),
+      rxState(0),
+      rxHeader(0),
+      rxRemaining(0),
+      rxLength(0),
+      rxMultiplier(1) {
+    memset(aliases, 0, sizeof(aliases));
+}
+
+void Mqtt5Client::setCallback(Mqtt5Callback callbackFunction) {
+    callback = callbackFunction;
+}
+
+void Mqtt5Client::setKeepAlive(uint16_t seconds) {
+    keepAlive = seconds;
+}
+
+int Mqtt5Client::acceptConnack(Mqtt5Connack& connack) {
+    uint8_t data[128];
+    size_t received = link.peekBuffered(data, sizeof(data));
+    int total = MqttPacket::parseConnack5(data, received, &connack);
+    if (total == 0 && received >= sizeof(data)) {
+        // 屬性太多，超過可檢查的範圍
+        return -1;
+    }
+    if (total <= 0) {
+        return total;
+    }
+
+    // 取走CONNACK，之後的資料由loop()處理
+    link.read(data, total);
+
+    if (connack.reasonCode >= 0x80) {
+        lastReasonCode = connack.reasonCode;
+        return 1;
+    }
+
+    sessionUp = true;
+    aliasMaximum = connack.topicAliasMaximum;
+    maximumPacketSize = connack.maximumPacketSize;
+    if (connack.serverKeepAlive != 0) {
+        keepAlive = connack.serverKeepAlive;
+    }
+    lastOutbound = lastInbound = millis();
+    pingOutstanding = false;
+    rxState = 0;
+
+    // 別名只在單一連線內有效
+    for (uint8_t i = 0; i < ALIAS_SLOTS; i++) {
+        aliases[i].announced = false;
+    }
+
+    return 1;
+}
+
+bool Mqtt5Client::connected() const {
+    return sessionUp && link.fd() >= 0;
+}
+
+bool Mqtt5Client::loop() {
+    if (!sessionUp) {
+        return false;
+    }
+    if (!link.connected()) {
+        close();
+        return false;
+    }
+
+    // 逐位元組組裝封包，讀完目前可用的資料就返回
+    while (sessionUp && link.available() > 0) {
+        int value = link.read();
+        if (value < 0) {
+            break;
+        }
+        uint8_t b = (uint8_t)value;
+        lastInbound = millis();
+
+        switch (rxState) {
+            case 0:
+                rxHeader = b;
+                rxRemaining = 0;
+                rxLength = 0;
+                rxMultiplier = 1;
+                rxState = 1;
+                break;
+
+            case 1:
+                rxRemaining += (b & 0x7F) * rxMultiplier;
+                rxMultiplier *= 128;
+                if ((b & 0x80) != 0) {
+                    if (rxMultiplier > 128 * 128 * 128) {
+                        LOG_E("MQTT 5封包長度格式錯誤，關閉連線");
+                        disconnect(0x81);
+                        return false;
+                    }
+                    break;
+                }
+                if (rxRemaining == 0) {
+                    rxState = 0;
+                    handlePacket(rxHeader, buffer, 0, false);
+                } else {
+                    rxState = 2;
+                }
+                break;
+
+            default:
+                if (rxLength < BUFFER_SIZE) {
+                    buffer[rxLength] = b;
+                }
+                rxLength++;
+                if (rxLength == rxRemaining) {
+                    rxState = 0;
+                    bool truncated = rxLength > BUFFER_SIZE;
+                    handlePacket(rxHeader, buffer, truncated ? BUFFER_SIZE : rxLength, truncated);
+                }
+                break;
+        }
+    }
+
+    if (!sessionUp) {
+        return false;
+    }
+
+    // 心跳: 一個心跳間隔內沒有收發資料就送出PINGREQ，仍未收到回應則斷線
+    unsigned long now = millis();
+    unsigned long interval = (unsigned long)keepAlive * 1000UL;
+    if (keepAlive > 0 && (now - lastInbound >= interval || now - lastOutbound >= interval)) {
+        if (pingOutstanding) {
+            LOG_W("MQTT 5心跳逾時，關閉連線");
+            close();
+            return false;
+        }
+
+        static const uint8_t PINGREQ[] = {MQTT_PACKET_PINGREQ, 0x00};
+        if (!send(PINGREQ, sizeof(PINGREQ))) {
+            return false;
+        }
+        pingOutstanding = true;
+        lastInbound = now;
+    }
+
+    return true;
+}
+
+void Mqtt5Client::handlePacket(uint8_t header, uint8_t* body, size_t length, bool truncated) {
+    switch (header & 0xF0) {
+        case MQTT_PACKET_PUBLISH:
+            if (truncated) {
+                LOG_W("MQTT 5訊息超過 %u 位元組，已丟棄", (unsigned)BUFFER_SIZE);
+                return;
+            }
+            handlePublish(header, body, length);
+            break;
+
+        case MQTT_PACKET_SUBACK:
+        case MQTT_PACKET_UNSUBACK: {
+            // 封包ID(2) + 屬性 + 每個過濾器一個原因碼
+            uint32_t propertiesLength;
+            int propertyBytes = length > 2 ? MqttPacket::decodeRemainingLength(body + 2, length - 2, &propertiesLength) : -1;
+            if (propertyBytes <= 0) {
+                break;
+            }
+            for (size_t i = 2 + propertyBytes + propertiesLength; i < length; i++) {
+                if (body[i] >= 0x80) {
+                    lastReasonCode = body[i];
+                    LOG_W("MQTT 5%s失敗，原因碼 0x%02X: %s",
+                          (header & 0xF0) == MQTT_PACKET_SUBACK ? "訂閱" : "取消訂閱",
+                          body[i], describeReason(body[i]));
+                }
+            }
+            break;
+        }
+
+        case MQTT_PACKET_PINGRESP:
+            pingOutstanding = false;
+            break;
+
+        case MQTT_PACKET_DISCONNECT: {
+            uint8_t reasonCode = length > 0 ? body[0] : 0x00;
+            lastReasonCode = reasonCode;
+            LOG_W("伺服器中斷MQTT 5連線，原因碼 0x%02X: %s", reasonCode, describeReason(reasonCode));
+            close();
+            break;
+        }
+
+        default:
+            // PUBACK由MqttLink的封包監聽處理，AUTH等其他封包忽略
+            break;
+    }
+}
+
+void Mqtt5Client::handlePublish(uint8_t header, uint8_t* body, size_t length) {
+    uint8_t qos = (header >> 1) & 0x03;
+    if (length < 2) {
+        return;
+    }
+
+    size_t topicLength = ((size_t)body[0] << 8) | body[1];
+    size_t pos = 2 + topicLength;
+    uint16_t packetId = 0;
+    if (qos > 0) {
+        if (pos + 2 > length) {
+            return;
+        }
+        packetId = ((uint16_t)body[pos] << 8) | body[pos + 1];
+        pos += 2;
+    }
+
+    uint32_t propertiesLength;
+    int propertyBytes = pos < length ? MqttPacket::decodeRemainingLength(body + pos, length - pos, &propertiesLength) : -1;
+    if (propertyBytes <= 0 || pos + propertyBytes + propertiesLength > length) {
+        return;
+    }
+    pos += propertyBytes + propertiesLength;
+
+    if (qos == 1) {
+        uint8_t puback[] = {MQTT_PACKET_PUBACK, 0x02, (uint8_t)(packetId >> 8), (uint8_t)(packetId & 0xFF)};
+        send(puback, sizeof(puback));
+    }
+
+    // 把主題往前移兩個位元組並補上結尾，負載位置不變 (與PubSubClient相同的做法)
+    memmove(body, body + 2, topicLength);
+    body[topicLength] = '\0';
+
+    if (callback) {
+        callback((char*)body, body + pos, length - pos);
+    }
+}
+
+bool Mqtt5Client::publish(const char* topic, const uint8_t* payload, size_t length, bool retain) {
+    if (!connected()) {
+        return false;
+    }
+
+    // 查詢別名，伺服器不支援或超過上限時送完整主題
+    uint16_t alias = 0;
+    const char* wireTopic = topic;
+    for (uint8_t i = 0; i < ALIAS_SLOTS && i < aliasMaximum; i++) {
+        if (aliases[i].topic[0] != '\0' && strcmp(aliases[i].topic, topic) == 0) {
+            alias = i + 1;
+            if (aliases[i].announced) {
+                wireTopic = "";
+                aliasHits++;
+                aliasBytesSaved += strlen(topic) - 3;  // 省下主題字串，多了別名屬性
+            }
+            break;
+        }
+    }
+
+    uint8_t header[sizeof(aliases[0].topic) + 12];
+    size_t headerLength = MqttPacket::buildPublishHeader(header, sizeof(header), wireTopic, length, 0, retain,
+                                                         false, 0, MQTT_VERSION_5, alias);
+    if (headerLength == 0) {
+        return false;
+    }
+
+    if (maximumPacketSize != 0 && headerLength + length > maximumPacketSize) {
+        lastReasonCode = 0x95;
+        LOG_W("MQTT 5訊息超過伺服器上限 %lu 位元組: %s", (unsigned long)maximumPacketSize, topic);
+        return false;
+    }
+
+    if (!send(header, headerLength)) {
+        return false;
+    }
+    if (length > 0 && !send(payload, length)) {
+        return false;
+    }
+
+    if (alias != 0) {
+        aliases[alias - 1].announced = true;
+    }
+    return true;
+}
+
+bool Mqtt5Client::publish(const char* topic, const char* payload, bool retain) {
+    return publish(topic, (const uint8_t*)payload, strlen(payload), retain);
+}
+
+bool Mqtt5Client::subscribe(const char* filter, uint8_t qos) {
+    if (!connected()) {
+        return false;
+    }
+
+    uint8_t packet[sizeof(aliases[0].topic) + 12];
+    size_t length = MqttPacket::buildSubscription(packet, sizeof(packet), MQTT_PACKET_SUBSCRIBE, takePacketId(),
+                                                  filter, qos, MQTT_VERSION_5);
+    return length > 0 && send(packet, length);
+}
+
+bool Mqtt5Client::unsubscribe(const char* filter) {
+    if (!connected()) {
+        return false;
+    }
+
+    uint8_t packet[sizeof(aliases[0].topic) + 12];
+    size_t length = MqttPacket::buildSubscription(packet, sizeof(packet), MQTT_PACKET_UNSUBSCRIBE, takePacketId(),
+                                                  filter, 0, MQTT_VERSION_5);
+    return length > 0 && send(packet, length);
+}
+
+void Mqtt5Client::disconnect(uint8_t reasonCode) {
+    if (connected()) {
+        uint8_t packet[] = {MQTT_PACKET_DISCONNECT, 0x01, reasonCode};
+        send(packet, sizeof(packet));
+    }
+    close();
+}
+
+bool Mqtt5Client::reserveAlias(const char* topic) {
+    if (topic == NULL || topic[0] == '\0' || strlen(topic) >= sizeof(aliases[0].topic)) {
+        return false;
+    }
+
+    for (uint8_t i = 0; i < ALIAS_SLOTS; i++) {
+        if (strcmp(aliases[i].topic, topic) == 0) {
+            return true;
+        }
+        if (aliases[i].topic[0] == '\0') {
+            strcpy(aliases[i].topic, topic);
+            aliases[i].announced = false;
+            return true;
+        }
+    }
+    return false;
+}
+
+void Mqtt5Client::clearAliases() {
+    memset(aliases, 0, sizeof(aliases));
+}
+
+uint8_t Mqtt5Client::getLastReasonCode() const {
+    return lastReasonCode;
+}
+
+uint32_t Mqtt5Client::getAliasHits() const {
+    return aliasHits;
+}
+
+uint32_t Mqtt5Client::getAliasBytesSaved() const {
+    return aliasBytesSaved;
+}
+
+const char* Mqtt5Client::describeReason(uint8_t reasonCode) {
+    switch (reasonCode) {
+        case 0x00: return "成功";
+        case 0x04: return "斷線並發布遺囑";
+        case 0x80: return "未指定的錯誤";
+        case 0x81: return "封包格式錯誤";
+        case 0x82: return "協議錯誤";
+        case 0x83: return "實作特定的錯誤";
+        case 0x84: return "不支援的協議版本";
+        case 0x85: return "客戶端ID無效";
+        case 0x86: return "使用者名稱或密碼錯誤";
+        case 0x87: return "未授權";
+        case 0x88: return "伺服器無法使用";
+        case 0x89: return "伺服器忙碌";
+        case 0x8A: return "已被封鎖";
+        case 0x8B: return "伺服器關閉中";
+        case 0x8D: return "心跳逾時";
+        case 0x8E: return "會話被接管";
+        case 0x8F: return "主題過濾器無效";
+        case 0x90: return "主題名稱無效";
+        case 0x93: return "超過接收上限";
+        case 0x94: return "主題別名無效";
+        case 0x95: return "封包過大";
+        case 0x96: return "訊息速率過高";
+        case 0x97: return "超過配額";
+        case 0x9A: return "不支援保留訊息";
+        case 0x9B: return "不支援此QoS";
+        case 0x9C: return "請改用其他伺服器";
+        case 0x9D: return "伺服器已遷移";
+        case 0x9E: return "不支援共享訂閱";
+        case 0x9F: return "連線速率過高";
+        case 0xA2: return "不支援萬用字元訂閱";
+        default:   return "未知的原因碼";
+    }
+}
+
+bool Mqtt5Client::send(const uint8_t* data, size_t length) {
+    if (link.write(data, length) != length) {
+        close();
+        return false;
+    }
+    lastOutbound = millis();
+    return true;
+}
+
+uint16_t Mqtt5Client::takePacketId() {
+    uint16_t packetId = nextPacketId++;
+    if (nextPacketId == 0) {
+        nextPacketId = 1;
+    }
+    return packetId;
+}
+
+void Mqtt5Client::close() {
+    sessionUp = false;
+    pingOutstanding = false;
+    rxState = 0;
+    link.stop();
+}
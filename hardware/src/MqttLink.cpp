@@ -0,0 +1,512 @@
+#include "MqttLink.h"
+#include "MqttPacket.h"
+#include <lwip/sockets.h>
+#include <lwip/dns.h>
+#include <lwip/tcpip.h>
+#include <lwip/priv/tcpip_priv.h>
+
+// 一個DNS查詢的回調參數 (記錄送出時的查詢編號)
+struct MqttDnsRequest {
+    MqttDnsQuery* query;
+    uint32_t generation;
+};
+
+// 在TCP/IP執行緒中開始查詢的參數
+struct MqttDnsStart {
+    struct tcpip_api_call_data call;    // 必須是第一個成員
+    MqttDnsQuery* query;
+    const char* host;
+    err_t result;
+};
+
+// lwIP DNS查詢完成回調 (在TCP/IP執行緒中執行)
+static void mqttDnsFound(const char* name, const ip_addr_t* ipaddr, void* arg) {
+    MqttDnsRequest* request = static_cast<MqttDnsRequest*>(arg);
+    MqttDnsQuery* query = request->query;
+
+    // 已被新的查詢取代時不寫入結果
+    if (request->generation == query->generation) {
+        if (ipaddr != NULL) {
+            query->address = ip4_addr_get_u32(ip_2_ip4(ipaddr));
+            query->state = 1;
+        } else {
+            query->state = -1;
+        }
+    }
+    delete request;
+}
+
+// 在TCP/IP執行緒中開始查詢 (dns_gethostbyname不可在其他任務中直接呼叫)
+static err_t mqttDnsStart(struct tcpip_api_call_data* call) {
+    MqttDnsStart* start = reinterpret_cast<MqttDnsStart*>(call);
+    MqttDnsQuery* query = start->query;
+    query->generation++;
+    query->state = 0;
+
+    MqttDnsRequest* request = new MqttDnsRequest;
+    request->query = query;
+    request->generation = query->generation;
+
+    ip_addr_t address;
+    start->result = dns_gethostbyname(start->host, &address, mqttDnsFound, request);
+    if (start->result == ERR_INPROGRESS) {
+        // 回調負責釋放request
+        return ERR_OK;
+    }
+
+    if (start->result == ERR_OK) {
+        // IP字串或快取命中，立即完成
+        query->address = ip4_addr_get_u32(ip_2_ip4(&address));
+        query->state = 1;
+    } else {
+        query->state = -1;
+    }
+    delete request;
+    return ERR_OK;
+}
+
+MqttLink::MqttLink()
+    : sock(-1),
+      isConnected(false),
+      tcpReady(false),
+      tls(NULL),
+      swallowConnect(false),
+      writeTimeout(3000),
+      pingSentMillis(0),
+      rxStart(0),
+      rxEnd(0),
+      packetListener(NULL),
+      listenerContext(NULL),
+      sniffState(0) {
+    dnsQuery.generation = 0;
+    dnsQuery.state = -1;
+    dnsQuery.address = 0;
+}
+
+MqttLink::~MqttLink() {
+    closeSocket();
+}
+
+bool MqttLink::beginResolve(const char* host) {
+    MqttDnsStart start;
+    memset(&start, 0, sizeof(start));
+    start.query = &dnsQuery;
+    start.host = host;
+    start.result = ERR_ARG;
+
+    tcpip_api_call(mqttDnsStart, &start.call);
+    return start.result == ERR_OK || start.result == ERR_INPROGRESS;
+}
+
+MqttLink::PollResult MqttLink::pollResolve(IPAddress& address) {
+    if (dnsQuery.state == 0) {
+        return POLL_PENDING;
+    }
+
+    if (dnsQuery.state < 0) {
+        return POLL_FAILED;
+    }
+
+    address = IPAddress(dnsQuery.address);
+    return POLL_DONE;
+}
+
+bool MqttLink::beginConnect(IPAddress ip, uint16_t port) {
+    closeSocket();
+
+    sock = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if (sock < 0) {
+        return false;
+    }
+
+    int flags = fcntl(sock, F_GETFL, 0);
+    fcntl(sock, F_SETFL, flags | O_NONBLOCK);
+
+    struct sockaddr_in serverAddress;
+    memset(&serverAddress, 0, sizeof(serverAddress));
+    serverAddress.sin_family = AF_INET;
+    serverAddress.sin_port = htons(port);
+    serverAddress.sin_addr.s_addr = (uint32_t)ip;
+
+    int result = ::connect(sock, (struct sockaddr*)&serverAddress, sizeof(serverAddress));
+    if (result < 0 && errno != EINPROGRESS) {
+        closeSocket();
+        return false;
+    }
+
+    return true;
+}
+
+MqttLink::PollResult MqttLink::pollConnect() {
+    if (sock < 0) {
+        return POLL_FAILED;
+    }
+
+    if (isConnected) {
+        return POLL_DONE;
+    }
+
+    if (!tcpReady) {
+        // 以零逾時檢查socket是否可寫 (連線完成或失敗)
+        fd_set writeSet;
+        FD_ZERO(&writeSet);
+        FD_SET(sock, &writeSet);
+        struct timeval timeout = {0, 0};
+
+        int ready = select(sock + 1, NULL, &writeSet, NULL, &timeout);
+        if (ready < 0) {
+            closeSocket();
+            return POLL_FAILED;
+        }
+        if (ready == 0) {
+            return POLL_PENDING;
+        }
+
+        int socketError = 0;
+        socklen_t length = sizeof(socketError);
+        getsockopt(sock, SOL_SOCKET, SO_ERROR, &socketError, &length);
+        if (socketError != 0) {
+            closeSocket();
+            return POLL_FAILED;
+        }
+
+        int noDelay = 1;
+        setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+        tcpReady = true;
+
+        if (tls != NULL && !tls->begin(sock)) {
+            closeSocket();
+            return POLL_FAILED;
+        }
+    }
+
+    // TLS握手每次只推進到需要等待socket為止
+    if (tls != NULL) {
+        MqttTls::HandshakeResult result = tls->handshake();
+        if (result == MqttTls::HANDSHAKE_PENDING) {
+            return POLL_PENDING;
+        }
+        if (result == MqttTls::HANDSHAKE_FAILED) {
+            closeSocket();
+            return POLL_FAILED;
+        }
+    }
+
+    isConnected = true;
+    rxStart = rxEnd = 0;
+    return POLL_DONE;
+}
+
+void MqttLink::setTls(MqttTls* tlsLayer) {
+    tls = tlsLayer;
+}
+
+MqttTls* MqttLink::getTls() const {
+    return tls;
+}
+
+void MqttLink::suppressNextConnect() {
+    swallowConnect = true;
+}
+
+size_t MqttLink::peekBuffered(uint8_t* out, size_t length) {
+    fillBuffer();
+
+    size_t count = rxEnd - rxStart;
+    if (count > length) {
+        count = length;
+    }
+    memcpy(out, rxBuffer + rxStart, count);
+    return count;
+}
+
+void MqttLink::setPacketListener(MqttPacketListener listener, void* context) {
+    packetListener = listener;
+    listenerContext = context;
+}
+
+void MqttLink::setWriteTimeout(uint32_t timeoutMs) {
+    writeTimeout = timeoutMs;
+}
+
+int MqttLink::connect(IPAddress ip, uint16_t port) {
+    // 阻塞式備援介面，正常流程由MQTTManager分步完成連線
+    if (!beginConnect(ip, port)) {
+        return 0;
+    }
+
+    unsigned long start = millis();
+    while (millis() - start < BLOCKING_CONNECT_TIMEOUT) {
+        PollResult result = pollConnect();
+        if (result != POLL_PENDING) {
+            return result == POLL_DONE ? 1 : 0;
+        }
+        delay(10);
+    }
+
+    closeSocket();
+    return 0;
+}
+
+int MqttLink::connect(const char* host, uint16_t port) {
+    if (!beginResolve(host)) {
+        return 0;
+    }
+
+    IPAddress address;
+    unsigned long start = millis();
+    while (millis() - start < BLOCKING_CONNECT_TIMEOUT) {
+        PollResult result = pollResolve(address);
+        if (result == POLL_DONE) {
+            return connect(address, port);
+        }
+        if (result == POLL_FAILED) {
+            return 0;
+        }
+        delay(10);
+    }
+
+    return 0;
+}
+
+size_t MqttLink::write(uint8_t b) {
+    return write(&b, 1);
+}
+
+size_t MqttLink::write(const uint8_t* buf, size_t size) {
+    if (!isConnected || size == 0) {
+        return 0;
+    }
+
+    // CONNECT已由MQTTManager送出，丟棄PubSubClient重複產生的封包
+    if (swallowConnect && (buf[0] & 0xF0) == MQTT_PACKET_CONNECT) {
+        swallowConnect = false;
+        return size;
+    }
+    
+    // 記錄PINGREQ送出時間，用於計算與伺服器的往返時間
+    if ((buf[0] & 0xF0) == MQTT_PACKET_PINGREQ) {
+        pingSentMillis = millis();
+    }
+
+    size_t sent = 0;
+    unsigned long start = millis();
+
+    while (sent < size) {
+        int result = transmit(buf + sent, size - sent);
+        if (result > 0) {
+            sent += result;
+            continue;
+        }
+
+        if (result < 0) {
+            closeSocket();
+            break;
+        }
+
+        // 傳送緩衝區已滿，等待socket可寫
+        uint32_t elapsed = millis() - start;
+        if (elapsed >= writeTimeout) {
+            closeSocket();
+            break;
+        }
+
+        fd_set writeSet;
+        FD_ZERO(&writeSet);
+        FD_SET(sock, &writeSet);
+        uint32_t remaining = writeTimeout - elapsed;
+        struct timeval timeout = {(long)(remaining / 1000), (long)((remaining % 1000) * 1000)};
+        select(sock + 1, NULL, &writeSet, NULL, &timeout);
+    }
+
+    return sent;
+}
+
+int MqttLink::available() {
+    if (rxStart == rxEnd) {
+        fillBuffer();
+    }
+    return rxEnd - rxStart;
+}
+
+int MqttLink::read() {
+    if (available() <= 0) {
+        return -1;
+    }
+    uint8_t b = rxBuffer[rxStart++];
+    sniff(b);
+    return b;
+}
+
+int MqttLink::read(uint8_t* buf, size_t size) {
+    size_t count = 0;
+    while (count < size && available() > 0) {
+        size_t chunk = rxEnd - rxStart;
+        if (chunk > size - count) {
+            chunk = size - count;
+        }
+        memcpy(buf + count, rxBuffer + rxStart, chunk);
+        for (size_t i = 0; i < chunk; i++) {
+            sniff(rxBuffer[rxStart + i]);
+        }
+        rxStart += chunk;
+        count += chunk;
+    }
+    return count > 0 ? (int)count : -1;
+}
+
+int MqttLink::peek() {
+    if (available() <= 0) {
+        return -1;
+    }
+    return rxBuffer[rxStart];
+}
+
+void MqttLink::flush() {
+    // 寫入皆為直接送出，沒有需要清空的輸出緩衝區
+}
+
+void MqttLink::stop() {
+    closeSocket();
+}
+
+uint8_t MqttLink::connected() {
+    if (isConnected && rxStart == rxEnd) {
+        fillBuffer();
+    }
+    return isConnected || rxStart != rxEnd;
+}
+
+MqttLink::operator bool() {
+    return sock >= 0;
+}
+
+int MqttLink::fd() const {
+    return sock;
+}
+
+size_t MqttLink::buffered() const {
+    // TLS已解密但尚未讀入的資料不會讓socket變為可讀，也要計入
+    return rxEnd - rxStart + (tls != NULL && isConnected ? tls->pending() : 0);
+}
+
+unsigned long MqttLink::getPingSentMillis() const {
+    return pingSentMillis;
+}
+
+void MqttLink::sniff(uint8_t b) {
+    bool complete = false;
+
+    switch (sniffState) {
+        case 0:
+            sniffHeader = b;
+            sniffRemaining = 0;
+            sniffMultiplier = 1;
+            sniffBodyLength = 0;
+            sniffState = 1;
+            break;
+
+        case 1:
+            sniffRemaining += (b & 0x7F) * sniffMultiplier;
+            sniffMultiplier *= 128;
+            if ((b & 0x80) == 0) {
+                if (sniffRemaining == 0) {
+                    complete = true;
+                } else {
+                    sniffState = 2;
+                }
+            }
+            break;
+
+        default:
+            if (sniffBodyLength < SNIFF_BODY_SIZE) {
+                sniffBody[sniffBodyLength++] = b;
+            }
+            if (--sniffRemaining == 0) {
+                complete = true;
+            }
+            break;
+    }
+
+    if (complete) {
+        sniffState = 0;
+        if (packetListener != NULL) {
+            packetListener(sniffHeader, sniffBody, sniffBodyLength, listenerContext);
+        }
+    }
+}
+
+void MqttLink::fillBuffer() {
+    if (!isConnected) {
+        return;
+    }
+
+    // 緩衝區已讀完時從頭開始，否則把剩餘資料搬到前面
+    if (rxStart == rxEnd) {
+        rxStart = rxEnd = 0;
+    } else if (rxStart > 0) {
+        memmove(rxBuffer, rxBuffer + rxStart, rxEnd - rxStart);
+        rxEnd -= rxStart;
+        rxStart = 0;
+    }
+
+    if (rxEnd >= RX_BUFFER_SIZE) {
+        return;
+    }
+
+    int result = receive(rxBuffer + rxEnd, RX_BUFFER_SIZE - rxEnd);
+    if (result > 0) {
+        rxEnd += result;
+    } else if (result < 0) {
+        // 對方關閉連線或發生錯誤，保留已收到的資料供讀取
+        if (tls != NULL) {
+            tls->end();
+        }
+        ::close(sock);
+        sock = -1;
+        isConnected = false;
+        tcpReady = false;
+    }
+}
+
+int MqttLink::transmit(const uint8_t* buf, size_t size) {
+    if (tls != NULL) {
+        return tls->send(buf, size);
+    }
+
+    int result = send(sock, buf, size, 0);
+    if (result > 0) {
+        return result;
+    }
+    return result < 0 && errno != EAGAIN && errno != EWOULDBLOCK ? -1 : 0;
+}
+
+int MqttLink::receive(uint8_t* buf, size_t size) {
+    if (tls != NULL) {
+        return tls->recv(buf, size);
+    }
+
+    int result = recv(sock, buf, size, MSG_DONTWAIT);
+    if (result > 0) {
+        return result;
+    }
+    if (result == 0 || (errno != EAGAIN && errno != EWOULDBLOCK)) {
+        return -1;
+    }
+    return 0;
+}
+
+void MqttLink::closeSocket() {
+    if (tls != NULL) {
+        tls->end();
+    }
+    if (sock >= 0) {
+        ::close(sock);
+        sock = -1;
+    }
+    isConnected = false;
+    tcpReady = false;
+    swallowConnect = false;
+    rxStart = rxEnd = 0;
+    sniffState = 0;
+}
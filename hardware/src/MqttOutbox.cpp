@@ -0,0 +1,235 @@
+#include "MqttOutbox.h"
+#include "MqttPacket.h"
+
+MqttOutbox::MqttOutbox(uint8_t windowSize)
+    : windowSize(windowSize > 0 ? windowSize : 1),
+      receiveMaximum(0xFFFF),
+      protocolVersion(MQTT_VERSION_3_1_1),
+      nextPacketId(1),
+      retransmitCount(0),
+      droppedCount(0) {
+    memset(entries, 0, sizeof(entries));
+    lock = xSemaphoreCreateMutex();
+}
+
+MqttOutbox::~MqttOutbox() {
+    if (lock != NULL) {
+        vSemaphoreDelete(lock);
+    }
+}
+
+void MqttOutbox::setProtocolVersion(uint8_t version) {
+    protocolVersion = version;
+}
+
+void MqttOutbox::setReceiveMaximum(uint16_t maximum) {
+    // 0是協議錯誤，至少允許一則
+    receiveMaximum = maximum > 0 ? maximum : 1;
+}
+
+bool MqttOutbox::enqueue(const char* topic, const uint8_t* payload, size_t length, bool retain) {
+    if (length > sizeof(entries[0].payload) || strlen(topic) >= sizeof(entries[0].topic)) {
+        droppedCount++;
+        return false;
+    }
+
+    xSemaphoreTake(lock, portMAX_DELAY);
+
+    MqttOutboxEntry* slot = NULL;
+    for (uint8_t i = 0; i < CAPACITY; i++) {
+        if (!entries[i].used) {
+            slot = &entries[i];
+            break;
+        }
+    }
+
+    if (slot == NULL) {
+        droppedCount++;
+        xSemaphoreGive(lock);
+        return false;
+    }
+
+    slot->used = true;
+    slot->inFlight = false;
+    slot->dup = false;
+    slot->retain = retain;
+    slot->packetId = allocatePacketId();
+    slot->length = length;
+    slot->sentAt = 0;
+    strcpy(slot->topic, topic);
+    memcpy(slot->payload, payload, length);
+
+    xSemaphoreGive(lock);
+    return true;
+}
+
+uint8_t MqttOutbox::service(Print& out) {
+    uint8_t sentCount = 0;
+
+    // 依封包ID順序送出，盡量維持發布順序
+    while (true) {
+        xSemaphoreTake(lock, portMAX_DELAY);
+
+        uint8_t inFlight = 0;
+        MqttOutboxEntry* next = NULL;
+        for (uint8_t i = 0; i < CAPACITY; i++) {
+            MqttOutboxEntry& entry = entries[i];
+            if (!entry.used) {
+                continue;
+            }
+            if (entry.inFlight) {
+                inFlight++;
+            } else if (next == NULL || (uint16_t)(entry.packetId - next->packetId) > 0x8000) {
+                next = &entry;
+            }
+        }
+
+        if (next == NULL || inFlight >= window()) {
+            xSemaphoreGive(lock);
+            break;
+        }
+
+        // 先標記為在途再釋放鎖：enqueue()只使用空位，PUBACK與重送標記都在MQTT任務中處理，
+        // 寫入期間不會有其他任務修改這則訊息
+        next->inFlight = true;
+        xSemaphoreGive(lock);
+
+        bool written = send(out, *next);
+
+        xSemaphoreTake(lock, portMAX_DELAY);
+        if (written) {
+            next->sentAt = millis();
+        } else {
+            next->inFlight = false;
+        }
+        xSemaphoreGive(lock);
+
+        if (!written) {
+            break;
+        }
+        sentCount++;
+    }
+
+    return sentCount;
+}
+
+void MqttOutbox::acknowledge(uint16_t packetId) {
+    xSemaphoreTake(lock, portMAX_DELAY);
+
+    for (uint8_t i = 0; i < CAPACITY; i++) {
+        if (entries[i].used && entries[i].inFlight && entries[i].packetId == packetId) {
+            entries[i].used = false;
+            entries[i].inFlight = false;
+            break;
+        }
+    }
+
+    xSemaphoreGive(lock);
+}
+
+void MqttOutbox::markForRetransmit() {
+    xSemaphoreTake(lock, portMAX_DELAY);
+
+    for (uint8_t i = 0; i < CAPACITY; i++) {
+        if (entries[i].used && entries[i].inFlight) {
+            entries[i].inFlight = false;
+            entries[i].dup = true;
+            retransmitCount++;
+        }
+    }
+
+    xSemaphoreGive(lock);
+}
+
+uint8_t MqttOutbox::getInFlight() const {
+    uint8_t count = 0;
+    for (uint8_t i = 0; i < CAPACITY; i++) {
+        if (entries[i].used && entries[i].inFlight) {
+            count++;
+        }
+    }
+    return count;
+}
+
+uint8_t MqttOutbox::getQueued() const {
+    uint8_t count = 0;
+    for (uint8_t i = 0; i < CAPACITY; i++) {
+        if (entries[i].used) {
+            count++;
+        }
+    }
+    return count;
+}
+
+bool MqttOutbox::hasSendable() const {
+    uint8_t inFlight = 0;
+    bool pending = false;
+    for (uint8_t i = 0; i < CAPACITY; i++) {
+        if (!entries[i].used) {
+            continue;
+        }
+        if (entries[i].inFlight) {
+            inFlight++;
+        } else {
+            pending = true;
+        }
+    }
+    return pending && inFlight < window();
+}
+
+uint32_t MqttOutbox::getRetransmitCount() const {
+    return retransmitCount;
+}
+
+uint32_t MqttOutbox::getDroppedCount() const {
+    return droppedCount;
+}
+
+uint16_t MqttOutbox::reservePacketId() {
+    xSemaphoreTake(lock, portMAX_DELAY);
+    uint16_t packetId = allocatePacketId();
+    xSemaphoreGive(lock);
+    return packetId;
+}
+
+uint16_t MqttOutbox::allocatePacketId() {
+    while (true) {
+        uint16_t candidate = nextPacketId++;
+        if (nextPacketId == 0) {
+            nextPacketId = 1;
+        }
+
+        bool inUse = false;
+        for (uint8_t i = 0; i < CAPACITY; i++) {
+            if (entries[i].used && entries[i].packetId == candidate) {
+                inUse = true;
+                break;
+            }
+        }
+        if (!inUse) {
+            return candidate;
+        }
+    }
+}
+
+uint8_t MqttOutbox::window() const {
+    return receiveMaximum < windowSize ? receiveMaximum : windowSize;
+}
+
+bool MqttOutbox::send(Print& out, const MqttOutboxEntry& entry) {
+    uint8_t header[sizeof(entry.topic) + 10];
+    size_t headerLength = MqttPacket::buildPublishHeader(header, sizeof(header), entry.topic, entry.length,
+                                                         1, entry.retain, entry.dup, entry.packetId,
+                                                         protocolVersion);
+    if (headerLength == 0) {
+        return false;
+    }
+
+    if (out.write(header, headerLength) != headerLength) {
+        return false;
+    }
+    if (entry.length > 0 && out.write(entry.payload, entry.length) != entry.length) {
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,371 @@
+#include "MqttPacket.h"
+
+size_t MqttPacket::encodeRemainingLength(uint32_t length, uint8_t* out) {
+    size_t count = 0;
+    do {
+        uint8_t digit = length % 128;
+        length /= 128;
+        if (length > 0) {
+            digit |= 0x80;
+        }
+        out[count++] = digit;
+    } while (length > 0 && count < 4);
+    return count;
+}
+
+int MqttPacket::decodeRemainingLength(const uint8_t* data, size_t length, uint32_t* value) {
+    uint32_t result = 0;
+    uint32_t multiplier = 1;
+    for (size_t i = 0; i < 4; i++) {
+        if (i >= length) {
+            return 0;
+        }
+        result += (data[i] & 0x7F) * multiplier;
+        if ((data[i] & 0x80) == 0) {
+            *value = result;
+            return (int)(i + 1);
+        }
+        multiplier *= 128;
+    }
+    return -1;
+}
+
+size_t MqttPacket::writeString(uint8_t* out, const char* str) {
+    size_t length = strlen(str);
+    out[0] = (uint8_t)(length >> 8);
+    out[1] = (uint8_t)(length & 0xFF);
+    memcpy(out + 2, str, length);
+    return length + 2;
+}
+
+size_t MqttPacket::buildConnect(uint8_t* buffer, size_t bufferSize, const MqttConnectOptions& options) {
+    bool hasWill = options.willTopic != NULL;
+    bool hasUser = options.username != NULL;
+    bool hasPassword = hasUser && options.password != NULL;
+
+    bool isV5 = options.protocolVersion == MQTT_VERSION_5;
+
+    // MQTT 5的屬性: 只在需要時帶入會話保留時間
+    uint8_t propertiesLength = isV5 && options.sessionExpiry > 0 ? 5 : 0;
+
+    // 可變標頭: 協議名稱(6) + 協議等級(1) + 旗標(1) + 心跳(2) [+ 屬性]
+    uint32_t remaining = 10 + 2 + strlen(options.clientId);
+    if (isV5) {
+        remaining += 1 + propertiesLength;
+    }
+    if (hasWill) {
+        remaining += 2 + strlen(options.willTopic) + 2 + strlen(options.willMessage);
+        if (isV5) {
+            remaining += 1;  // 遺囑屬性長度
+        }
+    }
+    if (hasUser) {
+        remaining += 2 + strlen(options.username);
+    }
+    if (hasPassword) {
+        remaining += 2 + strlen(options.password);
+    }
+
+    // 固定標頭最多5個位元組
+    if (remaining + 5 > bufferSize) {
+        return 0;
+    }
+
+    size_t pos = 0;
+    buffer[pos++] = MQTT_PACKET_CONNECT;
+    pos += encodeRemainingLength(remaining, buffer + pos);
+
+    pos += writeString(buffer + pos, "MQTT");
+    buffer[pos++] = isV5 ? MQTT_VERSION_5 : MQTT_VERSION_3_1_1;
+
+    uint8_t flags = 0;
+    if (options.cleanSession) {
+        flags |= 0x02;
+    }
+    if (hasWill) {
+        flags |= 0x04 | ((options.willQos & 0x03) << 3);
+        if (options.willRetain) {
+            flags |= 0x20;
+        }
+    }
+    if (hasUser) {
+        flags |= 0x80;
+    }
+    if (hasPassword) {
+        flags |= 0x40;
+    }
+    buffer[pos++] = flags;
+    buffer[pos++] = (uint8_t)(options.keepAlive >> 8);
+    buffer[pos++] = (uint8_t)(options.keepAlive & 0xFF);
+
+    if (isV5) {
+        buffer[pos++] = propertiesLength;
+        if (options.sessionExpiry > 0) {
+            buffer[pos++] = MQTT_PROP_SESSION_EXPIRY;
+            buffer[pos++] = (uint8_t)(options.sessionExpiry >> 24);
+            buffer[pos++] = (uint8_t)(options.sessionExpiry >> 16);
+            buffer[pos++] = (uint8_t)(options.sessionExpiry >> 8);
+            buffer[pos++] = (uint8_t)(options.sessionExpiry & 0xFF);
+        }
+    }
+
+    pos += writeString(buffer + pos, options.clientId);
+    if (hasWill) {
+        if (isV5) {
+            buffer[pos++] = 0;
+        }
+        pos += writeString(buffer + pos, options.willTopic);
+        pos += writeString(buffer + pos, options.willMessage);
+    }
+    if (hasUser) {
+        pos += writeString(buffer + pos, options.username);
+    }
+    if (hasPassword) {
+        pos += writeString(buffer + pos, options.password);
+    }
+
+    return pos;
+}
+
+size_t MqttPacket::buildPublishHeader(uint8_t* buffer, size_t bufferSize, const char* topic, size_t payloadLength,
+                                      uint8_t qos, bool retain, bool dup, uint16_t packetId,
+                                      uint8_t version, uint16_t topicAlias) {
+    bool isV5 = version == MQTT_VERSION_5;
+    uint8_t propertiesLength = isV5 && topicAlias != 0 ? 3 : 0;
+    
+    size_t topicLength = strlen(topic);
+    uint32_t remaining = 2 + topicLength + (qos > 0 ? 2 : 0) + (isV5 ? 1 + propertiesLength : 0) + payloadLength;
+    size_t headerLength = 5 + 2 + topicLength + 2 + (isV5 ? 1 + propertiesLength : 0);
+    if (headerLength > bufferSize) {
+        return 0;
+    }
+
+    size_t pos = 0;
+    uint8_t header = MQTT_PACKET_PUBLISH | ((qos & 0x03) << 1);
+    if (retain) {
+        header |= 0x01;
+    }
+    if (dup && qos > 0) {
+        header |= 0x08;
+    }
+    buffer[pos++] = header;
+    pos += encodeRemainingLength(remaining, buffer + pos);
+    pos += writeString(buffer + pos, topic);
+
+    if (qos > 0) {
+        buffer[pos++] = (uint8_t)(packetId >> 8);
+        buffer[pos++] = (uint8_t)(packetId & 0xFF);
+    }
+
+    if (isV5) {
+        buffer[pos++] = propertiesLength;
+        if (topicAlias != 0) {
+            buffer[pos++] = MQTT_PROP_TOPIC_ALIAS;
+            buffer[pos++] = (uint8_t)(topicAlias >> 8);
+            buffer[pos++] = (uint8_t)(topicAlias & 0xFF);
+        }
+    }
+
+    return pos;
+}
+
+size_t MqttPacket::buildSubscription(uint8_t* buffer, size_t bufferSize, uint8_t type, uint16_t packetId,
+                                     const char* filter, uint8_t qos, uint8_t version) {
+    bool isSubscribe = type == MQTT_PACKET_SUBSCRIBE;
+    bool isV5 = version == MQTT_VERSION_5;
+
+    // 封包ID(2) [+ 屬性長度(1)] + 過濾器 [+ 訂閱選項(1)]
+    uint32_t remaining = 2 + (isV5 ? 1 : 0) + 2 + strlen(filter) + (isSubscribe ? 1 : 0);
+    if (remaining + 5 > bufferSize) {
+        return 0;
+    }
+
+    size_t pos = 0;
+    buffer[pos++] = type | 0x02;  // SUBSCRIBE/UNSUBSCRIBE的保留位元固定為0010
+    pos += encodeRemainingLength(remaining, buffer + pos);
+    buffer[pos++] = (uint8_t)(packetId >> 8);
+    buffer[pos++] = (uint8_t)(packetId & 0xFF);
+    if (isV5) {
+        buffer[pos++] = 0;
+    }
+    pos += writeString(buffer + pos, filter);
+    if (isSubscribe) {
+        buffer[pos++] = qos & 0x03;
+    }
+
+    return pos;
+}
+
+size_t MqttPacket::buildSubscribe(uint8_t* buffer, size_t bufferSize, uint16_t packetId, const char* const* filters,
+                                  uint8_t count, uint8_t qos, uint8_t version) {
+    if (count == 0) {
+        return 0;
+    }
+
+    // 封包ID(2) [+ 屬性長度(1)] + 每個過濾器的字串與訂閱選項(1)
+    uint32_t remaining = 2 + (version == MQTT_VERSION_5 ? 1 : 0);
+    for (uint8_t i = 0; i < count; i++) {
+        remaining += 2 + strlen(filters[i]) + 1;
+    }
+    if (remaining + 5 > bufferSize) {
+        return 0;
+    }
+
+    size_t pos = 0;
+    buffer[pos++] = MQTT_PACKET_SUBSCRIBE | 0x02;
+    pos += encodeRemainingLength(remaining, buffer + pos);
+    buffer[pos++] = (uint8_t)(packetId >> 8);
+    buffer[pos++] = (uint8_t)(packetId & 0xFF);
+    if (version == MQTT_VERSION_5) {
+        buffer[pos++] = 0;
+    }
+    for (uint8_t i = 0; i < count; i++) {
+        pos += writeString(buffer + pos, filters[i]);
+        buffer[pos++] = qos & 0x03;
+    }
+
+    return pos;
+}
+
+bool MqttPacket::parseConnack(const uint8_t* data, size_t length, uint8_t* returnCode) {
+    if (length < 4 || data[0] != MQTT_PACKET_CONNACK || data[1] != 0x02) {
+        return false;
+    }
+    *returnCode = data[3];
+    return true;
+}
+
+int MqttPacket::parseConnack5(const uint8_t* data, size_t length, Mqtt5Connack* connack) {
+    if (length < 1) {
+        return 0;
+    }
+    if (data[0] != MQTT_PACKET_CONNACK) {
+        return -1;
+    }
+
+    uint32_t remaining;
+    int lengthBytes = decodeRemainingLength(data + 1, length - 1, &remaining);
+    if (lengthBytes <= 0) {
+        return lengthBytes;
+    }
+
+    size_t total = 1 + lengthBytes + remaining;
+    if (length < total) {
+        return 0;
+    }
+    if (remaining < 2) {
+        return -1;
+    }
+
+    const uint8_t* p = data + 1 + lengthBytes;
+    const uint8_t* end = p + remaining;
+
+    memset(connack, 0, sizeof(*connack));
+    connack->sessionPresent = (p[0] & 0x01) != 0;
+    connack->reasonCode = p[1];
+    connack->receiveMaximum = 65535;
+    p += 2;
+
+    // 舊版伺服器或拒絕連線時可能沒有屬性
+    if (p == end) {
+        return (int)total;
+    }
+
+    uint32_t propertiesLength;
+    int propertyBytes = decodeRemainingLength(p, end - p, &propertiesLength);
+    if (propertyBytes <= 0 || p + propertyBytes + propertiesLength > end) {
+        return -1;
+    }
+    p += propertyBytes;
+    const uint8_t* propertiesEnd = p + propertiesLength;
+
+    while (p < propertiesEnd) {
+        uint8_t id = *p++;
+        size_t available = propertiesEnd - p;
+
+        switch (id) {
+            case MQTT_PROP_RECEIVE_MAXIMUM:
+            case MQTT_PROP_TOPIC_ALIAS_MAXIMUM:
+            case MQTT_PROP_SERVER_KEEP_ALIVE: {
+                if (available < 2) {
+                    return -1;
+                }
+                uint16_t value = ((uint16_t)p[0] << 8) | p[1];
+                if (id == MQTT_PROP_RECEIVE_MAXIMUM) {
+                    connack->receiveMaximum = value;
+                } else if (id == MQTT_PROP_TOPIC_ALIAS_MAXIMUM) {
+                    connack->topicAliasMaximum = value;
+                } else {
+                    connack->serverKeepAlive = value;
+                }
+                p += 2;
+                break;
+            }
+
+            case MQTT_PROP_SESSION_EXPIRY:
+            case MQTT_PROP_MAXIMUM_PACKET_SIZE: {
+                if (available < 4) {
+                    return -1;
+                }
+                uint32_t value = ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+                if (id == MQTT_PROP_MAXIMUM_PACKET_SIZE) {
+                    connack->maximumPacketSize = value;
+                }
+                p += 4;
+                break;
+            }
+
+            // 單一位元組的屬性 (Maximum QoS、Retain Available等)
+            case 0x24:
+            case 0x25:
+            case 0x28:
+            case 0x29:
+            case 0x2A:
+                if (available < 1) {
+                    return -1;
+                }
+                p += 1;
+                break;
+
+            // 字串或二進位資料的屬性 (Assigned Client ID、Reason String等)
+            case MQTT_PROP_ASSIGNED_CLIENT_ID:
+            case 0x15:
+            case 0x16:
+            case 0x1A:
+            case 0x1C:
+            case MQTT_PROP_REASON_STRING: {
+                if (available < 2) {
+                    return -1;
+                }
+                size_t fieldLength = 2 + (((size_t)p[0] << 8) | p[1]);
+                if (available < fieldLength) {
+                    return -1;
+                }
+                p += fieldLength;
+                break;
+            }
+
+            // 使用者屬性 (兩個字串)
+            case 0x26: {
+                for (int i = 0; i < 2; i++) {
+                    available = propertiesEnd - p;
+                    if (available < 2) {
+                        return -1;
+                    }
+                    size_t fieldLength = 2 + (((size_t)p[0] << 8) | p[1]);
+                    if (available < fieldLength) {
+                        return -1;
+                    }
+                    p += fieldLength;
+                }
+                break;
+            }
+
+            default:
+                // 未知的屬性無法得知長度，視為格式錯誤
+                return -1;
+        }
+    }
+
+    return (int)total;
+}
@@ -0,0 +1,63 @@
+#include "MqttStats.h"
+
+// 各直方圖的區間上限
+static const uint32_t PUBLISH_BOUNDS_US[] = {100, 250, 500, 1000, 2500, 5000, 10000, 25000, 50000, 100000, 250000};
+static const uint32_t PING_BOUNDS_MS[] = {10, 25, 50, 100, 250, 500, 1000, 2500, 5000, 10000};
+static const uint32_t RECONNECT_BOUNDS_MS[] = {100, 250, 500, 1000, 2500, 5000, 10000, 30000, 60000, 120000};
+static const uint32_t TLS_BOUNDS_MS[] = {50, 100, 200, 400, 700, 1000, 1500, 2000, 3000, 5000};
+
+#define BOUND_COUNT(bounds) (sizeof(bounds) / sizeof(bounds[0]))
+
+MqttStats::MqttStats()
+    : publishMicros(PUBLISH_BOUNDS_US, BOUND_COUNT(PUBLISH_BOUNDS_US)),
+      pingMillis(PING_BOUNDS_MS, BOUND_COUNT(PING_BOUNDS_MS)),
+      reconnectMillis(RECONNECT_BOUNDS_MS, BOUND_COUNT(RECONNECT_BOUNDS_MS)),
+      inboundMicros(PUBLISH_BOUNDS_US, BOUND_COUNT(PUBLISH_BOUNDS_US)),
+      tlsFullMillis(TLS_BOUNDS_MS, BOUND_COUNT(TLS_BOUNDS_MS)),
+      tlsResumedMillis(TLS_BOUNDS_MS, BOUND_COUNT(TLS_BOUNDS_MS)) {
+    reset();
+}
+
+void MqttStats::encode(JsonDocument& doc) const {
+    doc["up"] = millis() / 1000;
+
+    JsonObject counters = doc.createNestedObject("c");
+    counters["pubOk"] = publishOk;
+    counters["pubFail"] = publishFailed;
+    counters["bytesOut"] = bytesOut;
+    counters["msgIn"] = messagesIn;
+    counters["puback"] = pubacks;
+    counters["ping"] = pings;
+    counters["conn"] = connectAttempts;
+    counters["connFail"] = connectFailures;
+    counters["drop"] = disconnects;
+
+    publishMicros.encode(doc.createNestedObject("pub"));
+    pingMillis.encode(doc.createNestedObject("ping"));
+    reconnectMillis.encode(doc.createNestedObject("reconn"));
+    inboundMicros.encode(doc.createNestedObject("in"));
+
+    if (tlsFullMillis.getCount() > 0 || tlsResumedMillis.getCount() > 0) {
+        tlsFullMillis.encode(doc.createNestedObject("tlsFull"));
+        tlsResumedMillis.encode(doc.createNestedObject("tlsRes"));
+    }
+}
+
+void MqttStats::reset() {
+    publishOk = 0;
+    publishFailed = 0;
+    bytesOut = 0;
+    messagesIn = 0;
+    pubacks = 0;
+    pings = 0;
+    connectAttempts = 0;
+    connectFailures = 0;
+    disconnects = 0;
+
+    publishMicros.reset();
+    pingMillis.reset();
+    reconnectMillis.reset();
+    inboundMicros.reset();
+    tlsFullMillis.reset();
+    tlsResumedMillis.reset();
+}
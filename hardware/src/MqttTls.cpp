@@ -0,0 +1,321 @@
+#include "MqttTls.h"
+#include "Logger.h"
+#include <mbedtls/error.h>
+
+// 序列化後的會話保存在RTC記憶體，重啟後仍保留 (斷電後內容無效，以魔術數字與校驗碼判斷)
+static const uint32_t RTC_SESSION_MAGIC = 0x544C5331;  // "TLS1"
+static const size_t RTC_SESSION_SIZE = 1536;
+
+struct RtcTlsSession {
+    uint32_t magic;
+    uint32_t hostHash;
+    uint32_t length;
+    uint32_t checksum;
+    uint8_t data[RTC_SESSION_SIZE];
+};
+
+RTC_NOINIT_ATTR static RtcTlsSession rtcSession;
+
+// FNV-1a雜湊
+static uint32_t fnv1a(const uint8_t* data, size_t length, uint32_t hash = 2166136261UL) {
+    for (size_t i = 0; i < length; i++) {
+        hash ^= data[i];
+        hash *= 16777619UL;
+    }
+    return hash;
+}
+
+MqttTls::MqttTls()
+    : configured(false),
+      active(false),
+      sessionValid(false),
+      resume(true),
+      resumed(false),
+      offeredSession(false),
+      sawCertificate(false),
+      hostHash(0),
+      host(NULL),
+      handshakeStart(0),
+      handshakeMillis(0),
+      fullCount(0),
+      resumedCount(0) {
+    mbedtls_ssl_init(&ssl);
+    mbedtls_ssl_config_init(&config);
+    mbedtls_entropy_init(&entropy);
+    mbedtls_ctr_drbg_init(&drbg);
+    mbedtls_x509_crt_init(&caChain);
+    mbedtls_net_init(&net);
+    mbedtls_ssl_session_init(&session);
+}
+
+MqttTls::~MqttTls() {
+    end();
+    mbedtls_ssl_session_free(&session);
+    mbedtls_x509_crt_free(&caChain);
+    mbedtls_ssl_config_free(&config);
+    mbedtls_ctr_drbg_free(&drbg);
+    mbedtls_entropy_free(&entropy);
+}
+
+bool MqttTls::configure(const char* caCert, const char* hostname, bool resumeSessions) {
+    int ret;
+
+    if (!configured) {
+        ret = mbedtls_ctr_drbg_seed(&drbg, mbedtls_entropy_func, &entropy, (const unsigned char*)"aiot-mqtt", 9);
+        if (ret != 0) {
+            logError("亂數產生器初始化", ret);
+            return false;
+        }
+
+        ret = mbedtls_ssl_config_defaults(&config, MBEDTLS_SSL_IS_CLIENT, MBEDTLS_SSL_TRANSPORT_STREAM,
+                                          MBEDTLS_SSL_PRESET_DEFAULT);
+        if (ret != 0) {
+            logError("TLS設定", ret);
+            return false;
+        }
+
+        mbedtls_ssl_conf_rng(&config, mbedtls_ctr_drbg_random, &drbg);
+#if defined(MBEDTLS_SSL_SESSION_TICKETS)
+        mbedtls_ssl_conf_session_tickets(&config, MBEDTLS_SSL_SESSION_TICKETS_ENABLED);
+#endif
+        configured = true;
+    }
+
+    mbedtls_x509_crt_free(&caChain);
+    mbedtls_x509_crt_init(&caChain);
+
+    if (caCert != NULL) {
+        // PEM格式的長度必須包含結尾的NUL
+        ret = mbedtls_x509_crt_parse(&caChain, (const unsigned char*)caCert, strlen(caCert) + 1);
+        if (ret != 0) {
+            logError("CA憑證解析", ret);
+            return false;
+        }
+        mbedtls_ssl_conf_ca_chain(&config, &caChain, NULL);
+        mbedtls_ssl_conf_authmode(&config, MBEDTLS_SSL_VERIFY_REQUIRED);
+    } else {
+        LOG_W("未設定CA憑證，TLS不驗證伺服器身分 (僅供本地測試)");
+        mbedtls_ssl_conf_authmode(&config, MBEDTLS_SSL_VERIFY_NONE);
+    }
+
+    resume = resumeSessions;
+    setHostname(hostname);
+    return true;
+}
+
+void MqttTls::setHostname(const char* hostname) {
+    host = hostname;
+
+    uint32_t newHash = fnv1a((const uint8_t*)hostname, strlen(hostname));
+    if (newHash != hostHash) {
+        // 換了伺服器，舊會話不可再用
+        if (sessionValid) {
+            mbedtls_ssl_session_free(&session);
+            mbedtls_ssl_session_init(&session);
+            sessionValid = false;
+        }
+        hostHash = newHash;
+    }
+
+    if (resume && !sessionValid) {
+        restoreSession();
+    }
+}
+
+bool MqttTls::begin(int sock) {
+    end();
+
+    if (!configured) {
+        return false;
+    }
+
+    mbedtls_ssl_init(&ssl);
+    int ret = mbedtls_ssl_setup(&ssl, &config);
+    if (ret != 0) {
+        logError("TLS連線建立", ret);
+        mbedtls_ssl_free(&ssl);
+        return false;
+    }
+    active = true;
+
+    if (host != NULL) {
+        mbedtls_ssl_set_hostname(&ssl, host);
+    }
+
+    offeredSession = false;
+    if (resume && sessionValid) {
+        offeredSession = mbedtls_ssl_set_session(&ssl, &session) == 0;
+    }
+
+    net.fd = sock;
+    mbedtls_ssl_set_bio(&ssl, &net, mbedtls_net_send, mbedtls_net_recv, NULL);
+
+    sawCertificate = false;
+    handshakeStart = millis();
+    return true;
+}
+
+MqttTls::HandshakeResult MqttTls::handshake() {
+    if (!active) {
+        return HANDSHAKE_FAILED;
+    }
+
+    // 逐步推進，才能觀察到是否經過伺服器憑證階段 (會話恢復時會略過)
+    while (ssl.state != MBEDTLS_SSL_HANDSHAKE_OVER) {
+        int ret = mbedtls_ssl_handshake_step(&ssl);
+        if (ssl.state == MBEDTLS_SSL_SERVER_CERTIFICATE) {
+            sawCertificate = true;
+        }
+
+        if (ret == MBEDTLS_ERR_SSL_WANT_READ || ret == MBEDTLS_ERR_SSL_WANT_WRITE) {
+            return HANDSHAKE_PENDING;
+        }
+        if (ret != 0) {
+            logError("TLS握手", ret);
+            if (offeredSession) {
+                // 伺服器可能不接受舊會話的參數，下次改用完整握手
+                clearSession();
+            }
+            return HANDSHAKE_FAILED;
+        }
+    }
+
+    handshakeMillis = millis() - handshakeStart;
+    resumed = offeredSession && !sawCertificate;
+    if (resumed) {
+        resumedCount++;
+    } else {
+        fullCount++;
+    }
+    LOG_I("TLS%s握手完成，耗時 %lu ms", resumed ? "會話恢復" : "完整", handshakeMillis);
+
+    // 快取本次的會話 (可能包含新的Session Ticket)
+    if (resume) {
+        mbedtls_ssl_session_free(&session);
+        mbedtls_ssl_session_init(&session);
+        sessionValid = mbedtls_ssl_get_session(&ssl, &session) == 0;
+        if (sessionValid) {
+            persistSession();
+        }
+    }
+
+    return HANDSHAKE_DONE;
+}
+
+int MqttTls::send(const uint8_t* data, size_t length) {
+    if (!active) {
+        return -1;
+    }
+
+    int ret = mbedtls_ssl_write(&ssl, data, length);
+    if (ret > 0) {
+        return ret;
+    }
+    if (ret == MBEDTLS_ERR_SSL_WANT_READ || ret == MBEDTLS_ERR_SSL_WANT_WRITE) {
+        return 0;
+    }
+
+    logError("TLS寫入", ret);
+    return -1;
+}
+
+int MqttTls::recv(uint8_t* data, size_t length) {
+    if (!active) {
+        return -1;
+    }
+
+    int ret = mbedtls_ssl_read(&ssl, data, length);
+    if (ret > 0) {
+        return ret;
+    }
+    if (ret == MBEDTLS_ERR_SSL_WANT_READ || ret == MBEDTLS_ERR_SSL_WANT_WRITE) {
+        return 0;
+    }
+
+    if (ret != 0 && ret != MBEDTLS_ERR_SSL_PEER_CLOSE_NOTIFY) {
+        logError("TLS讀取", ret);
+    }
+    return -1;
+}
+
+size_t MqttTls::pending() const {
+    return active ? mbedtls_ssl_get_bytes_avail(&ssl) : 0;
+}
+
+void MqttTls::end() {
+    if (!active) {
+        return;
+    }
+
+    // 盡力送出close_notify，socket已關閉時會直接失敗
+    mbedtls_ssl_close_notify(&ssl);
+    mbedtls_ssl_free(&ssl);
+    active = false;
+}
+
+void MqttTls::clearSession() {
+    mbedtls_ssl_session_free(&session);
+    mbedtls_ssl_session_init(&session);
+    sessionValid = false;
+    rtcSession.magic = 0;
+}
+
+bool MqttTls::hasSession() const {
+    return sessionValid;
+}
+
+bool MqttTls::wasResumed() const {
+    return resumed;
+}
+
+unsigned long MqttTls::getHandshakeMillis() const {
+    return handshakeMillis;
+}
+
+uint32_t MqttTls::getFullHandshakes() const {
+    return fullCount;
+}
+
+uint32_t MqttTls::getResumedHandshakes() const {
+    return resumedCount;
+}
+
+void MqttTls::persistSession() {
+    size_t length = 0;
+    int ret = mbedtls_ssl_session_save(&session, rtcSession.data, sizeof(rtcSession.data), &length);
+    if (ret != 0) {
+        // 保留伺服器憑證時會話可能超過RTC空間，只在記憶體中快取
+        rtcSession.magic = 0;
+        LOG_D("TLS會話無法寫入RTC記憶體 (錯誤 -0x%04X)", (unsigned)-ret);
+        return;
+    }
+
+    rtcSession.hostHash = hostHash;
+    rtcSession.length = length;
+    rtcSession.checksum = fnv1a(rtcSession.data, length, hostHash);
+    rtcSession.magic = RTC_SESSION_MAGIC;
+}
+
+void MqttTls::restoreSession() {
+    if (rtcSession.magic != RTC_SESSION_MAGIC || rtcSession.hostHash != hostHash ||
+        rtcSession.length > sizeof(rtcSession.data) ||
+        rtcSession.checksum != fnv1a(rtcSession.data, rtcSession.length, hostHash)) {
+        return;
+    }
+
+    if (mbedtls_ssl_session_load(&session, rtcSession.data, rtcSession.length) == 0) {
+        sessionValid = true;
+        LOG_I("已從RTC記憶體載入TLS會話，將嘗試恢復");
+    } else {
+        // mbedTLS版本或設定不同，內容無法使用
+        mbedtls_ssl_session_free(&session);
+        mbedtls_ssl_session_init(&session);
+        rtcSession.magic = 0;
+    }
+}
+
+void MqttTls::logError(const char* action, int code) {
+    char message[64];
+    mbedtls_strerror(code, message, sizeof(message));
+    LOG_W("%s失敗: -0x%04X %s", action, (unsigned)-code, message);
+}
@@ -0,0 +1,42 @@
+#include "MqttTopicTable.h"
+
+// 格式化到固定緩衝區，內容被截斷時返回false
+static bool format(char* buffer, size_t size, const char* pattern, const char* a, const char* b = "",
+                   const char* c = "") {
+    int written = snprintf(buffer, size, pattern, a, b, c);
+    return written >= 0 && written < (int)size;
+}
+
+bool MqttTopicTable::build(const char* baseTopic, const char* commandTopic, const char* room, const char* deviceId) {
+    strncpy(roomId, room, sizeof(roomId) - 1);
+    roomId[sizeof(roomId) - 1] = '\0';
+    bool complete = strlen(room) < sizeof(roomId);
+    bool hasRoom = roomId[0] != '\0';
+    const char* roomLevel = hasRoom ? roomId : "unknown";
+
+    if (hasRoom) {
+        complete = format(roomTopic, sizeof(roomTopic), "%s/%s", baseTopic, roomId) && complete;
+        complete = format(commandRoomTopic, sizeof(commandRoomTopic), "%s/%s", commandTopic, roomId) && complete;
+    } else {
+        roomTopic[0] = '\0';
+        commandRoomTopic[0] = '\0';
+    }
+    complete = format(deviceTopic, sizeof(deviceTopic), "%s/%s/%s", baseTopic, roomLevel, deviceId) && complete;
+    complete = format(commandDeviceTopic, sizeof(commandDeviceTopic), "%s/%s/%s", commandTopic, roomLevel,
+                      deviceId) && complete;
+
+    complete = format(capabilityTopic, sizeof(capabilityTopic), "%s/capabilities", deviceTopic) && complete;
+    complete = format(encodingTopic, sizeof(encodingTopic), "%s/encoding", deviceTopic) && complete;
+    complete = format(configTopic, sizeof(configTopic), "%s/config", deviceTopic) && complete;
+    complete = format(diagTopic, sizeof(diagTopic), "%s/diag", deviceTopic) && complete;
+    complete = format(logTopic, sizeof(logTopic), "%s/log", deviceTopic) && complete;
+    complete = format(shadowTopic, sizeof(shadowTopic), "%s/shadow", deviceTopic) && complete;
+    complete = format(shadowDeltaTopic, sizeof(shadowDeltaTopic), "%s/shadow/delta", deviceTopic) && complete;
+    complete = format(shadowGetTopic, sizeof(shadowGetTopic), "%s/shadow/get", deviceTopic) && complete;
+    complete = format(shadowHistoryTopic, sizeof(shadowHistoryTopic), "%s/shadow/history", deviceTopic) && complete;
+    return complete;
+}
+
+bool MqttTopicTable::roomChanged(const char* room) const {
+    return strcmp(roomId, room) != 0;
+}
@@ -0,0 +1,190 @@
+#include "PayloadTemplate.h"
+#include <math.h>
+#include <string.h>
+
+// 超出此範圍時ArduinoJson改用指數表示，不在這裡處理
+static const double POSITIVE_EXPONENTIATION_THRESHOLD = 1e7;
+static const double NEGATIVE_EXPONENTIATION_THRESHOLD = 1e-5;
+
+PayloadTemplate::PayloadTemplate() {
+    clear();
+}
+
+void PayloadTemplate::clear() {
+    textLength = 0;
+    slotCount = 0;
+    valid = true;
+    text[0] = '\0';
+}
+
+bool PayloadTemplate::appendLiteral(const char* literal) {
+    size_t length = strlen(literal);
+    if (!valid || textLength + length > sizeof(text)) {
+        valid = false;
+        return false;
+    }
+
+    memcpy(text + textLength, literal, length);
+    textLength += length;
+    return true;
+}
+
+bool PayloadTemplate::appendString(const char* value) {
+    if (!appendLiteral("\"")) {
+        return false;
+    }
+
+    // 與ArduinoJson相同，只跳脫引號、反斜線與有簡寫的控制字元
+    for (const char* p = value; *p != '\0'; p++) {
+        char escaped = 0;
+        switch (*p) {
+            case '"': escaped = '"'; break;
+            case '\\': escaped = '\\'; break;
+            case '\b': escaped = 'b'; break;
+            case '\f': escaped = 'f'; break;
+            case '\n': escaped = 'n'; break;
+            case '\r': escaped = 'r'; break;
+            case '\t': escaped = 't'; break;
+            default: break;
+        }
+
+        size_t needed = escaped ? 2 : 1;
+        if (textLength + needed > sizeof(text)) {
+            valid = false;
+            return false;
+        }
+        if (escaped) {
+            text[textLength++] = '\\';
+            text[textLength++] = escaped;
+        } else {
+            text[textLength++] = *p;
+        }
+    }
+
+    return appendLiteral("\"");
+}
+
+bool PayloadTemplate::appendSlot() {
+    if (!valid || slotCount >= MAX_SLOTS) {
+        valid = false;
+        return false;
+    }
+
+    slotOffsets[slotCount++] = textLength;
+    return true;
+}
+
+bool PayloadTemplate::isValid() const {
+    return valid;
+}
+
+uint8_t PayloadTemplate::getSlotCount() const {
+    return slotCount;
+}
+
+size_t PayloadTemplate::render(const double* values, uint8_t count, char* buffer, size_t bufferSize) const {
+    if (!valid || count != slotCount) {
+        return 0;
+    }
+
+    size_t written = 0;
+    size_t copied = 0;
+
+    for (uint8_t i = 0; i <= slotCount; i++) {
+        // 複製到下一個欄位 (或結尾) 為止的靜態文字
+        size_t end = i < slotCount ? slotOffsets[i] : textLength;
+        size_t length = end - copied;
+        if (written + length > bufferSize) {
+            return 0;
+        }
+        memcpy(buffer + written, text + copied, length);
+        written += length;
+        copied = end;
+
+        if (i == slotCount) {
+            break;
+        }
+
+        char number[NUMBER_BUFFER_SIZE];
+        size_t numberLength = formatNumber(values[i], number);
+        if (numberLength == 0 || written + numberLength > bufferSize) {
+            return 0;
+        }
+        memcpy(buffer + written, number, numberLength);
+        written += numberLength;
+    }
+
+    return written;
+}
+
+size_t PayloadTemplate::formatNumber(double value, char* buffer) {
+    if (isnan(value) || isinf(value)) {
+        return 0;
+    }
+
+    size_t length = 0;
+    if (value < 0.0) {
+        buffer[length++] = '-';
+        value = -value;
+    }
+
+    if (value >= POSITIVE_EXPONENTIATION_THRESHOLD ||
+        (value > 0 && value <= NEGATIVE_EXPONENTIATION_THRESHOLD)) {
+        return 0;
+    }
+
+    // 定點拆成整數與小數部分，有效位數與ArduinoJson的FloatParts相同 (整數位數 + 小數位數 = 10)
+    uint32_t maxDecimalPart = 1000000000;
+    int8_t decimalPlaces = 9;
+
+    uint32_t integral = (uint32_t)value;
+    for (uint32_t tmp = integral; tmp >= 10; tmp /= 10) {
+        maxDecimalPart /= 10;
+        decimalPlaces--;
+    }
+
+    double remainder = (value - (double)integral) * (double)maxDecimalPart;
+    uint32_t decimal = (uint32_t)remainder;
+    remainder -= (double)decimal;
+
+    // 四捨五入
+    decimal += (uint32_t)(remainder * 2);
+    if (decimal >= maxDecimalPart) {
+        decimal = 0;
+        integral++;
+    }
+
+    // 去除小數結尾的0
+    while (decimal % 10 == 0 && decimalPlaces > 0) {
+        decimal /= 10;
+        decimalPlaces--;
+    }
+
+    length += writeInteger(integral, buffer + length);
+
+    if (decimalPlaces > 0) {
+        buffer[length++] = '.';
+        // 補足前導的0
+        for (int8_t i = decimalPlaces - 1; i >= 0; i--) {
+            buffer[length + i] = '0' + decimal % 10;
+            decimal /= 10;
+        }
+        length += decimalPlaces;
+    }
+
+    return length;
+}
+
+size_t PayloadTemplate::writeInteger(uint32_t value, char* buffer) {
+    char digits[10];
+    size_t count = 0;
+    do {
+        digits[count++] = '0' + value % 10;
+        value /= 10;
+    } while (value != 0);
+
+    for (size_t i = 0; i < count; i++) {
+        buffer[i] = digits[count - 1 - i];
+    }
+    return count;
+}
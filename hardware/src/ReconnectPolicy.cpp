@@ -0,0 +1,71 @@
+#include "ReconnectPolicy.h"
+
+ReconnectPolicy::ReconnectPolicy(unsigned long baseDelay, unsigned long maxDelay, unsigned long fastDelay)
+    : _baseDelay(baseDelay),
+      _maxDelay(maxDelay),
+      _fastDelay(fastDelay),
+      _attempt(0),
+      _fastPath(false),
+      _state(0x9E3779B9) {
+}
+
+void ReconnectPolicy::seed(const char* deviceId) {
+    // FNV-1a雜湊
+    uint32_t hash = 2166136261u;
+    for (const char* p = deviceId; *p != '\0'; p++) {
+        hash ^= (uint8_t)*p;
+        hash *= 16777619u;
+    }
+
+    // xorshift的狀態不可為0
+    _state = hash != 0 ? hash : 0x9E3779B9;
+}
+
+void ReconnectPolicy::configure(unsigned long baseDelay, unsigned long maxDelay) {
+    _baseDelay = baseDelay;
+    _maxDelay = maxDelay;
+}
+
+unsigned long ReconnectPolicy::nextDelay() {
+    if (_fastPath) {
+        _fastPath = false;
+        return _fastDelay;
+    }
+
+    // 上限 = min(maxDelay, baseDelay * 2^attempt)，避免位移溢位
+    unsigned long ceiling = _baseDelay;
+    for (uint8_t i = 0; i < _attempt && ceiling < _maxDelay; i++) {
+        ceiling <<= 1;
+    }
+    if (ceiling > _maxDelay) {
+        ceiling = _maxDelay;
+    }
+
+    if (_attempt < 31) {
+        _attempt++;
+    }
+
+    // 完全抖動: 在 [0, ceiling] 中取亂數
+    return nextRandom() % (ceiling + 1);
+}
+
+void ReconnectPolicy::onConnected() {
+    _attempt = 0;
+    _fastPath = false;
+}
+
+void ReconnectPolicy::onDisconnected(bool clean) {
+    _attempt = 0;
+    _fastPath = clean;
+}
+
+uint8_t ReconnectPolicy::getAttempt() const {
+    return _attempt;
+}
+
+uint32_t ReconnectPolicy::nextRandom() {
+    _state ^= _state << 13;
+    _state ^= _state >> 17;
+    _state ^= _state << 5;
+    return _state;
+}
@@ -92,6 +92,31 @@ bool StorageManager::loadBool(const char* key, bool defaultValue) {
     return result;
 }
 
+bool StorageManager::saveBytes(const char* key, const void* data, size_t length) {
+    if (key == nullptr || data == nullptr) {
+        return false;
+    }
+    
+    begin(false);
+    bool success = _preferences.putBytes(key, data, length) == length;
+    end();
+    return success;
+}
+
+size_t StorageManager::loadBytes(const char* key, void* buffer, size_t maxLength) {
+    if (key == nullptr || buffer == nullptr) {
+        return 0;
+    }
+    
+    begin(true);
+    size_t length = 0;
+    if (_preferences.isKey(key)) {
+        length = _preferences.getBytes(key, buffer, maxLength);
+    }
+    end();
+    return length;
+}
+
 bool StorageManager::deleteKey(const char* key) {
     if (key == nullptr) {
         return false;
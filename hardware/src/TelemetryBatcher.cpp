@@ -0,0 +1,82 @@
+#include "TelemetryBatcher.h"
+
+TelemetryBatcher::TelemetryBatcher()
+    : _count(0),
+      _batchSize(1),
+      _maxLatency(0) {
+}
+
+void TelemetryBatcher::configure(uint8_t batchSize, unsigned long maxLatency) {
+    if (batchSize > MAX_BATCH_SIZE) {
+        batchSize = MAX_BATCH_SIZE;
+    }
+    _batchSize = batchSize > 0 ? batchSize : 1;
+    _maxLatency = maxLatency;
+}
+
+bool TelemetryBatcher::isEnabled() const {
+    return _batchSize > 1;
+}
+
+void TelemetryBatcher::add(const TelemetrySample& sample) {
+    if (_count < MAX_BATCH_SIZE) {
+        _samples[_count++] = sample;
+    }
+}
+
+bool TelemetryBatcher::isReady(unsigned long currentMillis) const {
+    if (_count == 0) {
+        return false;
+    }
+
+    if (_count >= _batchSize) {
+        return true;
+    }
+
+    return currentMillis - _samples[0].capturedMillis >= _maxLatency;
+}
+
+size_t TelemetryBatcher::count() const {
+    return _count;
+}
+
+const TelemetrySample& TelemetryBatcher::at(size_t index) const {
+    return _samples[index];
+}
+
+void TelemetryBatcher::encode(JsonDocument& doc) const {
+    doc["batch"] = _count;
+    if (_count > 0 && _samples[0].timestamp != 0) {
+        doc["t0"] = _samples[0].timestamp;
+    }
+    doc["scale"] = VALUE_SCALE;
+
+    JsonArray dt = doc.createNestedArray("dt");
+    JsonArray temp = doc.createNestedArray("temp");
+    JsonArray humidity = doc.createNestedArray("humidity");
+
+    int32_t prevTemp = 0;
+    int32_t prevHumidity = 0;
+    uint32_t prevMillis = _count > 0 ? _samples[0].capturedMillis : 0;
+
+    for (uint8_t i = 0; i < _count; i++) {
+        int32_t t = scaled(_samples[i].temperature);
+        int32_t h = scaled(_samples[i].humidity);
+
+        dt.add(_samples[i].capturedMillis - prevMillis);
+        temp.add(t - prevTemp);
+        humidity.add(h - prevHumidity);
+
+        prevMillis = _samples[i].capturedMillis;
+        prevTemp = t;
+        prevHumidity = h;
+    }
+}
+
+void TelemetryBatcher::clear() {
+    _count = 0;
+}
+
+int32_t TelemetryBatcher::scaled(float value) {
+    return (int32_t)lroundf(value * VALUE_SCALE);
+}
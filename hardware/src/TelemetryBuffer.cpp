@@ -0,0 +1,191 @@
+#include "TelemetryBuffer.h"
+#include "Logger.h"
+
+TelemetryBuffer::TelemetryBuffer(size_t capacity, StorageManager* spillStorage, size_t spillPages)
+    : _capacity(capacity > 0 ? capacity : 1),
+      _head(0),
+      _count(0),
+      _storage(spillStorage),
+      _spillPages(spillPages),
+      _spillHead(0),
+      _spillTail(0),
+      _bootSpillHead(0),
+      _pageCount(0),
+      _pagePos(0),
+      _dropped(0) {
+    _ring = new TelemetrySample[_capacity];
+}
+
+TelemetryBuffer::~TelemetryBuffer() {
+    delete[] _ring;
+}
+
+void TelemetryBuffer::begin() {
+    if (!spillEnabled()) {
+        return;
+    }
+
+    _spillHead = (uint32_t)_storage->loadInt("tb_head", 0);
+    _spillTail = (uint32_t)_storage->loadInt("tb_tail", 0);
+
+    // 索引不合理時重置
+    if (_spillHead - _spillTail > _spillPages) {
+        _spillHead = 0;
+        _spillTail = 0;
+        saveSpillIndex();
+    }
+    _bootSpillHead = _spillHead;
+
+    if (_spillHead != _spillTail) {
+        LOG_I("遙測緩衝區: Flash中尚有 %u 頁未送出", (unsigned)(_spillHead - _spillTail));
+    }
+}
+
+bool TelemetryBuffer::spillEnabled() const {
+    return _storage != nullptr && _spillPages > 0 && _capacity >= SPILL_PAGE_SAMPLES;
+}
+
+void TelemetryBuffer::push(const TelemetrySample& sample) {
+    if (_count == _capacity) {
+        // RAM已滿，優先溢出到Flash
+        if (!spillEnabled() || !spillOldestPage()) {
+            _head = (_head + 1) % _capacity;
+            _count--;
+            _dropped++;
+        }
+    }
+
+    _ring[(_head + _count) % _capacity] = sample;
+    _count++;
+}
+
+bool TelemetryBuffer::peek(TelemetrySample& sample, bool* previousBoot) {
+    // Flash中的頁面比RAM中的樣本更舊，優先送出
+    while (_pageCount == 0 && _spillHead != _spillTail) {
+        loadSpillPage();
+    }
+
+    if (_pageCount > 0) {
+        sample = _page[_pagePos];
+        if (previousBoot != nullptr) {
+            *previousBoot = (int32_t)(_spillTail - _bootSpillHead) < 0;
+        }
+        return true;
+    }
+
+    if (_count > 0) {
+        sample = _ring[_head];
+        if (previousBoot != nullptr) {
+            *previousBoot = false;
+        }
+        return true;
+    }
+
+    return false;
+}
+
+void TelemetryBuffer::pop() {
+    if (_pageCount > 0) {
+        if (++_pagePos >= _pageCount) {
+            releaseSpillPage();
+        }
+        return;
+    }
+
+    if (_count > 0) {
+        _head = (_head + 1) % _capacity;
+        _count--;
+    }
+}
+
+size_t TelemetryBuffer::size() const {
+    // 載入中的頁面仍在Flash索引中，扣掉已送出與讀取時缺少的樣本
+    size_t spilled = (_spillHead - _spillTail) * SPILL_PAGE_SAMPLES;
+    if (_pageCount > 0) {
+        spilled -= SPILL_PAGE_SAMPLES - (_pageCount - _pagePos);
+    }
+    return _count + spilled;
+}
+
+bool TelemetryBuffer::isEmpty() const {
+    return size() == 0;
+}
+
+uint32_t TelemetryBuffer::getDroppedCount() const {
+    return _dropped;
+}
+
+bool TelemetryBuffer::spillOldestPage() {
+    // Flash已滿時丟棄最舊的一頁 (正在送出時丟棄其餘未送出的樣本)
+    if (_spillHead - _spillTail >= _spillPages) {
+        if (_pageCount > 0) {
+            _dropped += _pageCount - _pagePos;
+            releaseSpillPage();
+        } else {
+            char key[16];
+            pageKey(_spillTail, key, sizeof(key));
+            _storage->deleteKey(key);
+            _spillTail++;
+            _dropped += SPILL_PAGE_SAMPLES;
+        }
+    }
+
+    TelemetrySample page[SPILL_PAGE_SAMPLES];
+    for (size_t i = 0; i < SPILL_PAGE_SAMPLES; i++) {
+        page[i] = _ring[(_head + i) % _capacity];
+    }
+
+    char key[16];
+    pageKey(_spillHead, key, sizeof(key));
+    if (!_storage->saveBytes(key, page, sizeof(page))) {
+        LOG_W("遙測緩衝區: 寫入Flash失敗");
+        return false;
+    }
+
+    _spillHead++;
+    saveSpillIndex();
+
+    _head = (_head + SPILL_PAGE_SAMPLES) % _capacity;
+    _count -= SPILL_PAGE_SAMPLES;
+    return true;
+}
+
+bool TelemetryBuffer::loadSpillPage() {
+    char key[16];
+    pageKey(_spillTail, key, sizeof(key));
+
+    size_t length = _storage->loadBytes(key, _page, sizeof(_page));
+    _pageCount = length / sizeof(TelemetrySample);
+    _pagePos = 0;
+
+    if (_pageCount < SPILL_PAGE_SAMPLES) {
+        _dropped += SPILL_PAGE_SAMPLES - _pageCount;
+    }
+
+    if (_pageCount == 0) {
+        LOG_W("遙測緩衝區: 無法讀取Flash頁面 %u，已跳過", (unsigned)_spillTail);
+        releaseSpillPage();
+        return false;
+    }
+    return true;
+}
+
+void TelemetryBuffer::releaseSpillPage() {
+    char key[16];
+    pageKey(_spillTail, key, sizeof(key));
+    _storage->deleteKey(key);
+    _spillTail++;
+    saveSpillIndex();
+
+    _pageCount = 0;
+    _pagePos = 0;
+}
+
+void TelemetryBuffer::saveSpillIndex() {
+    _storage->saveInt("tb_head", (int)_spillHead);
+    _storage->saveInt("tb_tail", (int)_spillTail);
+}
+
+void TelemetryBuffer::pageKey(uint32_t sequence, char* key, size_t keySize) const {
+    snprintf(key, keySize, "tb_p%u", (unsigned)(sequence % _spillPages));
+}
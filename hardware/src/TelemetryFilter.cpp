@@ -0,0 +1,81 @@
+#include "TelemetryFilter.h"
+
+TelemetryFilter::TelemetryFilter()
+    : _enabled(false),
+      _hasLast(false),
+      _temperatureDeadband(1.0f),
+      _humidityDeadband(1.0f),
+      _heartbeat(300000),
+      _lastTemperature(0),
+      _lastHumidity(0),
+      _lastReportMillis(0),
+      _suppressedCount(0),
+      _heartbeatCount(0) {
+}
+
+void TelemetryFilter::configure(float temperatureDeadband, float humidityDeadband, unsigned long heartbeat) {
+    _temperatureDeadband = temperatureDeadband >= 0 ? temperatureDeadband : 0;
+    _humidityDeadband = humidityDeadband >= 0 ? humidityDeadband : 0;
+    _heartbeat = heartbeat;
+}
+
+void TelemetryFilter::setEnabled(bool enabled) {
+    if (enabled && !_enabled) {
+        _hasLast = false;
+    }
+    _enabled = enabled;
+}
+
+bool TelemetryFilter::isEnabled() const {
+    return _enabled;
+}
+
+bool TelemetryFilter::shouldReport(const TelemetrySample& sample) {
+    if (!_enabled) {
+        return true;
+    }
+
+    bool report = !_hasLast;
+
+    if (!report) {
+        // DHT11解析度為1，死區設為1即代表只在讀數改變時回報
+        report = fabsf(sample.temperature - _lastTemperature) >= _temperatureDeadband ||
+                 fabsf(sample.humidity - _lastHumidity) >= _humidityDeadband;
+    }
+
+    if (!report && _heartbeat > 0 && sample.capturedMillis - _lastReportMillis >= _heartbeat) {
+        report = true;
+        _heartbeatCount++;
+    }
+
+    if (!report) {
+        _suppressedCount++;
+        return false;
+    }
+
+    _hasLast = true;
+    _lastTemperature = sample.temperature;
+    _lastHumidity = sample.humidity;
+    _lastReportMillis = sample.capturedMillis;
+    return true;
+}
+
+uint32_t TelemetryFilter::getSuppressedCount() const {
+    return _suppressedCount;
+}
+
+uint32_t TelemetryFilter::getHeartbeatCount() const {
+    return _heartbeatCount;
+}
+
+float TelemetryFilter::getTemperatureDeadband() const {
+    return _temperatureDeadband;
+}
+
+float TelemetryFilter::getHumidityDeadband() const {
+    return _humidityDeadband;
+}
+
+unsigned long TelemetryFilter::getHeartbeat() const {
+    return _heartbeat;
+}
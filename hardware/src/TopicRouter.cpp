@@ -0,0 +1,302 @@
+#include "TopicRouter.h"
+
+// 比較層級名稱 (依位元組順序，較短的前綴排在前面)
+static int compareSegment(const char* a, size_t aLength, const char* b, size_t bLength) {
+    int result = memcmp(a, b, aLength < bLength ? aLength : bLength);
+    if (result != 0) {
+        return result;
+    }
+    return aLength < bLength ? -1 : (aLength > bLength ? 1 : 0);
+}
+
+TopicRouter::TopicRouter()
+    : root(createNode(NULL, 0)),
+      filterCount(0) {
+}
+
+TopicRouter::~TopicRouter() {
+    destroyNode(root);
+}
+
+bool TopicRouter::add(const char* filter, MqttTopicHandler handler) {
+    if (!isValidFilter(filter) || !handler) {
+        return false;
+    }
+
+    Node* node = root;
+    const char* level = filter;
+    while (true) {
+        const char* end = strchr(level, '/');
+        size_t length = end != NULL ? (size_t)(end - level) : strlen(level);
+
+        if (length == 1 && level[0] == '+') {
+            if (node->plusChild == NULL) {
+                node->plusChild = createNode(level, length);
+            }
+            node = node->plusChild;
+        } else if (length == 1 && level[0] == '#') {
+            if (node->hashChild == NULL) {
+                node->hashChild = createNode(level, length);
+            }
+            node = node->hashChild;
+        } else {
+            node = child(node, level, length, true);
+        }
+
+        if (end == NULL) {
+            break;
+        }
+        level = end + 1;
+    }
+
+    if (node->handlers == NULL) {
+        filterCount++;
+    }
+
+    // 加在串列尾端，維持註冊順序
+    HandlerEntry* entry = new HandlerEntry{handler, NULL};
+    HandlerEntry** tail = &node->handlers;
+    while (*tail != NULL) {
+        tail = &(*tail)->next;
+    }
+    *tail = entry;
+    return true;
+}
+
+bool TopicRouter::remove(const char* filter) {
+    if (!isValidFilter(filter)) {
+        return false;
+    }
+
+    Node* node = root;
+    const char* level = filter;
+    while (node != NULL) {
+        const char* end = strchr(level, '/');
+        size_t length = end != NULL ? (size_t)(end - level) : strlen(level);
+
+        if (length == 1 && level[0] == '+') {
+            node = node->plusChild;
+        } else if (length == 1 && level[0] == '#') {
+            node = node->hashChild;
+        } else {
+            node = child(node, level, length, false);
+        }
+
+        if (end == NULL) {
+            break;
+        }
+        level = end + 1;
+    }
+
+    if (node == NULL || node->handlers == NULL) {
+        return false;
+    }
+
+    // 保留空節點，過濾器數量少且之後常會再次註冊
+    clearHandlers(node);
+    filterCount--;
+    return true;
+}
+
+size_t TopicRouter::dispatch(const char* topic, const uint8_t* payload, unsigned int length) const {
+    return match(root, topic, topic, true, payload, length);
+}
+
+void TopicRouter::forEachFilter(MqttFilterVisitor visitor) const {
+    char path[MAX_FILTER_LENGTH + 1];
+    path[0] = '\0';
+    visit(root, path, 0, true, visitor);
+}
+
+size_t TopicRouter::size() const {
+    return filterCount;
+}
+
+bool TopicRouter::isValidFilter(const char* filter) {
+    size_t length = strlen(filter);
+    if (length == 0 || length > MAX_FILTER_LENGTH) {
+        return false;
+    }
+
+    for (size_t i = 0; i < length; i++) {
+        char c = filter[i];
+        if (c != '+' && c != '#') {
+            continue;
+        }
+
+        bool startsLevel = i == 0 || filter[i - 1] == '/';
+        bool endsLevel = i + 1 == length || filter[i + 1] == '/';
+        if (!startsLevel || !endsLevel) {
+            return false;
+        }
+        if (c == '#' && i + 1 != length) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+TopicRouter::Node* TopicRouter::createNode(const char* segment, size_t length) {
+    Node* node = new Node();
+    node->segment = NULL;
+    node->segmentLength = length;
+    if (segment != NULL) {
+        node->segment = new char[length + 1];
+        memcpy(node->segment, segment, length);
+        node->segment[length] = '\0';
+    }
+    node->children = NULL;
+    node->childCount = 0;
+    node->childCapacity = 0;
+    node->plusChild = NULL;
+    node->hashChild = NULL;
+    node->handlers = NULL;
+    return node;
+}
+
+void TopicRouter::destroyNode(Node* node) {
+    if (node == NULL) {
+        return;
+    }
+
+    for (uint16_t i = 0; i < node->childCount; i++) {
+        destroyNode(node->children[i]);
+    }
+    delete[] node->children;
+    destroyNode(node->plusChild);
+    destroyNode(node->hashChild);
+
+    clearHandlers(node);
+    delete[] node->segment;
+    delete node;
+}
+
+void TopicRouter::clearHandlers(Node* node) {
+    HandlerEntry* entry = node->handlers;
+    while (entry != NULL) {
+        HandlerEntry* next = entry->next;
+        delete entry;
+        entry = next;
+    }
+    node->handlers = NULL;
+}
+
+TopicRouter::Node* TopicRouter::child(Node* parent, const char* segment, size_t length, bool create) {
+    size_t low = 0;
+    size_t high = parent->childCount;
+    while (low < high) {
+        size_t middle = (low + high) / 2;
+        const Node* node = parent->children[middle];
+        int result = compareSegment(node->segment, node->segmentLength, segment, length);
+        if (result == 0) {
+            return parent->children[middle];
+        }
+        if (result < 0) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+
+    if (!create) {
+        return NULL;
+    }
+
+    // 陣列已滿時加倍容量 (只在註冊時發生)
+    if (parent->childCount == parent->childCapacity) {
+        uint16_t capacity = parent->childCapacity > 0 ? parent->childCapacity * 2 : 2;
+        Node** children = new Node*[capacity];
+        if (parent->childCount > 0) {
+            memcpy(children, parent->children, parent->childCount * sizeof(Node*));
+        }
+        delete[] parent->children;
+        parent->children = children;
+        parent->childCapacity = capacity;
+    }
+
+    Node* node = createNode(segment, length);
+    memmove(parent->children + low + 1, parent->children + low, (parent->childCount - low) * sizeof(Node*));
+    parent->children[low] = node;
+    parent->childCount++;
+    return node;
+}
+
+size_t TopicRouter::match(const Node* node, const char* topic, const char* level, bool firstLevel,
+                          const uint8_t* payload, unsigned int length) {
+    // 以 $ 開頭的系統主題不符合第一層的萬用字元
+    bool wildcardAllowed = !(firstLevel && level[0] == '$');
+    size_t count = 0;
+
+    // # 也符合父層級本身，例如 "a/#" 符合 "a"
+    if (wildcardAllowed && node->hashChild != NULL) {
+        count += invoke(node->hashChild, topic, payload, length);
+    }
+
+    const char* end = strchr(level, '/');
+    size_t levelLength = end != NULL ? (size_t)(end - level) : strlen(level);
+
+    const Node* exact = child(const_cast<Node*>(node), level, levelLength, false);
+    const Node* plus = wildcardAllowed ? node->plusChild : NULL;
+
+    if (end == NULL) {
+        if (exact != NULL) {
+            count += invoke(exact, topic, payload, length);
+            if (exact->hashChild != NULL) {
+                count += invoke(exact->hashChild, topic, payload, length);
+            }
+        }
+        if (plus != NULL) {
+            count += invoke(plus, topic, payload, length);
+            if (plus->hashChild != NULL) {
+                count += invoke(plus->hashChild, topic, payload, length);
+            }
+        }
+        return count;
+    }
+
+    if (exact != NULL) {
+        count += match(exact, topic, end + 1, false, payload, length);
+    }
+    if (plus != NULL) {
+        count += match(plus, topic, end + 1, false, payload, length);
+    }
+    return count;
+}
+
+size_t TopicRouter::invoke(const Node* node, const char* topic, const uint8_t* payload, unsigned int length) {
+    size_t count = 0;
+    for (HandlerEntry* entry = node->handlers; entry != NULL; entry = entry->next) {
+        entry->handler(topic, payload, length);
+        count++;
+    }
+    return count;
+}
+
+void TopicRouter::visit(const Node* node, char* path, size_t pathLength, bool isRoot,
+                        const MqttFilterVisitor& visitor) {
+    if (node->handlers != NULL) {
+        visitor(path);
+    }
+
+    // 一般子節點之後是 + 與 # 子節點
+    size_t total = node->childCount + 2;
+    for (size_t i = 0; i < total; i++) {
+        const Node* current = i < node->childCount ? node->children[i]
+                            : (i == node->childCount ? node->plusChild : node->hashChild);
+        if (current == NULL) {
+            continue;
+        }
+
+        size_t next = pathLength + (isRoot ? 0 : 1) + current->segmentLength;
+        if (next <= MAX_FILTER_LENGTH) {
+            if (!isRoot) {
+                path[pathLength] = '/';
+            }
+            memcpy(path + next - current->segmentLength, current->segment, current->segmentLength);
+            path[next] = '\0';
+            visit(current, path, next, false, visitor);
+            path[pathLength] = '\0';
+        }
+    }
+}
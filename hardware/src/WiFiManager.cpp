@@ -205,6 +205,13 @@ String WiFiManager::getRoomID() const {
     return "";
 }
 
+const char* WiFiManager::getRoomIDCStr() const {
+    if (_hasRoomID) {
+        return _roomID;
+    }
+    return "";
+}
+
 bool WiFiManager::hasRoomID() const {
     return _hasRoomID;
 }
@@ -11,7 +11,11 @@
 #include "DisplayManager.h" // 顯示管理器
 #include "TimeManager.h" // 時間管理器
 #include "IRManager.h" // IR管理器
+#include "IRCodeLibrary.h" // IR碼庫
 #include "MQTTManager.h" // MQTT管理器
+#include "Logger.h"      // 非同步日誌
+#include "TelemetryBuffer.h" // 遙測暫存緩衝區
+#include "SeqLock.h"         // 序號鎖共享快照
 
 // 前向宣告
 void handleWiFiCredentials(const char* message);
@@ -39,42 +43,91 @@ TimeManager timeManager("pool.ntp.org", 28800, 0, &wifiManager);
 // 創建IRManager實例
 IRManager irManager(IR_LED_PIN, IR_RECV_PIN);
 
+// 具名IR碼庫 (獨立的NVS命名空間，第一次使用時才載入索引)
+StorageManager irCodeStorage("ircodes");
+IRCodeLibrary irCodeLibrary(&irCodeStorage);
+
 // FreeRTOS相關定義
 #define CORE_0 0  // 通訊核心
 #define CORE_1 1  // 顯示核心
 #define TASK_STACK_SIZE 4096  // 減少到4KB以節省內存
+// MQTT任務另外配置：mbedTLS握手 (憑證解析、ECDHE) 在此任務中執行，需要約10KB堆疊
+#define MQTT_TASK_STACK_SIZE (AIOT_MQTT_TLS ? 12288 : 6144)
 #define MQTT_PRIORITY 1
 #define DISPLAY_PRIORITY 2
 #define DHT_PRIORITY 1
 
-// 互斥鎖用於保護共享數據
-SemaphoreHandle_t mutex = NULL;
-
 // 任務句柄
 TaskHandle_t mqttTaskHandle = NULL;
 TaskHandle_t displayTaskHandle = NULL;
 TaskHandle_t dhtTaskHandle = NULL; 
 
-// 共享數據結構
+// 共享數據結構 - 只由DHT任務寫入，MQTT與顯示任務以序號鎖讀取快照，不需互斥鎖
 struct SharedData {
   float temperature;
   float humidity;
-} sharedData;
+};
+SeqLock<SharedData> sharedData;
 
 // 設備ID
 String deviceId = "";
 
-// MQTT設定
-const char* mqtt_server = "broker.emqx.io";
-const int mqtt_port = 1883;
+// MQTT設定 (可在platformio.ini以build flag覆寫，例如指向本地broker做壓力測試)
+#ifndef AIOT_MQTT_SERVER
+#define AIOT_MQTT_SERVER "broker.emqx.io"
+#endif
+#ifndef AIOT_MQTT_TLS
+#define AIOT_MQTT_TLS 0  // 1: 以TLS連線 (mbedTLS)
+#endif
+#ifndef AIOT_MQTT_CA_CERT
+#define AIOT_MQTT_CA_CERT NULL  // PEM格式的CA憑證，NULL代表不驗證伺服器 (只適合本地測試)
+#endif
+#ifndef AIOT_MQTT_PORT
+#define AIOT_MQTT_PORT (AIOT_MQTT_TLS ? 8883 : 1883)
+#endif
+#ifndef AIOT_MQTT_FALLBACK_PORT
+#define AIOT_MQTT_FALLBACK_PORT AIOT_MQTT_PORT  // 備援伺服器埠 (AIOT_MQTT_FALLBACK_SERVER未定義時不使用)
+#endif
+#ifndef AIOT_MQTT_PUBLISH_INTERVAL
+#define AIOT_MQTT_PUBLISH_INTERVAL 5000
+#endif
+#ifndef AIOT_MQTT_PERSISTENT_SESSION
+#define AIOT_MQTT_PERSISTENT_SESSION 0  // 1: 固定客戶端ID + clean session = false，伺服器保留離線期間的QoS 1命令
+#endif
+#ifndef AIOT_IR_LEGACY_TOPIC
+#define AIOT_IR_LEGACY_TOPIC 0  // 1: 同時訂閱全域的esp32/ir_control (所有裝置都會發射)
+#endif
+#ifndef AIOT_IR_RX_POLLING
+#define AIOT_IR_RX_POLLING 0  // 1: IR接收改回每10ms輪詢 (用於比較，預設以邊緣中斷喚醒)
+#endif
+#ifndef AIOT_MQTT_POLLING
+#define AIOT_MQTT_POLLING 0  // 1: MQTT任務改回每10ms輪詢 (用於比較，預設等待socket與任務通知)
+#endif
+#ifndef AIOT_TELEMETRY_TEMPLATE
+#define AIOT_TELEMETRY_TEMPLATE 0  // 1: 單筆遙測以預先序列化範本發布 (尚未在ArduinoJson上逐位元組驗證)
+#endif
+#ifndef AIOT_TELEMETRY_SHADOW
+#define AIOT_TELEMETRY_SHADOW 0  // 1: 裝置影子模式 (完整狀態保留訊息 + 差異更新)
+#endif
+#ifndef AIOT_MQTT_PROTOCOL
+#define AIOT_MQTT_PROTOCOL 4  // 4: MQTT 3.1.1 (PubSubClient), 5: MQTT 5
+#endif
+#ifndef AIOT_MQTT_SESSION_EXPIRY
+#define AIOT_MQTT_SESSION_EXPIRY 0  // MQTT 5會話保留秒數
+#endif
+
+const char* mqtt_server = AIOT_MQTT_SERVER;
+const int mqtt_port = AIOT_MQTT_PORT;
 const char* mqtt_topic = "esp32/sensors";
 const char* client_id = "ESP32_Client_";
 const long mqttIconBlinkInterval = 500;
 
-// MQTT客戶端設定
-WiFiClient espClient;
-// 創建MQTTManager實例
-MQTTManager mqttManager(&espClient, &wifiManager, &mutex, mqtt_server, mqtt_port, mqtt_topic, client_id, 5000, 5000, mqttIconBlinkInterval);
+// 創建MQTTManager實例 (內部使用非阻塞的MqttLink連線)
+MQTTManager mqttManager(&wifiManager, mqtt_server, mqtt_port, mqtt_topic, client_id, 5000, AIOT_MQTT_PUBLISH_INTERVAL, mqttIconBlinkInterval);
+
+// 斷線期間的遙測暫存 (RAM 64筆，溢出時最多8頁寫入Flash)
+StorageManager telemetryStorage("telemetry");
+TelemetryBuffer telemetryBuffer(64, &telemetryStorage, 8);
 
 // MQTT 主題設定 - 在全局添加
 String mqttTopic = "esp32/device/";   // 將附加 deviceId/dht11
@@ -107,7 +160,7 @@ const long dhtInterval = 2000;
 U8G2_SH1106_128X64_NONAME_F_HW_I2C u8g2(U8G2_R0, /* reset=*/U8X8_PIN_NONE);
 
 // 創建DisplayManager實例
-DisplayManager displayManager(&u8g2, &wifiManager, &bleManager, &timeManager, &mutex, mqttIconBlinkInterval);
+DisplayManager displayManager(&u8g2, &wifiManager, &bleManager, &timeManager, mqttIconBlinkInterval);
 
 // BLE狀態改變回調
 void onBLEStatusChange(bool connected, const String& message) {
@@ -150,39 +203,108 @@ void handleWiFiCredentials(const char* message) {
   }
 }
 
-// MQTT回調函數
-void mqtt_callback(const char* topic, byte* payload, unsigned int length) {
-  // 簡化處理方式，減少內存使用
-  if (length > 0) {
-    // 將 payload 轉換為 null 結尾的字串
-    payload[length] = '\0';
-    String payloadStr = String((char*)payload);
-    
-    // 嘗試使用IRManager處理消息
-    if (irManager.handleMQTTMessage(topic, payloadStr.c_str())) {
-      // 如果IRManager已處理，則返回
-      return;
-    }
-    
-    // 可以在這裡處理來自Flutter的其他命令
-  }
+// 日誌轉送到MQTT - 只在已連線時經由獨立的日誌佇列以QoS 0送出，
+// 不佔用QoS 1佇列，QoS 1佇列已滿的警告也不會再被轉送回佇列
+bool mqttLogSink(uint8_t level, const char* line) {
+  return mqttManager.forwardLog(line);
 }
 
 // MQTT通訊任務
 void mqttTask(void *parameter) {
+  unsigned long lastStatsLog = 0;
+  uint32_t lastWakeups = 0;
+  uint64_t lastBusyMicros = 0;
+  IRReceiveStats lastRxStats = IRReceiveStats();
+  
   while (true) {    // 使用MQTTManager處理連接和消息循環
     mqttManager.loop();
     
-    // 獲取當前傳感器數據
-    xSemaphoreTake(mutex, portMAX_DELAY);
-    float temp = sharedData.temperature;
-    float humid = sharedData.humidity;
-    xSemaphoreGive(mutex);
+    // 定期輸出QoS 1佇列狀態
+    if (millis() - lastStatsLog >= 60000) {
+      lastStatsLog = millis();
+      LOG_I("QoS1 在途: %u 佇列: %u 重送: %u 丟棄: %u",
+                    mqttManager.getInFlightDepth(), mqttManager.getOutboxDepth(),
+                    (unsigned)mqttManager.getRetransmitCount(), (unsigned)mqttManager.getOutboxDropped());
+      
+      LOG_I("遙測抑制: %u 範本發布: %u 日誌丟棄: %u", (unsigned)mqttManager.getSuppressedCount(),
+                    (unsigned)mqttManager.getTemplatePublishCount(), (unsigned)Logger::getDroppedCount());
+      const MqttTls* tls = mqttManager.getTls();
+      if (tls != NULL) {
+        const MqttStats& stats = mqttManager.getStats();
+        LOG_I("TLS握手 完整: %u 次 平均 %u ms 恢復: %u 次 平均 %u ms",
+                      (unsigned)tls->getFullHandshakes(), (unsigned)stats.tlsFullMillis.getMean(),
+                      (unsigned)tls->getResumedHandshakes(), (unsigned)stats.tlsResumedMillis.getMean());
+      }
+      const BrokerPool& brokers = mqttManager.getBrokerPool();
+      if (brokers.count() > 1) {
+        for (uint8_t i = 0; i < brokers.count(); i++) {
+          const BrokerEndpoint& broker = brokers.at(i);
+          LOG_I("MQTT伺服器%s%u %s 分數: %u 連線: %u ms RTT: %u ms 失敗: %u/%u",
+                        i == brokers.currentIndex() ? "*" : " ", (unsigned)i, broker.host,
+                        (unsigned)brokers.score(i, millis()), (unsigned)broker.connectMillis,
+                        (unsigned)broker.rttMillis, (unsigned)broker.failures,
+                        (unsigned)(broker.connects + broker.failures));
+        }
+      }
+      if (mqttManager.getProtocolVersion() == MQTT_VERSION_5) {
+        LOG_I("MQTT 5 別名省下: %u 位元組 最近原因碼: 0x%02X",
+                      (unsigned)mqttManager.getAliasBytesSaved(), mqttManager.getLastReasonCode());
+      }
+      // 輸出這60秒內的增量，兩種模式以相同的指標比較
+      uint32_t wakeups = mqttManager.getWakeupCount();
+      uint64_t busyMicros = mqttManager.getBusyMicros();
+      LOG_I("MQTT任務(%s) 每分鐘喚醒: %u 忙碌: %llu us 收訊延遲: %lu/%lu us",
+                    AIOT_MQTT_POLLING ? "輪詢" : "事件", (unsigned)(wakeups - lastWakeups),
+                    (unsigned long long)(busyMicros - lastBusyMicros),
+                    mqttManager.getInboundLatencyMicros(), mqttManager.getMaxInboundLatencyMicros());
+      lastWakeups = wakeups;
+      lastBusyMicros = busyMicros;
+      // ESP32的堆疊高水位以位元組為單位
+      LOG_I("MQTT任務 堆疊: %u 位元組 最少剩餘: %u 位元組",
+                    (unsigned)MQTT_TASK_STACK_SIZE, (unsigned)uxTaskGetStackHighWaterMark(NULL));
+      
+      IRTransmitStats irStats = irManager.getTransmitStats();
+      LOG_I("IR發射 已送: %u 溢位: %u 群組略過: %u 入列: %lu/%lu us 發射: %lu/%lu us",
+                    (unsigned)irStats.sent, (unsigned)irStats.overflow, (unsigned)irStats.groupFiltered,
+                    irStats.lastEnqueueMicros, irStats.maxEnqueueMicros,
+                    irStats.lastEmitMicros, irStats.maxEmitMicros);
+      
+      IRReceiveStats rxStats = irManager.getReceiveStats();
+      LOG_I("IR接收(%s) 每分鐘喚醒: %u 訊框: %u 雜訊: %u decode: %u 忙碌: %llu us 延遲: %lu/%lu us",
+                    rxStats.edgeDriven ? "中斷" : "輪詢", (unsigned)(rxStats.wakeups - lastRxStats.wakeups),
+                    (unsigned)(rxStats.frames - lastRxStats.frames),
+                    (unsigned)(rxStats.spurious - lastRxStats.spurious),
+                    (unsigned)(rxStats.decodeCalls - lastRxStats.decodeCalls),
+                    (unsigned long long)(rxStats.busyMicros - lastRxStats.busyMicros),
+                    rxStats.lastLatencyMicros, rxStats.maxLatencyMicros);
+      lastRxStats = rxStats;
+      
+      IRCodeLibraryStats codeStats = irCodeLibrary.getStats();
+      LOG_I("IR碼庫 筆數: %u 快取命中: %u 讀取Flash: %u 寫入: %u 失敗: %u",
+                    (unsigned)codeStats.codes, (unsigned)codeStats.hits, (unsigned)codeStats.misses,
+                    (unsigned)codeStats.stores, (unsigned)codeStats.failures);
+      
+      LOG_I("共享資料 寫入: %u 讀取重試: %u 畫面繪製: %lu/%lu us",
+                    (unsigned)sharedData.getWriteCount(), (unsigned)sharedData.getRetryCount(),
+                    displayManager.getFrameMicros(), displayManager.getMaxFrameMicros());
+    }
     
-    // 發布傳感器數據
-    mqttManager.publishSensorData(temp, humid);
+    // 只在到達發布時間時才讀取共享的傳感器數據
+    if (mqttManager.isPublishDue()) {
+      SharedData data = sharedData.read();
+      
+      // 發布傳感器數據
+      mqttManager.publishSensorData(data.temperature, data.humidity);
+    }
     
-    vTaskDelay(10 / portTICK_PERIOD_MS);
+#if AIOT_MQTT_POLLING
+    // 比較用的舊行為：固定每10ms輪詢一次 (仍計入喚醒次數)
+    vTaskDelay(pdMS_TO_TICKS(10));
+    mqttManager.waitForEvent(0);
+#else
+    // 等待socket資料、其他任務的通知或下一個期限，不再固定輪詢
+    mqttManager.waitForEvent(1000);
+#endif
   }
 }
 
@@ -204,10 +326,11 @@ void dhtTask(void *parameter) {
       if (!isnan(newTemp) && !isnan(newHum)) {
         readSuccess = true;
         
-        xSemaphoreTake(mutex, portMAX_DELAY);
-        sharedData.temperature = newTemp;
-        sharedData.humidity = newHum;
-        xSemaphoreGive(mutex);
+        SharedData data = {newTemp, newHum};
+        sharedData.write(data);
+        
+        // 通知MQTT任務有新的讀數
+        mqttManager.notify();
       } else {
         retryCount++;
         vTaskDelay(500 / portTICK_PERIOD_MS);
@@ -225,20 +348,18 @@ void displayTask(void *parameter) {
   
   while (true) {
   // 使用DisplayManager更新主畫面或顯示IR數據
-    xSemaphoreTake(mutex, portMAX_DELAY);
-    float temp = sharedData.temperature;
-    float humid = sharedData.humidity;
+    // 讀取快照後再繪圖，I2C傳輸期間不持有任何與網路任務共用的鎖
+    SharedData data = sharedData.read();
     bool isMqttConnected = mqttManager.isConnected();
     bool isMqttTransmitting = mqttManager.isTransmitting();
     unsigned long mqttIconBlinkMillis = mqttManager.getIconBlinkMillis();
-    xSemaphoreGive(mutex);
     
     // 優先顯示IR數據，如果有的話
     bool hasIrData = displayManager.showIRData();
     
     // 如果沒有IR數據要顯示，則顯示主畫面
     if (!hasIrData) {
-      displayManager.updateMainScreen(temp, humid, isMqttConnected, isMqttTransmitting, mqttIconBlinkMillis);
+      displayManager.updateMainScreen(data.temperature, data.humidity, isMqttConnected, isMqttTransmitting, mqttIconBlinkMillis);
     }
     
     vTaskDelay(displayInterval / portTICK_PERIOD_MS);
@@ -249,21 +370,21 @@ void setup() {
   // 初始化序列通訊
   Serial.begin(115200);
   
+  // 啟動日誌輸出任務 (低優先權，在核心1上執行)
+  Logger::begin(1, CORE_1);
+  
   // 初始化設備ID（使用MAC地址）
   deviceId = WiFi.macAddress();
   deviceId.replace(":", ""); // 移除冒號使其更簡潔
   Serial.println("裝置ID: " + deviceId);
   
-  // 創建互斥鎖
-  mutex = xSemaphoreCreateMutex();
-  
-  // 初始化共享數據
-  memset(&sharedData, 0, sizeof(sharedData));
   // DHT11 初始化
   pinMode(DHTPIN, INPUT);
   dht.begin();
     // 初始化紅外線發射器
   irManager.setDisplayManager(&displayManager);  // 連接顯示管理器
+  irManager.setConfigManager(&configManager);   // 載入IR群組設定
+  irManager.setCodeLibrary(&irCodeLibrary);     // 啟用play/store/learn/delete命令
   irManager.begin();
   
   // LED控制器初始化
@@ -291,24 +412,48 @@ void setup() {
   }
   
   // 初始化MQTT管理器
+  telemetryBuffer.begin();
+  mqttManager.setTelemetryBuffer(&telemetryBuffer);
+  mqttManager.setProtocolVersion(AIOT_MQTT_PROTOCOL, AIOT_MQTT_SESSION_EXPIRY);
+  if (AIOT_MQTT_TLS) {
+    mqttManager.setTls(AIOT_MQTT_CA_CERT);
+  }
+  mqttManager.setPersistentSession(AIOT_MQTT_PERSISTENT_SESSION);
+  mqttManager.setSampleTemplate(AIOT_TELEMETRY_TEMPLATE);
+  mqttManager.setShadowMode(AIOT_TELEMETRY_SHADOW);
+#ifdef AIOT_MQTT_FALLBACK_SERVER
+  mqttManager.addBroker(AIOT_MQTT_FALLBACK_SERVER, AIOT_MQTT_FALLBACK_PORT);
+#endif
+  
+  // 註冊主題處理函數 (連線後自動訂閱)
+  // IR命令只訂閱本裝置與本房間的主題: esp32/cmd/{roomId}/{deviceId}/ir 與 esp32/cmd/{roomId}/ir
+  mqttManager.onScoped("ir", [](const char* topic, const uint8_t* payload, unsigned int length) {
+    irManager.handleCommand(payload, length);
+  });
+  if (AIOT_IR_LEGACY_TOPIC) {
+    mqttManager.on(irManager.getIRControlTopic(), [](const char* topic, const uint8_t* payload, unsigned int length) {
+      irManager.handleMQTTMessage(topic, payload, length);
+    });
+  }
+  
   mqttManager.begin(deviceId);
-  mqttManager.setCallback(mqtt_callback);
   
-  // 訂閱必要的主題
+  // 警告以上的日誌轉送到 {deviceTopic}/log，最多連續2筆，之後每10秒1筆
+  Logger::setSink(mqttLogSink, AIOT_LOG_LEVEL_WARN, 2, 10000);
+  
+  // 發布IR接收器狀態
   if (mqttManager.isConnected()) {
-    mqttManager.subscribe("esp32/commands");
-    mqttManager.subscribe(irManager.getIRControlTopic());
     mqttManager.publish(irManager.getIRReceiveTopic(), "IR接收器已啟動", true);
   }
   
   // 啟動IR接收任務
-  irManager.startReceiverTask(&mqttManager);
+  irManager.startReceiverTask(&mqttManager, !AIOT_IR_RX_POLLING);
   
   // 創建任務
   xTaskCreatePinnedToCore(
     mqttTask,
     "MQTTTask",
-    TASK_STACK_SIZE,
+    MQTT_TASK_STACK_SIZE,
     NULL,
     MQTT_PRIORITY,
     &mqttTaskHandle,